@@ -103,11 +103,13 @@ DemoGLFW::init()
 
 	// Load resources
 	mesh_.load( pathDataIn_ + "box_triangles.obj" );
-	meshtfb_.load( pathDataIn_ + "box_triangles.obj" );
-	//meshtfb_.create( mesh_.getPrimitivesCount(),
-	//				 mesh_.getVertexCount(),
-	//				 mesh_.getPrimitivesType(),
-	//				 mesh_.getVertexFormat( 0 ) );
+	meshtfb_.create( mesh_.getPrimitivesCount(),
+					 mesh_.getVertexCount(),
+					 mesh_.getPrimitivesType(),
+					 mesh_.getVertexAttributeFormat( 0 ),
+					 VERTEX_FORMAT_NONE,
+					 mesh_.getVertexAttributeFormat( 2 ) );
+	meshtfb_.getPrimitivesPtr()->share( *mesh_.getPrimitivesPtr() );
 
 	
 	//texture_.load( pathDataIn_ + "world.200406.3x512x512.bmp" );
@@ -116,13 +118,9 @@ DemoGLFW::init()
 	//texture_.load( pathDataIn_ + "world.200406.3x512x512_monochrome.pfm" );
 	//texture_.load( pathDataIn_ + "world.200406.3x512x512.dds" );
 	texture_.create( 512, 512, TEXTURE_FORMAT_RGB_32F );
-	for ( unsigned int i = 0; i < 512; ++i )
-	{
-		for ( unsigned int j = 0; j < 512; ++j )
-		{
-			texture_.getMipLevePtr( 0 )->set<Vec3f>( i, j, Vec3f( 1, 0, 0 ) );
-		}
-	}
+	TypedView<Vec3f, ALLOC_FORMAT_VEC3_32F> texels(
+		*texture_.getMipLevePtr( 0 ) );
+	texels.forEach( []( Vec3f& texel ) { texel = Vec3f( 1, 0, 0 ); } );
 	vertexShader_.load( pathShaders_ + "pass_through.vert" );
 	tessCtrlShader_.load( pathShaders_ + "pass_through.tesc" );
 	tessEvalShader_.load( pathShaders_ + "pass_through.tese" );
@@ -176,6 +174,7 @@ void
 DemoGLFW::draw()
 {
 	frame_++;
+	Loader::newFrame();
 
 
 	// update scene
@@ -198,13 +197,13 @@ DemoGLFW::keyboardPressFunc( const int _key, const float _x, const float _y,
 		switch ( _key )
 		{
 		case KEYBOARD_KEY_R:
-			mesh_.reload();
-			texture_.reload();
-			vertexShader_.reload();
-			tessCtrlShader_.reload();
-			tessEvalShader_.reload();
-			geometryShader_.reload();
-			fragmentShader_.reload();
+			mesh_.reloadAsync();
+			texture_.reloadAsync();
+			vertexShader_.reloadAsync();
+			tessCtrlShader_.reloadAsync();
+			tessEvalShader_.reloadAsync();
+			geometryShader_.reloadAsync();
+			fragmentShader_.reloadAsync();
 			break;
 		case KEYBOARD_KEY_S:
 			renderState_.downloadBuffers();
@@ -149,6 +149,10 @@ DemoQt5::paintGL()
 	frame_++;
 
 
+	// swap in reloaded files
+	Loader::newFrame();
+
+
 	// update scene
 	root_.update();
 
@@ -188,12 +192,12 @@ DemoQt5::keyPressEvent( QKeyEvent* _e )
 		switch ( _e->key() )
 		{
 		case KEYBOARD_KEY_R:
-			mesh_.reload();
-			vertexShader_.reload();
-			tessCtrlShader_.reload();
-			tessEvalShader_.reload();
-			geometryShader_.reload();
-			fragmentShader_.reload();
+			mesh_.reloadAsync();
+			vertexShader_.reloadAsync();
+			tessCtrlShader_.reloadAsync();
+			tessEvalShader_.reloadAsync();
+			geometryShader_.reloadAsync();
+			fragmentShader_.reloadAsync();
 			break;
 		case KEYBOARD_KEY_S:
 			mesh_.save( pathDataOut_ + "box_quads.obj" );
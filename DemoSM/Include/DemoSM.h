@@ -101,6 +101,10 @@ private:
 	void createPrimitiveCube( const float _size,
 							  const PRIM_TYPE _primType = PRIM_TYPE_TRIANGLE );
 
+	void benchmarkMeshLoading();
+
+	void checkMeshMove();
+
 private:
 	
 	// Global paths
@@ -122,6 +126,7 @@ private:
 	// Rendering
 	RenderState depthRenderState_;
 	RenderState shadowsRenderState_;
+	Allocator visiblePrimitives_;
 
 	
 	// Nodes
@@ -8,6 +8,7 @@
 //== INCLUDES ==================================================================
 
 #include "DemoSM.h"
+#include <chrono>
 
 
 //== CLASS IMPLEMENTATION ======================================================
@@ -104,14 +105,21 @@ DemoSM::init()
 	orbi_.setCamera( &cam_ );
 
 
-	// Load resources
-	mesh_.load( pathDataIn_ + "town_triangles.obj" );
+	// Load resources, the town in narrow formats the shaders still read as
+	// floats, and 16 bit indices as it has few enough vertices. The files
+	// are read in parallel on the loader workers
+	mesh_.setLoadFormat( 0, VERTEX_FORMAT_XYZ_16F );
+	mesh_.setLoadFormat( 2, VERTEX_FORMAT_XYZW_2_10_10_10 );
+	mesh_.setLoadFormat( 8, VERTEX_FORMAT_XY_16F );
+	mesh_.loadAsync( pathDataIn_ + "town_triangles.obj" );
+	depthVertexShader_.loadAsync( pathShaders_ + "depth.vert" );
+	depthFragmentShader_.loadAsync( pathShaders_ + "depth.frag" );
+	shadowsVertexShader_.loadAsync( pathShaders_ + "shadows.vert" );
+	shadowsFragmentShader_.loadAsync( pathShaders_ + "shadows.frag" );
 	colorTexture_.create( 1024, 1024, TEXTURE_FORMAT_R_32F );
 	depthTexture_.create( 1024, 1024, TEXTURE_FORMAT_R_32F );
-	depthVertexShader_.load( pathShaders_ + "depth.vert" );
-	depthFragmentShader_.load( pathShaders_ + "depth.frag" );
-	shadowsVertexShader_.load( pathShaders_ + "shadows.vert" );
-	shadowsFragmentShader_.load( pathShaders_ + "shadows.frag" );
+	Loader::finishLoads();
+	mesh_.buildMeshlets();
 
 
 	// Setup depth render state
@@ -131,11 +139,17 @@ DemoSM::init()
 
 	// setup shadows render state
 	shadowsRenderState_.setClear( true, Vec4f::ZERO, true, 1 );
-	shadowsRenderState_.setCulling( false, CULL_FACE_BACK );
+	shadowsRenderState_.setCulling( true, CULL_FACE_BACK );
 	shadowsRenderState_.setDepthTest( true, true, DEPTH_FUNC_LEQUAL );
 	shadowsRenderState_.setViewportPtr( cam_.getViewportWidthPtr(),
 									  cam_.getViewportHeightPtr() );
 	shadowsRenderState_.setMesh( &mesh_ );
+
+	// the camera only sees part of the town, its triangles come from a
+	// store culled every frame, the first cull allocates it
+	mesh_.cullMeshlets( cam_, objPivot_.getDerivedTransform(),
+						&visiblePrimitives_ );
+	shadowsRenderState_.setVertexIndexData( &visiblePrimitives_ );
 	shadowsRenderState_.setVertexShader( &shadowsVertexShader_ );
 	shadowsRenderState_.setFragmentShader( &shadowsFragmentShader_ );
 	shadowsRenderState_.setTexture( &depthTexture_, TEXTURE_UNIT_0 );
@@ -167,12 +181,21 @@ void
 DemoSM::draw()
 {
 	frame_++;
+	RenderState::newFrame();
+	AllocatorFactory::newFrame();
+	Loader::newFrame();
 
 
 	// update scene
 	root_.update();
 
 
+	// only draw the meshlets the camera can see
+	MeshLoader::CULLSTATS stats = mesh_.cullMeshlets( cam_,
+		objPivot_.getDerivedTransform(), &visiblePrimitives_ );
+	shadowsRenderState_.setDrawRange( 0, stats.primitivesCount );
+
+
 	// Draw each Render State
 	depthRenderState_.draw();
 	shadowsRenderState_.draw();
@@ -202,11 +225,11 @@ DemoSM::keyboardPressFunc( const int _key, const float _x, const float _y,
 		switch ( _key )
 		{
 		case KEYBOARD_KEY_R:
-			//mesh_.reload();
-			depthVertexShader_.reload();
-			depthFragmentShader_.reload();
-			shadowsVertexShader_.reload();
-			shadowsFragmentShader_.reload();
+			//mesh_.reloadAsync();
+			depthVertexShader_.reloadAsync();
+			depthFragmentShader_.reloadAsync();
+			shadowsVertexShader_.reloadAsync();
+			shadowsFragmentShader_.reloadAsync();
 			break;
 		case KEYBOARD_KEY_S:
 			depthRenderState_.downloadBuffers();
@@ -215,6 +238,19 @@ DemoSM::keyboardPressFunc( const int _key, const float _x, const float _y,
 			depthTexture_.save( pathDataOut_ + "depthTexture_.pfm" );
 			mesh_.save( pathDataOut_ + "mesh_.obj" );
 			break;
+		case KEYBOARD_KEY_B:
+			benchmarkMeshLoading();
+			break;
+		case KEYBOARD_KEY_V:
+			checkMeshMove();
+			break;
+		case KEYBOARD_KEY_U:
+			GEM_CONSOLE( "Uploaded " << RenderState::getLastFrameUploadByteCount()
+						 << " bytes to Buffer Objects last frame." );
+			break;
+		case KEYBOARD_KEY_M:
+			AllocatorFactory::printStats();
+			break;
 		default:
 			//
 			break;
@@ -231,6 +267,120 @@ DemoSM::keyboardReleaseFunc( const int _key, const float _x, const float _y,
 	orbi_.mousePressFunc( _key, _x, _y, _mousestate, _modifiers );
 }
 
+//-- benchmarks and checks -------------------------------------------------
+
+void
+DemoSM::benchmarkMeshLoading()
+{
+	// meshes in the data folder and number of loads per parser
+	const char* names[] = { "box_quads.obj", "box_triangles.obj",
+							"head_cutout.obj", "head_quads.obj", "quad.obj",
+							"sphere.obj", "town_quads.obj",
+							"town_triangles.obj" };
+	const unsigned int nameCount = sizeof( names ) / sizeof( names[0] );
+	const unsigned int loadCount = 10;
+	const PARSE_MODE modes[] = { PARSE_MODE_STREAM, PARSE_MODE_BUFFERED,
+								 PARSE_MODE_PARALLEL, PARSE_MODE_BUFFERED };
+	const bool caches[] = { false, false, false, true };
+	const unsigned int modeCount = sizeof( modes ) / sizeof( modes[0] );
+
+
+	// mute the loaders while timing
+	std::streambuf* console = std::cout.rdbuf( NULL );
+	std::ostringstream report;
+	report << std::fixed << std::setprecision( 2 );
+	for ( unsigned int i = 0; i < nameCount; ++i )
+	{
+		report << '\n' << std::setw( 20 ) << names[i];
+		double first = 0;
+		for ( unsigned int j = 0; j < modeCount; ++j )
+		{
+			MeshLoader mesh;
+			mesh.setParseMode( modes[j] );
+			mesh.setCacheEnabled( caches[j] );
+			if ( caches[j] )
+				mesh.load( pathDataIn_ + names[i] );
+			std::chrono::high_resolution_clock::time_point start =
+				std::chrono::high_resolution_clock::now();
+			for ( unsigned int k = 0; k < loadCount; ++k )
+				mesh.load( pathDataIn_ + names[i] );
+			double ms = std::chrono::duration<double, std::milli>(
+				std::chrono::high_resolution_clock::now() - start ).count()
+				/ loadCount;
+			if ( !j )
+				first = ms;
+			report << std::setw( 10 ) << ms << " ms";
+			if ( j )
+				report << " (x" << first / ms << ")";
+		}
+	}
+	std::cout.rdbuf( console );
+
+
+	GEM_CONSOLE( "Mesh loading, ms per load (stream, buffered, parallel, "
+				 "cached):" << report.str() );
+}
+
+void
+DemoSM::checkMeshMove()
+{
+#ifdef GEM_HAS_RVALUE_REFS
+	// the largest mesh in the data folder on the heap, and where each of its
+	// stores lives. Created meshes are lazy and never reach the factory
+	MeshLoader mesh;
+	mesh.setMapEnabled( false );
+	mesh.load( pathDataIn_ + "sphere.obj" );
+	const unsigned int primitivesCount = mesh.getPrimitivesCount();
+	const unsigned int vertexCount = mesh.getVertexCount();
+	const void* before[MAX_VERTEX_ATTRIBUTES + 1] = { NULL };
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( mesh.getVertexAttributesPtr( i )->isAlloc() )
+			before[i] = mesh.getVertexAttributesPtr( i )->getReadPtr<char>();
+	}
+	before[MAX_VERTEX_ATTRIBUTES] = mesh.getPrimitivesPtr()->getReadPtr<char>();
+
+
+	// move construct and move assign, neither may allocate
+	unsigned long long allocationCount =
+		AllocatorFactory::getStats().allocationCount;
+	MeshLoader moved( std::move( mesh ) );
+	MeshLoader assigned;
+	assigned = std::move( moved );
+	bool isAllocationFree = allocationCount ==
+		AllocatorFactory::getStats().allocationCount;
+
+
+	// the stores are where they were, the moved from meshes are empty
+	bool isInPlace = primitivesCount &&
+					 assigned.getPrimitivesCount() == primitivesCount &&
+					 assigned.getVertexCount() == vertexCount &&
+					 !mesh.getPrimitivesPtr()->isAlloc() &&
+					 !moved.getPrimitivesPtr()->isAlloc();
+	for ( unsigned int i = 0; i <= MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		Allocator* store = i < MAX_VERTEX_ATTRIBUTES ?
+			assigned.getVertexAttributesPtr( i ) : assigned.getPrimitivesPtr();
+		const void* after = store->isAlloc() ? store->getReadPtr<char>() : NULL;
+		isInPlace = isInPlace && after == before[i];
+	}
+
+
+	if ( !isAllocationFree )
+	{
+		GEM_ERROR( "Mesh move check failed, the move allocated." );
+	}
+	if ( !isInPlace )
+	{
+		GEM_ERROR( "Mesh move check failed, the stores moved." );
+	}
+	GEM_CONSOLE( "Mesh move check passed." );
+#else
+	GEM_WARNING( "Mesh move check needs rvalue references." );
+#endif
+}
+
+
 //-- mouse callbacks -------------------------------------------------------
 
 void
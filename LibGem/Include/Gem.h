@@ -60,8 +60,13 @@
 //	LOADERS
 //	-------
 //	Contain Allocator objects that can connect to RenderState INPUT/OUTPUT.
+//	Files can be loaded on worker threads and swapped in between frames.
 //
 //	Allocator
+//	AllocatorFactory
+//	TypedView
+//	LoadHandle
+//	TextureAtlas
 //	Loader .---> MeshLoader
 //	       |---> TextureLoader
 //	       |---> ShaderLoader
@@ -118,8 +123,11 @@
 
 // Loaders
 #include "GemAllocator.h"
+#include "GemAllocatorFactory.h"
+#include "GemTypedView.h"
 #include "GemMeshLoader.h"
 #include "GemTextureLoader.h"
+#include "GemTextureAtlas.h"
 #include "GemShaderLoader.h"
 
 // Nodes
@@ -138,6 +146,7 @@
 // Utility
 #include "GemGlobals.h"
 #include "GemTracker.h"
+#include "GemBlockCompression.h"
 
 
 //==============================================================================
@@ -5,10 +5,7 @@
 //	functions to access the underlying data as if it was a Vec3f, unsigned int
 //	Mat4f or what have you.
 //
-//	A good reason for centralizing the allocation is to later implement an
-//	allocator factory that you have to go through to create new data stores.
-//	You could use this to print diagnostics for the application and for 
-//	garbage collection.
+//	Heap storage comes from the AllocatorFactory, see setTag().
 //
 //	Tracking updates to data
 //	-----------------------
@@ -19,30 +16,10 @@
 //	counters. The following functions increase theese counters
 //
 //	alloc:		alloc
-//	read:		at, get, getReadPtr, read
-//	write:		at, set, getWritePtr, write
+//	read:		at, get, getReadPtr, read, readSpan, gather
+//	write:		at, get (non-const), set, getWritePtr, write, writeSpan, scatter
 //
-//
-//	TODO TODO TODO
-//	--------------
-//	In many cases it useful to have data live _only_ on the GPU, for instance
-//	when doing transform feedback. For these cases it would be practical to
-//	keep the Allocator---oLoader---oRenderState system intact. In this case the
-//	Allocator would simply act a specification sheet for the type of data to 
-//	allocate on GPU. Currently this will allocate the data on the CPU aswell
-//	because there is not way to specify an allocator without allocating data.
-//	In some cases this actually wanted because even in a transform feedback
-//	loop you might want to download the geometry for debugging purposes.
-//
-//	The proposed change is to use on demand allocation. So the Allocator will
-//	always start out empty even when defined for a specific type and size.
-//	All writers will then have an initial boundary check and allocate memory as
-//	required. Data should be allocated in chunks defined by some constant for
-//	performance reasons.
-//
-//	A consequence is that all direct access operators should be disabled
-//	because	we cant guarantee the memory state even within the size
-//	specification.
+//	Writes also record the byte ranges they touch, see getDirtyRanges().
 //
 //==============================================================================
 
@@ -72,6 +49,9 @@ public:
 
 	//-- define, typedef, enum -------------------------------------------------
 
+	// byte range [first, second)
+	typedef std::pair<unsigned int, unsigned int> Range;
+
 
 	//-- constructors ----------------------------------------------------------
 
@@ -79,6 +59,10 @@ public:
 	
 	Allocator( const Allocator& other );
 
+#ifdef GEM_HAS_RVALUE_REFS
+	Allocator( Allocator&& other );
+#endif
+
 	~Allocator( );
 
 
@@ -86,6 +70,10 @@ public:
 
 	void copy( const Allocator& other );
 
+	// share storage with other, copy-on-write, only the reference count is
+	// thread safe
+	void share( Allocator& other );
+
 	void clear();
 
 
@@ -93,6 +81,10 @@ public:
 
 	Allocator& operator=(const Allocator& rhs);
 
+#ifdef GEM_HAS_RVALUE_REFS
+	Allocator& operator=(Allocator&& rhs);
+#endif
+
 
 	//-- direct access operators -----------------------------------------------
 	
@@ -103,9 +95,14 @@ public:
 		// boundary check
 		assert( (pos+1)*sizeof(T) <= byteCount_ );
 
+		// make sure memory is there and is ours
+		unshare();
+		touch( pos*sizeof(T), sizeof(T) );
+
 		// update activity counters
 		readCount_++;
 		writeCount_++;
+		markDirty( pos*sizeof(T), sizeof(T) );
 
 		// return value at pos
 		T* ptr = static_cast<T*>(ptr_);
@@ -117,7 +114,7 @@ public:
 	T& at( const unsigned int i, const unsigned int j )
 	{
 		// return values at [i,j]
-		return this->at( i * width_ + j );
+		return this->at<T>( i * width_ + j );
 	}
 
 	// access to element through alloc.set<T>(pos,T), write-only
@@ -127,8 +124,13 @@ public:
 		// boundary check
 		assert( (pos+1)*sizeof(T) <= byteCount_ );
 
+		// make sure memory is there and is ours
+		unshare();
+		touch( pos*sizeof(T), sizeof(T) );
+
 		// update activity counters
 		writeCount_++;
+		markDirty( pos*sizeof(T), sizeof(T) );
 
 		// set value at pos
 		T* ptr = static_cast<T*>(ptr_);
@@ -140,30 +142,51 @@ public:
 	void set( const unsigned int i, const unsigned int j, const T& value )
 	{
 		// set values at [i,j]
-		this->set( i * width_ + j, value );
+		this->set<T>( i * width_ + j, value );
 	}
 
-	// access to element through alloc.get<T>(pos), read-only
+	// access to element through alloc.get<T>(pos), the reference can be
+	// written through, so shared and read-only storage is copied first as
+	// for at()
 	template<typename T>
 	T& get( const unsigned int pos )
+	{
+		return this->at<T>( pos );
+	}
+
+	// access to element through alloc.get<T>(i,j), as get<T>(pos)
+	template<typename T>
+	T& get( const unsigned int i, const unsigned int j )
+	{
+		return this->at<T>( i * width_ + j );
+	}
+
+	// access to element through alloc.get<T>(pos), read-only
+	template<typename T>
+	const T& get( const unsigned int pos ) const
 	{
 		// boundary check
 		assert( (pos+1)*sizeof(T) <= byteCount_ );
 
+		// make sure memory is there, committing lazy storage does not
+		// change its contents
+		Allocator* self = const_cast<Allocator*>( this );
+		self->touch( pos*sizeof(T), sizeof(T) );
+
 		// update activity counters
-		readCount_++;
+		self->readCount_++;
 
 		// return read only reference to value at pos
-		T* ptr = static_cast<T*>(ptr_);
+		const T* ptr = static_cast<const T*>(ptr_);
 		return ptr[pos];
 	}
 
 	// access to element through alloc.get<T>(i,j), read-only
 	template<typename T>
-	T& get( const unsigned int i, const unsigned int j )
+	const T& get( const unsigned int i, const unsigned int j ) const
 	{
 		// return read only reference to value at [i,j]
-		return this->get( i * width_ + j );
+		return this->get<T>( i * width_ + j );
 	}
 
 
@@ -173,9 +196,14 @@ public:
 	template<typename T>
 	T* getWritePtr()
 	{
+		// make sure memory is there and is ours
+		unshare();
+		touch( 0, byteCount_ );
+
 		// update activity counters
 		readCount_++;
 		writeCount_++;
+		markDirty( 0, byteCount_ );
 
 		// return read/write pointer
 		return static_cast<T*>(ptr_);
@@ -186,6 +214,9 @@ public:
 	template<typename T>
 	const T* getReadPtr()
 	{
+		// make sure memory is there
+		touch( 0, byteCount_ );
+
 		// update activity counters
 		readCount_++;
 
@@ -193,6 +224,24 @@ public:
 		return static_cast<T*>(ptr_);
 	}
 
+	// pointer to element pos, read only, for reading count elements
+	// only commits the span touched, unlike getReadPtr()
+	template<typename T>
+	const T* getReadPtr( const unsigned int pos, const unsigned int count )
+	{
+		// boundary check
+		assert( (pos+count)*sizeof(T) <= byteCount_ );
+
+		// make sure memory is there
+		touch( pos*sizeof(T), count*sizeof(T) );
+
+		// update activity counters
+		readCount_++;
+
+		// return read only pointer
+		return static_cast<T*>(ptr_) + pos;
+	}
+
 	// pointer a pointer to the first element, pointer to const pointer
 	// disallow caller to change class pointer to content, makes sense yes?
 	//template<typename T>
@@ -213,6 +262,9 @@ public:
 		if ( (pos+1)*sizeof(T) > byteCount_ )
 			return false;
 
+		// make sure memory is there
+		touch( pos*sizeof(T), sizeof(T) );
+
 		// update activity counters
 		readCount_++;
 
@@ -222,16 +274,21 @@ public:
 		return true;
 	}
 
-	// mass read from pointer. no boundary check on pointer (obviously)
+	// mass read to e[offset], e[offset+stride] ... below e[count], all or
+	// nothing. no boundary check on pointer (obviously)
 	template<typename T>
 	bool read( T* e, const unsigned int count,
 			   const unsigned int offset = 0, const unsigned int stride = 1 )
 	{
-		for ( unsigned int i = offset; i < count; i+=stride )
-		{
-			if ( !read<T>( &(e[i]) ) )
-				return false;
-		}
+		// elements to read and current position
+		unsigned int n = count > offset ?
+						 ( count - offset + stride - 1 ) / stride : 0;
+		unsigned int pos = static_cast<T*>(cur_) - static_cast<T*>(ptr_);
+
+		// read elements and increase pointer
+		if ( !gather<T>( pos, 1, e + offset, n, stride ) )
+			return false;
+		cur_ = static_cast<void*>( static_cast<T*>(cur_) + n );
 		return true;
 	}
 
@@ -247,25 +304,36 @@ public:
 		if ( (pos+1)*sizeof(T) > byteCount_  )
 			return false;
 
+		// make sure memory is there and is ours
+		unshare();
+		touch( pos*sizeof(T), sizeof(T) );
+
 		// update activity counters
 		writeCount_++;
+		markDirty( pos*sizeof(T), sizeof(T) );
 
 		// write element and increase pointer
+		cur = static_cast<T*>(cur_);
 		*cur = e;
 		cur_ = static_cast<void*>(++cur);
 		return true;
 	}
 
-	// mass write from pointer. no boundary check on pointer (obviously)
+	// mass write from e[offset], e[offset+stride] ... below e[count], all or
+	// nothing. no boundary check on pointer (obviously)
 	template<typename T>
 	bool write( const T* e, const unsigned int count,
 				const unsigned int offset = 0, const unsigned int stride = 1 )
 	{
-		for ( unsigned int i = offset; i < count; i+=stride )
-		{
-			if ( !write<T>( e[i] ) )
-				return false;
-		}
+		// elements to write and current position
+		unsigned int n = count > offset ?
+						 ( count - offset + stride - 1 ) / stride : 0;
+		unsigned int pos = static_cast<T*>(cur_) - static_cast<T*>(ptr_);
+
+		// write elements and increase pointer
+		if ( !scatter<T>( pos, 1, e + offset, n, stride ) )
+			return false;
+		cur_ = static_cast<void*>( static_cast<T*>(cur_) + n );
 		return true;
 	}
 
@@ -291,12 +359,109 @@ public:
 	}
 
 
+	//-- span access -----------------------------------------------------------
+
+	// Bounds and counters are checked once per span, use these rather than
+	// element access for more than a few elements.
+
+	// read count elements starting at pos into e
+	template<typename T>
+	bool readSpan( const unsigned int pos, T* e, const unsigned int count )
+	{
+		return gather<T>( pos, 1, e, count, 1 );
+	}
+
+	// write count elements from e starting at pos
+	template<typename T>
+	bool writeSpan( const unsigned int pos, const T* e,
+					const unsigned int count )
+	{
+		return scatter<T>( pos, 1, e, count, 1 );
+	}
+
+	// read elements pos, pos+stride ... into e[0], e[eStride] ...
+	template<typename T>
+	bool gather( const unsigned int pos, const unsigned int stride,
+				 T* e, const unsigned int count,
+				 const unsigned int eStride = 1 )
+	{
+		// boundary check, once for the whole run
+		if ( !count )
+			return true;
+		unsigned long long last = pos +
+			static_cast<unsigned long long>( count - 1 ) * stride;
+		if ( ( last + 1 ) * sizeof(T) > byteCount_ )
+			return false;
+
+		// make sure memory is there
+		unsigned int span = static_cast<unsigned int>( last + 1 - pos );
+		touch( pos*sizeof(T), span*sizeof(T) );
+
+		// update activity counters
+		readCount_++;
+
+		// copy elements
+		const T* ptr = static_cast<const T*>(ptr_) + pos;
+		if ( stride == 1 && eStride == 1 )
+		{
+			std::memcpy( e, ptr, count*sizeof(T) );
+		}
+		else
+		{
+			for ( unsigned int i=0; i<count; ++i )
+				e[i*eStride] = ptr[i*stride];
+		}
+		return true;
+	}
+
+	// write e[0], e[eStride] ... to elements pos, pos+stride ...
+	template<typename T>
+	bool scatter( const unsigned int pos, const unsigned int stride,
+				  const T* e, const unsigned int count,
+				  const unsigned int eStride = 1 )
+	{
+		// boundary check, once for the whole run
+		if ( !count )
+			return true;
+		unsigned long long last = pos +
+			static_cast<unsigned long long>( count - 1 ) * stride;
+		if ( ( last + 1 ) * sizeof(T) > byteCount_ )
+			return false;
+
+		// make sure memory is there and is ours
+		unsigned int span = static_cast<unsigned int>( last + 1 - pos );
+		unshare();
+		touch( pos*sizeof(T), span*sizeof(T) );
+
+		// update activity counters
+		writeCount_++;
+		markDirty( pos*sizeof(T), span*sizeof(T) );
+
+		// copy elements
+		T* ptr = static_cast<T*>(ptr_) + pos;
+		if ( stride == 1 && eStride == 1 )
+		{
+			std::memcpy( ptr, e, count*sizeof(T) );
+		}
+		else
+		{
+			for ( unsigned int i=0; i<count; ++i )
+				ptr[i*stride] = e[i*eStride];
+		}
+		return true;
+	}
+
+
 	//-- normal gets and sets --------------------------------------------------
 
 	ALLOC_FORMAT getFormat( ) const { return format_; }
 	ALLOC_DIM getDim( ) const { return dim_; }
 	ALLOC_TYPE getType( ) const { return type_; }
 
+	// set before alloc, storage already allocated keeps its backend
+	ALLOC_TAG getTag( ) const { return tag_; }
+	void setTag( const ALLOC_TAG _tag ) { tag_ = _tag; }
+
 	unsigned int getWidth( ) const { return width_; }
 	const unsigned int* getWidthPtr() const { return &width_; }
 	unsigned int getHeight( ) const { return height_; }
@@ -314,17 +479,123 @@ public:
 	const unsigned int* getWriteCountPtr() const { return &writeCount_; }
 
 	bool isAlloc( ) const { return isAlloc_; }
+	bool isLazy( ) const { return isLazy_; }
+	bool isShared( ) const { return shared_ && shared_->refCount > 1; }
+	bool isMapped( ) const { return mapPtr_ != NULL; }
+
+	// host memory in use, less than byte count for lazy storage
+	unsigned int getResidentByteCount( ) const;
+
+	// byte ranges written since last clearDirtyRanges(), sorted and disjoint
+	const std::vector<Range>& getDirtyRanges( ) const { return dirtyRanges_; }
+	unsigned int getDirtyByteCount( ) const;
+	void clearDirtyRanges( ) { dirtyRanges_.clear(); }
 
 
 	//-- alloc/dealloc ---------------------------------------------------------
 
 	void alloc( ALLOC_FORMAT _format,
 				const unsigned int _width = 0,
-				const unsigned int _height = 1 );
+				const unsigned int _height = 1,
+				const ALLOC_MODE _mode = ALLOC_MODE_ZERO );
+
+	// Map _width x _height elements at byte _offset of a file (throws).
+	// Read-only until written, then copied to the heap, unless
+	// _isCopyOnWrite. Unmapped in clear().
+	void map( const std::string& _path,
+			  const unsigned long long _offset,
+			  ALLOC_FORMAT _format,
+			  const unsigned int _width = 0,
+			  const unsigned int _height = 1,
+			  const bool _isCopyOnWrite = false );
 
 protected:
 private:
 
+	//-- storage ---------------------------------------------------------------
+
+	// format and derived settings, throws on unsupported formats
+	void setFormat( ALLOC_FORMAT _format,
+					const unsigned int _width,
+					const unsigned int _height );
+
+	// reference count of shared storage
+	struct SHARED
+	{
+		std::atomic<unsigned int> refCount;
+	};
+
+	void allocStorage( const unsigned int _byteCount, const ALLOC_MODE _mode );
+
+	void copyStorage( const void* _ptr, const std::vector<bool>* _chunks );
+
+	static void freeStorage( void* _ptr, const bool _isLazy,
+							 const size_t _chunkCount, void* _mapPtr,
+							 const size_t _mapByteCount, SHARED* _shared );
+
+	void moveFrom( Allocator& other );
+
+	// Allocators that never hold data stay out of the factory registry
+	void registerOnce();
+
+	// get a private copy of shared or read-only storage before writing
+	void unshare()
+	{
+		if ( shared_ || isReadOnly_ )
+			detach();
+	}
+
+	void detach();
+
+
+	//-- mapped storage --------------------------------------------------------
+
+	// returns pointer to _offset, mapping starts earlier at *_mapPtr
+	static void* mapFile( const std::string& _path,
+						  const unsigned long long _offset,
+						  const unsigned int _byteCount,
+						  const bool _isCopyOnWrite,
+						  void** _mapPtr, size_t* _mapByteCount );
+
+	static void unmapFile( void* _ptr, const size_t _byteCount );
+
+
+	//-- lazy storage ----------------------------------------------------------
+
+	// commit chunks of lazy storage in byte range, cheap when all committed
+	void touch( const unsigned int _offset, const unsigned int _byteCount )
+	{
+		if ( chunksLeft_ )
+			commit( _offset, _byteCount );
+	}
+
+	void commit( const unsigned int _offset, const unsigned int _byteCount );
+
+	// platform virtual memory
+	static void* reservePages( const size_t _byteCount );
+	static void commitPages( void* _ptr, const size_t _byteCount );
+	static void releasePages( void* _ptr, const size_t _byteCount );
+
+	//-- dirty ranges ----------------------------------------------------------
+
+	// add byte range to dirty ranges, cheap when extending the last range
+	void markDirty( const unsigned int _offset, const unsigned int _byteCount )
+	{
+		if ( !dirtyRanges_.empty() &&
+			 _offset >= dirtyRanges_.back().first &&
+			 _offset <= dirtyRanges_.back().second + ALLOC_DIRTY_GAP )
+		{
+			dirtyRanges_.back().second = std::max( dirtyRanges_.back().second,
+												   _offset + _byteCount );
+			return;
+		}
+		addDirtyRange( _offset, _byteCount );
+	}
+
+	void addDirtyRange( const unsigned int _offset,
+						const unsigned int _byteCount );
+
+
 
 	//-- local variables -------------------------------------------------------
 
@@ -352,6 +623,28 @@ private:
 
 	// isAlloc - there is data in the Allocator
 	bool isAlloc_;
+
+	// lazy storage, committed chunks and number of chunks not committed
+	bool isLazy_;
+	std::vector<bool> chunks_;
+	unsigned int chunksLeft_;
+
+	// written byte ranges not yet consumed, see BufferState::upload()
+	std::vector<Range> dirtyRanges_;
+
+	// reference count if storage is shared, see share()
+	SHARED* shared_;
+
+	// file mapping if storage is mapped, see map()
+	void* mapPtr_;
+	size_t mapByteCount_;
+	bool isReadOnly_;
+
+	// what the storage is used for, picks the factory backend
+	ALLOC_TAG tag_;
+
+	// in the factory registry, from the first time there is data
+	bool isRegistered_;
 };
 
 
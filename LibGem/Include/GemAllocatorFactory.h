@@ -0,0 +1,153 @@
+//==============================================================================
+//
+//	Heap memory for every Allocator, from a backend picked by its tag, and a
+//	registry of live Allocators for memory statistics. Thread safe.
+//
+//==============================================================================
+
+
+#ifndef GEM_ALLOCATORFACTORY_H
+#define GEM_ALLOCATORFACTORY_H
+
+
+//== INCLUDES ==================================================================
+
+#include "GemPrerequisites.h"
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== CLASS DECLARATION =========================================================
+
+class AllocatorFactory
+{
+
+public:
+
+	//-- define, typedef, enum -------------------------------------------------
+
+	// snapshot returned by getStats()
+	struct STATS
+	{
+		unsigned int allocatorCount[ALLOC_TAG_COUNT];
+		unsigned long long byteCount[ALLOC_TAG_COUNT];
+		unsigned long long residentByteCount[ALLOC_TAG_COUNT];
+		unsigned long long totalByteCount;
+		unsigned long long systemByteCount;
+		unsigned long long highWaterByteCount;
+		unsigned long long pooledByteCount;
+		unsigned long long frameByteCount;
+		unsigned long long allocationCount;
+		double allocationsPerSecond;
+		double bytesPerSecond;
+	};
+
+
+	//-- memory ----------------------------------------------------------------
+
+	// ALLOC_ALIGNMENT aligned memory from the backend of _tag (throws)
+	static void* allocate( const size_t _byteCount, const ALLOC_TAG _tag );
+
+	static void deallocate( void* _ptr );
+
+	// by default TRANSIENT uses FRAME and everything else POOL. POOL sends
+	// requests over ALLOC_POOL_MAX_SIZE to HEAP, FRAME memory is only good
+	// until newFrame()
+	static void setBackend( const ALLOC_TAG _tag,
+							const ALLOC_BACKEND _backend );
+	static ALLOC_BACKEND getBackend( const ALLOC_TAG _tag );
+
+	// rewind the frame arena, call once per frame
+	static void newFrame();
+
+	// give pooled blocks back to the system
+	static void trim();
+
+
+	//-- registry --------------------------------------------------------------
+
+	static void registerAllocator( const Allocator* _allocatorPtr );
+	static void unregisterAllocator( const Allocator* _allocatorPtr );
+
+	// live bytes per tag, system bytes and allocation rate, read without
+	// locking the Allocators
+	static STATS getStats();
+	static void printStats( const unsigned int _listCount = 10 );
+
+
+private:
+
+	//-- constructors/destructor -----------------------------------------------
+
+	// only instance() creates a factory, and it is never destroyed so
+	// Allocators with static storage can outlive main
+	AllocatorFactory();
+
+	static AllocatorFactory& instance();
+
+
+	//-- backends --------------------------------------------------------------
+
+	// a block handed out, keyed by its address
+	struct BLOCK
+	{
+		size_t byteCount;
+		ALLOC_BACKEND backend;
+		unsigned int sizeClass;
+	};
+
+	// pool size class of a request and the block size of a class
+	static unsigned int getSizeClass( const size_t _byteCount );
+	static size_t getSizeClassByteCount( const unsigned int _sizeClass );
+
+	// enough classes to reach ALLOC_POOL_MAX_SIZE
+	static const unsigned int POOL_CLASS_COUNT = 48;
+
+	void* allocateHeap( const size_t _byteCount );
+	void freeHeap( void* _ptr, const size_t _byteCount );
+	void* allocateFrame( const size_t _byteCount );
+
+
+	//-- local variables -------------------------------------------------------
+
+	std::mutex mutex_;
+
+	// live Allocators and blocks
+	std::unordered_set<const Allocator*> allocators_;
+	std::unordered_map<void*, BLOCK> blocks_;
+
+	// backend of each tag
+	ALLOC_BACKEND backends_[ALLOC_TAG_COUNT];
+
+	// free blocks of each pool size class
+	std::vector<void*> pools_[POOL_CLASS_COUNT];
+	unsigned long long pooledByteCount_;
+
+	// frame arena blocks, current block and offset into it
+	std::vector< std::pair<void*, size_t> > frameBlocks_;
+	unsigned int frameBlock_;
+	size_t frameOffset_;
+	unsigned int frameLiveCount_;
+
+	// counters
+	unsigned long long systemByteCount_;
+	unsigned long long highWaterByteCount_;
+	unsigned long long allocationCount_;
+	unsigned long long allocationByteCount_;
+	unsigned long long lastAllocationCount_;
+	unsigned long long lastAllocationByteCount_;
+	std::chrono::steady_clock::time_point lastStatsTime_;
+};
+
+
+//==============================================================================
+GEM_END_NAMESPACE
+#endif
+//==============================================================================
@@ -0,0 +1,123 @@
+//==============================================================================
+//
+//	Block compression of 8 bit textures to BC1 (DXT1), BC2 (DXT3), BC3
+//	(DXT5), BC4 and BC5, and back
+//
+//	BC6H and BC7 are only recognized, they are not encoded or decoded here.
+//
+//==============================================================================
+
+
+#ifndef GEM_BLOCKCOMPRESSION_H
+#define GEM_BLOCKCOMPRESSION_H
+
+
+//== INCLUDES ==================================================================
+
+#include "GemPrerequisites.h"
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== GLOBAL FUNCTIONS ==========================================================
+
+
+//-- formats -------------------------------------------------------------------
+
+inline bool isBlockCompressed( const ALLOC_TYPE _type )
+{
+	return _type == ALLOC_TYPE_DXT1 || _type == ALLOC_TYPE_DXT3 ||
+		   _type == ALLOC_TYPE_DXT5 || _type == ALLOC_TYPE_BC4 ||
+		   _type == ALLOC_TYPE_BC5 || _type == ALLOC_TYPE_BC6H ||
+		   _type == ALLOC_TYPE_BC7;
+}
+
+inline bool isBlockCompressed( const TEXTURE_FORMAT _format )
+{
+	return _format == TEXTURE_FORMAT_RGB_DXT1 ||
+		   _format == TEXTURE_FORMAT_RGBA_DXT3 ||
+		   _format == TEXTURE_FORMAT_RGBA_DXT5 ||
+		   _format == TEXTURE_FORMAT_R_BC4 ||
+		   _format == TEXTURE_FORMAT_RG_BC5 ||
+		   _format == TEXTURE_FORMAT_RGB_BC6H ||
+		   _format == TEXTURE_FORMAT_RGBA_BC7;
+}
+
+// bytes of one block, 0 if not block compressed
+inline unsigned int getBlockSize( const TEXTURE_FORMAT _format )
+{
+	return _format == TEXTURE_FORMAT_RGB_DXT1 ||
+		   _format == TEXTURE_FORMAT_R_BC4 ? 8 :
+		   isBlockCompressed( _format ) ? 16 : 0;
+}
+
+// bytes of a _width by _height image, partial blocks counted whole
+inline unsigned int getBlockByteCount( const unsigned int _width,
+									   const unsigned int _height,
+									   const TEXTURE_FORMAT _format )
+{
+	return ( ( _width + 3 ) / 4 ) * ( ( _height + 3 ) / 4 ) *
+		   getBlockSize( _format );
+}
+
+
+//-- blocks --------------------------------------------------------------------
+
+// Encoders take 16 rgba pixels, row by row. BC1 encodes rgb, BC2 and BC3
+// rgba, BC4 r and BC5 r and g. Decoders write 16 rgba pixels, the channels
+// a format does not store as 0, alpha as 255. BC1 blocks written in three
+// color mode by other encoders decode their fourth color as transparent
+// black.
+
+void encodeBlockBC1( const unsigned char* _rgba, unsigned char* _block,
+					 const COMPRESS_QUALITY _quality = COMPRESS_QUALITY_FAST );
+
+void encodeBlockBC2( const unsigned char* _rgba, unsigned char* _block,
+					 const COMPRESS_QUALITY _quality = COMPRESS_QUALITY_FAST );
+
+void encodeBlockBC3( const unsigned char* _rgba, unsigned char* _block,
+					 const COMPRESS_QUALITY _quality = COMPRESS_QUALITY_FAST );
+
+void encodeBlockBC4( const unsigned char* _rgba, unsigned char* _block,
+					 const COMPRESS_QUALITY _quality = COMPRESS_QUALITY_FAST );
+
+void encodeBlockBC5( const unsigned char* _rgba, unsigned char* _block,
+					 const COMPRESS_QUALITY _quality = COMPRESS_QUALITY_FAST );
+
+void decodeBlockBC1( const unsigned char* _block, unsigned char* _rgba );
+
+void decodeBlockBC2( const unsigned char* _block, unsigned char* _rgba );
+
+void decodeBlockBC3( const unsigned char* _block, unsigned char* _rgba );
+
+void decodeBlockBC4( const unsigned char* _block, unsigned char* _rgba );
+
+void decodeBlockBC5( const unsigned char* _block, unsigned char* _rgba );
+
+
+//-- images --------------------------------------------------------------------
+
+// Compress a _width by _height image of _dim 8 bit components a pixel, rows
+// packed, into getBlockByteCount() bytes of _format. One component is gray,
+// two are red and green. Edge blocks repeat the edge pixels, and
+// COMPRESS_QUALITY_HIGH is for asset builds, around thirty times slower.
+void compressImage( const unsigned char* _src, const unsigned int _width,
+					const unsigned int _height, const unsigned int _dim,
+					const TEXTURE_FORMAT _format,
+					const COMPRESS_QUALITY _quality, unsigned char* _dst );
+
+// Decompress a _width by _height image of _format into _dim 8 bit
+// components a pixel, the first _dim of rgba.
+void decompressImage( const unsigned char* _src, const unsigned int _width,
+					  const unsigned int _height,
+					  const TEXTURE_FORMAT _format, const unsigned int _dim,
+					  unsigned char* _dst );
+
+
+//==============================================================================
+GEM_END_NAMESPACE
+#endif
+//==============================================================================
@@ -86,6 +86,16 @@ public:
 
 	virtual float getForeshortening( const Vec3f& _positionWorld );
 
+	// height in pixels of a length _size at the point of a sphere of _radius
+	// around _positionWorld that is closest to the camera
+	virtual float getProjectedSize( const Vec3f& _positionWorld,
+									const float _size,
+									const float _radius = 0.0f );
+
+	// left, right, bottom, top, near and far plane in world space, a point
+	// p is inside where dot( plane.xyz, p ) + plane.w >= 0 for all six
+	void getFrustumPlanes( float _planes[6][4] ) const;
+
 
 protected:
 private:
@@ -22,7 +22,363 @@ GEM_BEGIN_NAMESPACE
 //== GLOBAL FUNCTIONS ==========================================================
 
 
+//-- text scanning -------------------------------------------------------------
+
+// In place scanners for ascii file formats. They all work on a cursor _ptr
+// that is advanced past whatever was consumed and an _end pointer that is
+// never dereferenced, so the text does not have to be null terminated.
+// Number scanners return false and leave the cursor untouched if there is no
+// number at the cursor.
+
+// skip spaces and tabs, stops at newline
+inline void skipBlanks( const char*& _ptr, const char* _end )
+{
+	while ( _ptr < _end && ( *_ptr == ' ' || *_ptr == '\t' ||
+							 *_ptr == '\r' ) )
+		++_ptr;
+}
+
+// skip to first character after next newline
+inline void skipLine( const char*& _ptr, const char* _end )
+{
+	const void* newline = _ptr < _end ? std::memchr( _ptr, '\n', _end - _ptr )
+									  : NULL;
+	_ptr = newline ? static_cast<const char*>( newline ) + 1 : _end;
+}
+
+// skip to first blank or newline
+inline void skipToken( const char*& _ptr, const char* _end )
+{
+	while ( _ptr < _end && *_ptr != ' ' && *_ptr != '\t' &&
+			*_ptr != '\r' && *_ptr != '\n' )
+		++_ptr;
+}
+
+// true if cursor is at a newline or at the end of text
+inline bool isLineEnd( const char* _ptr, const char* _end )
+{
+	return _ptr >= _end || *_ptr == '\n';
+}
+
+// unsigned decimal integer
+inline bool scanUInt( const char*& _ptr, const char* _end,
+					  unsigned int* _value )
+{
+	const char* p = _ptr;
+	unsigned int value = 0;
+	while ( p < _end && static_cast<unsigned int>( *p - '0' ) < 10 )
+	{
+		value = value * 10 + static_cast<unsigned int>( *p - '0' );
+		++p;
+	}
+	if ( p == _ptr )
+		return false;
+	*_value = value;
+	_ptr = p;
+	return true;
+}
+
+// signed decimal integer
+inline bool scanInt( const char*& _ptr, const char* _end, int* _value )
+{
+	const char* p = _ptr;
+	bool negative = false;
+	if ( p < _end && ( *p == '-' || *p == '+' ) )
+		negative = ( *p++ == '-' );
+	unsigned int value = 0;
+	if ( !scanUInt( p, _end, &value ) )
+		return false;
+	*_value = negative ? -static_cast<int>( value ) : static_cast<int>( value );
+	_ptr = p;
+	return true;
+}
+
+// decimal floating point number, [+-]digits[.digits][(e|E)[+-]digits]
+// Up to 19 significant digits and exponents within +-22 are converted exactly
+// in double precision, anything else is handed over to strtod.
+inline bool scanFloat( const char*& _ptr, const char* _end, float* _value )
+{
+	static const double POW10[] =
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+		1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* p = _ptr;
+	bool negative = false;
+	if ( p < _end && ( *p == '-' || *p == '+' ) )
+		negative = ( *p++ == '-' );
+
+	// mantissa digits, leading zeros are not significant
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool truncated = false;
+	const char* first = p;
+	while ( p < _end && static_cast<unsigned int>( *p - '0' ) < 10 )
+	{
+		if ( digits < 19 )
+		{
+			mantissa = mantissa * 10 + static_cast<unsigned int>( *p - '0' );
+			digits += ( mantissa != 0 );
+		}
+		else
+		{
+			++exponent;
+			truncated = true;
+		}
+		++p;
+	}
+	bool hasDigits = ( p != first );
+	if ( p < _end && *p == '.' )
+	{
+		++p;
+		first = p;
+		while ( p < _end && static_cast<unsigned int>( *p - '0' ) < 10 )
+		{
+			if ( digits < 19 )
+			{
+				mantissa = mantissa * 10 + static_cast<unsigned int>( *p - '0' );
+				digits += ( mantissa != 0 );
+				--exponent;
+			}
+			else
+			{
+				truncated = true;
+			}
+			++p;
+		}
+		hasDigits = hasDigits || ( p != first );
+	}
+	if ( !hasDigits )
+		return false;
+
+	// optional exponent, only consumed if followed by digits
+	if ( p < _end && ( *p == 'e' || *p == 'E' ) )
+	{
+		const char* q = p + 1;
+		int e = 0;
+		if ( scanInt( q, _end, &e ) )
+		{
+			exponent += e;
+			p = q;
+		}
+	}
+
+	// fast path, mantissa and power of ten are both exact doubles
+	double value;
+	if ( mantissa == 0 )
+	{
+		value = 0.0;
+	}
+	else if ( !truncated && mantissa < ( 1ull << 53 ) &&
+			  exponent >= -22 && exponent <= 22 )
+	{
+		value = exponent < 0 ? mantissa / POW10[-exponent]
+							 : mantissa * POW10[exponent];
+	}
+	else if ( p - _ptr < 64 )
+	{
+		char buffer[64];
+		std::copy( _ptr, p, buffer );
+		buffer[p - _ptr] = '\0';
+		value = std::fabs( std::strtod( buffer, NULL ) );
+	}
+	else
+	{
+		std::string token( _ptr, p );
+		value = std::fabs( std::strtod( token.c_str(), NULL ) );
+	}
+
+	*_value = static_cast<float>( negative ? -value : value );
+	_ptr = p;
+	return true;
+}
+
+
+//-- text formatting -----------------------------------------------------------
+
+// Writers for ascii file formats, the counterparts of the scanners above. They
+// write at _ptr without a terminator and return the end of what was written.
+// Leave room for 24 characters per number.
+
+// unsigned decimal integer
+inline char* formatUInt( char* _ptr, unsigned int _value )
+{
+	char digits[10];
+	int n = 0;
+	do
+	{
+		digits[n++] = static_cast<char>( '0' + _value % 10 );
+		_value /= 10;
+	}
+	while ( _value );
+	while ( n )
+		*_ptr++ = digits[--n];
+	return _ptr;
+}
+
+// Shortest decimal that scans back to the same float, fixed notation for
+// exponents -4 to 8 and scientific outside that. Candidates are checked
+// against the rounding interval of the float in double precision with a
+// small safety margin, so a value whose shortest decimal sits right at the
+// edge of its interval gets a digit more than needed, never one too few.
+inline char* formatFloat( char* _ptr, float _value )
+{
+	// powers of ten past 1e22 are not exact, the margin covers that
+	static const double POW10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+		1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23,
+		1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31,
+		1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+		1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47,
+		1e48, 1e49, 1e50, 1e51, 1e52, 1e53, 1e54, 1e55,
+		1e56, 1e57, 1e58, 1e59, 1e60, 1e61, 1e62, 1e63
+	};
+
+	// sign, also of zero, nan and infinity
+	unsigned int bits;
+	std::memcpy( &bits, &_value, sizeof( bits ) );
+	if ( _value != _value )
+	{
+		std::memcpy( _ptr, "nan", 3 );
+		return _ptr + 3;
+	}
+	if ( bits >> 31 )
+		*_ptr++ = '-';
+	double value = std::fabs( static_cast<double>( _value ) );
+	if ( value == 0.0 )
+	{
+		*_ptr++ = '0';
+		return _ptr;
+	}
+	if ( value > std::numeric_limits<float>::max() )
+	{
+		std::memcpy( _ptr, "inf", 3 );
+		return _ptr + 3;
+	}
+
+
+	// rounding interval from the bits, the lower half is smaller at powers
+	// of two except at the smallest normal. The ulp is 2^(biased - 150) and
+	// built directly as a double
+	unsigned int biased = ( bits >> 23 ) & 0xff;
+	int ulpExponent = static_cast<int>( std::max( biased, 1u ) ) - 150;
+	unsigned long long halfBits =
+		static_cast<unsigned long long>( ulpExponent - 1 + 1023 ) << 52;
+	double above;
+	std::memcpy( &above, &halfBits, sizeof( above ) );
+	above *= 1.0 - 1e-6;
+	double below = ( ( bits & 0x7fffff ) == 0 && biased > 1 ) ? 0.5 * above
+															  : above;
+
+
+	// decimal exponent from the binary one, then corrected so that nine
+	// digits are enough and the mantissa fits in 32 bits
+	int exponent = static_cast<int>( biased ) - 126;
+	if ( !biased )
+		std::frexp( value, &exponent );
+	int e10 = static_cast<int>( std::floor( ( exponent - 1 ) * 0.30103 ) );
+	double scaled9 = 8 - e10 < 0 ? value / POW10[e10 - 8]
+								 : value * POW10[8 - e10];
+	if ( scaled9 >= 1e9 )
+		++e10;
+	else if ( scaled9 < 1e8 )
+		--e10;
+
+
+	// fewest digits with a candidate in the interval, the nearest one or its
+	// neighbour on the other side. Any decimal of fewer digits also has more
+	// digits, so the digit count can be searched for by bisection
+	unsigned int mantissa = 0;
+	int scale = 0;
+	int lo = 1;
+	int hi = 9;
+	while ( lo <= hi )
+	{
+		int digits = ( lo + hi ) / 2;
+		int s = digits - 1 - e10;
+		double power = POW10[s < 0 ? -s : s];
+		double scaled = s < 0 ? value / power : value * power;
+		unsigned int candidates[2];
+		candidates[0] = static_cast<unsigned int>( scaled + 0.5 );
+		candidates[1] = scaled < candidates[0] ? candidates[0] - 1
+											   : candidates[0] + 1;
+		unsigned int found = 0;
+		for ( unsigned int i = 0; i < 2 && !found; ++i )
+		{
+			double decimal = s < 0 ? candidates[i] * power
+								   : candidates[i] / power;
+			if ( candidates[i] && decimal - value < above &&
+				 value - decimal < below )
+				found = candidates[i];
+		}
+		if ( found )
+		{
+			mantissa = found;
+			scale = s;
+			hi = digits - 1;
+		}
+		else
+		{
+			lo = digits + 1;
+		}
+	}
+	while ( mantissa % 10 == 0 )
+	{
+		mantissa /= 10;
+		--scale;
+	}
+
+
+	// digits, then where the decimal point goes
+	char digits[10];
+	int n = 0;
+	for ( unsigned int m = mantissa; m; m /= 10 )
+		digits[9 - n++] = static_cast<char>( '0' + m % 10 );
+	const char* first = digits + 10 - n;
+	int point = n - scale;
+	if ( point - 1 < -4 || point - 1 > 8 )
+	{
+		*_ptr++ = first[0];
+		if ( n > 1 )
+		{
+			*_ptr++ = '.';
+			_ptr = std::copy( first + 1, first + n, _ptr );
+		}
+		*_ptr++ = 'e';
+		if ( point - 1 < 0 )
+			*_ptr++ = '-';
+		_ptr = formatUInt( _ptr, std::abs( point - 1 ) );
+	}
+	else if ( scale <= 0 )
+	{
+		_ptr = std::copy( first, first + n, _ptr );
+		for ( int i = 0; i < -scale; ++i )
+			*_ptr++ = '0';
+	}
+	else if ( point > 0 )
+	{
+		_ptr = std::copy( first, first + point, _ptr );
+		*_ptr++ = '.';
+		_ptr = std::copy( first + point, first + n, _ptr );
+	}
+	else
+	{
+		*_ptr++ = '0';
+		*_ptr++ = '.';
+		for ( int i = 0; i < -point; ++i )
+			*_ptr++ = '0';
+		_ptr = std::copy( first, first + n, _ptr );
+	}
+	return _ptr;
+}
+
+
 //==============================================================================
 GEM_END_NAMESPACE
 #endif
-//==============================================================================
\ No newline at end of file
+//==============================================================================
@@ -3,6 +3,9 @@
 //	Basic interface for file loaders. Also contains some file specific
 //	utility functions,
 //
+//	loadAsync() of the loaders parses on a worker pool, and the result is
+//	swapped in by Loader::newFrame().
+//
 //==============================================================================
 
 
@@ -14,6 +17,7 @@
 
 
 #include "GemPrerequisites.h"
+#include <memory>
 
 
 //== NAMESPACES ================================================================
@@ -21,6 +25,50 @@
 GEM_BEGIN_NAMESPACE
 
 
+//== CLASS DECLARATION =========================================================
+
+// a load running on the worker pool, defined in GemLoader.cpp
+struct LoadTask;
+
+// Handle to an asynchronous load, see Loader. Copies refer to the same load.
+class LoadHandle
+{
+
+public:
+
+	//-- constructors/destructor -----------------------------------------------
+
+	// handle to no load, status LOAD_STATUS_NONE
+	LoadHandle();
+
+	// default copy constructor is ok
+
+	// default destructor ok
+
+
+public:
+
+	//-- gets ------------------------------------------------------------------
+
+	LOAD_STATUS getStatus() const;
+
+	// queued, parsing or parsed but not yet swapped in
+	bool isPending() const;
+
+	// block until the file is parsed, it is swapped in by Loader::newFrame()
+	void wait() const;
+
+
+private:
+
+	friend class Loader;
+
+	explicit LoadHandle( const std::shared_ptr<LoadTask>& _task );
+
+	std::shared_ptr<LoadTask> task_;
+};
+
+
 //== CLASS DECLARATION =========================================================
 
 class Loader
@@ -34,9 +82,14 @@ public:
 	// default constructor ok
 	Loader();
 
-	// default copy constructor is ok
+	// a pending load belongs to this loader only, copies dont get it
+	Loader( const Loader& other );
 
-	// default destructor ok
+	// cancels a pending load
+	~Loader();
+
+	// as the copy constructor
+	Loader& operator=( const Loader& rhs );
 
 
 	//-- copy and clear --------------------------------------------------------
@@ -57,6 +110,41 @@ public:
 					   const FILE_FORMAT _fileType = FILE_FORMAT_NONE ) {};
 
 
+	//-- asynchronous loading --------------------------------------------------
+
+	// Swap finished loads into their loaders, call once per frame from the
+	// thread that draws, before any RenderState::draw(). Allocators are
+	// moved into, not replaced, so RenderStates keep their pointers. A
+	// failed load leaves the old data in place.
+	static void newFrame();
+
+	// wait for all pending loads and swap them in, for start up code
+	static void finishLoads();
+
+
+protected:
+
+	//-- asynchronous loading --------------------------------------------------
+
+	// runs on a worker, loads the file into the staged loader and returns
+	// true if it is loaded
+	typedef std::function<bool( Loader* _staged )> LoadFunction;
+
+	// runs in newFrame(), swaps the data of the target and staged loaders
+	typedef std::function<void( Loader* _target, Loader* _staged )>
+		SwapFunction;
+
+	// queue a load of _path into _staged on the worker pool, replacing any
+	// pending load of this loader
+	LoadHandle submitLoad( const std::string& _path,
+						   const std::shared_ptr<Loader>& _staged,
+						   const LoadFunction& _load,
+						   const SwapFunction& _swap );
+
+	// cancel the pending load of this loader, if any
+	void cancelLoad();
+
+
 protected:
 
 	//-- private file utility --------------------------------------------------
@@ -64,11 +152,15 @@ protected:
 	void splitPath( const std::string& _path,
 					std::string* _dir, std::string* _name, std::string* _ext );
 
+	void readFile( const std::string& _path, std::vector<char>* _buffer );
+
 protected:
 
 
 private:
 
+	// load started by submitLoad() and not yet swapped in
+	std::shared_ptr<LoadTask> pendingTask_;
 };
 
 
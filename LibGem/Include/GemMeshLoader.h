@@ -4,6 +4,8 @@
 //	You can create a mesh with a given index and attribute composition or load
 //	it from file and let the file specify the composition.
 //
+//	Text files are cached next to themselves as binary .gmb files.
+//
 //==============================================================================
 
 
@@ -30,12 +32,73 @@ class MeshLoader : public Loader
 {
 public:
 
+	//-- define, typedef, enum -------------------------------------------------
+
+	// vertices transformed by a FIFO cache, returned by getCacheStats()
+	struct CACHESTATS
+	{
+		unsigned int cacheSize;
+		unsigned int primitivesCount;
+		unsigned int vertexCount;		// vertices used by the primitives
+		unsigned int missCount;			// vertices transformed
+		float acmr;						// misses per primitive
+		float atvr;						// misses per vertex used
+	};
+
+	// a level of detail, returned by getLOD()
+	struct LODLEVEL
+	{
+		unsigned int primitivesFirst;
+		unsigned int primitivesCount;
+		float error;					// in model units
+	};
+
+	// a cluster of level 0 triangles, returned by getMeshlet()
+	struct MESHLET
+	{
+		unsigned int vertexFirst;		// into getMeshletVertices()
+		unsigned int vertexCount;
+		unsigned int triangleFirst;		// into getMeshletTriangles()
+		unsigned int triangleCount;
+		float center[3];				// bounding sphere
+		float radius;
+		float coneAxis[3];				// normals within the cone, one as
+		float coneCutoff;				// cutoff if there is no cone
+	};
+
+	// meshlets dropped by cullMeshlets()
+	struct CULLSTATS
+	{
+		unsigned int meshletCount;
+		unsigned int frustumCullCount;
+		unsigned int backfaceCullCount;
+		unsigned int primitivesCount;	// triangles written
+	};
+
+	// a ray hit, returned by intersectRay() and pick()
+	struct RAYHIT
+	{
+		unsigned int primitive;			// level 0 triangle, NO_HIT if none
+		float distance;					// in lengths of the direction
+		float u;						// barycentric weights of corners
+		float v;						// 1 and 2
+	};
+
+	static const unsigned int NO_HIT = 0xffffffff;
+
+
 	//-- constructors/destructor -----------------------------------------------
 
 	// default constructor
 	MeshLoader( );
 
-	// default copy constructor is ok
+	// copy constructor, deep copy
+	MeshLoader( const MeshLoader& other );
+
+#ifdef GEM_HAS_RVALUE_REFS
+	// move constructor, takes the stores without allocating
+	MeshLoader( MeshLoader&& other );
+#endif
 
 	// default destructor
 	~MeshLoader( );
@@ -47,11 +110,24 @@ public:
 
 	void copy( const MeshLoader& other );
 
+	// share the stores of other, copy-on-write, see Allocator::share()
+	void share( MeshLoader& other );
+
+
+	//-- assignment operators --------------------------------------------------
+
+	MeshLoader& operator=( const MeshLoader& rhs );
+
+#ifdef GEM_HAS_RVALUE_REFS
+	MeshLoader& operator=( MeshLoader&& rhs );
+#endif
+
 
 public:
 
 	//-- sets and gets ---------------------------------------------------------
 
+	// primitives of the mesh, level 0 when there are levels of detail
 	unsigned int getPrimitivesCount() const
 	{ return primitivesCount_; }
 
@@ -71,6 +147,86 @@ public:
 	Allocator* getVertexAttributesPtr( const unsigned int _attrID )
 	{ return &vertexAttributes_[_attrID]; }
 
+	PARSE_MODE getParseMode() const
+	{ return parseMode_; }
+
+	void setParseMode( const PARSE_MODE _parseMode )
+	{ parseMode_ = _parseMode; }
+
+	bool isCacheEnabled() const
+	{ return isCacheEnabled_; }
+
+	void setCacheEnabled( const bool _isCacheEnabled )
+	{ isCacheEnabled_ = _isCacheEnabled; }
+
+	// map gmb files and caches instead of reading them
+	bool isMapEnabled() const
+	{ return isMapEnabled_; }
+
+	void setMapEnabled( const bool _isMapEnabled )
+	{ isMapEnabled_ = _isMapEnabled; }
+
+	// merge near duplicate vertices of obj/obx files, zero turns it off
+	float getWeldEpsilon() const
+	{ return weldEpsilon_; }
+
+	void setWeldEpsilon( const float _weldEpsilon )
+	{ weldEpsilon_ = _weldEpsilon; }
+
+	// format a store of obj/obx files is converted to when loading, none
+	// keeps it as parsed
+	VERTEX_FORMAT getLoadFormat( const unsigned int _attrID ) const
+	{ return loadFormats_[_attrID]; }
+
+	void setLoadFormat( const unsigned int _attrID,
+						const VERTEX_FORMAT _vertexFormat )
+	{ loadFormats_[_attrID] = _vertexFormat; }
+
+	// 16 bit indices for obj/obx files with less than 65536 vertices
+	bool isIndexNarrowingEnabled() const
+	{ return isIndexNarrowingEnabled_; }
+
+	void setIndexNarrowingEnabled( const bool _isIndexNarrowingEnabled )
+	{ isIndexNarrowingEnabled_ = _isIndexNarrowingEnabled; }
+
+	// optimize obj/obx files when loading, before they are cached
+	bool isOptimizeEnabled() const
+	{ return isOptimizeEnabled_; }
+
+	void setOptimizeEnabled( const bool _isOptimizeEnabled )
+	{ isOptimizeEnabled_ = _isOptimizeEnabled; }
+
+	// levels of detail generated for obj/obx files when loading, one turns
+	// it off
+	unsigned int getLoadLODCount() const
+	{ return loadLODCount_; }
+
+	void setLoadLODCount( const unsigned int _loadLODCount )
+	{ loadLODCount_ = _loadLODCount; }
+
+	// levels of detail, one for meshes without a chain
+	unsigned int getLODCount() const
+	{ return lods_.empty() ? 1 : static_cast<unsigned int>( lods_.size() ); }
+
+	LODLEVEL getLOD( const unsigned int _level ) const;
+
+	// meshlets, none until built
+	unsigned int getMeshletCount() const
+	{ return static_cast<unsigned int>( meshlets_.size() ); }
+
+	const MESHLET& getMeshlet( const unsigned int _meshlet ) const
+	{ return meshlets_[_meshlet]; }
+
+	const unsigned int* getMeshletVertices() const
+	{ return meshletVertices_.empty() ? NULL : &meshletVertices_[0]; }
+
+	const unsigned char* getMeshletTriangles() const
+	{ return meshletTriangles_.empty() ? NULL : &meshletTriangles_[0]; }
+
+	// nodes of the bounding volume hierarchy, none until built
+	unsigned int getBVHNodeCount() const
+	{ return static_cast<unsigned int>( bvhNodes_.size() ); }
+
 	bool isLoaded() const
 	{ return isLoaded_; }
 
@@ -84,6 +240,13 @@ public:
 
 	void reload();
 
+	// as load() and reload(), but parsed on a worker and swapped in by
+	// Loader::newFrame(), see Loader
+	LoadHandle loadAsync( const std::string& _path,
+						  const FILE_FORMAT _fileFormat = FILE_FORMAT_NONE );
+
+	LoadHandle reloadAsync();
+
 	void create( const unsigned int _primitivesCount,
 				 const unsigned int _vertexCount,
 				 const PRIM_TYPE _primType = PRIM_TYPE_NONE,
@@ -107,30 +270,466 @@ public:
 	void save( const std::string& _path,
 			   const FILE_FORMAT _fileFormat = FILE_FORMAT_NONE );
 
+
+	//-- optimize --------------------------------------------------------------
+
+	// Reorder triangles for the post-transform cache (Forsyth), then
+	// clusters for overdraw and vertices in order of first use.
+	// Overdraw clusters may transform up to _overdrawThreshold times more
+	// vertices than the cache order alone. Only triangles are reordered,
+	// vertices are reordered for any primitive type.
+	void optimize( const bool _isOverdrawEnabled = true,
+				   const float _overdrawThreshold = 1.05f );
+
+	// cache use of the primitives of level of detail _level
+	CACHESTATS getCacheStats( const unsigned int _cacheSize = MESH_CACHE_SIZE,
+							  const unsigned int _level = 0 );
+
+
+	//-- levels of detail ------------------------------------------------------
+
+	// Simplify triangles into a chain of up to _levelCount levels, each with
+	// _reduction times the triangles of the one before, by quadric error
+	// edge collapses. Open edges are locked. All levels share the vertices
+	// and the chain ends early when too little can be collapsed.
+	void generateLODs( const unsigned int _levelCount = 4,
+					   const float _reduction = 0.5f );
+
+	// coarsest level whose error is at most _pixelError pixels on screen,
+	// for the mesh with its origin at _positionWorld
+	unsigned int selectLOD( CameraNode& _camera, const Vec3f& _positionWorld,
+							const float _pixelError = 1.0f ) const;
+
+
+	//-- meshlets --------------------------------------------------------------
+
+	// partition level 0 into meshlets with bounding spheres and normal
+	// cones, dropped by anything that changes the primitives
+	void buildMeshlets(
+		const unsigned int _maxVertices = MESH_MESHLET_VERTICES,
+		const unsigned int _maxTriangles = MESH_MESHLET_TRIANGLES );
+
+	// Write the triangles of meshlets that _camera can see to the front of
+	// _primitives, for the mesh placed by _modelMatrix. The store is sized
+	// for level 0, so its buffer object keeps its size from frame to frame.
+	// Backface culling is only right when the GL culls back faces too.
+	CULLSTATS cullMeshlets( CameraNode& _camera, const Mat4f& _modelMatrix,
+							Allocator* _primitives,
+							const bool _isBackfaceCullEnabled = true );
+
+
+	//-- normals and tangents --------------------------------------------------
+
+	// vertex normals of level 0 to slot 2, weighted by area or corner angle
+	void generateNormals( const NORMAL_WEIGHT _weight = NORMAL_WEIGHT_ANGLE );
+
+	// tangents with their handedness in w to slot _attr, from positions,
+	// normals (2) and texcoords (8) of level 0, as MikkTSpace
+	void generateTangents( const unsigned int _attr = MESH_TANGENT_ATTRIBUTE );
+
+
+	//-- ray queries -----------------------------------------------------------
+
+	// SAH bounding volume hierarchy of level 0, dropped by anything that
+	// changes the primitives
+	void buildBVH( const unsigned int _maxLeafSize = MESH_BVH_LEAF_SIZE );
+
+	// Closest triangle hit by the ray from _origin along _direction in model
+	// space, at most _maxDistance direction lengths away. False on a miss or
+	// without a hierarchy.
+	bool intersectRay( const Vec3f& _origin, const Vec3f& _direction,
+					   RAYHIT* _hit,
+					   const float _maxDistance =
+						   std::numeric_limits<float>::max() ) const;
+
+	// whether the ray hits any triangle within _maxDistance
+	bool intersectRayAny( const Vec3f& _origin, const Vec3f& _direction,
+						  const float _maxDistance =
+							  std::numeric_limits<float>::max() ) const;
+
+	// intersectRay() for _count rays, four at a time. Returns the number of
+	// hits, misses have NO_HIT primitives.
+	unsigned int intersectRays( const Vec3f* _origins,
+								const Vec3f* _directions,
+								const unsigned int _count, RAYHIT* _hits,
+								const float _maxDistance =
+									std::numeric_limits<float>::max() ) const;
+
+	// Closest triangle under _positionWindow for the mesh placed by
+	// _modelMatrix, the distance is in world units from the camera
+	bool pick( CameraNode& _camera, const Mat4f& _modelMatrix,
+			   const Vec2f& _positionWindow, RAYHIT* _hit ) const;
+
+
+	//-- formats ---------------------------------------------------------------
+
+	// convert a store between 32 bit floats and a narrow format, or between
+	// two narrow formats through floats
+	void convertVertexAttribute( const unsigned int _attr,
+								 const VERTEX_FORMAT _vertexFormat );
+
+	// texcoords times _scale plus _offset, such as the place of a texture
+	// on a TextureAtlas page, narrow stores stay narrow
+	void remapTexcoords( const Vec2f& _scale, const Vec2f& _offset,
+						 const unsigned int _attr = MESH_TEXCOORD_ATTRIBUTE );
+
 protected:
 
 
 private:
 
+	//-- private structs -------------------------------------------------------
+
+	// command codes returned by scanOBXCommand, below that an attribute index
+	enum
+	{
+		OBX_COMMAND_FACE = MAX_VERTEX_ATTRIBUTES,
+		OBX_COMMAND_UNKNOWN
+	};
+
+	// Depth below which BVH nodes are split at the median instead of by
+	// area, and the traversal stack that this bounds the tree depth for
+	enum
+	{
+		BVH_MEDIAN_DEPTH = 48,
+		BVH_STACK_SIZE = 96
+	};
+
+	// A byte range of an obj/obx file at line boundaries and what it holds.
+	// Dims and types are taken from the first line of each kind in the range.
+	// Destinations are where the range starts writing in the stores and how
+	// many attribute elements are left there, so ranges can be parsed in
+	// parallel. attributeFirst is the index of the first element of each kind
+	// in the range, for negative face indices. If any face has a v/vt/vn
+	// triplet the corners are written as 1-based triplets too, zero where
+	// the file has no index.
+	struct OBXRANGE
+	{
+		const char* begin;
+		const char* end;
+		unsigned int primitivesCount;
+		unsigned int primitivesDim;
+		unsigned int attributeCount[MAX_VERTEX_ATTRIBUTES];
+		unsigned int attributeDim[MAX_VERTEX_ATTRIBUTES];
+		ALLOC_TYPE attributeType[MAX_VERTEX_ATTRIBUTES];
+		bool hasCorners;
+		unsigned int* primitives;
+		unsigned int* corners;
+		void* attributes[MAX_VERTEX_ATTRIBUTES];
+		unsigned int attributeSpace[MAX_VERTEX_ATTRIBUTES];
+		unsigned int attributeFirst[MAX_VERTEX_ATTRIBUTES];
+	};
+
+	// Lines first to last of one obj/obx command, written to text by
+	// formatOBXLines. Each line is the command followed by dim elements of
+	// type. Faces have a corner pattern where # stands for the 1-based index,
+	// such as "#/#/#" for v/vt/vn triplets, attributes have none.
+	struct OBXLINES
+	{
+		const char* command;
+		const void* data;
+		ALLOC_TYPE type;
+		unsigned int dim;
+		const char* corner;
+		unsigned int first;
+		unsigned int last;
+		std::vector<char>* text;
+		size_t length;
+	};
+
+	// A range of level 0 triangles or of vertices for the normal and tangent
+	// kernels. Stores are floats with their dims as strides. Triangles
+	// weigh their corners into SoA arrays, xyz a vector and w a weight whose
+	// sign is the texture orientation for tangents. Vertices sum the corners
+	// listed for them, cornerFirst[v] to cornerFirst[v+1] in corners, into
+	// frames, normals if frameDim is 3 and tangents if it is 4.
+	struct FRAMERANGE
+	{
+		unsigned int first;
+		unsigned int last;
+		const unsigned int* indices;
+		const float* positions;
+		unsigned int positionDim;
+		const float* normals;
+		unsigned int normalDim;
+		const float* texcoords;
+		unsigned int texcoordDim;
+		NORMAL_WEIGHT weight;
+		float* cornerX;
+		float* cornerY;
+		float* cornerZ;
+		float* cornerW;
+		const unsigned int* cornerFirst;
+		const unsigned int* corners;
+		float* frames;
+		unsigned int frameDim;
+	};
+
+	// A node of the bounding volume hierarchy. Inner nodes have a count of
+	// zero, the left child right after them and the right child at first.
+	// Leaves have count triangles from first in bvhTriangles_.
+	struct BVHNODE
+	{
+		float lower[3];
+		unsigned int first;
+		float upper[3];
+		unsigned int count;
+	};
+
+	// a triangle being sorted into the hierarchy, with its bounds
+	struct BVHPRIMITIVE
+	{
+		float lower[3];
+		unsigned int primitive;
+		float upper[3];
+	};
+
+	// A subtree of the hierarchy being built, over triangles first to last
+	// of primitives, which are partitioned in place. Nodes are appended to
+	// nodes with child indices relative to its start, so subtrees built on
+	// threads are joined by offsetting them, and the halves of a subtree go
+	// to threads of their own for threadDepth more levels.
+	struct BVHRANGE
+	{
+		unsigned int first;
+		unsigned int last;
+		BVHPRIMITIVE* primitives;
+		unsigned int maxLeafSize;
+		unsigned int depth;
+		unsigned int threadDepth;
+		std::vector<BVHNODE>* nodes;
+	};
+
+	// Header of the binary mesh format, all offsets are from start of file.
+	// The source fields identify the text file a cache was made from and the
+	// parser and options that made it, they are zero for explicitly saved
+	// files.
+	#define GMB_MAGIC (MAKEFOURCC('G','M','B',' '))
+	#define GMB_VERSION 2
+	#define GMB_ALIGNMENT 64
+	// bump when the obj/obx parser changes what ends up in the stores
+	#define GMB_PARSER_REVISION 2
+	struct GMBHEADER
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned int headerSize;
+		unsigned int primitivesFormat;
+		unsigned int primitivesCount;			// all levels of detail
+		unsigned int primitivesOffset;
+		unsigned int primitivesByteCount;
+		unsigned int vertexCount;
+		unsigned int attributeFormat[MAX_VERTEX_ATTRIBUTES];
+		unsigned int attributeOffset[MAX_VERTEX_ATTRIBUTES];
+		unsigned int attributeByteCount[MAX_VERTEX_ATTRIBUTES];
+		unsigned int lodCount;
+		unsigned int lodPrimitivesFirst[MESH_MAX_LODS];
+		unsigned int lodPrimitivesCount[MESH_MAX_LODS];
+		float lodError[MESH_MAX_LODS];
+		float lodRadius;
+		unsigned int sourcePathHash;
+		unsigned int sourceOptions;
+		unsigned long long sourceSize;
+		unsigned long long sourceTime;
+	};
+
 
 	//-- load and create ------------------------------------------------------
 
+	// defaults of every member but the stores, for the constructors
+	void init();
+
+	// every member but the stores and derived data, for copy, share and move
+	void copyMembers( const MeshLoader& other );
+
+	// load settings only, no data
+	void copySettings( const MeshLoader& other );
+
 	void createPrimitives( const PRIM_TYPE _primType,
-						   const unsigned int _primitivesCount );
+						   const unsigned int _primitivesCount,
+						   const ALLOC_MODE _allocMode = ALLOC_MODE_ZERO );
 
 	void createVertexAttribute( const unsigned int _attr,
 								const VERTEX_FORMAT _vertexFormat,
-								const unsigned int _vertexCount );
+								const unsigned int _vertexCount,
+								const ALLOC_MODE _allocMode = ALLOC_MODE_ZERO );
+
+
+	//-- private optimize ------------------------------------------------------
+
+	void optimizeMesh( const bool _isOverdrawEnabled,
+					   const float _overdrawThreshold );
+
+	void optimizeVertexCache( const unsigned int _first,
+							  const unsigned int _count );
+
+	void optimizeOverdraw( const unsigned int _first,
+						   const unsigned int _count,
+						   const float _threshold );
+
+	void optimizeVertexFetch();
+
+	static unsigned int simulateCache( const unsigned int* _indices,
+									   const unsigned int _count,
+									   const unsigned int _cacheSize,
+									   std::vector<unsigned int>& _stamps,
+									   unsigned int* _time );
+
+
+	//-- private levels of detail ----------------------------------------------
+
+	void simplifyMesh( const unsigned int _levelCount,
+					   const float _reduction );
+
+	void dropLODs();
+
+	static float getTriangleDistance( const float* _p, const float* _a,
+									  const float* _b, const float* _c );
+
+
+	//-- private meshlets ------------------------------------------------------
+
+	void partitionMeshlets( const unsigned int _maxVertices,
+							const unsigned int _maxTriangles );
+
+	void boundMeshlet( MESHLET* _meshlet, const float* _positions,
+					   const unsigned int _dim ) const;
+
+
+	//-- private normals and tangents ------------------------------------------
+
+	void computeNormals( const NORMAL_WEIGHT _weight );
+
+	void computeTangents( const unsigned int _attr );
+
+	void getTriangleIndices( std::vector<unsigned int>& _indices );
+
+	void getFloatAttribute( const unsigned int _attr, const unsigned int _dim,
+							Allocator& _store );
+
+	static void listVertexCorners( const std::vector<unsigned int>& _indices,
+								   const unsigned int _vertexCount,
+								   std::vector<unsigned int>& _cornerFirst,
+								   std::vector<unsigned int>& _corners );
+
+	void runFrameKernel( void (*_kernel)( FRAMERANGE* ),
+						 const FRAMERANGE& _range,
+						 const unsigned int _count ) const;
+
+	static void weighNormalCorners( FRAMERANGE* _range );
+
+	static void weighTangentCorners( FRAMERANGE* _range );
+
+	static void sumFrameCorners( FRAMERANGE* _range );
+
+
+	//-- private ray queries ---------------------------------------------------
+
+	void computeBVH( const unsigned int _maxLeafSize );
+
+	static void buildBVHRange( BVHRANGE* _range );
+
+	static unsigned int splitBVHRange( BVHRANGE* _range,
+									   const float* _centroidLower,
+									   const float* _centroidUpper );
+
+	void traceRayPacket( const Vec3f* _origins, const Vec3f* _directions,
+						 const unsigned int _count, RAYHIT* _hits,
+						 const float _maxDistance ) const;
+
+
+	//-- private formats -------------------------------------------------------
+
+	static ALLOC_FORMAT getWideFormat( const Allocator& _store );
+
+	void convertStore( Allocator& _store, const ALLOC_FORMAT _format );
+
+	void narrowPrimitives();
+
+	bool widenPrimitives();
+
+	static void encodeHalf( const float* _src, unsigned short* _dst,
+							const unsigned int _count );
+
+	static void decodeHalf( const unsigned short* _src, float* _dst,
+							const unsigned int _count );
+
+	static void encodeOctahedral( const float* _src,
+								  const unsigned int _srcDim,
+								  short* _dst, const unsigned int _count );
+
+	static void decodeOctahedral( const short* _src, float* _dst,
+								  const unsigned int _dstDim,
+								  const unsigned int _count );
+
+	static void encodePacked( const float* _src, const unsigned int _srcDim,
+							  unsigned int* _dst, const unsigned int _count );
+
+	static void decodePacked( const unsigned int* _src, float* _dst,
+							  const unsigned int _dstDim,
+							  const unsigned int _count );
+
+	static void narrowIndices( const unsigned int* _src, unsigned short* _dst,
+							   const unsigned int _count );
 
 
 	//-- private file-io -------------------------------------------------------
 
 	void loadOBX( const std::string& _path );
 
+	void loadOBXBuffered( const std::string& _path,
+						  const unsigned int _threadCount );
+
+	static unsigned int scanOBXCommand( const char*& _ptr, const char* _end,
+										ALLOC_TYPE* _type );
+
+	static void scanOBXRange( OBXRANGE* _range );
+
+	void createOBXStores( const OBXRANGE& _range );
+
+	void parseOBXRange( const OBXRANGE& _range ) const;
+
+	static bool scanOBXCorner( const char*& _ptr, const char* _end,
+							   int* _corner );
+
+	static unsigned int getOBXIndex( const int _index,
+									 const unsigned int _count );
+
+	void resolveOBXCorners( std::vector<unsigned int>& _corners );
+
+	void weldVertices( const float _epsilon );
+
+	static unsigned int getWeldCell( const std::vector<int>& _cells,
+									 const std::vector<unsigned int>& _heads,
+									 const int* _cell );
+
+	void gatherVertexAttribute( const unsigned int _attr,
+								const unsigned int* _sources,
+								const unsigned int _stride,
+								const unsigned int _count );
+
+	void appendVertexAttribute( const unsigned int _attr );
+
+	bool loadGMB( const std::string& _path, const GMBHEADER* _source );
+
+	bool loadCache( const std::string& _path );
+
+	void saveGMB( const std::string& _path, const GMBHEADER* _source );
+
+	void saveCache( const std::string& _path );
+
+	bool getSource( const std::string& _path, GMBHEADER* _source ) const;
+
 	void saveOBJ(  const std::string& _path );
 
 	void saveOBX(  const std::string& _path );
 
+	static void writeOBXLines( std::ofstream& _ofs, const char* _command,
+							   Allocator& _store, const char* _corner,
+							   std::vector< std::vector<char> >* _buffers );
+
+	static void formatOBXLines( OBXLINES* _lines );
+
 private:
 
 	// file information
@@ -145,6 +744,41 @@ private:
 	unsigned int vertexCount_;
 	Allocator vertexAttributes_[MAX_VERTEX_ATTRIBUTES];
 
+	// text parser used by load and binary cache of text files
+	PARSE_MODE parseMode_;
+	bool isCacheEnabled_;
+
+	// gmb payloads are mapped from file, see Allocator::map()
+	bool isMapEnabled_;
+
+	// near duplicate vertices of text files are merged, see weldVertices()
+	float weldEpsilon_;
+
+	// text files are optimized before caching, see optimize()
+	bool isOptimizeEnabled_;
+
+	// narrow formats of text files, see setLoadFormat()
+	VERTEX_FORMAT loadFormats_[MAX_VERTEX_ATTRIBUTES];
+	bool isIndexNarrowingEnabled_;
+
+	// levels of detail as ranges of primitives_, empty without a chain, and
+	// the largest distance of a vertex from the origin, see generateLODs()
+	std::vector<LODLEVEL> lods_;
+	float lodRadius_;
+	unsigned int loadLODCount_;
+
+	// meshlets of level 0, their vertex lists and local triangles, see
+	// buildMeshlets()
+	std::vector<MESHLET> meshlets_;
+	std::vector<unsigned int> meshletVertices_;
+	std::vector<unsigned char> meshletTriangles_;
+
+	// bounding volume hierarchy of level 0, its triangles in leaf order and
+	// their corner and edges, see buildBVH()
+	std::vector<BVHNODE> bvhNodes_;
+	std::vector<unsigned int> bvhPrimitives_;
+	std::vector<float> bvhTriangles_;
+
 	// status flags
 	bool isLoaded_;
 
@@ -26,13 +26,23 @@
 // cpp limits
 #include <limits>	// numeric_limits<int>::max()
 
+// cpp threads
+#include <thread>	// thread, hardware_concurrency
+#include <functional>	// cref
+#include <atomic>	// atomic reference counts
+#include <mutex>	// mutex, lock_guard
+
 // cpp algorithms
 #include <algorithm> // for_each, sort, unique
 
 // c libraries
 #include <cassert>	// assert
 #include <cmath>	// pow, sqrt, sin, cos etc in std namespace
+#include <cstdlib>	// strtod, malloc, free in std namespace
+#include <cstdio>	// rename, remove in std namespace
+#include <cstring>	// memcpy, memset, memchr in std namespace
 #include <ctime>	// time, gmtime, localtime in std namespace
+#include <sys/stat.h>	// stat, file size and modification time
 
 // GL stuff
 //#include <GLXW/glxw.h>
@@ -75,6 +85,26 @@
 #define GEM_BEGIN_NAMESPACE namespace Gem {
 #define GEM_END_NAMESPACE	}
 
+// rvalue references and std::move, VC10 and later or any C++11 compiler
+#if ( defined(_MSC_VER) && _MSC_VER >= 1600 ) || __cplusplus >= 201103L
+#define GEM_HAS_RVALUE_REFS
+#endif
+
+// pointers that do not alias anything else in scope, lets loops vectorize
+#if defined(_MSC_VER)
+#define GEM_RESTRICT __restrict
+#elif defined(__GNUC__)
+#define GEM_RESTRICT __restrict__
+#else
+#define GEM_RESTRICT
+#endif
+
+// SSE2 intrinsics, always there on x64 and with /arch:SSE2 on x86
+#if defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 ) || \
+	defined(__SSE2__)
+#define GEM_HAS_SSE2
+#endif
+
 
 //== NAMESPACES ================================================================
 
@@ -138,8 +168,13 @@ using Mem::Polyd;
 //	THROW:		For private functions, any error. catch in public functions
 //				and handle with ERROR
 //
+//	The macros hold consoleMutex while they print, so loads on worker threads
+//	can report errors too.
+//
+extern std::mutex consoleMutex;
 #define GEM_CONSOLE( msg ) \
 { \
+	std::lock_guard<std::mutex> gemConsoleLock( Gem::consoleMutex ); \
 	std::time_t rawtime; \
 	std::tm* timeinfo; \
 	std::time( &rawtime ); \
@@ -153,6 +188,7 @@ using Mem::Polyd;
 #ifdef _MSC_VER
 #define GEM_WARNING( msg ) \
 { \
+	std::lock_guard<std::mutex> gemConsoleLock( Gem::consoleMutex ); \
 	std::cout	<< std::string( 80, '-' ) \
 				<< "WARNING: " << __FUNCTION__ << "():\n\n" \
 				<< msg << '\n' \
@@ -161,6 +197,7 @@ using Mem::Polyd;
 #else
 #define GEM_WARNING( msg ) \
 { \
+	std::lock_guard<std::mutex> gemConsoleLock( Gem::consoleMutex ); \
 	std::cout	<< std::string( 80, '-' ) \
 				<< "WARNING: " << __func__ << "():\n\n" \
 				<< msg << '\n' \
@@ -170,6 +207,7 @@ using Mem::Polyd;
 #ifdef _MSC_VER
 #define GEM_ERROR( msg ) \
 { \
+	std::lock_guard<std::mutex> gemConsoleLock( Gem::consoleMutex ); \
 	std::cout	<< std::string( 80, '-' ) \
 				<< "ERROR: " << __FUNCTION__ << "():\n\n" \
 				<< msg << '\n' \
@@ -179,6 +217,7 @@ using Mem::Polyd;
 #else
 #define GEM_ERROR( msg ) \
 { \
+	std::lock_guard<std::mutex> gemConsoleLock( Gem::consoleMutex ); \
 	std::cout	<< std::string( 80, '-' ) \
 				<< "ERROR: " << __func__ << "():\n\n" \
 				<< msg << '\n' \
@@ -199,6 +238,24 @@ using Mem::Polyd;
 #define MAX_MIP_LEVELS 16
 #define MAX_FRAMEBUFFER_ATTACHMENTS 6 // 4 color, depth, stencil
 #define MAX_TRANSFORMFEEDBACK_ATTACHMENTS 8
+#define ALLOC_CHUNK_SIZE 65536 // granularity of lazy Allocator storage
+#define ALLOC_ALIGNMENT 64 // alignment and size granularity of Allocator storage
+#define ALLOC_POOL_MAX_SIZE 4194304 // largest pooled block, larger go to heap
+#define ALLOC_POOL_QUARTER_SIZE 65536 // pool sizes step by quarters above this
+#define ALLOC_FRAME_BLOCK_SIZE 4194304 // frame arena grows in blocks this big
+#define ALLOC_DIRTY_GAP 256 // dirty ranges closer than this are merged
+#define ALLOC_DIRTY_RANGES 64 // max dirty ranges before collapsing to one
+#define MESH_CACHE_SIZE 16 // post-transform cache size meshes are optimized for
+#define MESH_MAX_LODS 8 // levels of detail a mesh can have
+#define MESH_MESHLET_VERTICES 64 // default meshlet size, at most 256
+#define MESH_MESHLET_TRIANGLES 124 // default meshlet size
+#define MESH_TANGENT_ATTRIBUTE 14 // slot of generated tangents, TANGENT in Cg
+#define MESH_TEXCOORD_ATTRIBUTE 8 // slot of texcoords, TEXCOORD0 in Cg
+#define MESH_BVH_LEAF_SIZE 4 // default triangles per leaf of a mesh BVH
+#define MESH_BVH_BINS 16 // centroid bins per axis of the BVH split search
+#define ATLAS_PAGE_SIZE 2048 // default largest side of a texture atlas page
+#define ATLAS_MIP_LEVELS 4 // default mip levels of texture atlas pages
+#define ATLAS_PADDING 1 // default border of each texture on the last level
 
 // still want to be able to use NULL when stdio.h is removed
 #ifndef NULL
@@ -257,7 +314,50 @@ enum ALLOC_FORMAT
 	ALLOC_FORMAT_MAT4_32F,
 	// compressed texture formats
 	ALLOC_FORMAT_VEC3_DXT1,
-	ALLOC_FORMAT_VEC3_DXT3,
+	ALLOC_FORMAT_VEC4_DXT3,
+	// narrow vertex and index formats, last so the values of the formats
+	// above stay the same in gmb files
+	ALLOC_FORMAT_SCALAR_16UI,
+	ALLOC_FORMAT_VEC2_16UI,
+	ALLOC_FORMAT_VEC3_16UI,
+	ALLOC_FORMAT_VEC4_16UI,
+	ALLOC_FORMAT_VEC2_16I,
+	ALLOC_FORMAT_VEC2_16F,
+	ALLOC_FORMAT_VEC3_16F,
+	ALLOC_FORMAT_VEC4_16F,
+	ALLOC_FORMAT_VEC4_2_10_10_10,
+	// block compressed texture formats
+	ALLOC_FORMAT_VEC4_DXT5,
+	ALLOC_FORMAT_SCALAR_BC4,
+	ALLOC_FORMAT_VEC2_BC5,
+	ALLOC_FORMAT_VEC3_BC6H,
+	ALLOC_FORMAT_VEC4_BC7,
+	// half float textures
+	ALLOC_FORMAT_SCALAR_16F,
+};
+
+enum ALLOC_MODE
+{
+	ALLOC_MODE_ZERO,				// host memory up front, set to zero
+	ALLOC_MODE_LAZY,				// spec only, host memory on first access
+	ALLOC_MODE_NOINIT,				// host memory up front, left undefined
+};
+
+enum ALLOC_TAG
+{
+	ALLOC_TAG_OTHER,				// untagged
+	ALLOC_TAG_MESH,					// MeshLoader stores
+	ALLOC_TAG_TEXTURE,				// TextureLoader mip levels
+	ALLOC_TAG_UNIFORM,				// uniform blocks
+	ALLOC_TAG_TRANSIENT,			// dead by the end of the frame
+	ALLOC_TAG_COUNT,
+};
+
+enum ALLOC_BACKEND
+{
+	ALLOC_BACKEND_HEAP,				// aligned malloc/free
+	ALLOC_BACKEND_POOL,				// size classes, freed blocks reused
+	ALLOC_BACKEND_FRAME,			// linear arena, reset every frame
 };
 
 enum ALLOC_DIM
@@ -277,19 +377,90 @@ enum ALLOC_TYPE
 	ALLOC_TYPE_NONE,
 	ALLOC_TYPE_8I,
 	ALLOC_TYPE_8UI,
+	ALLOC_TYPE_16I,
+	ALLOC_TYPE_16UI,
+	ALLOC_TYPE_16F,					// half float
 	ALLOC_TYPE_32I,
 	ALLOC_TYPE_32UI,
 	ALLOC_TYPE_32F,
+	ALLOC_TYPE_2_10_10_10,			// signed, packed in one 32 bit word
 	ALLOC_TYPE_DXT1,
+	ALLOC_TYPE_DXT5,				// BC3, DXT1 colors and BC4 alpha
+	ALLOC_TYPE_BC4,					// one channel, RGTC1 in OpenGL
+	ALLOC_TYPE_BC5,					// two BC4 channels, RGTC2 in OpenGL
+	ALLOC_TYPE_DXT3,				// BC2, DXT1 colors and 4 bit alpha
+	ALLOC_TYPE_BC6H,				// unsigned half float rgb, BPTC
+	ALLOC_TYPE_BC7,					// rgba, BPTC in OpenGL
 };
 
+// dimension, component type and bits per element of each ALLOC_FORMAT, as
+// X( format, dim, type, bitsPerElement ). Allocator::alloc and
+// AllocFormatTraits expand it, so a new format only needs a line here
+#define GEM_ALLOC_FORMAT_TABLE( X ) \
+	X( ALLOC_FORMAT_SCALAR_8I, ALLOC_DIM_SCALAR, ALLOC_TYPE_8I, 8 ) \
+	X( ALLOC_FORMAT_SCALAR_8UI, ALLOC_DIM_SCALAR, ALLOC_TYPE_8UI, 8 ) \
+	X( ALLOC_FORMAT_SCALAR_32I, ALLOC_DIM_SCALAR, ALLOC_TYPE_32I, 32 ) \
+	X( ALLOC_FORMAT_SCALAR_32UI, ALLOC_DIM_SCALAR, ALLOC_TYPE_32UI, 32 ) \
+	X( ALLOC_FORMAT_SCALAR_32F, ALLOC_DIM_SCALAR, ALLOC_TYPE_32F, 32 ) \
+	X( ALLOC_FORMAT_VEC2_8I, ALLOC_DIM_VEC2, ALLOC_TYPE_8I, 16 ) \
+	X( ALLOC_FORMAT_VEC2_8UI, ALLOC_DIM_VEC2, ALLOC_TYPE_8UI, 16 ) \
+	X( ALLOC_FORMAT_VEC2_32I, ALLOC_DIM_VEC2, ALLOC_TYPE_32I, 64 ) \
+	X( ALLOC_FORMAT_VEC2_32UI, ALLOC_DIM_VEC2, ALLOC_TYPE_32UI, 64 ) \
+	X( ALLOC_FORMAT_VEC2_32F, ALLOC_DIM_VEC2, ALLOC_TYPE_32F, 64 ) \
+	X( ALLOC_FORMAT_VEC3_8I, ALLOC_DIM_VEC3, ALLOC_TYPE_8I, 24 ) \
+	X( ALLOC_FORMAT_VEC3_8UI, ALLOC_DIM_VEC3, ALLOC_TYPE_8UI, 24 ) \
+	X( ALLOC_FORMAT_VEC3_32I, ALLOC_DIM_VEC3, ALLOC_TYPE_32I, 96 ) \
+	X( ALLOC_FORMAT_VEC3_32UI, ALLOC_DIM_VEC3, ALLOC_TYPE_32UI, 96 ) \
+	X( ALLOC_FORMAT_VEC3_32F, ALLOC_DIM_VEC3, ALLOC_TYPE_32F, 96 ) \
+	X( ALLOC_FORMAT_VEC4_8I, ALLOC_DIM_VEC4, ALLOC_TYPE_8I, 32 ) \
+	X( ALLOC_FORMAT_VEC4_8UI, ALLOC_DIM_VEC4, ALLOC_TYPE_8UI, 32 ) \
+	X( ALLOC_FORMAT_VEC4_32I, ALLOC_DIM_VEC4, ALLOC_TYPE_32I, 128 ) \
+	X( ALLOC_FORMAT_VEC4_32UI, ALLOC_DIM_VEC4, ALLOC_TYPE_32UI, 128 ) \
+	X( ALLOC_FORMAT_VEC4_32F, ALLOC_DIM_VEC4, ALLOC_TYPE_32F, 128 ) \
+	X( ALLOC_FORMAT_MAT2_8I, ALLOC_DIM_MAT2, ALLOC_TYPE_8I, 32 ) \
+	X( ALLOC_FORMAT_MAT2_8UI, ALLOC_DIM_MAT2, ALLOC_TYPE_8UI, 32 ) \
+	X( ALLOC_FORMAT_MAT2_32I, ALLOC_DIM_MAT2, ALLOC_TYPE_32I, 128 ) \
+	X( ALLOC_FORMAT_MAT2_32UI, ALLOC_DIM_MAT2, ALLOC_TYPE_32UI, 128 ) \
+	X( ALLOC_FORMAT_MAT2_32F, ALLOC_DIM_MAT2, ALLOC_TYPE_32F, 128 ) \
+	X( ALLOC_FORMAT_MAT3_8I, ALLOC_DIM_MAT3, ALLOC_TYPE_8I, 72 ) \
+	X( ALLOC_FORMAT_MAT3_8UI, ALLOC_DIM_MAT3, ALLOC_TYPE_8UI, 72 ) \
+	X( ALLOC_FORMAT_MAT3_32I, ALLOC_DIM_MAT3, ALLOC_TYPE_32I, 288 ) \
+	X( ALLOC_FORMAT_MAT3_32UI, ALLOC_DIM_MAT3, ALLOC_TYPE_32UI, 288 ) \
+	X( ALLOC_FORMAT_MAT3_32F, ALLOC_DIM_MAT3, ALLOC_TYPE_32F, 288 ) \
+	X( ALLOC_FORMAT_MAT4_8I, ALLOC_DIM_MAT4, ALLOC_TYPE_8I, 128 ) \
+	X( ALLOC_FORMAT_MAT4_8UI, ALLOC_DIM_MAT4, ALLOC_TYPE_8UI, 128 ) \
+	X( ALLOC_FORMAT_MAT4_32I, ALLOC_DIM_MAT4, ALLOC_TYPE_32I, 512 ) \
+	X( ALLOC_FORMAT_MAT4_32UI, ALLOC_DIM_MAT4, ALLOC_TYPE_32UI, 512 ) \
+	X( ALLOC_FORMAT_MAT4_32F, ALLOC_DIM_MAT4, ALLOC_TYPE_32F, 512 ) \
+	X( ALLOC_FORMAT_VEC3_DXT1, ALLOC_DIM_VEC3, ALLOC_TYPE_DXT1, 4 ) \
+	X( ALLOC_FORMAT_SCALAR_16UI, ALLOC_DIM_SCALAR, ALLOC_TYPE_16UI, 16 ) \
+	X( ALLOC_FORMAT_VEC2_16UI, ALLOC_DIM_VEC2, ALLOC_TYPE_16UI, 32 ) \
+	X( ALLOC_FORMAT_VEC3_16UI, ALLOC_DIM_VEC3, ALLOC_TYPE_16UI, 48 ) \
+	X( ALLOC_FORMAT_VEC4_16UI, ALLOC_DIM_VEC4, ALLOC_TYPE_16UI, 64 ) \
+	X( ALLOC_FORMAT_VEC2_16I, ALLOC_DIM_VEC2, ALLOC_TYPE_16I, 32 ) \
+	X( ALLOC_FORMAT_VEC2_16F, ALLOC_DIM_VEC2, ALLOC_TYPE_16F, 32 ) \
+	X( ALLOC_FORMAT_VEC3_16F, ALLOC_DIM_VEC3, ALLOC_TYPE_16F, 48 ) \
+	X( ALLOC_FORMAT_VEC4_16F, ALLOC_DIM_VEC4, ALLOC_TYPE_16F, 64 ) \
+	X( ALLOC_FORMAT_VEC4_2_10_10_10, ALLOC_DIM_VEC4, ALLOC_TYPE_2_10_10_10, 32 ) \
+	X( ALLOC_FORMAT_VEC4_DXT5, ALLOC_DIM_VEC4, ALLOC_TYPE_DXT5, 8 ) \
+	X( ALLOC_FORMAT_SCALAR_BC4, ALLOC_DIM_SCALAR, ALLOC_TYPE_BC4, 4 ) \
+	X( ALLOC_FORMAT_VEC2_BC5, ALLOC_DIM_VEC2, ALLOC_TYPE_BC5, 8 ) \
+	X( ALLOC_FORMAT_VEC4_DXT3, ALLOC_DIM_VEC4, ALLOC_TYPE_DXT3, 8 ) \
+	X( ALLOC_FORMAT_VEC3_BC6H, ALLOC_DIM_VEC3, ALLOC_TYPE_BC6H, 8 ) \
+	X( ALLOC_FORMAT_VEC4_BC7, ALLOC_DIM_VEC4, ALLOC_TYPE_BC7, 8 ) \
+	X( ALLOC_FORMAT_SCALAR_16F, ALLOC_DIM_SCALAR, ALLOC_TYPE_16F, 16 )
+
 enum PRIM_TYPE
 {
 	PRIM_TYPE_NONE					= ALLOC_FORMAT_NONE,
 	PRIM_TYPE_POINT					= ALLOC_FORMAT_SCALAR_32UI,
 	PRIM_TYPE_LINE					= ALLOC_FORMAT_VEC2_32UI,
 	PRIM_TYPE_TRIANGLE				= ALLOC_FORMAT_VEC3_32UI,
-	PRIM_TYPE_QUAD					= ALLOC_FORMAT_VEC4_32UI
+	PRIM_TYPE_QUAD					= ALLOC_FORMAT_VEC4_32UI,
+	PRIM_TYPE_POINT_16UI			= ALLOC_FORMAT_SCALAR_16UI,
+	PRIM_TYPE_LINE_16UI				= ALLOC_FORMAT_VEC2_16UI,
+	PRIM_TYPE_TRIANGLE_16UI			= ALLOC_FORMAT_VEC3_16UI,
+	PRIM_TYPE_QUAD_16UI				= ALLOC_FORMAT_VEC4_16UI
 };
 
 enum VERTEX_FORMAT
@@ -302,7 +473,12 @@ enum VERTEX_FORMAT
 	VERTEX_FORMAT_XYZ_32UI			= ALLOC_FORMAT_VEC3_32UI,
 	VERTEX_FORMAT_XYZ_32F			= ALLOC_FORMAT_VEC3_32F,
 	VERTEX_FORMAT_XYZW_32UI			= ALLOC_FORMAT_VEC4_32UI,
-	VERTEX_FORMAT_XYZW_32F			= ALLOC_FORMAT_VEC4_32F
+	VERTEX_FORMAT_XYZW_32F			= ALLOC_FORMAT_VEC4_32F,
+	VERTEX_FORMAT_XY_16F			= ALLOC_FORMAT_VEC2_16F,
+	VERTEX_FORMAT_XYZ_16F			= ALLOC_FORMAT_VEC3_16F,
+	VERTEX_FORMAT_XYZW_16F			= ALLOC_FORMAT_VEC4_16F,
+	VERTEX_FORMAT_OCT_16I			= ALLOC_FORMAT_VEC2_16I, // unit vector
+	VERTEX_FORMAT_XYZW_2_10_10_10	= ALLOC_FORMAT_VEC4_2_10_10_10
 };
 
 enum TEXTURE_FORMAT
@@ -317,6 +493,23 @@ enum TEXTURE_FORMAT
 	TEXTURE_FORMAT_RGBA_8UI			= ALLOC_FORMAT_VEC4_8UI,
 	TEXTURE_FORMAT_RGBA_32F			= ALLOC_FORMAT_VEC4_32F,
 	TEXTURE_FORMAT_RGB_DXT1			= ALLOC_FORMAT_VEC3_DXT1,
+	TEXTURE_FORMAT_RGBA_DXT5		= ALLOC_FORMAT_VEC4_DXT5,
+	TEXTURE_FORMAT_R_BC4			= ALLOC_FORMAT_SCALAR_BC4,
+	TEXTURE_FORMAT_RG_BC5			= ALLOC_FORMAT_VEC2_BC5,
+	TEXTURE_FORMAT_RGBA_DXT3		= ALLOC_FORMAT_VEC4_DXT3,
+	TEXTURE_FORMAT_RGB_BC6H			= ALLOC_FORMAT_VEC3_BC6H,
+	TEXTURE_FORMAT_RGBA_BC7			= ALLOC_FORMAT_VEC4_BC7,
+	TEXTURE_FORMAT_R_16F			= ALLOC_FORMAT_SCALAR_16F,
+	TEXTURE_FORMAT_RG_16F			= ALLOC_FORMAT_VEC2_16F,
+	TEXTURE_FORMAT_RGBA_16F			= ALLOC_FORMAT_VEC4_16F,
+};
+
+enum TEXTURE_TARGET
+{
+	TEXTURE_TARGET_2D,				// one layer
+	TEXTURE_TARGET_2D_ARRAY,		// layers of the same size
+	TEXTURE_TARGET_CUBE_MAP,		// six faces, +x -x +y -y +z -z
+	TEXTURE_TARGET_CUBE_MAP_ARRAY,	// six faces per cube
 };
 
 enum TEXTURE_UNIT
@@ -372,7 +565,45 @@ enum FILE_FORMAT
 	FILE_FORMAT_OBX,
 	FILE_FORMAT_BMP,
 	FILE_FORMAT_PFM,
-	FILE_FORMAT_DDS
+	FILE_FORMAT_DDS,
+	FILE_FORMAT_GMB,				// binary mesh, see MeshLoader
+};
+
+enum PARSE_MODE
+{
+	PARSE_MODE_STREAM,				// line by line through iostreams
+	PARSE_MODE_BUFFERED,			// whole file in memory, scanned in place
+	PARSE_MODE_PARALLEL,			// as buffered, split over all cores
+};
+
+enum NORMAL_WEIGHT
+{
+	NORMAL_WEIGHT_AREA,				// by the area of each triangle
+	NORMAL_WEIGHT_ANGLE,			// by the angle of each corner
+};
+
+enum MIP_FILTER
+{
+	MIP_FILTER_NONE,				// no mip levels generated
+	MIP_FILTER_BOX,					// area weighted average
+	MIP_FILTER_KAISER,				// Kaiser windowed sinc
+	MIP_FILTER_LANCZOS,				// Lanczos windowed sinc
+};
+
+enum COMPRESS_QUALITY
+{
+	COMPRESS_QUALITY_FAST,			// range fit, for runtime
+	COMPRESS_QUALITY_HIGH,			// cluster fit, for asset builds
+};
+
+enum LOAD_STATUS
+{
+	LOAD_STATUS_NONE,				// no load
+	LOAD_STATUS_PENDING,			// queued or parsing on a worker
+	LOAD_STATUS_READY,				// parsed, swapped in by Loader::newFrame()
+	LOAD_STATUS_DONE,				// swapped in
+	LOAD_STATUS_FAILED,				// not loaded, the old data is kept
+	LOAD_STATUS_CANCELLED,			// replaced by a newer load or loader gone
 };
 
 enum SHADER_TYPE
@@ -479,6 +710,7 @@ class RenderState;
 
 // Loaders
 class Allocator;
+class AllocatorFactory;
 class MeshLoader;
 class TextureLoader;
 class ShaderLoader;
@@ -71,8 +71,8 @@
 //  |	UPLOAD - upload RAM ---> Buffer
 //  d		
 //	a	glBindBuffer()
-//	t	glBufferStorage()
-//	a	or glBufferData()
+//	t	glBufferSubData()		dirty ranges only
+//	a	or glBufferData()		everything, past RenderState fraction
 //	|	glBindBuffer(0)
 //	c
 //	h
@@ -392,6 +392,9 @@ public:
 	unsigned int getUploadCount() const { return uploadCount_; }
 	const unsigned int* getUploadCountPtr() const { return &uploadCount_; }
 
+	// lifetime bytes sent to the Buffer Object
+	unsigned long long getUploadByteCount() const { return uploadByteCount_; }
+
 	void increasePackCount() { packCount_++; }
 	unsigned int getPackCount() const { return packCount_; }
 	const unsigned int* getPackCountPtr() const { return &packCount_; }
@@ -439,7 +442,9 @@ private:
 	unsigned int uploadCount_;
 	unsigned int packCount_;
 	unsigned int feedbackCount_;
+	unsigned long long uploadByteCount_;
 	bool isDeclared_;
+	bool isFullUpload_;
 };
 
 
@@ -495,6 +500,7 @@ private:
 	GLenum indexType_;
 	GLenum attributeDim_[MAX_VERTEX_ATTRIBUTES];
 	GLenum attributeType_[MAX_VERTEX_ATTRIBUTES];
+	GLboolean attributeNormalized_[MAX_VERTEX_ATTRIBUTES];
 
 	// BufferStates and trackers
 	BufferState* indexBufferPtr_;
@@ -699,6 +705,10 @@ public:
 	void setTextureUnit( TEXTURE_UNIT _textureUnit )
 	{ textureUnit_ = _textureUnit; }
 
+	// layers of each mip level, one after the other, see TextureLoader
+	void setTarget( const TEXTURE_TARGET _textureTarget,
+					const unsigned int _layerCount );
+
 
 	//-- Buffer <--> OpenGL functions ------------------------------------------
 
@@ -726,6 +736,8 @@ private:
 	Trackerui trackerBufferPackCount_[MAX_MIP_LEVELS];
 	TEXTURE_UNIT textureUnit_;
 	unsigned int mipLevelCount_;
+	TEXTURE_TARGET textureTarget_;
+	unsigned int layerCount_;
 
 	// Counters and flags
 	bool isDeclared_;
@@ -889,6 +901,24 @@ public:
 	void draw();
 
 
+	//-- UPLOAD STATISTICS -----------------------------------------------------
+	//
+	// Bytes sent to Buffer Objects by all RenderStates. Call newFrame() once
+	// per frame to have them reported per frame.
+	//
+
+	static void newFrame();
+	static unsigned int getUploadByteCount() { return uploadByteCount_; }
+	static unsigned int getLastFrameUploadByteCount()
+	{ return lastFrameUploadByteCount_; }
+
+	// Buffers with more than this fraction dirty are uploaded whole, which
+	// also orphans the old storage instead of waiting for the GPU to finish
+	static void setFullUploadFraction( const float _fullUploadFraction )
+	{ fullUploadFraction_ = _fullUploadFraction; }
+	static float getFullUploadFraction() { return fullUploadFraction_; }
+
+
 	//-- OPENGL FLAGS & VARS ---------------------------------------------------
 
 	// clear color, depth, stencil
@@ -917,6 +947,10 @@ public:
 	void setViewportPtr( const unsigned int* _viewportWidthPtr, 
 						 const unsigned int* _viewportHeightPtr );
 
+	// primitives drawn, a level of detail of a mesh or all by default
+	void setDrawRange( const unsigned int _primitivesFirst = 0,
+					   const unsigned int _primitivesCount = ~0u );
+
 
 	//-- INPUT: mesh data ------------------------------------------------------
 
@@ -1146,10 +1180,17 @@ private:
 	unsigned int viewportHeight_;
 	const unsigned int* viewportWidthPtr_;
 	const unsigned int* viewportHeightPtr_;
+	// draw range, clamped to the index buffer when drawing
+	unsigned int drawFirst_;
+	unsigned int drawCount_;
 
 
 	// SHARED: Buffer Object
 	static std::map<const Allocator*,BufferState> bufferStates_;
+	static unsigned int uploadByteCount_;
+	static unsigned int lastFrameUploadByteCount_;
+	static float fullUploadFraction_;
+	friend class BufferState;
 
 
 	// INPUT: Vertex Data
@@ -83,6 +83,13 @@ public:
 
 	void reload();
 
+	// as load() and reload(), but read on a worker and swapped in by
+	// Loader::newFrame(), see Loader
+	LoadHandle loadAsync( const std::string& _path,
+						  const SHADER_TYPE _shaderType = SHADER_TYPE_NONE );
+
+	LoadHandle reloadAsync();
+
 protected:
 
 
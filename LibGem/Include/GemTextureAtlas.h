@@ -0,0 +1,172 @@
+//==============================================================================
+//
+//	Packs many small textures into a few large ones, so a scene binds a
+//	texture per page instead of one per material
+//
+//	Texcoords map to a page with MeshLoader::remapTexcoords(), so only
+//	textures that do not repeat across a mesh can go into an atlas.
+//
+//==============================================================================
+
+
+#ifndef GEM_TEXTUREATLAS_H
+#define GEM_TEXTUREATLAS_H
+
+
+//== INCLUDES ==================================================================
+
+#include "GemPrerequisites.h"
+#include "GemTextureLoader.h"
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== CLASS DECLARATION =========================================================
+
+class TextureAtlas
+{
+public:
+
+	//-- define, typedef, enum -------------------------------------------------
+
+	// where a texture went, returned by getEntry()
+	struct ATLASENTRY
+	{
+		unsigned int page;
+		unsigned int x;					// lower left pixel of the texture
+		unsigned int y;					// in level 0 of the page
+		unsigned int width;
+		unsigned int height;
+		Vec2f uvScale;					// page texcoords are texture
+		Vec2f uvOffset;					// texcoords times scale plus offset
+	};
+
+
+	//-- constructors/destructor -----------------------------------------------
+
+	// default constructor
+	TextureAtlas( );
+
+	// default destructor
+	~TextureAtlas( );
+
+
+	//-- copy and clear --------------------------------------------------------
+
+	void clear( );
+
+
+public:
+
+	//-- sets and gets ---------------------------------------------------------
+
+	// largest side of a page, a power of two
+	unsigned int getMaxPageSize() const
+	{ return maxPageSize_; }
+
+	void setMaxPageSize( const unsigned int _maxPageSize )
+	{ maxPageSize_ = _maxPageSize; }
+
+	// mip levels of the pages, cells are aligned so no level mixes cells
+	unsigned int getMipLevelCount() const
+	{ return mipLevelCount_; }
+
+	void setMipLevelCount( const unsigned int _mipLevelCount )
+	{ mipLevelCount_ = _mipLevelCount; }
+
+	// border pixels around each texture on the last level
+	unsigned int getPadding() const
+	{ return padding_; }
+
+	void setPadding( const unsigned int _padding )
+	{ padding_ = _padding; }
+
+	unsigned int getPageCount() const
+	{ return static_cast<unsigned int>( pages_.size() ); }
+
+	TextureLoader* getPagePtr( const unsigned int _page )
+	{ return &pages_[_page]; }
+
+	// one per texture given to build(), in the same order
+	unsigned int getEntryCount() const
+	{ return static_cast<unsigned int>( entries_.size() ); }
+
+	const ATLASENTRY& getEntry( const unsigned int _texture ) const
+	{ return entries_[_texture]; }
+
+
+public:
+
+	//-- build -----------------------------------------------------------------
+
+	// Pack level 0 of _textureCount textures into pages with MaxRects,
+	// largest first, one page format each. 8UI and 32F single layer
+	// textures only, not block compressed.
+	void build( TextureLoader* const* _textures,
+				const unsigned int _textureCount );
+
+
+private:
+
+	//-- private structs -------------------------------------------------------
+
+	// a rectangle of a page, in units of getAlignment() pixels
+	struct ATLASRECT
+	{
+		unsigned int x;
+		unsigned int y;
+		unsigned int width;
+		unsigned int height;
+	};
+
+	// a page being packed, its free rectangles and the corner of what is used
+	struct ATLASBIN
+	{
+		TEXTURE_FORMAT textureFormat;
+		std::vector<ATLASRECT> freeRects;
+		unsigned int usedWidth;
+		unsigned int usedHeight;
+	};
+
+
+	//-- private build ---------------------------------------------------------
+
+	void packTextures( TextureLoader* const* _textures,
+					   const unsigned int _textureCount,
+					   std::vector<ATLASBIN>& _bins );
+
+	void fillPage( TextureLoader* const* _textures,
+				   const unsigned int _textureCount,
+				   const unsigned int _page );
+
+	static bool findFreeRect( const ATLASBIN& _bin, const unsigned int _width,
+							  const unsigned int _height,
+							  unsigned int* _shortSide,
+							  unsigned int* _longSide, ATLASRECT* _rect );
+
+	static void placeRect( ATLASBIN& _bin, const ATLASRECT& _rect );
+
+	// pixels cells start and end on multiples of, and of the border at
+	// level 0
+	unsigned int getAlignment() const;
+
+	unsigned int getBorderSize() const;
+
+
+	//-- private variables -----------------------------------------------------
+
+	unsigned int maxPageSize_;
+	unsigned int mipLevelCount_;
+	unsigned int padding_;
+	std::vector<TextureLoader> pages_;
+	std::vector<ATLASENTRY> entries_;
+};
+
+
+//==============================================================================
+GEM_END_NAMESPACE
+#endif
+//==============================================================================
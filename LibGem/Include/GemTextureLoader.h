@@ -1,12 +1,16 @@
 //==============================================================================
 //
-// An empty class, copy this when creating a new class.h
+//	Creates and holds texture data, a chain of mip levels in one Allocator
+//	each. You can create a texture of a given size and format or load it from
+//	bmp, pfm or dds files.
+//
+//	Rows run bottom to top, as in bmp and pfm files and as GL wants them.
 //
 //==============================================================================
 
 
-#ifndef GEM_EMPTY_H
-#define GEM_EMPTY_H
+#ifndef GEM_TEXTURELOADER_H
+#define GEM_TEXTURELOADER_H
 
 
 //== INCLUDES ==================================================================
@@ -30,34 +34,41 @@ private:
 
 	//-- define, typedef, enum -------------------------------------------------
 
+	// bmp and pfm headers, fixed width fields as in the file, so the info
+	// header is 40 bytes with no padding on any platform
 	struct BITMAPINFOHEADER {
-		unsigned long	size;
-				 long	width;
-				 long	height;
+		unsigned int	size;
+				 int	width;
+				 int	height;		// negative if rows run top to bottom
 		unsigned short	planes;
 		unsigned short	bitCount;
-		unsigned long	compression;
-		unsigned long	sizeImage;
-				 long	xPelsPerMeter;
-				 long	yPelsPerMeter;
-		unsigned long	clrUsed;
-		unsigned long	clrImportant;
+		unsigned int	compression;
+		unsigned int	sizeImage;
+				 int	xPelsPerMeter;
+				 int	yPelsPerMeter;
+		unsigned int	clrUsed;
+		unsigned int	clrImportant;
 	};
 
 	struct BITMAPFILEHEADER {
 		char			type[2];	
-		unsigned long	size;
+		unsigned int	size;
 		unsigned short	reserved1;
 		unsigned short	reserved2;
-		unsigned long	offBits;
+		unsigned int	offBits;
 	};
 
+	// BITMAPINFOHEADER compression, BI_ from wingdi.h
+	#define BMP_RGB				0
+	#define BMP_BITFIELDS		3
+	#define BMP_ALPHABITFIELDS	6
+
 	struct PFMHEADER {
 		unsigned char	p;
 		unsigned char	f;
-		unsigned long	width;
-		unsigned long	height;
-		float			scalefactor;
+		unsigned int	width;
+		unsigned int	height;
+		float			scalefactor;	// negative if little endian
 	};
 
 	// This is the DDSURFACEDESC2 struct from ddraw.h with all the union
@@ -101,6 +112,74 @@ private:
 	#define FOURCC_DXT3  (MAKEFOURCC('D','X','T','3'))
 	#define FOURCC_DXT4  (MAKEFOURCC('D','X','T','4'))
 	#define FOURCC_DXT5  (MAKEFOURCC('D','X','T','5'))
+	#define FOURCC_ATI1  (MAKEFOURCC('A','T','I','1'))
+	#define FOURCC_ATI2  (MAKEFOURCC('A','T','I','2'))
+	#define FOURCC_BC4U  (MAKEFOURCC('B','C','4','U'))
+	#define FOURCC_BC5U  (MAKEFOURCC('B','C','5','U'))
+	#define FOURCC_DX10  (MAKEFOURCC('D','X','1','0'))
+
+	// D3DFORMAT values dds files put in fourCC for float formats
+	#define D3DFMT_R16F				111
+	#define D3DFMT_G16R16F			112
+	#define D3DFMT_A16B16G16R16F	113
+	#define D3DFMT_R32F				114
+	#define D3DFMT_G32R32F			115
+	#define D3DFMT_A32B32G32R32F	116
+
+	// DDSHEADER flags, pixel format flags and caps
+	#define DDSD_CAPS			0x00000001
+	#define DDSD_HEIGHT			0x00000002
+	#define DDSD_WIDTH			0x00000004
+	#define DDSD_PITCH			0x00000008
+	#define DDSD_PIXELFORMAT	0x00001000
+	#define DDSD_MIPMAPCOUNT	0x00020000
+	#define DDSD_LINEARSIZE		0x00080000
+	#define DDPF_ALPHAPIXELS	0x00000001
+	#define DDPF_ALPHA			0x00000002
+	#define DDPF_FOURCC			0x00000004
+	#define DDPF_RGB			0x00000040
+	#define DDPF_LUMINANCE		0x00020000
+	#define DDSCAPS_COMPLEX		0x00000008
+	#define DDSCAPS_TEXTURE		0x00001000
+	#define DDSCAPS_MIPMAP		0x00400000
+	#define DDSCAPS2_CUBEMAP	0x00000200
+	#define DDSCAPS2_ALLFACES	0x0000fc00
+	#define DDSCAPS2_VOLUME		0x00200000
+
+	// Extended header after DDSHEADER when fourCC is DX10, from dds.h
+	struct DDSHEADERDX10 {
+		unsigned int	dxgiFormat;			// DXGI_FORMAT
+		unsigned int	resourceDimension;	// 3 for 2D textures
+		unsigned int	miscFlag;			// DDS_RESOURCE_MISC_TEXTURECUBE
+		unsigned int	arraySize;			// textures, or cubes
+		unsigned int	miscFlags2;			// alpha mode
+	};
+
+	#define DDS_DIMENSION_TEXTURE2D		3
+	#define DDS_MISC_TEXTURECUBE		0x00000004
+
+	// taps of a separable mip filter along one axis, see buildMipKernel()
+	struct MIPKERNEL {
+		unsigned int tapCount;				// taps of each pixel
+		unsigned int tapStride;				// tapCount rounded up to four
+		std::vector<int> first;				// first tap of each pixel
+		std::vector<float> weights;			// tapStride each, zero padded
+	};
+
+	// rows of a mip level for a thread, see filterMipRows()
+	struct MIPRANGE {
+		unsigned int first;					// rows of the smaller level
+		unsigned int last;
+		const unsigned char* src;			// larger level
+		unsigned char* dst;					// smaller level
+		unsigned int srcWidth;
+		unsigned int srcHeight;
+		unsigned int dstWidth;
+		unsigned int dim;					// components per pixel
+		bool isFloat;						// 32F, or 8UI if not
+		const MIPKERNEL* columns;			// along a row
+		const MIPKERNEL* rows;				// along a column
+	};
 
 
 public:
@@ -110,21 +189,37 @@ public:
 	// default constructor
 	TextureLoader();
 
-	// default copy constructor is ok
+	// copy constructor, deep copy
+	TextureLoader( const TextureLoader& other );
+
+#ifdef GEM_HAS_RVALUE_REFS
+	// move constructor, takes the mip levels without allocating
+	TextureLoader( TextureLoader&& other );
+#endif
 
 	// destructor
 	~TextureLoader();
 
-	// default assignment operator is ok
-
 
 	//-- copy and clear --------------------------------------------------------
 
 	void copy( const TextureLoader& other );
 
+	// share the mip levels of other, copy-on-write, see Allocator::share()
+	void share( TextureLoader& other );
+
 	void clear();
 
 
+	//-- assignment operators --------------------------------------------------
+
+	TextureLoader& operator=( const TextureLoader& rhs );
+
+#ifdef GEM_HAS_RVALUE_REFS
+	TextureLoader& operator=( TextureLoader&& rhs );
+#endif
+
+
 public:
 
 	//-- sets and gets ---------------------------------------------------------
@@ -134,6 +229,30 @@ public:
 
 	unsigned int getMipLevelCount() const 
 	{ return mipLevelCount_; }
+
+	// Layers of each level, six per cube in the order +x -x +y -y +z -z.
+	// A level holds all of its layers one after the other, as glTexImage3D
+	// wants them.
+	unsigned int getLayerCount() const
+	{ return layerCount_; }
+
+	TEXTURE_TARGET getTextureTarget() const
+	{ return textureTarget_; }
+
+	// map pfm and dds pixel data from file instead of reading it
+	bool isMapEnabled() const
+	{ return isMapEnabled_; }
+
+	void setMapEnabled( const bool _isMapEnabled )
+	{ isMapEnabled_ = _isMapEnabled; }
+
+	// filter bmp and pfm loads generate their mip levels with, none by
+	// default, see generateMipLevels()
+	MIP_FILTER getMipFilter() const
+	{ return mipFilter_; }
+
+	void setMipFilter( const MIP_FILTER _mipFilter )
+	{ mipFilter_ = _mipFilter; }
 	
 	bool isLoaded() const
 	{ return isLoaded_; }
@@ -147,6 +266,13 @@ public:
 
 	void reload();
 
+	// as load() and reload(), but parsed on a worker and swapped in by
+	// Loader::newFrame(), see Loader
+	LoadHandle loadAsync( const std::string& _path,
+						  const FILE_FORMAT _fileFormat = FILE_FORMAT_NONE );
+
+	LoadHandle reloadAsync();
+
 	void create( const unsigned int _width, const unsigned int _height, 
 				 const TEXTURE_FORMAT _textureFormat,
 				 const bool _generateMipLevels = false );
@@ -155,18 +281,79 @@ public:
 			   const FILE_FORMAT _fileFormat = FILE_FORMAT_NONE );
 
 
+	//-- mip levels ------------------------------------------------------------
+
+	// Fill mip level 1 and down from level 0, allocating the levels missing.
+	// The chain stops after _maxMipLevelCount levels, the rest are dropped.
+	// 8UI and 32F textures only. The filters are separable and spread odd
+	// pixels over their neighbours, the result does not depend on threads.
+	void generateMipLevels( const MIP_FILTER _filter = MIP_FILTER_BOX,
+							const unsigned int _maxMipLevelCount =
+								MAX_MIP_LEVELS );
+
+
+	//-- block compression -----------------------------------------------------
+
+	// Compress every mip level of an 8UI or 32F texture to a block
+	// compressed _format, see GemBlockCompression.h, 32F clamped to [0, 1]
+	// first. BC6H and BC7 do not compress.
+	void compress( const TEXTURE_FORMAT _format,
+				   const COMPRESS_QUALITY _quality = COMPRESS_QUALITY_FAST );
+
+	// Decompress every mip level to R, RG, RGB or RGBA 8UI
+	void decompress();
+
+
 
 protected:
 
 
 private:
 
+	//-- copy and clear --------------------------------------------------------
+
+	// defaults of every member but the mip levels, for the constructors
+	void init();
+
+	// every member but the mip levels, for copy, share and move
+	void copyMembers( const TextureLoader& other );
+
+
 	//-- load and create -------------------------------------------------------
 
 	void createMipLevels( const unsigned int _width,
 						  const unsigned int _height,
 						  const TEXTURE_FORMAT _textureFormat,
-						  unsigned int _maxMipLevelCount = MAX_MIP_LEVELS );
+						  unsigned int _maxMipLevelCount = MAX_MIP_LEVELS,
+						  const ALLOC_MODE _allocMode = ALLOC_MODE_ZERO,
+						  const std::string& _mapPath = "",
+						  const unsigned long long _mapOffset = 0,
+						  const TEXTURE_TARGET _textureTarget =
+							  TEXTURE_TARGET_2D,
+						  const unsigned int _layerCount = 1 );
+
+
+	//-- private mip levels ----------------------------------------------------
+
+	void computeMipLevels( const MIP_FILTER _filter,
+						   const unsigned int _maxMipLevelCount );
+
+	// taps that filter srcSize pixels down to dstSize
+	static void buildMipKernel( const unsigned int _srcSize,
+								const unsigned int _dstSize,
+								const MIP_FILTER _filter,
+								MIPKERNEL* _kernel );
+
+	// filter rows first to last of a smaller level
+	static void filterMipRows( MIPRANGE* _range );
+
+
+	//-- private block compression ---------------------------------------------
+
+	void compressMipLevels( const TEXTURE_FORMAT _format,
+							const COMPRESS_QUALITY _quality );
+
+	void decompressMipLevels();
 
 
 	//-- private file-io -------------------------------------------------------
@@ -194,8 +381,16 @@ private:
 	unsigned int height_;
 	TEXTURE_FORMAT textureFormat_;
 	unsigned int mipLevelCount_;
+	TEXTURE_TARGET textureTarget_;
+	unsigned int layerCount_;
 	Allocator mipLevels_[MAX_MIP_LEVELS];
 
+	// pixel data is mapped from file when possible
+	bool isMapEnabled_;
+
+	// mip levels generated on load
+	MIP_FILTER mipFilter_;
+
 	// status flags
 	bool isLoaded_;
 };
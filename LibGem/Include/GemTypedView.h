@@ -0,0 +1,351 @@
+//==============================================================================
+//
+//	TypedView and ConstTypedView give unchecked typed access to the storage
+//	of an Allocator for loops over many elements. A view does not compile
+//	unless T matches the ALLOC_FORMAT F.
+//
+//==============================================================================
+
+
+#ifndef GEM_TYPEDVIEW_H
+#define GEM_TYPEDVIEW_H
+
+
+//== INCLUDES ==================================================================
+
+#include "GemPrerequisites.h"
+#include "GemAllocator.h"
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== TRAITS ====================================================================
+
+// dimension, type and size of a format at compile time, formats missing from
+// the table have no traits and do not compile
+template<ALLOC_FORMAT F>
+struct AllocFormatTraits;
+
+#define GEM_ALLOC_FORMAT_TRAITS( f, d, t, b ) \
+template<> \
+struct AllocFormatTraits<f> \
+{ \
+	enum { dim = d, type = t, bitsPerElement = b }; \
+};
+GEM_ALLOC_FORMAT_TABLE( GEM_ALLOC_FORMAT_TRAITS )
+#undef GEM_ALLOC_FORMAT_TRAITS
+
+
+// dimension and type of an element type, none for types that cant be stored
+template<typename T>
+struct AllocElementTraits
+{
+	enum { dim = ALLOC_DIM_NONE, type = ALLOC_TYPE_NONE };
+};
+
+template<>
+struct AllocElementTraits<signed char>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_8I };
+};
+
+template<>
+struct AllocElementTraits<unsigned char>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_8UI };
+};
+
+template<>
+struct AllocElementTraits<signed short>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_16I };
+};
+
+template<>
+struct AllocElementTraits<unsigned short>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_16UI };
+};
+
+template<>
+struct AllocElementTraits<signed int>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_32I };
+};
+
+template<>
+struct AllocElementTraits<unsigned int>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_32UI };
+};
+
+template<>
+struct AllocElementTraits<float>
+{
+	enum { dim = ALLOC_DIM_SCALAR, type = ALLOC_TYPE_32F };
+};
+
+// vectors and square matrices of scalars
+template<typename T, int S>
+struct AllocVectorTraits
+{
+	enum
+	{
+		type = AllocElementTraits<T>::dim == ALLOC_DIM_SCALAR ?
+			   AllocElementTraits<T>::type : ALLOC_TYPE_NONE
+	};
+};
+
+template<typename T>
+struct AllocElementTraits< Mem::Vector<T,2> >
+{
+	enum { dim = ALLOC_DIM_VEC2, type = AllocVectorTraits<T,2>::type };
+};
+
+template<typename T>
+struct AllocElementTraits< Mem::Vector<T,3> >
+{
+	enum { dim = ALLOC_DIM_VEC3, type = AllocVectorTraits<T,3>::type };
+};
+
+template<typename T>
+struct AllocElementTraits< Mem::Vector<T,4> >
+{
+	enum { dim = ALLOC_DIM_VEC4, type = AllocVectorTraits<T,4>::type };
+};
+
+template<typename T>
+struct AllocElementTraits< Mem::Matrix<T,2,2> >
+{
+	enum { dim = ALLOC_DIM_MAT2, type = AllocVectorTraits<T,4>::type };
+};
+
+template<typename T>
+struct AllocElementTraits< Mem::Matrix<T,3,3> >
+{
+	enum { dim = ALLOC_DIM_MAT3, type = AllocVectorTraits<T,9>::type };
+};
+
+template<typename T>
+struct AllocElementTraits< Mem::Matrix<T,4,4> >
+{
+	enum { dim = ALLOC_DIM_MAT4, type = AllocVectorTraits<T,16>::type };
+};
+
+
+//== CLASS DECLARATION =========================================================
+
+template<typename T, ALLOC_FORMAT F>
+class TypedView
+{
+	static_assert( (int)AllocElementTraits<T>::dim ==
+				   (int)AllocFormatTraits<F>::dim &&
+				   (int)AllocElementTraits<T>::type ==
+				   (int)AllocFormatTraits<F>::type,
+				   "Element type does not match the Allocator format." );
+	static_assert( sizeof(T) * 8 == AllocFormatTraits<F>::bitsPerElement,
+				   "Element size does not match the Allocator format." );
+
+public:
+
+	//-- constructors ----------------------------------------------------------
+
+	// One write to the whole Allocator, the view is valid until the
+	// Allocator is reallocated, cleared, shared or written another way
+	explicit TypedView( Allocator& _allocator )
+	: ptr_( NULL )
+	, width_( _allocator.getWidth() )
+	, height_( _allocator.getHeight() )
+	, elementCount_( _allocator.getElementCount() )
+	{
+		assert( _allocator.getFormat() == F || !_allocator.isAlloc() );
+		ptr_ = _allocator.getWritePtr<T>();
+	}
+
+
+	//-- element access --------------------------------------------------------
+
+	T& operator[]( const unsigned int pos ) const
+	{
+		assert( pos < elementCount_ );
+		return ptr_[pos];
+	}
+
+	T& operator()( const unsigned int i, const unsigned int j ) const
+	{
+		assert( i < height_ && j < width_ );
+		return ptr_[i * width_ + j];
+	}
+
+	// first element of row i
+	T* row( const unsigned int i ) const
+	{
+		assert( i < height_ );
+		return ptr_ + i * width_;
+	}
+
+	T* data() const { return ptr_; }
+	T* begin() const { return ptr_; }
+	T* end() const { return ptr_ + elementCount_; }
+
+
+	//-- iteration -------------------------------------------------------------
+
+	// f( T& ) for every element
+	template<typename Func>
+	void forEach( Func f ) const
+	{
+		T* GEM_RESTRICT ptr = ptr_;
+		const unsigned int count = elementCount_;
+		for ( unsigned int k = 0; k < count; ++k )
+		{
+			f( ptr[k] );
+		}
+	}
+
+	// f( i, j, T& ) for every element, row by row
+	template<typename Func>
+	void forEach2D( Func f ) const
+	{
+		const unsigned int width = width_;
+		const unsigned int height = height_;
+		for ( unsigned int i = 0; i < height; ++i )
+		{
+			T* GEM_RESTRICT ptr = ptr_ + i * width;
+			for ( unsigned int j = 0; j < width; ++j )
+			{
+				f( i, j, ptr[j] );
+			}
+		}
+	}
+
+
+	//-- gets ------------------------------------------------------------------
+
+	unsigned int getWidth() const { return width_; }
+	unsigned int getHeight() const { return height_; }
+	unsigned int getElementCount() const { return elementCount_; }
+
+
+private:
+
+	//-- local variables -------------------------------------------------------
+
+	T* ptr_;
+	unsigned int width_;
+	unsigned int height_;
+	unsigned int elementCount_;
+};
+
+
+//== CLASS DECLARATION =========================================================
+
+template<typename T, ALLOC_FORMAT F>
+class ConstTypedView
+{
+	static_assert( (int)AllocElementTraits<T>::dim ==
+				   (int)AllocFormatTraits<F>::dim &&
+				   (int)AllocElementTraits<T>::type ==
+				   (int)AllocFormatTraits<F>::type,
+				   "Element type does not match the Allocator format." );
+	static_assert( sizeof(T) * 8 == AllocFormatTraits<F>::bitsPerElement,
+				   "Element size does not match the Allocator format." );
+
+public:
+
+	//-- constructors ----------------------------------------------------------
+
+	// one read of the whole Allocator, valid as TypedView
+	explicit ConstTypedView( Allocator& _allocator )
+	: ptr_( NULL )
+	, width_( _allocator.getWidth() )
+	, height_( _allocator.getHeight() )
+	, elementCount_( _allocator.getElementCount() )
+	{
+		assert( _allocator.getFormat() == F || !_allocator.isAlloc() );
+		ptr_ = _allocator.getReadPtr<T>();
+	}
+
+
+	//-- element access --------------------------------------------------------
+
+	const T& operator[]( const unsigned int pos ) const
+	{
+		assert( pos < elementCount_ );
+		return ptr_[pos];
+	}
+
+	const T& operator()( const unsigned int i, const unsigned int j ) const
+	{
+		assert( i < height_ && j < width_ );
+		return ptr_[i * width_ + j];
+	}
+
+	// first element of row i
+	const T* row( const unsigned int i ) const
+	{
+		assert( i < height_ );
+		return ptr_ + i * width_;
+	}
+
+	const T* data() const { return ptr_; }
+	const T* begin() const { return ptr_; }
+	const T* end() const { return ptr_ + elementCount_; }
+
+
+	//-- iteration -------------------------------------------------------------
+
+	// f( const T& ) for every element
+	template<typename Func>
+	void forEach( Func f ) const
+	{
+		const T* GEM_RESTRICT ptr = ptr_;
+		const unsigned int count = elementCount_;
+		for ( unsigned int k = 0; k < count; ++k )
+		{
+			f( ptr[k] );
+		}
+	}
+
+	// f( i, j, const T& ) for every element, row by row
+	template<typename Func>
+	void forEach2D( Func f ) const
+	{
+		const unsigned int width = width_;
+		const unsigned int height = height_;
+		for ( unsigned int i = 0; i < height; ++i )
+		{
+			const T* GEM_RESTRICT ptr = ptr_ + i * width;
+			for ( unsigned int j = 0; j < width; ++j )
+			{
+				f( i, j, ptr[j] );
+			}
+		}
+	}
+
+
+	//-- gets ------------------------------------------------------------------
+
+	unsigned int getWidth() const { return width_; }
+	unsigned int getHeight() const { return height_; }
+	unsigned int getElementCount() const { return elementCount_; }
+
+
+private:
+
+	//-- local variables -------------------------------------------------------
+
+	const T* ptr_;
+	unsigned int width_;
+	unsigned int height_;
+	unsigned int elementCount_;
+};
+
+
+//==============================================================================
+GEM_END_NAMESPACE
+#endif
+//==============================================================================
@@ -1,6 +1,17 @@
 //== INCLUDES ==================================================================
 
 #include "GemAllocator.h"
+#include "GemAllocatorFactory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 //== NAMESPACES ================================================================
@@ -29,16 +40,84 @@ Allocator::Allocator( )
 , readCount_(0)
 , writeCount_(0)
 , isAlloc_(false)
-{}
+, isLazy_(false)
+, chunks_()
+, chunksLeft_(0)
+, dirtyRanges_()
+, shared_(NULL)
+, mapPtr_(NULL)
+, mapByteCount_(0)
+, isReadOnly_(false)
+, tag_(ALLOC_TAG_OTHER)
+, isRegistered_(false)
+{
+}
 
 Allocator::Allocator( const Allocator& other )
+: ptr_(NULL)
+, cur_(NULL)
+, format_(ALLOC_FORMAT_NONE)
+, width_(0)
+, height_( 0 )
+, dim_(ALLOC_DIM_NONE)
+, type_(ALLOC_TYPE_NONE)
+, bitsPerElement_(0)
+, elementCount_(0)
+, byteCount_(0)
+, allocCount_(0)
+, readCount_(0)
+, writeCount_(0)
+, isAlloc_(false)
+, isLazy_(false)
+, chunks_()
+, chunksLeft_(0)
+, dirtyRanges_()
+, shared_(NULL)
+, mapPtr_(NULL)
+, mapByteCount_(0)
+, isReadOnly_(false)
+, tag_(other.tag_)
+, isRegistered_(false)
 {
 	copy( other );
 }
 
+#ifdef GEM_HAS_RVALUE_REFS
+Allocator::Allocator( Allocator&& other )
+: ptr_(NULL)
+, cur_(NULL)
+, format_(ALLOC_FORMAT_NONE)
+, width_(0)
+, height_( 0 )
+, dim_(ALLOC_DIM_NONE)
+, type_(ALLOC_TYPE_NONE)
+, bitsPerElement_(0)
+, elementCount_(0)
+, byteCount_(0)
+, allocCount_(0)
+, readCount_(0)
+, writeCount_(0)
+, isAlloc_(false)
+, isLazy_(false)
+, chunks_()
+, chunksLeft_(0)
+, dirtyRanges_()
+, shared_(NULL)
+, mapPtr_(NULL)
+, mapByteCount_(0)
+, isReadOnly_(false)
+, tag_(other.tag_)
+, isRegistered_(false)
+{
+	moveFrom( other );
+}
+#endif
+
 Allocator::~Allocator( )
 {
 	clear();
+	if ( isRegistered_ )
+		AllocatorFactory::unregisterAllocator( this );
 }
 
 //-- copy and clear ------------------------------------------------------------
@@ -50,21 +129,61 @@ Allocator::copy( const Allocator& other )
 		this->clear();
 
 
-	// allocate data
-	unsigned char* newPtr;
-	newPtr = new unsigned char[other.byteCount_];
-	cur_ = ptr_ = static_cast<void*>(newPtr);
+	// allocate data in the same mode as other, contents are copied below
+	if ( other.isAlloc_ )
+	{
+		alloc( other.format_, other.width_, other.height_,
+			   other.isLazy_ ? ALLOC_MODE_LAZY : ALLOC_MODE_NOINIT );
+	}
+
+
+	// copy data (deep copy), only chunks in use for lazy storage
+	copyStorage( other.ptr_, other.isLazy_ ? &other.chunks_ : NULL );
 
 
-	// copy data (deep copy)
-	unsigned char* otherPtr = static_cast<unsigned char*>(other.ptr_);
-	for ( unsigned int i=0; i<byteCount_; ++i )
+	// copy activity counters
+	allocCount_ = other.allocCount_;
+	readCount_ = other.readCount_;
+	writeCount_ = other.writeCount_;
+
+
+	// all of the data is new to whoever tracks this Allocator
+	if ( byteCount_ )
 	{
-		newPtr[i] = otherPtr[i];
+		dirtyRanges_.push_back( Range( 0, byteCount_ ) );
 	}
+}
+
+void
+Allocator::share( Allocator& other )
+{
+	if ( this == &other || ( shared_ && shared_ == other.shared_ ) )
+		return;
 
 
-	// copy stack member variables
+	// nothing to share, a copy is just as cheap
+	if ( !other.ptr_ )
+	{
+		copy( other );
+		return;
+	}
+	if ( isAlloc_ )
+		this->clear();
+
+
+	// start counting references to others storage
+	if ( !other.shared_ )
+	{
+		other.shared_ = new SHARED;
+		other.shared_->refCount = 1;
+	}
+	other.shared_->refCount++;
+	shared_ = other.shared_;
+
+
+	// same storage and format as other
+	ptr_ = other.ptr_;
+	cur_ = ptr_;
 	format_ = other.format_;
 	width_ = other.width_;
 	height_ = other.height_;
@@ -73,17 +192,28 @@ Allocator::copy( const Allocator& other )
 	bitsPerElement_ = other.bitsPerElement_;
 	elementCount_ = other.elementCount_;
 	byteCount_ = other.byteCount_;
-	allocCount_ = other.allocCount_;
-	readCount_ = other.readCount_;
-	writeCount_ = other.writeCount_;
-	isAlloc_ = other.isAlloc_;
+	isAlloc_ = true;
+	registerOnce();
+	isLazy_ = other.isLazy_;
+	chunks_ = other.chunks_;
+	chunksLeft_ = other.chunksLeft_;
+	mapPtr_ = other.mapPtr_;
+	mapByteCount_ = other.mapByteCount_;
+	isReadOnly_ = other.isReadOnly_;
+
+
+	// new data to whoever tracks this Allocator, like alloc and write
+	allocCount_++;
+	writeCount_++;
+	dirtyRanges_.assign( 1, Range( 0, byteCount_ ) );
 }
 
 void
 Allocator::clear( )
 {	
-	// deallocate data
-	delete [] ptr_;
+	// deallocate or unmap data, shared storage only by the last owner
+	freeStorage( ptr_, isLazy_, chunks_.size(), mapPtr_, mapByteCount_,
+				 shared_ );
 
 	// reset member variables
 	ptr_				= NULL;
@@ -100,6 +230,14 @@ Allocator::clear( )
 	readCount_			= readCount_; // dont reset, lifetime counter
 	writeCount_			= writeCount_; // dont reset, lifetime counter
 	isAlloc_			= false;
+	isLazy_				= false;
+	chunks_.clear();
+	chunksLeft_			= 0;
+	dirtyRanges_.clear();
+	shared_				= NULL;
+	mapPtr_				= NULL;
+	mapByteCount_		= 0;
+	isReadOnly_			= false;
 }
 
 //-- assignment operator -------------------------------------------------------
@@ -115,17 +253,81 @@ Allocator::operator=( const Allocator& rhs )
 	return *this;
 }
 
+#ifdef GEM_HAS_RVALUE_REFS
+Allocator&
+Allocator::operator=( Allocator&& rhs )
+{
+	if ( this != &rhs )
+	{
+		// lifetime counters never go backwards, so trackers of this
+		// Allocator see new data
+		unsigned int allocCount = std::max( allocCount_, rhs.allocCount_ ) + 1;
+		unsigned int readCount = std::max( readCount_, rhs.readCount_ );
+		unsigned int writeCount = std::max( writeCount_, rhs.writeCount_ ) + 1;
+		this->clear();
+		moveFrom( rhs );
+		allocCount_ = allocCount;
+		readCount_ = readCount;
+		writeCount_ = writeCount;
+	}
+	return *this;
+}
+#endif
+
 //-- alloc ---------------------------------------------------------------------
 
 void
 Allocator::alloc( ALLOC_FORMAT _format,
 				  const unsigned int _width, 
-				  const unsigned int _height )
+				  const unsigned int _height,
+				  const ALLOC_MODE _mode )
 {
 	if ( isAlloc_ )
 		this->clear();
 
-	
+
+	// setup data format, allocate data
+	setFormat( _format, _width, _height );
+	allocStorage( byteCount_, _mode );
+
+
+	// set member variables
+	allocCount_ += 1; // dont reset, lifetime counter
+	isAlloc_ = true;
+	registerOnce();
+}
+
+void
+Allocator::map( const std::string& _path,
+				const unsigned long long _offset,
+				ALLOC_FORMAT _format,
+				const unsigned int _width,
+				const unsigned int _height,
+				const bool _isCopyOnWrite )
+{
+	if ( isAlloc_ )
+		this->clear();
+
+
+	// setup data format, map data
+	setFormat( _format, _width, _height );
+	ptr_ = mapFile( _path, _offset, byteCount_, _isCopyOnWrite,
+					&mapPtr_, &mapByteCount_ );
+	cur_ = ptr_;
+	isReadOnly_ = !_isCopyOnWrite;
+
+
+	// set member variables
+	allocCount_ += 1; // dont reset, lifetime counter
+	isAlloc_ = true;
+	registerOnce();
+}
+
+void
+Allocator::setFormat( ALLOC_FORMAT _format,
+					  const unsigned int _width,
+					  const unsigned int _height )
+{
 	// local variables
 	ALLOC_FORMAT format = _format;
 	unsigned int width = _width;
@@ -137,196 +339,17 @@ Allocator::alloc( ALLOC_FORMAT _format,
 	unsigned int byteCount;
 
 
-	// setup data format variables
+	// setup data format variables from the format table
 	switch ( format )
 	{
-	// scalar formats
-	case ALLOC_FORMAT_SCALAR_8I:
-		dim = ALLOC_DIM_SCALAR;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 8;
-		break;
-	case ALLOC_FORMAT_SCALAR_8UI:
-		dim = ALLOC_DIM_SCALAR;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 8;
-		break;
-	case ALLOC_FORMAT_SCALAR_32I:
-		dim = ALLOC_DIM_SCALAR;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 32;
-		break;
-	case ALLOC_FORMAT_SCALAR_32UI:
-		dim = ALLOC_DIM_SCALAR;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 32;
-		break;
-	case ALLOC_FORMAT_SCALAR_32F:
-		dim = ALLOC_DIM_SCALAR;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 32;
-		break;
-
-	// vector formats
-	case ALLOC_FORMAT_VEC2_8I:
-		dim = ALLOC_DIM_VEC2;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 16;
-		break;
-	case ALLOC_FORMAT_VEC2_8UI:
-		dim = ALLOC_DIM_VEC2;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 16;
-		break;
-	case ALLOC_FORMAT_VEC2_32I:
-		dim = ALLOC_DIM_VEC2;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 64;
-		break;
-	case ALLOC_FORMAT_VEC2_32UI:
-		dim = ALLOC_DIM_VEC2;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 64;
-		break;
-	case ALLOC_FORMAT_VEC2_32F:
-		dim = ALLOC_DIM_VEC2;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 64;
-		break;
-	case ALLOC_FORMAT_VEC3_8I:
-		dim = ALLOC_DIM_VEC3;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 24;
-		break;
-	case ALLOC_FORMAT_VEC3_8UI:
-		dim = ALLOC_DIM_VEC3;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 24;
-		break;
-	case ALLOC_FORMAT_VEC3_32I:
-		dim = ALLOC_DIM_VEC3;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 96;
-		break;
-	case ALLOC_FORMAT_VEC3_32UI:
-		dim = ALLOC_DIM_VEC3;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 96;
-		break;
-	case ALLOC_FORMAT_VEC3_32F:
-		dim = ALLOC_DIM_VEC3;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 96;
-		break;
-	case ALLOC_FORMAT_VEC4_8I:
-		dim = ALLOC_DIM_VEC4;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 32;
-		break;
-	case ALLOC_FORMAT_VEC4_8UI:
-		dim = ALLOC_DIM_VEC4;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 32;
-		break;
-	case ALLOC_FORMAT_VEC4_32I:
-		dim = ALLOC_DIM_VEC4;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_VEC4_32UI:
-		dim = ALLOC_DIM_VEC4;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_VEC4_32F:
-		dim = ALLOC_DIM_VEC4;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 128;
-		break;
-
-	// matrix formats
-	case ALLOC_FORMAT_MAT2_8I:
-		dim = ALLOC_DIM_MAT2;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 32;
-		break;
-	case ALLOC_FORMAT_MAT2_8UI:
-		dim = ALLOC_DIM_MAT2;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 32;
-		break;
-	case ALLOC_FORMAT_MAT2_32I:
-		dim = ALLOC_DIM_MAT2;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_MAT2_32UI:
-		dim = ALLOC_DIM_MAT2;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_MAT2_32F:
-		dim = ALLOC_DIM_MAT2;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_MAT3_8I:
-		dim = ALLOC_DIM_MAT3;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 72;
-		break;
-	case ALLOC_FORMAT_MAT3_8UI:
-		dim = ALLOC_DIM_MAT3;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 72;
-		break;
-	case ALLOC_FORMAT_MAT3_32I:
-		dim = ALLOC_DIM_MAT3;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 288;
-		break;
-	case ALLOC_FORMAT_MAT3_32UI:
-		dim = ALLOC_DIM_MAT3;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 288;
-		break;
-	case ALLOC_FORMAT_MAT3_32F:
-		dim = ALLOC_DIM_MAT3;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 288;
-		break;
-	case ALLOC_FORMAT_MAT4_8I:
-		dim = ALLOC_DIM_MAT4;
-		type = ALLOC_TYPE_8I;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_MAT4_8UI:
-		dim = ALLOC_DIM_MAT4;
-		type = ALLOC_TYPE_8UI;
-		bitsPerElement = 128;
-		break;
-	case ALLOC_FORMAT_MAT4_32I:
-		dim = ALLOC_DIM_MAT4;
-		type = ALLOC_TYPE_32I;
-		bitsPerElement = 512;
-		break;
-	case ALLOC_FORMAT_MAT4_32UI:
-		dim = ALLOC_DIM_MAT4;
-		type = ALLOC_TYPE_32UI;
-		bitsPerElement = 512;
-		break;
-	case ALLOC_FORMAT_MAT4_32F:
-		dim = ALLOC_DIM_MAT4;
-		type = ALLOC_TYPE_32F;
-		bitsPerElement = 512;
-		break;
-
-	// compressed texture formats
-	case ALLOC_FORMAT_VEC3_DXT1:
-		dim = ALLOC_DIM_VEC3;
-		type = ALLOC_TYPE_DXT1;
-		bitsPerElement = 4;
+#define GEM_ALLOC_FORMAT_CASE( f, d, t, b ) \
+	case f: \
+		dim = d; \
+		type = t; \
+		bitsPerElement = b; \
 		break;
+	GEM_ALLOC_FORMAT_TABLE( GEM_ALLOC_FORMAT_CASE )
+#undef GEM_ALLOC_FORMAT_CASE
 
 	default:
 		GEM_THROW( "Unsupported data format." );
@@ -334,22 +357,11 @@ Allocator::alloc( ALLOC_FORMAT _format,
 	};
 
 
-	// calculate number of elements and byte count
+	// calculate number of elements and byte count, rounded up to whole bytes
 	elementCount = width * height;
-	byteCount = std::ceil( elementCount * (bitsPerElement / 8.0f) );
-
-
-	// allocate data
-	unsigned char* ptr;
-	ptr = new unsigned char[byteCount];
-	cur_ = ptr_ = static_cast<void*>(ptr);
-
-
-	// set to zero
-	for ( unsigned int i=0; i<byteCount; ++i )
-	{
-		ptr[i] = 0;
-	}
+	byteCount = static_cast<unsigned int>(
+		( static_cast<unsigned long long>( elementCount ) * bitsPerElement
+		  + 7 ) / 8 );
 
 
 	// set member variables
@@ -361,10 +373,413 @@ Allocator::alloc( ALLOC_FORMAT _format,
 	bitsPerElement_ = bitsPerElement;
 	elementCount_ = elementCount;
 	byteCount_ = byteCount;
-	allocCount_ += 1; // dont reset, lifetime counter
-	readCount_ = readCount_; // dont reset, lifetime counter
-	writeCount_ = writeCount_; // dont reset, lifetime counter
-	isAlloc_ = true;
+}
+
+unsigned int
+Allocator::getResidentByteCount( ) const
+{
+	if ( !isLazy_ )
+		return byteCount_;
+
+
+	// committed chunks, last one may be partial
+	unsigned int count = 0;
+	for ( unsigned int i=0; i<chunks_.size(); ++i )
+	{
+		if ( chunks_[i] )
+			count += std::min<unsigned int>( ALLOC_CHUNK_SIZE,
+											 byteCount_ - i*ALLOC_CHUNK_SIZE );
+	}
+	return count;
+}
+
+unsigned int
+Allocator::getDirtyByteCount( ) const
+{
+	unsigned int count = 0;
+	for ( unsigned int i=0; i<dirtyRanges_.size(); ++i )
+	{
+		count += dirtyRanges_[i].second - dirtyRanges_[i].first;
+	}
+	return count;
+}
+
+//-- dirty ranges --------------------------------------------------------------
+
+void
+Allocator::addDirtyRange( const unsigned int _offset,
+						  const unsigned int _byteCount )
+{
+	unsigned int begin = _offset;
+	unsigned int end = _offset + _byteCount;
+
+
+	// skip ranges that end well before the new one
+	std::vector<Range>::iterator i = dirtyRanges_.begin();
+	while ( i != dirtyRanges_.end() && i->second + ALLOC_DIRTY_GAP < begin )
+	{
+		++i;
+	}
+
+
+	// swallow ranges that overlap or are within the gap
+	std::vector<Range>::iterator j = i;
+	while ( j != dirtyRanges_.end() && j->first <= end + ALLOC_DIRTY_GAP )
+	{
+		begin = std::min( begin, j->first );
+		end = std::max( end, j->second );
+		++j;
+	}
+	i = dirtyRanges_.erase( i, j );
+	dirtyRanges_.insert( i, Range( begin, end ) );
+
+
+	// too many ranges, merge the two closest ones
+	if ( dirtyRanges_.size() > ALLOC_DIRTY_RANGES )
+	{
+		unsigned int closest = 0;
+		for ( unsigned int k=1; k+1<dirtyRanges_.size(); ++k )
+		{
+			if ( dirtyRanges_[k+1].first - dirtyRanges_[k].second <
+				 dirtyRanges_[closest+1].first - dirtyRanges_[closest].second )
+			{
+				closest = k;
+			}
+		}
+		dirtyRanges_[closest].second = dirtyRanges_[closest+1].second;
+		dirtyRanges_.erase( dirtyRanges_.begin() + closest + 1 );
+	}
+}
+
+//-- storage -------------------------------------------------------------------
+
+void
+Allocator::allocStorage( const unsigned int _byteCount,
+						 const ALLOC_MODE _mode )
+{
+	if ( _mode == ALLOC_MODE_LAZY )
+	{
+		// reserve address space only, see commit()
+		unsigned int chunkCount = ( _byteCount + ALLOC_CHUNK_SIZE - 1 ) /
+								  ALLOC_CHUNK_SIZE;
+		cur_ = ptr_ = chunkCount ?
+			reservePages( chunkCount * ALLOC_CHUNK_SIZE ) : NULL;
+		isLazy_ = true;
+		chunks_.assign( chunkCount, false );
+		chunksLeft_ = chunkCount;
+	}
+	else
+	{
+		// aligned and padded to whole alignment blocks
+		size_t paddedCount = ( static_cast<size_t>( _byteCount ) +
+							   ALLOC_ALIGNMENT - 1 ) & ~size_t(ALLOC_ALIGNMENT-1);
+		paddedCount = std::max<size_t>( paddedCount, ALLOC_ALIGNMENT );
+		cur_ = ptr_ = AllocatorFactory::allocate( paddedCount, tag_ );
+		isLazy_ = false;
+
+
+		// set to zero, padding included
+		if ( _mode == ALLOC_MODE_ZERO )
+		{
+			std::memset( ptr_, 0, paddedCount );
+		}
+	}
+}
+
+void
+Allocator::copyStorage( const void* _ptr, const std::vector<bool>* _chunks )
+{
+	// lazy source, only committed chunks hold anything but zeros
+	unsigned char* newPtr = static_cast<unsigned char*>(ptr_);
+	const unsigned char* otherPtr = static_cast<const unsigned char*>(_ptr);
+	if ( _chunks )
+	{
+		for ( unsigned int i=0; i<_chunks->size(); ++i )
+		{
+			if ( !(*_chunks)[i] )
+				continue;
+			unsigned int offset = i * ALLOC_CHUNK_SIZE;
+			unsigned int count = std::min<unsigned int>( ALLOC_CHUNK_SIZE,
+														 byteCount_ - offset );
+			commit( offset, count );
+			std::memcpy( newPtr + offset, otherPtr + offset, count );
+		}
+	}
+	else if ( byteCount_ )
+	{
+		std::memcpy( newPtr, otherPtr, byteCount_ );
+	}
+}
+
+void
+Allocator::freeStorage( void* _ptr, const bool _isLazy,
+						const size_t _chunkCount, void* _mapPtr,
+						const size_t _mapByteCount, SHARED* _shared )
+{
+	// shared storage is freed by the last owner
+	if ( _shared )
+	{
+		if ( --_shared->refCount )
+			return;
+		delete _shared;
+	}
+	if ( _mapPtr )
+	{
+		unmapFile( _mapPtr, _mapByteCount );
+	}
+	else if ( _isLazy )
+	{
+		releasePages( _ptr, _chunkCount * ALLOC_CHUNK_SIZE );
+	}
+	else
+	{
+		AllocatorFactory::deallocate( _ptr );
+	}
+}
+
+void
+Allocator::moveFrom( Allocator& other )
+{
+	// take everything, including lifetime counters
+	ptr_ = other.ptr_;
+	cur_ = other.cur_;
+	format_ = other.format_;
+	width_ = other.width_;
+	height_ = other.height_;
+	dim_ = other.dim_;
+	type_ = other.type_;
+	bitsPerElement_ = other.bitsPerElement_;
+	elementCount_ = other.elementCount_;
+	byteCount_ = other.byteCount_;
+	allocCount_ = other.allocCount_;
+	readCount_ = other.readCount_;
+	writeCount_ = other.writeCount_;
+	isAlloc_ = other.isAlloc_;
+	isLazy_ = other.isLazy_;
+	chunks_.swap( other.chunks_ );
+	chunksLeft_ = other.chunksLeft_;
+	dirtyRanges_.swap( other.dirtyRanges_ );
+	shared_ = other.shared_;
+	mapPtr_ = other.mapPtr_;
+	mapByteCount_ = other.mapByteCount_;
+	isReadOnly_ = other.isReadOnly_;
+	if ( isAlloc_ )
+		registerOnce();
+
+
+	// leave other empty, it has nothing left to free
+	other.ptr_ = NULL;
+	other.isLazy_ = false;
+	other.shared_ = NULL;
+	other.mapPtr_ = NULL;
+	other.clear();
+}
+
+void
+Allocator::registerOnce()
+{
+	if ( !isRegistered_ )
+	{
+		AllocatorFactory::registerAllocator( this );
+		isRegistered_ = true;
+	}
+}
+
+void
+Allocator::detach()
+{
+	// last owner of writable storage, the storage is ours alone now
+	if ( shared_ && shared_->refCount == 1 && !isReadOnly_ )
+	{
+		delete shared_;
+		shared_ = NULL;
+		return;
+	}
+
+
+	// copy to storage of our own and leave the shared or read-only mapped
+	// one to the others, mapped storage always goes to the heap
+	void* ptr = ptr_;
+	bool isLazy = isLazy_;
+	std::vector<bool> chunks;
+	chunks.swap( chunks_ );
+	SHARED* shared = shared_;
+	void* mapPtr = mapPtr_;
+	size_t mapByteCount = mapByteCount_;
+	unsigned int pos = static_cast<unsigned char*>(cur_) -
+					   static_cast<unsigned char*>(ptr_);
+	allocStorage( byteCount_, isLazy ? ALLOC_MODE_LAZY : ALLOC_MODE_NOINIT );
+	copyStorage( ptr, isLazy ? &chunks : NULL );
+	cur_ = static_cast<unsigned char*>(ptr_) + pos;
+	shared_ = NULL;
+	mapPtr_ = NULL;
+	mapByteCount_ = 0;
+	isReadOnly_ = false;
+	freeStorage( ptr, isLazy, chunks.size(), mapPtr, mapByteCount, shared );
+}
+
+//-- mapped storage ------------------------------------------------------------
+
+void*
+Allocator::mapFile( const std::string& _path,
+					const unsigned long long _offset,
+					const unsigned int _byteCount,
+					const bool _isCopyOnWrite,
+					void** _mapPtr, size_t* _mapByteCount )
+{
+	*_mapPtr = NULL;
+	*_mapByteCount = 0;
+	if ( !_byteCount )
+		return NULL;
+
+
+	// mappings start at a multiple of the allocation granularity
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	unsigned long long granularity = info.dwAllocationGranularity;
+#else
+	unsigned long long granularity = sysconf( _SC_PAGESIZE );
+#endif
+	unsigned long long base = _offset - _offset % granularity;
+	size_t byteCount = static_cast<size_t>( _offset - base ) + _byteCount;
+
+
+	// the handles can be closed right away, the view keeps the file open
+#ifdef _WIN32
+	HANDLE file = CreateFileA( _path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+							   NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+							   NULL );
+	if ( file == INVALID_HANDLE_VALUE )
+		GEM_THROW( "Could not open file " + _path );
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( file, &fileSize ) ||
+		 static_cast<unsigned long long>( fileSize.QuadPart ) <
+		 _offset + _byteCount )
+	{
+		CloseHandle( file );
+		GEM_THROW( "File is too short to map " + _path );
+	}
+	HANDLE mapping = CreateFileMappingA( file, NULL, _isCopyOnWrite ?
+										 PAGE_WRITECOPY : PAGE_READONLY,
+										 0, 0, NULL );
+	CloseHandle( file );
+	if ( !mapping )
+		GEM_THROW( "Could not map file " + _path );
+	void* ptr = MapViewOfFile( mapping, _isCopyOnWrite ?
+							   FILE_MAP_COPY : FILE_MAP_READ,
+							   static_cast<DWORD>( base >> 32 ),
+							   static_cast<DWORD>( base ), byteCount );
+	CloseHandle( mapping );
+	if ( !ptr )
+		GEM_THROW( "Could not map file " + _path );
+#else
+	int fd = open( _path.c_str(), O_RDONLY );
+	if ( fd < 0 )
+		GEM_THROW( "Could not open file " + _path );
+	struct stat info;
+	if ( fstat( fd, &info ) ||
+		 static_cast<unsigned long long>( info.st_size ) <
+		 _offset + _byteCount )
+	{
+		close( fd );
+		GEM_THROW( "File is too short to map " + _path );
+	}
+	void* ptr = _isCopyOnWrite ?
+		mmap( NULL, byteCount, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, base ):
+		mmap( NULL, byteCount, PROT_READ, MAP_SHARED, fd, base );
+	close( fd );
+	if ( ptr == MAP_FAILED )
+		GEM_THROW( "Could not map file " + _path );
+#endif
+
+
+	*_mapPtr = ptr;
+	*_mapByteCount = byteCount;
+	return static_cast<unsigned char*>(ptr) + ( _offset - base );
+}
+
+void
+Allocator::unmapFile( void* _ptr, const size_t _byteCount )
+{
+#ifdef _WIN32
+	UnmapViewOfFile( _ptr );
+#else
+	munmap( _ptr, _byteCount );
+#endif
+}
+
+//-- lazy storage --------------------------------------------------------------
+
+void
+Allocator::commit( const unsigned int _offset, const unsigned int _byteCount )
+{
+	// range of chunks touched
+	if ( _offset >= byteCount_ )
+		return;
+	unsigned int first = _offset / ALLOC_CHUNK_SIZE;
+	unsigned int last = ( std::min( _offset + std::max( _byteCount, 1u ),
+									byteCount_ ) - 1 ) / ALLOC_CHUNK_SIZE;
+
+
+	// commit runs of uncommitted chunks with one call each
+	unsigned char* ptr = static_cast<unsigned char*>(ptr_);
+	for ( unsigned int i = first; i <= last; ++i )
+	{
+		if ( chunks_[i] )
+			continue;
+		unsigned int end = i;
+		while ( end + 1 <= last && !chunks_[end + 1] )
+			++end;
+		commitPages( ptr + i * ALLOC_CHUNK_SIZE,
+					 ( end - i + 1 ) * ALLOC_CHUNK_SIZE );
+		for ( ; i <= end; ++i )
+		{
+			chunks_[i] = true;
+			--chunksLeft_;
+		}
+	}
+}
+
+void*
+Allocator::reservePages( const size_t _byteCount )
+{
+#ifdef _WIN32
+	void* ptr = VirtualAlloc( NULL, _byteCount, MEM_RESERVE, PAGE_NOACCESS );
+	if ( !ptr )
+		GEM_THROW( "Could not reserve address space." );
+#else
+	void* ptr = mmap( NULL, _byteCount, PROT_NONE,
+					  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if ( ptr == MAP_FAILED )
+		GEM_THROW( "Could not reserve address space." );
+#endif
+	return ptr;
+}
+
+void
+Allocator::commitPages( void* _ptr, const size_t _byteCount )
+{
+	// fresh pages are zero on both platforms
+#ifdef _WIN32
+	if ( !VirtualAlloc( _ptr, _byteCount, MEM_COMMIT, PAGE_READWRITE ) )
+		GEM_THROW( "Could not commit memory." );
+#else
+	if ( mprotect( _ptr, _byteCount, PROT_READ | PROT_WRITE ) )
+		GEM_THROW( "Could not commit memory." );
+#endif
+}
+
+void
+Allocator::releasePages( void* _ptr, const size_t _byteCount )
+{
+	if ( !_ptr )
+		return;
+#ifdef _WIN32
+	VirtualFree( _ptr, 0, MEM_RELEASE );
+#else
+	munmap( _ptr, _byteCount );
+#endif
 }
 
 //==============================================================================
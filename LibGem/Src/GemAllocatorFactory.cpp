@@ -0,0 +1,440 @@
+//== INCLUDES ==================================================================
+
+#include "GemAllocatorFactory.h"
+#include "GemAllocator.h"
+
+#ifndef _WIN32
+#include <stdlib.h>
+#endif
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== CLASS DEFINITION ==========================================================
+
+//-- constructors/destructor ---------------------------------------------------
+
+AllocatorFactory::AllocatorFactory()
+: mutex_()
+, allocators_()
+, blocks_()
+, pooledByteCount_( 0 )
+, frameBlocks_()
+, frameBlock_( 0 )
+, frameOffset_( 0 )
+, frameLiveCount_( 0 )
+, systemByteCount_( 0 )
+, highWaterByteCount_( 0 )
+, allocationCount_( 0 )
+, allocationByteCount_( 0 )
+, lastAllocationCount_( 0 )
+, lastAllocationByteCount_( 0 )
+, lastStatsTime_( std::chrono::steady_clock::now() )
+{
+	for ( unsigned int i = 0; i < ALLOC_TAG_COUNT; ++i )
+	{
+		backends_[i] = ALLOC_BACKEND_POOL;
+	}
+	backends_[ALLOC_TAG_TRANSIENT] = ALLOC_BACKEND_FRAME;
+}
+
+AllocatorFactory&
+AllocatorFactory::instance()
+{
+	// leaked on purpose, see header
+	static AllocatorFactory* factory = new AllocatorFactory();
+	return *factory;
+}
+
+
+//-- memory --------------------------------------------------------------------
+
+void*
+AllocatorFactory::allocate( const size_t _byteCount, const ALLOC_TAG _tag )
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+
+
+	// pick backend, pools only go so far
+	BLOCK block;
+	block.backend = f.backends_[_tag];
+	block.sizeClass = 0;
+	if ( block.backend == ALLOC_BACKEND_POOL &&
+		 _byteCount > ALLOC_POOL_MAX_SIZE )
+	{
+		block.backend = ALLOC_BACKEND_HEAP;
+	}
+
+
+	// get memory from the backend
+	void* ptr = NULL;
+	switch ( block.backend )
+	{
+	case ALLOC_BACKEND_POOL:
+		block.sizeClass = getSizeClass( _byteCount );
+		block.byteCount = getSizeClassByteCount( block.sizeClass );
+		if ( !f.pools_[block.sizeClass].empty() )
+		{
+			ptr = f.pools_[block.sizeClass].back();
+			f.pools_[block.sizeClass].pop_back();
+			f.pooledByteCount_ -= block.byteCount;
+		}
+		else
+		{
+			ptr = f.allocateHeap( block.byteCount );
+		}
+		break;
+	case ALLOC_BACKEND_FRAME:
+		block.byteCount = ( _byteCount + ALLOC_ALIGNMENT - 1 ) &
+						  ~size_t( ALLOC_ALIGNMENT - 1 );
+		ptr = f.allocateFrame( block.byteCount );
+		f.frameLiveCount_++;
+		break;
+	default:
+		block.byteCount = _byteCount;
+		ptr = f.allocateHeap( block.byteCount );
+		break;
+	}
+
+
+	// remember block for deallocate and accounting
+	f.blocks_[ptr] = block;
+	f.allocationCount_++;
+	f.allocationByteCount_ += _byteCount;
+	return ptr;
+}
+
+void
+AllocatorFactory::deallocate( void* _ptr )
+{
+	if ( !_ptr )
+		return;
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+
+
+	// find block
+	std::unordered_map<void*, BLOCK>::iterator i = f.blocks_.find( _ptr );
+	if ( i == f.blocks_.end() )
+	{
+		GEM_WARNING( "Pointer was not allocated by the factory." );
+		return;
+	}
+	BLOCK block = i->second;
+	f.blocks_.erase( i );
+
+
+	// hand it back to its backend
+	switch ( block.backend )
+	{
+	case ALLOC_BACKEND_POOL:
+		f.pools_[block.sizeClass].push_back( _ptr );
+		f.pooledByteCount_ += block.byteCount;
+		break;
+	case ALLOC_BACKEND_FRAME:
+		f.frameLiveCount_--;
+		break;
+	default:
+		f.freeHeap( _ptr, block.byteCount );
+		break;
+	}
+}
+
+void
+AllocatorFactory::setBackend( const ALLOC_TAG _tag,
+							  const ALLOC_BACKEND _backend )
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+	f.backends_[_tag] = _backend;
+}
+
+ALLOC_BACKEND
+AllocatorFactory::getBackend( const ALLOC_TAG _tag )
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+	return f.backends_[_tag];
+}
+
+void
+AllocatorFactory::newFrame()
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+
+
+	// rewinding under live data would hand it out twice
+	if ( f.frameLiveCount_ )
+	{
+		GEM_WARNING( "Transient Allocators alive at end of frame, frame "
+					 "arena is not rewound." );
+		return;
+	}
+	f.frameBlock_ = 0;
+	f.frameOffset_ = 0;
+}
+
+void
+AllocatorFactory::trim()
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+	for ( unsigned int c = 0; c < POOL_CLASS_COUNT; ++c )
+	{
+		size_t byteCount = getSizeClassByteCount( c );
+		for ( unsigned int i = 0; i < f.pools_[c].size(); ++i )
+		{
+			f.freeHeap( f.pools_[c][i], byteCount );
+		}
+		f.pools_[c].clear();
+	}
+	f.pooledByteCount_ = 0;
+}
+
+
+//-- registry ------------------------------------------------------------------
+
+void
+AllocatorFactory::registerAllocator( const Allocator* _allocatorPtr )
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+	f.allocators_.insert( _allocatorPtr );
+}
+
+void
+AllocatorFactory::unregisterAllocator( const Allocator* _allocatorPtr )
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+	f.allocators_.erase( _allocatorPtr );
+}
+
+AllocatorFactory::STATS
+AllocatorFactory::getStats()
+{
+	AllocatorFactory& f = instance();
+	std::lock_guard<std::mutex> lock( f.mutex_ );
+	STATS stats;
+
+
+	// live Allocators per tag
+	for ( unsigned int i = 0; i < ALLOC_TAG_COUNT; ++i )
+	{
+		stats.allocatorCount[i] = 0;
+		stats.byteCount[i] = 0;
+		stats.residentByteCount[i] = 0;
+	}
+	stats.totalByteCount = 0;
+	std::unordered_set<const Allocator*>::const_iterator i =
+		f.allocators_.begin();
+	for ( ; i != f.allocators_.end(); ++i )
+	{
+		const Allocator* a = *i;
+		if ( !a->isAlloc() )
+			continue;
+		stats.allocatorCount[a->getTag()]++;
+		stats.byteCount[a->getTag()] += a->getByteCount();
+		stats.residentByteCount[a->getTag()] += a->getResidentByteCount();
+		stats.totalByteCount += a->getByteCount();
+	}
+
+
+	// backends
+	stats.systemByteCount = f.systemByteCount_;
+	stats.highWaterByteCount = f.highWaterByteCount_;
+	stats.pooledByteCount = f.pooledByteCount_;
+	stats.frameByteCount = f.frameOffset_;
+	for ( unsigned int b = 0; b < f.frameBlock_; ++b )
+	{
+		stats.frameByteCount += f.frameBlocks_[b].second;
+	}
+
+
+	// allocation rate since last snapshot
+	std::chrono::steady_clock::time_point now =
+		std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(
+		now - f.lastStatsTime_ ).count();
+	stats.allocationCount = f.allocationCount_;
+	stats.allocationsPerSecond = seconds > 0.0 ?
+		( f.allocationCount_ - f.lastAllocationCount_ ) / seconds : 0.0;
+	stats.bytesPerSecond = seconds > 0.0 ?
+		( f.allocationByteCount_ - f.lastAllocationByteCount_ ) / seconds : 0.0;
+	f.lastAllocationCount_ = f.allocationCount_;
+	f.lastAllocationByteCount_ = f.allocationByteCount_;
+	f.lastStatsTime_ = now;
+
+	return stats;
+}
+
+void
+AllocatorFactory::printStats( const unsigned int _listCount )
+{
+	static const char* tagNames[ALLOC_TAG_COUNT] =
+	{
+		"other", "mesh", "texture", "uniform", "transient"
+	};
+	STATS stats = getStats();
+
+
+	// totals
+	std::stringstream ss;
+	ss << "Allocators: " << stats.totalByteCount << " bytes live, "
+	   << stats.systemByteCount << " from system ("
+	   << stats.highWaterByteCount << " peak, "
+	   << stats.pooledByteCount << " pooled, "
+	   << stats.frameByteCount << " frame), "
+	   << stats.allocationsPerSecond << " allocs/s, "
+	   << stats.bytesPerSecond << " bytes/s";
+	for ( unsigned int i = 0; i < ALLOC_TAG_COUNT; ++i )
+	{
+		ss << "\n  " << std::setw( 10 ) << std::setfill( ' ' ) << tagNames[i]
+		   << ": " << stats.allocatorCount[i] << " Allocators, "
+		   << stats.byteCount[i] << " bytes, "
+		   << stats.residentByteCount[i] << " resident";
+	}
+
+
+	// largest live Allocators
+	std::vector< std::pair<unsigned int, const Allocator*> > largest;
+	{
+		AllocatorFactory& f = instance();
+		std::lock_guard<std::mutex> lock( f.mutex_ );
+		std::unordered_set<const Allocator*>::const_iterator i =
+			f.allocators_.begin();
+		for ( ; i != f.allocators_.end(); ++i )
+		{
+			if ( (*i)->isAlloc() )
+				largest.push_back( std::make_pair( (*i)->getByteCount(), *i ) );
+		}
+	}
+	std::sort( largest.rbegin(), largest.rend() );
+	for ( unsigned int i = 0; i < largest.size() && i < _listCount; ++i )
+	{
+		const Allocator* a = largest[i].second;
+		ss << "\n  " << a << " " << tagNames[a->getTag()]
+		   << " format " << a->getFormat()
+		   << " " << a->getWidth() << "x" << a->getHeight()
+		   << " " << a->getByteCount() << " bytes"
+		   << ( a->isLazy() ? " lazy" : "" )
+		   << ( a->isMapped() ? " mapped" : "" )
+		   << ( a->isShared() ? " shared" : "" );
+	}
+	GEM_CONSOLE( ss.str() );
+}
+
+
+//-- backends ------------------------------------------------------------------
+
+unsigned int
+AllocatorFactory::getSizeClass( const size_t _byteCount )
+{
+	// powers of two up to ALLOC_POOL_QUARTER_SIZE
+	unsigned int c = 0;
+	size_t power = ALLOC_ALIGNMENT;
+	while ( power < _byteCount && power < ALLOC_POOL_QUARTER_SIZE )
+	{
+		power *= 2;
+		++c;
+	}
+	if ( power >= _byteCount )
+		return c;
+
+
+	// then four classes from each power of two to the next
+	while ( power * 2 < _byteCount )
+	{
+		power *= 2;
+		c += 4;
+	}
+	return c + static_cast<unsigned int>(
+		( _byteCount - power + power / 4 - 1 ) / ( power / 4 ) );
+}
+
+size_t
+AllocatorFactory::getSizeClassByteCount( const unsigned int _sizeClass )
+{
+	size_t power = ALLOC_ALIGNMENT;
+	unsigned int quarters = 0;
+	for ( unsigned int c = 0; c < _sizeClass; ++c )
+	{
+		if ( power < ALLOC_POOL_QUARTER_SIZE || quarters == 3 )
+		{
+			power *= 2;
+			quarters = 0;
+		}
+		else
+		{
+			++quarters;
+		}
+	}
+	return power + quarters * ( power / 4 );
+}
+
+void*
+AllocatorFactory::allocateHeap( const size_t _byteCount )
+{
+#ifdef _WIN32
+	void* ptr = _aligned_malloc( _byteCount, ALLOC_ALIGNMENT );
+#else
+	void* ptr = NULL;
+	if ( posix_memalign( &ptr, ALLOC_ALIGNMENT, _byteCount ) )
+		ptr = NULL;
+#endif
+	if ( !ptr )
+		GEM_THROW( "Could not allocate memory." );
+
+
+	// track system memory and its peak
+	systemByteCount_ += _byteCount;
+	highWaterByteCount_ = std::max( highWaterByteCount_, systemByteCount_ );
+	return ptr;
+}
+
+void
+AllocatorFactory::freeHeap( void* _ptr, const size_t _byteCount )
+{
+#ifdef _WIN32
+	_aligned_free( _ptr );
+#else
+	free( _ptr );
+#endif
+	systemByteCount_ -= _byteCount;
+}
+
+void*
+AllocatorFactory::allocateFrame( const size_t _byteCount )
+{
+	// move on to the next block that fits, allocate one if there is none
+	while ( frameBlock_ < frameBlocks_.size() &&
+			frameOffset_ + _byteCount > frameBlocks_[frameBlock_].second )
+	{
+		++frameBlock_;
+		frameOffset_ = 0;
+	}
+	if ( frameBlock_ == frameBlocks_.size() )
+	{
+		size_t byteCount = std::max<size_t>( ALLOC_FRAME_BLOCK_SIZE,
+											 _byteCount );
+		frameBlocks_.push_back( std::make_pair( allocateHeap( byteCount ),
+												byteCount ) );
+		frameOffset_ = 0;
+	}
+
+
+	// bump
+	void* ptr = static_cast<unsigned char*>( frameBlocks_[frameBlock_].first )
+				+ frameOffset_;
+	frameOffset_ += _byteCount;
+	return ptr;
+}
+
+//==============================================================================
+GEM_END_NAMESPACE
+//==============================================================================
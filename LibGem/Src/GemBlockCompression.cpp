@@ -0,0 +1,1033 @@
+//==============================================================================
+//
+//	Block compression of 8 bit textures to BC1 (DXT1), BC2 (DXT3), BC3
+//	(DXT5), BC4 and BC5, and back
+//
+//==============================================================================
+
+
+
+//== INCLUDES ==================================================================
+
+#include "GemBlockCompression.h"
+#ifdef GEM_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== BLOCK HELPERS =============================================================
+
+// colors of a block as floats, a channel after the other so four pixels
+// load into one register
+struct BCCOLORS
+{
+	float r[16];
+	float g[16];
+	float b[16];
+};
+
+// endpoints of the BC1 color that interpolates each 8 bit value the closest
+// as the third palette entry, 5 and 6 bit. Built before main() so there is
+// no race on first use.
+struct BCTABLES
+{
+	unsigned char match5[256][2];
+	unsigned char match6[256][2];
+
+	BCTABLES()
+	{
+		build( 5, match5 );
+		build( 6, match6 );
+	}
+
+	static void build( const int _bits, unsigned char _match[256][2] )
+	{
+		const int count = 1 << _bits;
+		for ( int v = 0; v < 256; ++v )
+		{
+			int bestError = 256;
+			for ( int e0 = 0; e0 < count; ++e0 )
+			{
+				for ( int e1 = 0; e1 < count; ++e1 )
+				{
+					const int p0 = ( e0 << ( 8 - _bits ) ) |
+								   ( e0 >> ( 2 * _bits - 8 ) );
+					const int p1 = ( e1 << ( 8 - _bits ) ) |
+								   ( e1 >> ( 2 * _bits - 8 ) );
+					const int error = std::abs( ( 2 * p0 + p1 + 1 ) / 3 - v );
+					if ( error < bestError )
+					{
+						bestError = error;
+						_match[v][0] = static_cast<unsigned char>( e0 );
+						_match[v][1] = static_cast<unsigned char>( e1 );
+					}
+				}
+			}
+		}
+	}
+};
+
+static const BCTABLES bcTables;
+
+// 565 color to 8 bit channels, the high bits replicated into the low
+static inline void unpack565( const unsigned int _color, int* _rgb )
+{
+	const int r = ( _color >> 11 ) & 31;
+	const int g = ( _color >> 5 ) & 63;
+	const int b = _color & 31;
+	_rgb[0] = ( r << 3 ) | ( r >> 2 );
+	_rgb[1] = ( g << 2 ) | ( g >> 4 );
+	_rgb[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+// closest 565 color of 8 bit channels as floats
+static inline unsigned int pack565( const float* _rgb )
+{
+	const int r = std::min( std::max( static_cast<int>(
+		std::floor( _rgb[0] * ( 31.0f / 255.0f ) + 0.5f ) ), 0 ), 31 );
+	const int g = std::min( std::max( static_cast<int>(
+		std::floor( _rgb[1] * ( 63.0f / 255.0f ) + 0.5f ) ), 0 ), 63 );
+	const int b = std::min( std::max( static_cast<int>(
+		std::floor( _rgb[2] * ( 31.0f / 255.0f ) + 0.5f ) ), 0 ), 31 );
+	return static_cast<unsigned int>( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+// four color palette of c0 > c1, or three colors and transparent black
+static inline void getPaletteBC1( const unsigned int _c0,
+								  const unsigned int _c1,
+								  const bool _isFourColor,
+								  int _palette[4][4] )
+{
+	unpack565( _c0, _palette[0] );
+	unpack565( _c1, _palette[1] );
+	for ( int k = 0; k < 3; ++k )
+	{
+		const int p0 = _palette[0][k];
+		const int p1 = _palette[1][k];
+		if ( _isFourColor )
+		{
+			_palette[2][k] = ( 2 * p0 + p1 + 1 ) / 3;
+			_palette[3][k] = ( p0 + 2 * p1 + 1 ) / 3;
+		}
+		else
+		{
+			_palette[2][k] = ( p0 + p1 + 1 ) / 2;
+			_palette[3][k] = 0;
+		}
+	}
+	_palette[0][3] = _palette[1][3] = _palette[2][3] = 255;
+	_palette[3][3] = _isFourColor ? 255 : 0;
+}
+
+// eight values of a0 > a1, or six and 0 and 255
+static inline void getPaletteBC4( const int _a0, const int _a1,
+								  int _palette[8] )
+{
+	_palette[0] = _a0;
+	_palette[1] = _a1;
+	if ( _a0 > _a1 )
+	{
+		for ( int i = 1; i < 7; ++i )
+			_palette[i+1] = ( ( 7 - i ) * _a0 + i * _a1 + 3 ) / 7;
+	}
+	else
+	{
+		for ( int i = 1; i < 5; ++i )
+			_palette[i+1] = ( ( 5 - i ) * _a0 + i * _a1 + 2 ) / 5;
+		_palette[6] = 0;
+		_palette[7] = 255;
+	}
+}
+
+// closest palette color of each pixel, returns the squared error
+static float fitIndicesBC1( const BCCOLORS& _colors,
+							const int _palette[4][4],
+							unsigned int* _indices )
+{
+#ifdef GEM_HAS_SSE2
+	__m128 vError = _mm_setzero_ps();
+	for ( unsigned int i = 0; i < 16; i += 4 )
+	{
+		const __m128 r = _mm_loadu_ps( _colors.r + i );
+		const __m128 g = _mm_loadu_ps( _colors.g + i );
+		const __m128 b = _mm_loadu_ps( _colors.b + i );
+		__m128 vBest = _mm_set1_ps( std::numeric_limits<float>::max() );
+		__m128i vIndex = _mm_setzero_si128();
+		for ( int k = 0; k < 4; ++k )
+		{
+			const __m128 dr = _mm_sub_ps( r,
+				_mm_set1_ps( static_cast<float>( _palette[k][0] ) ) );
+			const __m128 dg = _mm_sub_ps( g,
+				_mm_set1_ps( static_cast<float>( _palette[k][1] ) ) );
+			const __m128 db = _mm_sub_ps( b,
+				_mm_set1_ps( static_cast<float>( _palette[k][2] ) ) );
+			const __m128 d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dr, dr ),
+				_mm_mul_ps( dg, dg ) ), _mm_mul_ps( db, db ) );
+			const __m128i mask = _mm_castps_si128( _mm_cmplt_ps( d, vBest ) );
+			vBest = _mm_min_ps( d, vBest );
+			vIndex = _mm_or_si128( _mm_andnot_si128( mask, vIndex ),
+				_mm_and_si128( mask, _mm_set1_epi32( k ) ) );
+		}
+		vError = _mm_add_ps( vError, vBest );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _indices + i ),
+						  vIndex );
+	}
+	vError = _mm_add_ps( vError, _mm_movehl_ps( vError, vError ) );
+	vError = _mm_add_ss( vError, _mm_shuffle_ps( vError, vError, 1 ) );
+	return _mm_cvtss_f32( vError );
+#else
+	float error = 0.0f;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		float best = std::numeric_limits<float>::max();
+		_indices[i] = 0;
+		for ( unsigned int k = 0; k < 4; ++k )
+		{
+			const float dr = _colors.r[i] - _palette[k][0];
+			const float dg = _colors.g[i] - _palette[k][1];
+			const float db = _colors.b[i] - _palette[k][2];
+			const float d = dr * dr + dg * dg + db * db;
+			if ( d < best )
+			{
+				best = d;
+				_indices[i] = k;
+			}
+		}
+		error += best;
+	}
+	return error;
+#endif
+}
+
+// closest palette value of each pixel, returns the squared error
+static int fitIndicesBC4( const int* _values, const int _palette[8],
+						  unsigned int* _indices )
+{
+#ifdef GEM_HAS_SSE2
+	__m128i vError = _mm_setzero_si128();
+	for ( unsigned int i = 0; i < 16; i += 8 )
+	{
+		const __m128i v = _mm_packs_epi32(
+			_mm_loadu_si128( reinterpret_cast<const __m128i*>( _values + i ) ),
+			_mm_loadu_si128( reinterpret_cast<const __m128i*>( _values + i +
+															   4 ) ) );
+		__m128i vBest = _mm_set1_epi16( 0x7fff );
+		__m128i vIndex = _mm_setzero_si128();
+		for ( int k = 0; k < 8; ++k )
+		{
+			const __m128i p = _mm_set1_epi16(
+				static_cast<short>( _palette[k] ) );
+			const __m128i d = _mm_sub_epi16( _mm_max_epi16( v, p ),
+											 _mm_min_epi16( v, p ) );
+			const __m128i mask = _mm_cmplt_epi16( d, vBest );
+			vBest = _mm_min_epi16( d, vBest );
+			vIndex = _mm_or_si128( _mm_andnot_si128( mask, vIndex ),
+				_mm_and_si128( mask, _mm_set1_epi16(
+					static_cast<short>( k ) ) ) );
+		}
+		vError = _mm_add_epi32( vError, _mm_madd_epi16( vBest, vBest ) );
+		short indices[8];
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( indices ), vIndex );
+		for ( unsigned int j = 0; j < 8; ++j )
+			_indices[i+j] = static_cast<unsigned int>( indices[j] );
+	}
+	vError = _mm_add_epi32( vError, _mm_srli_si128( vError, 8 ) );
+	vError = _mm_add_epi32( vError, _mm_srli_si128( vError, 4 ) );
+	return _mm_cvtsi128_si32( vError );
+#else
+	int error = 0;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		int best = 0x7fff;
+		_indices[i] = 0;
+		for ( unsigned int k = 0; k < 8; ++k )
+		{
+			const int d = std::abs( _values[i] - _palette[k] );
+			if ( d < best )
+			{
+				best = d;
+				_indices[i] = k;
+			}
+		}
+		error += best * best;
+	}
+	return error;
+#endif
+}
+
+// best BC1 color block found so far
+struct BCFIT
+{
+	unsigned int c0;
+	unsigned int c1;
+	unsigned int indices[16];
+	float error;
+};
+
+// endpoints _start and _end rounded to 565 and ordered for four color mode,
+// kept in _fit if closer than what it has
+static void tryEndpointsBC1( const BCCOLORS& _colors, const float* _start,
+							 const float* _end, BCFIT* _fit )
+{
+	unsigned int c0 = pack565( _start );
+	unsigned int c1 = pack565( _end );
+	if ( c0 < c1 )
+		std::swap( c0, c1 );
+	int palette[4][4];
+	getPaletteBC1( c0, c1, true, palette );
+	unsigned int indices[16];
+	const float error = fitIndicesBC1( _colors, palette, indices );
+	if ( error < _fit->error )
+	{
+		_fit->c0 = c0;
+		_fit->c1 = c1;
+		std::copy( indices, indices + 16, _fit->indices );
+		_fit->error = error;
+	}
+}
+
+// endpoints that fit the colors best by least squares for the indices of
+// _fit, false if the indices do not pin them down
+static bool solveEndpointsBC1( const BCCOLORS& _colors, const BCFIT& _fit,
+							   float* _start, float* _end )
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+	float alphaX[3] = { 0.0f, 0.0f, 0.0f };
+	float betaX[3] = { 0.0f, 0.0f, 0.0f };
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		const float alpha = weights[_fit.indices[i]];
+		const float beta = 1.0f - alpha;
+		const float x[3] = { _colors.r[i], _colors.g[i], _colors.b[i] };
+		alpha2 += alpha * alpha;
+		beta2 += beta * beta;
+		alphaBeta += alpha * beta;
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			alphaX[k] += alpha * x[k];
+			betaX[k] += beta * x[k];
+		}
+	}
+	const float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+	if ( std::fabs( det ) < 1e-6f )
+		return false;
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		_start[k] = ( alphaX[k] * beta2 - betaX[k] * alphaBeta ) / det;
+		_end[k] = ( betaX[k] * alpha2 - alphaX[k] * alphaBeta ) / det;
+	}
+	return true;
+}
+
+// mean and principal axis of the colors, the axis not normalized
+static void getPrincipalAxis( const BCCOLORS& _colors, float* _mean,
+							  float* _axis )
+{
+	// covariance
+	_mean[0] = _mean[1] = _mean[2] = 0.0f;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		_mean[0] += _colors.r[i];
+		_mean[1] += _colors.g[i];
+		_mean[2] += _colors.b[i];
+	}
+	for ( unsigned int k = 0; k < 3; ++k )
+		_mean[k] /= 16.0f;
+	float cov[3][3] = { { 0.0f } };
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		const float d[3] = { _colors.r[i] - _mean[0],
+							 _colors.g[i] - _mean[1],
+							 _colors.b[i] - _mean[2] };
+		for ( unsigned int k = 0; k < 3; ++k )
+			for ( unsigned int l = 0; l < 3; ++l )
+				cov[k][l] += d[k] * d[l];
+	}
+
+
+	// power iteration from the row of the largest variance
+	unsigned int row = 0;
+	for ( unsigned int k = 1; k < 3; ++k )
+		if ( cov[k][k] > cov[row][row] )
+			row = k;
+	float v[3] = { cov[row][0], cov[row][1], cov[row][2] };
+	for ( unsigned int iteration = 0; iteration < 8; ++iteration )
+	{
+		float w[3];
+		for ( unsigned int k = 0; k < 3; ++k )
+			w[k] = cov[k][0] * v[0] + cov[k][1] * v[1] + cov[k][2] * v[2];
+		const float scale = std::max( std::max( std::fabs( w[0] ),
+			std::fabs( w[1] ) ), std::fabs( w[2] ) );
+		if ( scale < 1e-12f )
+			break;
+		for ( unsigned int k = 0; k < 3; ++k )
+			v[k] = w[k] / scale;
+	}
+	_axis[0] = v[0];
+	_axis[1] = v[1];
+	_axis[2] = v[2];
+}
+
+// colors of the block at both ends of the axis
+static void fitRangeBC1( const BCCOLORS& _colors, const float* _mean,
+						 const float* _axis, BCFIT* _fit )
+{
+	float lower = std::numeric_limits<float>::max();
+	float upper = -lower;
+	unsigned int first = 0, last = 0;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		const float t = ( _colors.r[i] - _mean[0] ) * _axis[0] +
+						( _colors.g[i] - _mean[1] ) * _axis[1] +
+						( _colors.b[i] - _mean[2] ) * _axis[2];
+		if ( t < lower )
+		{
+			lower = t;
+			first = i;
+		}
+		if ( t > upper )
+		{
+			upper = t;
+			last = i;
+		}
+	}
+	const float start[3] = { _colors.r[last], _colors.g[last],
+							 _colors.b[last] };
+	const float end[3] = { _colors.r[first], _colors.g[first],
+						   _colors.b[first] };
+	tryEndpointsBC1( _colors, start, end, _fit );
+}
+
+// Every split of the colors ordered along the axis into four clusters, the
+// endpoints of each by least squares and snapped to the 565 grid. The best
+// is kept in _fit if closer than what it has, returns true if it was.
+static bool fitClustersBC1( const BCCOLORS& _colors, const float* _axis,
+							BCFIT* _fit )
+{
+	// order along the axis, and prefix sums of the ordered colors
+	unsigned int order[16];
+	float t[16];
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		const float ti = _colors.r[i] * _axis[0] + _colors.g[i] * _axis[1] +
+						 _colors.b[i] * _axis[2];
+		unsigned int j = i;
+		for ( ; j > 0 && t[j-1] > ti; --j )
+		{
+			t[j] = t[j-1];
+			order[j] = order[j-1];
+		}
+		t[j] = ti;
+		order[j] = i;
+	}
+	float sums[17][4];
+	sums[0][0] = sums[0][1] = sums[0][2] = sums[0][3] = 0.0f;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		sums[i+1][0] = sums[i][0] + _colors.r[order[i]];
+		sums[i+1][1] = sums[i][1] + _colors.g[order[i]];
+		sums[i+1][2] = sums[i][2] + _colors.b[order[i]];
+		sums[i+1][3] = 0.0f;
+	}
+
+
+	// clusters [0, i), [i, j), [j, k) and [k, 16) take palette entries 0,
+	// 2, 3 and 1, weighted 1, 2/3, 1/3 and 0 towards the start
+	float bestError = std::numeric_limits<float>::max();
+	float bestStart[4] = { 0.0f }, bestEnd[4] = { 0.0f };
+#ifdef GEM_HAS_SSE2
+	const __m128 vGrid = _mm_setr_ps( 31.0f / 255.0f, 63.0f / 255.0f,
+									  31.0f / 255.0f, 0.0f );
+	const __m128 vGridInverse = _mm_setr_ps( 255.0f / 31.0f, 255.0f / 63.0f,
+											 255.0f / 31.0f, 0.0f );
+	const __m128 vMax = _mm_set1_ps( 255.0f );
+	const __m128 vTwoThirds = _mm_set1_ps( 2.0f / 3.0f );
+	const __m128 vOneThird = _mm_set1_ps( 1.0f / 3.0f );
+	const __m128 vTotal = _mm_loadu_ps( sums[16] );
+	for ( unsigned int i = 0; i <= 16; ++i )
+	{
+		const __m128 s0 = _mm_loadu_ps( sums[i] );
+		for ( unsigned int j = i; j <= 16; ++j )
+		{
+			const __m128 s01 = _mm_loadu_ps( sums[j] );
+			const __m128 s1 = _mm_sub_ps( s01, s0 );
+			for ( unsigned int k = j; k <= 16; ++k )
+			{
+				const __m128 s012 = _mm_loadu_ps( sums[k] );
+				const __m128 s2 = _mm_sub_ps( s012, s01 );
+				const __m128 s3 = _mm_sub_ps( vTotal, s012 );
+				const float n0 = static_cast<float>( i );
+				const float n1 = static_cast<float>( j - i );
+				const float n2 = static_cast<float>( k - j );
+				const float n3 = static_cast<float>( 16 - k );
+				const float alpha2 = n0 + ( 4.0f * n1 + n2 ) / 9.0f;
+				const float beta2 = n3 + ( 4.0f * n2 + n1 ) / 9.0f;
+				const float alphaBeta = 2.0f * ( n1 + n2 ) / 9.0f;
+				const float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+				if ( det < 1e-6f )
+					continue;
+				const __m128 alphaX = _mm_add_ps( s0, _mm_add_ps(
+					_mm_mul_ps( s1, vTwoThirds ), _mm_mul_ps( s2, vOneThird ) ) );
+				const __m128 betaX = _mm_add_ps( s3, _mm_add_ps(
+					_mm_mul_ps( s2, vTwoThirds ), _mm_mul_ps( s1, vOneThird ) ) );
+				const __m128 vInverse = _mm_set1_ps( 1.0f / det );
+				__m128 a = _mm_mul_ps( _mm_sub_ps(
+					_mm_mul_ps( alphaX, _mm_set1_ps( beta2 ) ),
+					_mm_mul_ps( betaX, _mm_set1_ps( alphaBeta ) ) ), vInverse );
+				__m128 b = _mm_mul_ps( _mm_sub_ps(
+					_mm_mul_ps( betaX, _mm_set1_ps( alpha2 ) ),
+					_mm_mul_ps( alphaX, _mm_set1_ps( alphaBeta ) ) ), vInverse );
+				a = _mm_min_ps( _mm_max_ps( a, _mm_setzero_ps() ), vMax );
+				b = _mm_min_ps( _mm_max_ps( b, _mm_setzero_ps() ), vMax );
+				a = _mm_mul_ps( _mm_cvtepi32_ps( _mm_cvtps_epi32(
+					_mm_mul_ps( a, vGrid ) ) ), vGridInverse );
+				b = _mm_mul_ps( _mm_cvtepi32_ps( _mm_cvtps_epi32(
+					_mm_mul_ps( b, vGrid ) ) ), vGridInverse );
+				__m128 e = _mm_add_ps( _mm_add_ps(
+					_mm_mul_ps( _mm_mul_ps( a, a ), _mm_set1_ps( alpha2 ) ),
+					_mm_mul_ps( _mm_mul_ps( b, b ), _mm_set1_ps( beta2 ) ) ),
+					_mm_mul_ps( _mm_mul_ps( a, b ),
+								_mm_set1_ps( 2.0f * alphaBeta ) ) );
+				e = _mm_sub_ps( e, _mm_mul_ps( _mm_set1_ps( 2.0f ), _mm_add_ps(
+					_mm_mul_ps( a, alphaX ), _mm_mul_ps( b, betaX ) ) ) );
+				e = _mm_add_ps( e, _mm_movehl_ps( e, e ) );
+				e = _mm_add_ss( e, _mm_shuffle_ps( e, e, 1 ) );
+				const float error = _mm_cvtss_f32( e );
+				if ( error < bestError )
+				{
+					bestError = error;
+					_mm_storeu_ps( bestStart, a );
+					_mm_storeu_ps( bestEnd, b );
+				}
+			}
+		}
+	}
+#else
+	const float grid[3] = { 31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f };
+	for ( unsigned int i = 0; i <= 16; ++i )
+	{
+		for ( unsigned int j = i; j <= 16; ++j )
+		{
+			for ( unsigned int k = j; k <= 16; ++k )
+			{
+				const float n0 = static_cast<float>( i );
+				const float n1 = static_cast<float>( j - i );
+				const float n2 = static_cast<float>( k - j );
+				const float n3 = static_cast<float>( 16 - k );
+				const float alpha2 = n0 + ( 4.0f * n1 + n2 ) / 9.0f;
+				const float beta2 = n3 + ( 4.0f * n2 + n1 ) / 9.0f;
+				const float alphaBeta = 2.0f * ( n1 + n2 ) / 9.0f;
+				const float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+				if ( det < 1e-6f )
+					continue;
+				float error = 0.0f;
+				float a[3], b[3];
+				for ( unsigned int c = 0; c < 3; ++c )
+				{
+					const float s0 = sums[i][c];
+					const float s1 = sums[j][c] - sums[i][c];
+					const float s2 = sums[k][c] - sums[j][c];
+					const float s3 = sums[16][c] - sums[k][c];
+					const float alphaX = s0 + s1 * ( 2.0f / 3.0f ) +
+										 s2 * ( 1.0f / 3.0f );
+					const float betaX = s3 + s2 * ( 2.0f / 3.0f ) +
+										s1 * ( 1.0f / 3.0f );
+					const float inverse = 1.0f / det;
+					a[c] = ( alphaX * beta2 - betaX * alphaBeta ) * inverse;
+					b[c] = ( betaX * alpha2 - alphaX * alphaBeta ) * inverse;
+					a[c] = std::min( std::max( a[c], 0.0f ), 255.0f );
+					b[c] = std::min( std::max( b[c], 0.0f ), 255.0f );
+					a[c] = std::floor( a[c] * grid[c] + 0.5f ) / grid[c];
+					b[c] = std::floor( b[c] * grid[c] + 0.5f ) / grid[c];
+					error += a[c] * a[c] * alpha2 + b[c] * b[c] * beta2 +
+							 a[c] * b[c] * 2.0f * alphaBeta -
+							 2.0f * ( a[c] * alphaX + b[c] * betaX );
+				}
+				if ( error < bestError )
+				{
+					bestError = error;
+					std::copy( a, a + 3, bestStart );
+					std::copy( b, b + 3, bestEnd );
+				}
+			}
+		}
+	}
+#endif
+	if ( bestError == std::numeric_limits<float>::max() )
+		return false;
+	const float error = _fit->error;
+	tryEndpointsBC1( _colors, bestStart, bestEnd, _fit );
+	return _fit->error < error;
+}
+
+// BC1 color block of 16 rgba pixels, always in four color mode
+static void encodeColorBC1( const unsigned char* _rgba, unsigned char* _block,
+							const COMPRESS_QUALITY _quality )
+{
+	// colors of the block, and blocks of one color from the table
+	BCCOLORS colors;
+	bool isSolid = true;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		colors.r[i] = _rgba[4*i+0];
+		colors.g[i] = _rgba[4*i+1];
+		colors.b[i] = _rgba[4*i+2];
+		isSolid = isSolid && _rgba[4*i+0] == _rgba[0] &&
+				  _rgba[4*i+1] == _rgba[1] && _rgba[4*i+2] == _rgba[2];
+	}
+	BCFIT fit;
+	if ( isSolid )
+	{
+		const unsigned char* r = bcTables.match5[_rgba[0]];
+		const unsigned char* g = bcTables.match6[_rgba[1]];
+		const unsigned char* b = bcTables.match5[_rgba[2]];
+		fit.c0 = ( r[0] << 11 ) | ( g[0] << 5 ) | b[0];
+		fit.c1 = ( r[1] << 11 ) | ( g[1] << 5 ) | b[1];
+		unsigned int index = 2;
+		if ( fit.c0 < fit.c1 )
+		{
+			std::swap( fit.c0, fit.c1 );
+			index = 3;
+		}
+		else if ( fit.c0 == fit.c1 )
+		{
+			index = 0;
+		}
+		std::fill( fit.indices, fit.indices + 16, index );
+	}
+
+
+	// range fit, refined twice by least squares, then clusters along the
+	// axis while that gets closer
+	else
+	{
+		fit.error = std::numeric_limits<float>::max();
+		float mean[3], axis[3];
+		getPrincipalAxis( colors, mean, axis );
+		fitRangeBC1( colors, mean, axis, &fit );
+		for ( unsigned int iteration = 0; iteration < 2; ++iteration )
+		{
+			float start[3], end[3];
+			const float error = fit.error;
+			if ( !solveEndpointsBC1( colors, fit, start, end ) )
+				break;
+			tryEndpointsBC1( colors, start, end, &fit );
+			if ( !( fit.error < error ) )
+				break;
+		}
+		if ( _quality == COMPRESS_QUALITY_HIGH )
+		{
+			for ( unsigned int iteration = 0; iteration < 4; ++iteration )
+			{
+				if ( !fitClustersBC1( colors, axis, &fit ) )
+					break;
+				int p0[3], p1[3];
+				unpack565( fit.c0, p0 );
+				unpack565( fit.c1, p1 );
+				if ( fit.c0 == fit.c1 )
+					break;
+				for ( unsigned int k = 0; k < 3; ++k )
+					axis[k] = static_cast<float>( p0[k] - p1[k] );
+			}
+		}
+	}
+
+
+	// two endpoints and 2 bit indices, little endian
+	unsigned int bits = 0;
+	for ( unsigned int i = 0; i < 16; ++i )
+		bits |= fit.indices[i] << ( 2 * i );
+	_block[0] = static_cast<unsigned char>( fit.c0 );
+	_block[1] = static_cast<unsigned char>( fit.c0 >> 8 );
+	_block[2] = static_cast<unsigned char>( fit.c1 );
+	_block[3] = static_cast<unsigned char>( fit.c1 >> 8 );
+	_block[4] = static_cast<unsigned char>( bits );
+	_block[5] = static_cast<unsigned char>( bits >> 8 );
+	_block[6] = static_cast<unsigned char>( bits >> 16 );
+	_block[7] = static_cast<unsigned char>( bits >> 24 );
+}
+
+// BC4 block of channel _channel of 16 rgba pixels
+static void encodeChannelBC4( const unsigned char* _rgba,
+							  const unsigned int _channel,
+							  unsigned char* _block,
+							  const COMPRESS_QUALITY _quality )
+{
+	// extremes, and extremes besides 0 and 255 for six value mode
+	int values[16];
+	int lower = 255, upper = 0, lower6 = 255, upper6 = 0;
+	bool hasBounds = false;
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		values[i] = _rgba[4*i+_channel];
+		lower = std::min( lower, values[i] );
+		upper = std::max( upper, values[i] );
+		if ( values[i] == 0 || values[i] == 255 )
+		{
+			hasBounds = true;
+		}
+		else
+		{
+			lower6 = std::min( lower6, values[i] );
+			upper6 = std::max( upper6, values[i] );
+		}
+	}
+
+
+	// eight values from the extremes, six if closer, a few steps around
+	// both for high quality
+	int a0 = upper, a1 = lower;
+	unsigned int indices[16] = { 0 };
+	if ( lower < upper )
+	{
+		const int reach = _quality == COMPRESS_QUALITY_HIGH ? 3 : 0;
+		int palette[8];
+		unsigned int candidate[16];
+		int bestError = std::numeric_limits<int>::max();
+		for ( int d0 = -reach; d0 <= reach; ++d0 )
+		{
+			for ( int d1 = -reach; d1 <= reach; ++d1 )
+			{
+				const int e0 = std::min( std::max( upper + d0, 0 ), 255 );
+				const int e1 = std::min( std::max( lower + d1, 0 ), 255 );
+				if ( e0 <= e1 )
+					continue;
+				getPaletteBC4( e0, e1, palette );
+				const int error = fitIndicesBC4( values, palette, candidate );
+				if ( error < bestError )
+				{
+					bestError = error;
+					a0 = e0;
+					a1 = e1;
+					std::copy( candidate, candidate + 16, indices );
+				}
+			}
+		}
+		for ( int d0 = -reach; hasBounds && d0 <= reach; ++d0 )
+		{
+			for ( int d1 = -reach; d1 <= reach; ++d1 )
+			{
+				const int e0 = std::min( std::max( lower6 + d0, 0 ), 255 );
+				const int e1 = std::min( std::max( upper6 + d1, 0 ), 255 );
+				if ( e0 > e1 )
+					continue;
+				getPaletteBC4( e0, e1, palette );
+				const int error = fitIndicesBC4( values, palette, candidate );
+				if ( error < bestError )
+				{
+					bestError = error;
+					a0 = e0;
+					a1 = e1;
+					std::copy( candidate, candidate + 16, indices );
+				}
+			}
+		}
+	}
+
+
+	// two endpoints and 3 bit indices, little endian
+	unsigned long long bits = 0;
+	for ( unsigned int i = 0; i < 16; ++i )
+		bits |= static_cast<unsigned long long>( indices[i] ) << ( 3 * i );
+	_block[0] = static_cast<unsigned char>( a0 );
+	_block[1] = static_cast<unsigned char>( a1 );
+	for ( unsigned int i = 0; i < 6; ++i )
+		_block[2+i] = static_cast<unsigned char>( bits >> ( 8 * i ) );
+}
+
+static void decodeColorBC1( const unsigned char* _block,
+							const bool _isFourColorOnly,
+							unsigned char* _rgba )
+{
+	const unsigned int c0 = _block[0] | ( _block[1] << 8 );
+	const unsigned int c1 = _block[2] | ( _block[3] << 8 );
+	int palette[4][4];
+	getPaletteBC1( c0, c1, _isFourColorOnly || c0 > c1, palette );
+	const unsigned int bits = _block[4] | ( _block[5] << 8 ) |
+							  ( _block[6] << 16 ) |
+							  ( static_cast<unsigned int>( _block[7] ) << 24 );
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		const int* color = palette[( bits >> ( 2 * i ) ) & 3];
+		for ( unsigned int k = 0; k < 4; ++k )
+			_rgba[4*i+k] = static_cast<unsigned char>( color[k] );
+	}
+}
+
+static void decodeChannelBC4( const unsigned char* _block,
+							  const unsigned int _channel,
+							  unsigned char* _rgba )
+{
+	int palette[8];
+	getPaletteBC4( _block[0], _block[1], palette );
+	unsigned long long bits = 0;
+	for ( unsigned int i = 0; i < 6; ++i )
+		bits |= static_cast<unsigned long long>( _block[2+i] ) << ( 8 * i );
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		_rgba[4*i+_channel] = static_cast<unsigned char>(
+			palette[( bits >> ( 3 * i ) ) & 7] );
+	}
+}
+
+// block rows of an image over all cores, at least 1k blocks a thread, the
+// calling thread takes the first
+template<typename KERNEL>
+static void splitBlockRows( const unsigned int _rowCount,
+							const unsigned int _blocksPerRow,
+							const KERNEL& _kernel )
+{
+	unsigned int threadCount = std::max( 1u,
+		std::thread::hardware_concurrency() );
+	threadCount = std::max( 1u, std::min( threadCount,
+		( _rowCount * _blocksPerRow ) >> 10 ) );
+	std::vector<std::thread> workers;
+	for ( unsigned int i = 1; i < threadCount; ++i )
+	{
+		workers.push_back( std::thread( [=, &_kernel]()
+		{
+			_kernel( _rowCount * i / threadCount,
+					 _rowCount * ( i + 1 ) / threadCount );
+		} ) );
+	}
+	_kernel( 0, _rowCount / threadCount );
+	for ( unsigned int i = 0; i < workers.size(); ++i )
+		workers[i].join();
+}
+
+
+//== GLOBAL FUNCTIONS ==========================================================
+
+
+//-- blocks --------------------------------------------------------------------
+
+void
+encodeBlockBC1( const unsigned char* _rgba, unsigned char* _block,
+				const COMPRESS_QUALITY _quality )
+{
+	encodeColorBC1( _rgba, _block, _quality );
+}
+
+void
+encodeBlockBC2( const unsigned char* _rgba, unsigned char* _block,
+				const COMPRESS_QUALITY _quality )
+{
+	// alpha rounded to 4 bits, two pixels a byte
+	for ( unsigned int i = 0; i < 8; ++i )
+	{
+		const unsigned int a0 = ( _rgba[8*i+3] * 15 + 127 ) / 255;
+		const unsigned int a1 = ( _rgba[8*i+7] * 15 + 127 ) / 255;
+		_block[i] = static_cast<unsigned char>( a0 | ( a1 << 4 ) );
+	}
+	encodeColorBC1( _rgba, _block + 8, _quality );
+}
+
+void
+encodeBlockBC3( const unsigned char* _rgba, unsigned char* _block,
+				const COMPRESS_QUALITY _quality )
+{
+	encodeChannelBC4( _rgba, 3, _block, _quality );
+	encodeColorBC1( _rgba, _block + 8, _quality );
+}
+
+void
+encodeBlockBC4( const unsigned char* _rgba, unsigned char* _block,
+				const COMPRESS_QUALITY _quality )
+{
+	encodeChannelBC4( _rgba, 0, _block, _quality );
+}
+
+void
+encodeBlockBC5( const unsigned char* _rgba, unsigned char* _block,
+				const COMPRESS_QUALITY _quality )
+{
+	encodeChannelBC4( _rgba, 0, _block, _quality );
+	encodeChannelBC4( _rgba, 1, _block + 8, _quality );
+}
+
+void
+decodeBlockBC1( const unsigned char* _block, unsigned char* _rgba )
+{
+	decodeColorBC1( _block, false, _rgba );
+}
+
+void
+decodeBlockBC2( const unsigned char* _block, unsigned char* _rgba )
+{
+	decodeColorBC1( _block + 8, true, _rgba );
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		_rgba[4*i+3] = static_cast<unsigned char>(
+			( ( _block[i/2] >> ( 4 * ( i & 1 ) ) ) & 15 ) * 17 );
+	}
+}
+
+void
+decodeBlockBC3( const unsigned char* _block, unsigned char* _rgba )
+{
+	decodeColorBC1( _block + 8, true, _rgba );
+	decodeChannelBC4( _block, 3, _rgba );
+}
+
+void
+decodeBlockBC4( const unsigned char* _block, unsigned char* _rgba )
+{
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		_rgba[4*i+1] = _rgba[4*i+2] = 0;
+		_rgba[4*i+3] = 255;
+	}
+	decodeChannelBC4( _block, 0, _rgba );
+}
+
+void
+decodeBlockBC5( const unsigned char* _block, unsigned char* _rgba )
+{
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		_rgba[4*i+2] = 0;
+		_rgba[4*i+3] = 255;
+	}
+	decodeChannelBC4( _block, 0, _rgba );
+	decodeChannelBC4( _block + 8, 1, _rgba );
+}
+
+
+//-- images --------------------------------------------------------------------
+
+void
+compressImage( const unsigned char* _src, const unsigned int _width,
+			   const unsigned int _height, const unsigned int _dim,
+			   const TEXTURE_FORMAT _format, const COMPRESS_QUALITY _quality,
+			   unsigned char* _dst )
+{
+	// argument checks
+	if ( !isBlockCompressed( _format ) )
+		GEM_THROW( "Texture format is not block compressed." );
+	if ( _format == TEXTURE_FORMAT_RGB_BC6H ||
+		 _format == TEXTURE_FORMAT_RGBA_BC7 )
+		GEM_THROW( "BC6H and BC7 are not encoded on the CPU." );
+	if ( _dim < 1 || _dim > 4 )
+		GEM_THROW( "Images to compress have one to four components." );
+
+
+	// each block from the pixels it covers, past the edge repeating it
+	const unsigned int blocksPerRow = ( _width + 3 ) / 4;
+	const unsigned int blockSize = getBlockSize( _format );
+	splitBlockRows( ( _height + 3 ) / 4, blocksPerRow,
+		[=]( const unsigned int _first, const unsigned int _last )
+	{
+		unsigned char rgba[64];
+		for ( unsigned int by = _first; by < _last; ++by )
+		{
+			for ( unsigned int bx = 0; bx < blocksPerRow; ++bx )
+			{
+				for ( unsigned int i = 0; i < 16; ++i )
+				{
+					const unsigned int x = std::min( bx * 4 + ( i & 3 ),
+													 _width - 1 );
+					const unsigned int y = std::min( by * 4 + ( i >> 2 ),
+													 _height - 1 );
+					const unsigned char* p = _src +
+						( static_cast<size_t>( y ) * _width + x ) * _dim;
+					rgba[4*i+0] = p[0];
+					rgba[4*i+1] = _dim > 1 ? p[1] : p[0];
+					rgba[4*i+2] = _dim > 2 ? p[2] : _dim == 2 ? 0 : p[0];
+					rgba[4*i+3] = _dim > 3 ? p[3] : 255;
+				}
+				unsigned char* block = _dst + ( static_cast<size_t>( by ) *
+					blocksPerRow + bx ) * blockSize;
+				switch ( _format )
+				{
+				case TEXTURE_FORMAT_RGB_DXT1:
+					encodeBlockBC1( rgba, block, _quality );
+					break;
+				case TEXTURE_FORMAT_RGBA_DXT3:
+					encodeBlockBC2( rgba, block, _quality );
+					break;
+				case TEXTURE_FORMAT_RGBA_DXT5:
+					encodeBlockBC3( rgba, block, _quality );
+					break;
+				case TEXTURE_FORMAT_R_BC4:
+					encodeBlockBC4( rgba, block, _quality );
+					break;
+				default:
+					encodeBlockBC5( rgba, block, _quality );
+					break;
+				}
+			}
+		}
+	} );
+}
+
+void
+decompressImage( const unsigned char* _src, const unsigned int _width,
+				 const unsigned int _height, const TEXTURE_FORMAT _format,
+				 const unsigned int _dim, unsigned char* _dst )
+{
+	// argument checks
+	if ( !isBlockCompressed( _format ) )
+		GEM_THROW( "Texture format is not block compressed." );
+	if ( _format == TEXTURE_FORMAT_RGB_BC6H ||
+		 _format == TEXTURE_FORMAT_RGBA_BC7 )
+		GEM_THROW( "BC6H and BC7 are not decoded on the CPU." );
+	if ( _dim < 1 || _dim > 4 )
+		GEM_THROW( "Decompressed images have one to four components." );
+
+
+	// each block to the pixels it covers inside the image
+	const unsigned int blocksPerRow = ( _width + 3 ) / 4;
+	const unsigned int blockSize = getBlockSize( _format );
+	splitBlockRows( ( _height + 3 ) / 4, blocksPerRow,
+		[=]( const unsigned int _first, const unsigned int _last )
+	{
+		unsigned char rgba[64];
+		for ( unsigned int by = _first; by < _last; ++by )
+		{
+			for ( unsigned int bx = 0; bx < blocksPerRow; ++bx )
+			{
+				const unsigned char* block = _src + ( static_cast<size_t>(
+					by ) * blocksPerRow + bx ) * blockSize;
+				switch ( _format )
+				{
+				case TEXTURE_FORMAT_RGB_DXT1:
+					decodeBlockBC1( block, rgba );
+					break;
+				case TEXTURE_FORMAT_RGBA_DXT3:
+					decodeBlockBC2( block, rgba );
+					break;
+				case TEXTURE_FORMAT_RGBA_DXT5:
+					decodeBlockBC3( block, rgba );
+					break;
+				case TEXTURE_FORMAT_R_BC4:
+					decodeBlockBC4( block, rgba );
+					break;
+				default:
+					decodeBlockBC5( block, rgba );
+					break;
+				}
+				for ( unsigned int i = 0; i < 16; ++i )
+				{
+					const unsigned int x = bx * 4 + ( i & 3 );
+					const unsigned int y = by * 4 + ( i >> 2 );
+					if ( x >= _width || y >= _height )
+						continue;
+					std::copy( rgba + 4 * i, rgba + 4 * i + _dim, _dst +
+						( static_cast<size_t>( y ) * _width + x ) * _dim );
+				}
+			}
+		}
+	} );
+}
+
+
+//==============================================================================
+GEM_END_NAMESPACE
+//==============================================================================
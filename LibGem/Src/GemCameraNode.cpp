@@ -160,6 +160,43 @@ CameraNode::getForeshortening( const Vec3f& _positionWorld )
 	return p_clip[3];
 }
 
+float
+CameraNode::getProjectedSize( const Vec3f& _positionWorld, const float _size,
+							  const float _radius )
+{
+	/* The viewport height covers 2*tan(fov/2) units at a distance of one
+	 * along the line of sight, and a length shrinks with its distance, the
+	 * foreshortening. Inside the sphere the distance is the near plane
+	 */
+	float w = getForeshortening( _positionWorld ) - _radius;
+	w = std::max( w, frustumNearZ_ );
+	return _size * viewportHeight_ / ( 2.0f * tan( 0.5f * frustumFOV_ ) * w );
+}
+
+void
+CameraNode::getFrustumPlanes( float _planes[6][4] ) const
+{
+	/* Gribb and Hartmann, the planes are the w row of the view projection
+	 * matrix plus and minus each of the other rows, as -w <= x,y,z <= w
+	 * inside the frustum. Normalized so plane.w is a distance. Matrix
+	 * product is not const, so multiply copies
+	 */
+	Mat4f projMatrix = projMatrix_;
+	Mat4f viewMatrix = viewMatrix_;
+	Mat4f viewProj = projMatrix * viewMatrix;
+	for ( unsigned int i = 0; i < 6; ++i )
+	{
+		float sign = i % 2 ? -1.0f : 1.0f;
+		for ( unsigned int j = 0; j < 4; ++j )
+			_planes[i][j] = viewProj( 3, j ) + sign * viewProj( i / 2, j );
+		float length = sqrt( _planes[i][0] * _planes[i][0] +
+							 _planes[i][1] * _planes[i][1] +
+							 _planes[i][2] * _planes[i][2] );
+		for ( unsigned int j = 0; length > 0.0f && j < 4; ++j )
+			_planes[i][j] /= length;
+	}
+}
+
 
 //-- view and proj matrices ----------------------------------------------------
 
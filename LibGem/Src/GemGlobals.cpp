@@ -20,6 +20,8 @@ GEM_BEGIN_NAMESPACE
 
 //-- static constants ----------------------------------------------------------
 
+std::mutex consoleMutex;
+
 
 
 //==============================================================================
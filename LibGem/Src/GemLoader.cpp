@@ -1,6 +1,9 @@
 //== INCLUDES ==================================================================
 
 #include "GemLoader.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 
 //== NAMESPACES ================================================================
@@ -8,15 +11,362 @@
 GEM_BEGIN_NAMESPACE
 
 
+//== LOAD TASKS ================================================================
+
+// A load on the worker pool. The staged loader belongs to the worker while the
+// status is PENDING. The worker leaves PENDING with one compare and swap, to
+// READY and the staged loader then belongs to the thread that draws, or to
+// FAILED. If the thread that draws cancelled the load first the swap fails
+// and the worker still owns the staged loader and frees it.
+struct LoadTask
+{
+	LoadTask()
+	: status( LOAD_STATUS_NONE )
+	, target( NULL )
+	{}
+
+	// leave PENDING for _status and wake LoadHandle::wait(), false if the
+	// load already left it
+	bool finish( const LOAD_STATUS _status )
+	{
+		int expected = LOAD_STATUS_PENDING;
+		bool isFinished;
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			isFinished = status.compare_exchange_strong( expected, _status,
+				std::memory_order_acq_rel );
+		}
+		if ( isFinished )
+		{
+			finished.notify_all();
+		}
+		return isFinished;
+	}
+
+	std::atomic<int> status;
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::string path;
+	Loader* target;
+	std::shared_ptr<Loader> staged;
+	std::function<bool( Loader* )> load;
+	std::function<void( Loader*, Loader* )> swap;
+};
+
+
+// Worker threads taking tasks from a queue. Tasks without a load function
+// only carry a staged loader to be freed off the thread that draws.
+class LoadPool
+{
+
+public:
+
+	// queue a task, started on first use. After the pool is destroyed at
+	// exit tasks run at once on the calling thread
+	static void push( const std::shared_ptr<LoadTask>& _task )
+	{
+		if ( isDestroyed_ )
+		{
+			run( _task.get() );
+			return;
+		}
+		LoadPool& pool = instance();
+		{
+			std::lock_guard<std::mutex> lock( pool.mutex_ );
+			pool.tasks_.push_back( _task );
+		}
+		pool.condition_.notify_one();
+	}
+
+private:
+
+	// only used from the thread that draws
+	static LoadPool& instance()
+	{
+		static LoadPool pool;
+		return pool;
+	}
+
+	// one core is left to the thread that draws
+	LoadPool()
+	: isStopped_( false )
+	{
+		// hardware_concurrency() may be 0 when it is not known
+		const unsigned int coreCount = std::thread::hardware_concurrency();
+		const unsigned int threadCount = coreCount > 1 ? coreCount - 1 : 1;
+		for ( unsigned int i = 0; i < threadCount; ++i )
+		{
+			threads_.push_back( std::thread( &LoadPool::work, this ) );
+		}
+	}
+
+	// loads being parsed are finished, queued ones are dropped
+	~LoadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex_ );
+			isStopped_ = true;
+		}
+		condition_.notify_all();
+		for ( unsigned int i = 0; i < threads_.size(); ++i )
+		{
+			threads_[i].join();
+		}
+		isDestroyed_ = true;
+	}
+
+	void work()
+	{
+		for ( ;; )
+		{
+			std::shared_ptr<LoadTask> task;
+			{
+				std::unique_lock<std::mutex> lock( mutex_ );
+				while ( tasks_.empty() && !isStopped_ )
+				{
+					condition_.wait( lock );
+				}
+				if ( isStopped_ )
+					return;
+				task = tasks_.front();
+				tasks_.pop_front();
+			}
+			run( task.get() );
+		}
+	}
+
+	static void run( LoadTask* _task )
+	{
+		if ( _task->load )
+		{
+			execute( _task );
+		}
+		else
+		{
+			_task->staged.reset();
+		}
+	}
+
+	static void execute( LoadTask* _task )
+	{
+		// cancelled before it started
+		bool isLoaded = false;
+		if ( _task->status.load( std::memory_order_acquire ) ==
+			 LOAD_STATUS_PENDING )
+		{
+			try
+			{
+				isLoaded = _task->load( _task->staged.get() );
+			}
+			catch( const std::exception& e )
+			{
+				GEM_CONSOLE( "Async load of " + _task->path + " failed: " +
+							 e.what() );
+			}
+		}
+
+
+		// publish, the release orders every write to the staged loader
+		// before it
+		if ( !isLoaded )
+		{
+			_task->staged.reset();
+		}
+		if ( !_task->finish( isLoaded ? LOAD_STATUS_READY :
+										LOAD_STATUS_FAILED ) )
+		{
+			_task->staged.reset();
+		}
+	}
+
+	static bool isDestroyed_;
+	bool isStopped_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::deque< std::shared_ptr<LoadTask> > tasks_;
+	std::vector<std::thread> threads_;
+};
+
+bool LoadPool::isDestroyed_ = false;
+
+
+// loads not yet swapped in, only touched by the thread that draws
+static std::vector< std::shared_ptr<LoadTask> >& getPendingTasks()
+{
+	static std::vector< std::shared_ptr<LoadTask> >* tasks =
+		new std::vector< std::shared_ptr<LoadTask> >();
+	return *tasks;
+}
+
+
+//== CLASS DEFINITION ==========================================================
+
+//-- constructors/destructor ---------------------------------------------------
+
+LoadHandle::LoadHandle()
+: task_()
+{
+}
+
+LoadHandle::LoadHandle( const std::shared_ptr<LoadTask>& _task )
+: task_( _task )
+{
+}
+
+
+//-- gets ----------------------------------------------------------------------
+
+LOAD_STATUS
+LoadHandle::getStatus() const
+{
+	if ( !task_ )
+		return LOAD_STATUS_NONE;
+	return static_cast<LOAD_STATUS>(
+		task_->status.load( std::memory_order_acquire ) );
+}
+
+bool
+LoadHandle::isPending() const
+{
+	LOAD_STATUS status = getStatus();
+	return status == LOAD_STATUS_PENDING || status == LOAD_STATUS_READY;
+}
+
+void
+LoadHandle::wait() const
+{
+	if ( !task_ )
+		return;
+	std::unique_lock<std::mutex> lock( task_->mutex );
+	while ( task_->status.load( std::memory_order_acquire ) ==
+			LOAD_STATUS_PENDING )
+	{
+		task_->finished.wait( lock );
+	}
+}
+
+
 //== CLASS DEFINITION ==========================================================
 
 //-- constructors/destructor ---------------------------------------------------
 
 Loader::Loader()
-//: class initializer list
+: pendingTask_()
+{
+}
+
+Loader::Loader( const Loader& other )
+: pendingTask_()
 {
 }
 
+Loader::~Loader()
+{
+	cancelLoad();
+}
+
+Loader&
+Loader::operator=( const Loader& rhs )
+{
+	return *this;
+}
+
+
+//-- asynchronous loading ------------------------------------------------------
+
+void
+Loader::newFrame()
+{
+	std::vector< std::shared_ptr<LoadTask> >& tasks = getPendingTasks();
+	for ( unsigned int i = 0; i < tasks.size(); )
+	{
+		LoadTask* task = tasks[i].get();
+		int status = task->status.load( std::memory_order_acquire );
+		if ( status == LOAD_STATUS_PENDING )
+		{
+			++i;
+			continue;
+		}
+
+
+		// swap the new data in, the old data is now in the staged loader
+		// and is freed on a worker
+		if ( status == LOAD_STATUS_READY )
+		{
+			task->swap( task->target, task->staged.get() );
+			task->status.store( LOAD_STATUS_DONE, std::memory_order_release );
+			std::shared_ptr<LoadTask> release( new LoadTask() );
+			release->staged.swap( task->staged );
+			LoadPool::push( release );
+		}
+		if ( task->target && task->target->pendingTask_.get() == task )
+		{
+			task->target->pendingTask_.reset();
+		}
+		tasks.erase( tasks.begin() + i );
+	}
+}
+
+void
+Loader::finishLoads()
+{
+	std::vector< std::shared_ptr<LoadTask> >& tasks = getPendingTasks();
+	while ( !tasks.empty() )
+	{
+		for ( unsigned int i = 0; i < tasks.size(); ++i )
+		{
+			LoadHandle( tasks[i] ).wait();
+		}
+		newFrame();
+	}
+}
+
+LoadHandle
+Loader::submitLoad( const std::string& _path,
+					const std::shared_ptr<Loader>& _staged,
+					const LoadFunction& _load,
+					const SwapFunction& _swap )
+{
+	// a newer load replaces the pending one
+	cancelLoad();
+
+
+	std::shared_ptr<LoadTask> task( new LoadTask() );
+	task->status.store( LOAD_STATUS_PENDING );
+	task->path = _path;
+	task->target = this;
+	task->staged = _staged;
+	task->load = _load;
+	task->swap = _swap;
+	pendingTask_ = task;
+	getPendingTasks().push_back( task );
+	LoadPool::push( task );
+	return LoadHandle( task );
+}
+
+void
+Loader::cancelLoad()
+{
+	if ( !pendingTask_ )
+		return;
+
+
+	// while PENDING the worker frees the staged loader, once READY it is
+	// ours and freed on a worker
+	if ( !pendingTask_->finish( LOAD_STATUS_CANCELLED ) &&
+		 pendingTask_->status.load( std::memory_order_acquire ) ==
+		 LOAD_STATUS_READY )
+	{
+		pendingTask_->status.store( LOAD_STATUS_CANCELLED,
+									std::memory_order_release );
+		std::shared_ptr<LoadTask> release( new LoadTask() );
+		release->staged.swap( pendingTask_->staged );
+		LoadPool::push( release );
+	}
+	pendingTask_->target = NULL;
+	pendingTask_.reset();
+}
+
 
 //-- private file utility ------------------------------------------------------
 
@@ -45,6 +395,25 @@ Loader::splitPath( const std::string& _path,
 	}
 }
 
+void
+Loader::readFile( const std::string& _path, std::vector<char>* _buffer )
+{
+	// open file at the end to get the size
+	std::ifstream ifs( _path.c_str(), std::ifstream::in |
+									  std::ifstream::binary |
+									  std::ifstream::ate );
+	if ( ifs.fail() )
+		GEM_THROW( "Could not open file " + _path );
+
+
+	// read whole file in one go
+	std::streamoff size = ifs.tellg();
+	_buffer->resize( static_cast<size_t>( size ) );
+	ifs.seekg( 0 );
+	if ( size > 0 && !ifs.read( &(*_buffer)[0], size ) )
+		GEM_THROW( "Could not read file " + _path );
+}
+
 //==============================================================================
 GEM_END_NAMESPACE
 //==============================================================================
\ No newline at end of file
@@ -1,6 +1,12 @@
 //== INCLUDES ==================================================================
 
 #include "GemMeshLoader.h"
+#include "GemCameraNode.h"
+#include "GemGlobals.h"
+#include <unordered_map>
+#ifdef GEM_HAS_SSE2
+#include <emmintrin.h>
+#endif
 
 
 //== NAMESPACES ================================================================
@@ -8,20 +14,282 @@
 GEM_BEGIN_NAMESPACE
 
 
+//== SIMD HELPERS ==============================================================
+
+#ifdef GEM_HAS_SSE2
+// component k of four vertices of a store with dim components per vertex
+static inline __m128 gather4( const float* _store,
+							  const unsigned int* _vertices,
+							  const unsigned int _dim, const unsigned int _k )
+{
+	return _mm_setr_ps( _store[_vertices[0] * _dim + _k],
+						_store[_vertices[1] * _dim + _k],
+						_store[_vertices[2] * _dim + _k],
+						_store[_vertices[3] * _dim + _k] );
+}
+
+static inline __m128 dot4( const __m128 _ax, const __m128 _ay,
+						   const __m128 _az, const __m128 _bx,
+						   const __m128 _by, const __m128 _bz )
+{
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( _ax, _bx ),
+								   _mm_mul_ps( _ay, _by ) ),
+					   _mm_mul_ps( _az, _bz ) );
+}
+
+// one over the square root, zero for zero
+static inline __m128 invSqrt4( const __m128 _x )
+{
+	__m128 root = _mm_sqrt_ps( _x );
+	return _mm_and_ps( _mm_cmpgt_ps( root, _mm_setzero_ps() ),
+					   _mm_div_ps( _mm_set1_ps( 1.0f ), root ) );
+}
+
+// arc cosine of four cosines clamped to [-1, 1], Abramowitz and Stegun
+// 4.4.46 on |x| with acos( -x ) = pi - acos( x ), error below 2e-8
+static inline __m128 acos4( const __m128 _x )
+{
+	const __m128 vSignMask = _mm_set1_ps( -0.0f );
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	__m128 x = _mm_min_ps( _mm_andnot_ps( vSignMask, _x ), vOne );
+	__m128 p = _mm_set1_ps( -0.0012624911f );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( 0.0066700901f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( -0.0170881256f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( 0.0308918810f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( -0.0501743046f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( 0.0889789874f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( -0.2145988016f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, x ), _mm_set1_ps( 1.5707963050f ) );
+	p = _mm_mul_ps( p, _mm_sqrt_ps( _mm_sub_ps( vOne, x ) ) );
+	__m128 isNegative = _mm_cmplt_ps( _x, _mm_setzero_ps() );
+	return _mm_or_ps( _mm_and_ps( isNegative, _mm_sub_ps(
+		_mm_set1_ps( 3.14159265f ), p ) ), _mm_andnot_ps( isNegative, p ) );
+}
+#else
+// arc cosine of a cosine clamped to [-1, 1]
+static inline float acos1( const float _x )
+{
+	return std::acos( std::max( -1.0f, std::min( _x, 1.0f ) ) );
+}
+
+// one over the square root, zero for zero
+static inline float invSqrt1( const float _x )
+{
+	return _x > 0.0f ? 1.0f / std::sqrt( _x ) : 0.0f;
+}
+#endif
+
+
+//== RAY HELPERS ===============================================================
+
+// half the surface area of a box, for the surface area heuristic
+static inline float getHalfArea( const float* _lower, const float* _upper )
+{
+	float dx = _upper[0] - _lower[0];
+	float dy = _upper[1] - _lower[1];
+	float dz = _upper[2] - _lower[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+// grow a box by another, both as xyz and an unused w
+static inline void growBox( float* _lower, float* _upper,
+							const float* _otherLower,
+							const float* _otherUpper )
+{
+#ifdef GEM_HAS_SSE2
+	_mm_storeu_ps( _lower, _mm_min_ps( _mm_loadu_ps( _lower ),
+									   _mm_loadu_ps( _otherLower ) ) );
+	_mm_storeu_ps( _upper, _mm_max_ps( _mm_loadu_ps( _upper ),
+									   _mm_loadu_ps( _otherUpper ) ) );
+#else
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		_lower[k] = std::min( _lower[k], _otherLower[k] );
+		_upper[k] = std::max( _upper[k], _otherUpper[k] );
+	}
+#endif
+}
+
+// one over a direction component, nudged off zero so that slabs parallel to
+// the ray give huge distances of the right sign rather than nans
+static inline float invertDirection( const float _d )
+{
+	const float tiny = 1e-30f;
+	if ( std::fabs( _d ) > tiny )
+		return 1.0f / _d;
+	return _d < 0.0f ? -1.0f / tiny : 1.0f / tiny;
+}
+
+// Distance along a ray to where it enters a box, infinity if it misses it
+// or enters beyond _maxDistance. The exit is pushed out by a few ulps for
+// rounding, Ize, Robust BVH Ray Traversal, 2013, or a triangle lying in a
+// face of its box could be missed.
+static inline float enterBox( const float* _lower, const float* _upper,
+							  const float* _origin,
+							  const float* _invDirection,
+							  const float _maxDistance )
+{
+	float tNear = 0.0f;
+	float tFar = _maxDistance;
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		float t0 = ( _lower[k] - _origin[k] ) * _invDirection[k];
+		float t1 = ( _upper[k] - _origin[k] ) * _invDirection[k];
+		tNear = std::max( tNear, std::min( t0, t1 ) );
+		tFar = std::min( tFar, std::max( t0, t1 ) );
+	}
+	tFar *= 1.0000008f;
+	return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+}
+
+// Moller and Trumbore, Fast, Minimum Storage Ray/Triangle Intersection,
+// 1997, on a triangle stored as a corner and two edges, hit from both
+// sides. A hit closer than *_t replaces it and the barycentric weights.
+static inline bool hitTriangle( const float* _triangle, const float* _origin,
+								const float* _direction, float* _t,
+								float* _u, float* _v )
+{
+	const float* e1 = _triangle + 3;
+	const float* e2 = _triangle + 6;
+	float p[3] = { _direction[1] * e2[2] - _direction[2] * e2[1],
+				   _direction[2] * e2[0] - _direction[0] * e2[2],
+				   _direction[0] * e2[1] - _direction[1] * e2[0] };
+	float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+	if ( det == 0.0f )
+		return false;
+	float invDet = 1.0f / det;
+	float s[3] = { _origin[0] - _triangle[0], _origin[1] - _triangle[1],
+				   _origin[2] - _triangle[2] };
+	float u = ( s[0] * p[0] + s[1] * p[1] + s[2] * p[2] ) * invDet;
+	if ( !( u >= 0.0f && u <= 1.0f ) )
+		return false;
+	float q[3] = { s[1] * e1[2] - s[2] * e1[1],
+				   s[2] * e1[0] - s[0] * e1[2],
+				   s[0] * e1[1] - s[1] * e1[0] };
+	float v = ( _direction[0] * q[0] + _direction[1] * q[1] +
+				_direction[2] * q[2] ) * invDet;
+	if ( !( v >= 0.0f && u + v <= 1.0f ) )
+		return false;
+	float t = ( e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2] ) * invDet;
+	if ( !( t >= 0.0f && t < *_t ) )
+		return false;
+	*_t = t;
+	*_u = u;
+	*_v = v;
+	return true;
+}
+
+#ifdef GEM_HAS_SSE2
+// lanes of _a where _mask is set, of _b elsewhere
+static inline __m128 select4( const __m128 _mask, const __m128 _a,
+							  const __m128 _b )
+{
+	return _mm_or_ps( _mm_and_ps( _mask, _a ), _mm_andnot_ps( _mask, _b ) );
+}
+
+// enterBox() for four rays in SoA registers, returns a bit per ray that
+// enters the box
+static inline int enterBox4( const float* _lower, const float* _upper,
+							 const __m128* _origin,
+							 const __m128* _invDirection,
+							 const __m128 _maxDistance, __m128* _distance )
+{
+	__m128 tNear = _mm_setzero_ps();
+	__m128 tFar = _maxDistance;
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		__m128 t0 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _lower[k] ),
+											_origin[k] ), _invDirection[k] );
+		__m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _upper[k] ),
+											_origin[k] ), _invDirection[k] );
+		tNear = _mm_max_ps( tNear, _mm_min_ps( t0, t1 ) );
+		tFar = _mm_min_ps( tFar, _mm_max_ps( t0, t1 ) );
+	}
+	tFar = _mm_mul_ps( tFar, _mm_set1_ps( 1.0000008f ) );
+	__m128 isInside = _mm_cmple_ps( tNear, tFar );
+	*_distance = select4( isInside, tNear, _mm_set1_ps(
+		std::numeric_limits<float>::infinity() ) );
+	return _mm_movemask_ps( isInside );
+}
+
+// hitTriangle() for four rays, returns the mask of the rays that hit
+static inline __m128 hitTriangle4( const float* _triangle,
+								   const __m128* _origin,
+								   const __m128* _direction, __m128* _t,
+								   __m128* _u, __m128* _v )
+{
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	__m128 e1x = _mm_set1_ps( _triangle[3] );
+	__m128 e1y = _mm_set1_ps( _triangle[4] );
+	__m128 e1z = _mm_set1_ps( _triangle[5] );
+	__m128 e2x = _mm_set1_ps( _triangle[6] );
+	__m128 e2y = _mm_set1_ps( _triangle[7] );
+	__m128 e2z = _mm_set1_ps( _triangle[8] );
+	__m128 px = _mm_sub_ps( _mm_mul_ps( _direction[1], e2z ),
+							_mm_mul_ps( _direction[2], e2y ) );
+	__m128 py = _mm_sub_ps( _mm_mul_ps( _direction[2], e2x ),
+							_mm_mul_ps( _direction[0], e2z ) );
+	__m128 pz = _mm_sub_ps( _mm_mul_ps( _direction[0], e2y ),
+							_mm_mul_ps( _direction[1], e2x ) );
+	__m128 det = dot4( e1x, e1y, e1z, px, py, pz );
+	__m128 invDet = _mm_div_ps( vOne, det );
+	__m128 sx = _mm_sub_ps( _origin[0], _mm_set1_ps( _triangle[0] ) );
+	__m128 sy = _mm_sub_ps( _origin[1], _mm_set1_ps( _triangle[1] ) );
+	__m128 sz = _mm_sub_ps( _origin[2], _mm_set1_ps( _triangle[2] ) );
+	__m128 u = _mm_mul_ps( dot4( sx, sy, sz, px, py, pz ), invDet );
+	__m128 qx = _mm_sub_ps( _mm_mul_ps( sy, e1z ), _mm_mul_ps( sz, e1y ) );
+	__m128 qy = _mm_sub_ps( _mm_mul_ps( sz, e1x ), _mm_mul_ps( sx, e1z ) );
+	__m128 qz = _mm_sub_ps( _mm_mul_ps( sx, e1y ), _mm_mul_ps( sy, e1x ) );
+	__m128 v = _mm_mul_ps( dot4( _direction[0], _direction[1],
+								 _direction[2], qx, qy, qz ), invDet );
+	__m128 t = _mm_mul_ps( dot4( e2x, e2y, e2z, qx, qy, qz ), invDet );
+	__m128 isHit = _mm_and_ps( _mm_cmpneq_ps( det, vZero ),
+							   _mm_cmpge_ps( u, vZero ) );
+	isHit = _mm_and_ps( isHit, _mm_cmple_ps( u, vOne ) );
+	isHit = _mm_and_ps( isHit, _mm_cmpge_ps( v, vZero ) );
+	isHit = _mm_and_ps( isHit, _mm_cmple_ps( _mm_add_ps( u, v ), vOne ) );
+	isHit = _mm_and_ps( isHit, _mm_cmpge_ps( t, vZero ) );
+	isHit = _mm_and_ps( isHit, _mm_cmplt_ps( t, *_t ) );
+	*_t = select4( isHit, t, *_t );
+	*_u = select4( isHit, u, *_u );
+	*_v = select4( isHit, v, *_v );
+	return isHit;
+}
+#endif
+
+
 //=== IMPLEMENTATION ===========================================================
 
+//-- static constants ----------------------------------------------------------
+
+const unsigned int MeshLoader::NO_HIT;
+
+
 //-- constructors/destructor ---------------------------------------------------
 
 MeshLoader::MeshLoader( )
-: path_( "" )
-, fileFormat_( FILE_FORMAT_NONE )
-, primitivesCount_( 0 )
-, primitives_()
-, vertexCount_( 0 )
-, isLoaded_( false )
+: Loader()
+{
+	init();
+}
+
+
+MeshLoader::MeshLoader( const MeshLoader& other )
+: Loader( other )
 {
+	init();
+	copy( other );
 }
 
+#ifdef GEM_HAS_RVALUE_REFS
+MeshLoader::MeshLoader( MeshLoader&& other )
+: Loader()
+{
+	init();
+	(*this) = std::move( other );
+}
+#endif
 
 MeshLoader::~MeshLoader( )
 {
@@ -40,15 +308,144 @@ MeshLoader::clear( )
 	{
 		vertexAttributes_[i].clear();
 	}
+	lods_.clear();
+	lodRadius_ = 0.0f;
+	meshlets_.clear();
+	meshletVertices_.clear();
+	meshletTriangles_.clear();
+	bvhNodes_.clear();
+	bvhPrimitives_.clear();
+	bvhTriangles_.clear();
 	isLoaded_ = false;
 }
 
 void
 MeshLoader::copy( const MeshLoader& other )
 {
-	// no deep copy needed, allocators have deep copy implemented
-	(*this) = other;
+	// allocators have deep copy implemented
+	primitives_ = other.primitives_;
+	for ( unsigned int i=0; i<MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		vertexAttributes_[i] = other.vertexAttributes_[i];
+	}
+	copyMembers( other );
+	lods_ = other.lods_;
+	meshlets_ = other.meshlets_;
+	meshletVertices_ = other.meshletVertices_;
+	meshletTriangles_ = other.meshletTriangles_;
+	bvhNodes_ = other.bvhNodes_;
+	bvhPrimitives_ = other.bvhPrimitives_;
+	bvhTriangles_ = other.bvhTriangles_;
+}
+
+void
+MeshLoader::share( MeshLoader& other )
+{
+	if ( this == &other )
+		return;
+
+	// the allocators share storage, the rest is copied
+	primitives_.share( other.primitives_ );
+	for ( unsigned int i=0; i<MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		vertexAttributes_[i].share( other.vertexAttributes_[i] );
+	}
+	copyMembers( other );
+	lods_ = other.lods_;
+	meshlets_ = other.meshlets_;
+	meshletVertices_ = other.meshletVertices_;
+	meshletTriangles_ = other.meshletTriangles_;
+	bvhNodes_ = other.bvhNodes_;
+	bvhPrimitives_ = other.bvhPrimitives_;
+	bvhTriangles_ = other.bvhTriangles_;
+}
+
+void
+MeshLoader::init()
+{
+	path_ = "";
+	fileFormat_ = FILE_FORMAT_NONE;
+	primitivesCount_ = 0;
+	vertexCount_ = 0;
+	parseMode_ = PARSE_MODE_BUFFERED;
+	isCacheEnabled_ = true;
+	isMapEnabled_ = false;
+	weldEpsilon_ = 0.0f;
+	isOptimizeEnabled_ = false;
+	isIndexNarrowingEnabled_ = true;
+	lodRadius_ = 0.0f;
+	loadLODCount_ = 1;
+	isLoaded_ = false;
+	primitives_.setTag( ALLOC_TAG_MESH );
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		vertexAttributes_[i].setTag( ALLOC_TAG_MESH );
+		loadFormats_[i] = VERTEX_FORMAT_NONE;
+	}
+}
+
+void
+MeshLoader::copyMembers( const MeshLoader& other )
+{
+	path_ = other.path_;
+	fileFormat_ = other.fileFormat_;
+	primitivesCount_ = other.primitivesCount_;
+	vertexCount_ = other.vertexCount_;
+	lodRadius_ = other.lodRadius_;
+	isLoaded_ = other.isLoaded_;
+	copySettings( other );
+}
+
+void
+MeshLoader::copySettings( const MeshLoader& other )
+{
+	parseMode_ = other.parseMode_;
+	isCacheEnabled_ = other.isCacheEnabled_;
+	isMapEnabled_ = other.isMapEnabled_;
+	weldEpsilon_ = other.weldEpsilon_;
+	isOptimizeEnabled_ = other.isOptimizeEnabled_;
+	std::copy( other.loadFormats_, other.loadFormats_ + MAX_VERTEX_ATTRIBUTES,
+			   loadFormats_ );
+	isIndexNarrowingEnabled_ = other.isIndexNarrowingEnabled_;
+	loadLODCount_ = other.loadLODCount_;
+}
+
+//-- assignment operators ------------------------------------------------------
+
+MeshLoader&
+MeshLoader::operator=( const MeshLoader& rhs )
+{
+	if ( this != &rhs )
+	{
+		copy( rhs );
+	}
+	return *this;
+}
+
+#ifdef GEM_HAS_RVALUE_REFS
+MeshLoader&
+MeshLoader::operator=( MeshLoader&& rhs )
+{
+	if ( this != &rhs )
+	{
+		primitives_ = std::move( rhs.primitives_ );
+		for ( unsigned int i=0; i<MAX_VERTEX_ATTRIBUTES; ++i )
+		{
+			vertexAttributes_[i] = std::move( rhs.vertexAttributes_[i] );
+		}
+		copyMembers( rhs );
+		lods_ = std::move( rhs.lods_ );
+		meshlets_ = std::move( rhs.meshlets_ );
+		meshletVertices_ = std::move( rhs.meshletVertices_ );
+		meshletTriangles_ = std::move( rhs.meshletTriangles_ );
+		bvhNodes_ = std::move( rhs.bvhNodes_ );
+		bvhPrimitives_ = std::move( rhs.bvhPrimitives_ );
+		bvhTriangles_ = std::move( rhs.bvhTriangles_ );
+		rhs.clear();
+	}
+	return *this;
 }
+#endif
 
 //-- load and create -------------------------------------------------------
 
@@ -90,6 +487,10 @@ MeshLoader::load( const std::string& _path, const FILE_FORMAT _fileFormat )
 		{
 			fileFormat = FILE_FORMAT_OBX;
 		}
+		else if ( ext == "gmb" )
+		{
+			fileFormat = FILE_FORMAT_GMB;
+		}
 	}
 
 
@@ -99,10 +500,35 @@ MeshLoader::load( const std::string& _path, const FILE_FORMAT _fileFormat )
 		switch ( fileFormat )
 		{
 		case FILE_FORMAT_OBJ:
-			loadOBX( path );
-			break;
 		case FILE_FORMAT_OBX:
-			loadOBX( path );
+			if ( isCacheEnabled_ && loadCache( path ) )
+				break;
+			if ( parseMode_ == PARSE_MODE_STREAM )
+				loadOBX( path );
+			else if ( parseMode_ == PARSE_MODE_PARALLEL )
+				loadOBXBuffered( path, std::thread::hardware_concurrency() );
+			else
+				loadOBXBuffered( path, 1 );
+			if ( weldEpsilon_ > 0.0f )
+				weldVertices( weldEpsilon_ );
+			if ( loadLODCount_ > 1 )
+				simplifyMesh( loadLODCount_, 0.5f );
+			if ( isOptimizeEnabled_ )
+				optimizeMesh( true, 1.05f );
+			for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+			{
+				if ( loadFormats_[i] != VERTEX_FORMAT_NONE )
+					convertStore( vertexAttributes_[i],
+						static_cast<ALLOC_FORMAT>( loadFormats_[i] ) );
+			}
+			if ( isIndexNarrowingEnabled_ )
+				narrowPrimitives();
+			if ( isCacheEnabled_ )
+				saveCache( path );
+			break;
+		case FILE_FORMAT_GMB:
+			if ( !loadGMB( path, NULL ) )
+				GEM_THROW( "Unsupported gmb version " + path );
 			break;
 		default:
 			GEM_THROW( "Unsupported file type ." + ext );
@@ -135,6 +561,36 @@ MeshLoader::reload()
 	}
 }
 
+LoadHandle
+MeshLoader::loadAsync( const std::string& _path,
+					   const FILE_FORMAT _fileFormat )
+{
+	// the staged loader gets the settings of this one but none of the data,
+	// it is swapped with this one when parsed, see Loader
+	std::shared_ptr<MeshLoader> staged( new MeshLoader() );
+	staged->copySettings( *this );
+	return submitLoad( _path, staged,
+		[_path, _fileFormat]( Loader* _staged ) -> bool
+		{
+			MeshLoader* mesh = static_cast<MeshLoader*>( _staged );
+			mesh->load( _path, _fileFormat );
+			return mesh->isLoaded();
+		},
+		[]( Loader* _target, Loader* _staged )
+		{
+			std::swap( *static_cast<MeshLoader*>( _target ),
+					   *static_cast<MeshLoader*>( _staged ) );
+		} );
+}
+
+LoadHandle
+MeshLoader::reloadAsync()
+{
+	if ( !isLoaded_ )
+		return LoadHandle();
+	return loadAsync( path_, fileFormat_ );
+}
+
 void
 MeshLoader::create( const unsigned int _primitivesCount,
 				     const unsigned int _vertexCount,
@@ -157,9 +613,9 @@ MeshLoader::create( const unsigned int _primitivesCount,
 					 const VERTEX_FORMAT _vertexFormatAttr15 )
 {
 	// argument checks
-	if ( _primitivesCount > 0 )
+	if ( !_primitivesCount )
 		GEM_ERROR( "Invalid number of primitives " + _primitivesCount );
-	if ( _vertexCount > 0 )
+	if ( !_vertexCount )
 		GEM_ERROR( "Invalid number of vertices " + _vertexCount );
 	if ( _primType == PRIM_TYPE_NONE )
 		GEM_ERROR( "Invalid primitive type " + PRIM_TYPE_NONE );
@@ -175,11 +631,12 @@ MeshLoader::create( const unsigned int _primitivesCount,
 	vertexCount_ = _vertexCount;
 
 
-	// allocate memory for primitives
+	// created meshes are typically filled by the GPU, so only specify the
+	// stores and let host memory be committed on demand
 	try
 	{
 		if ( _primType != PRIM_TYPE_NONE )
-			createPrimitives( _primType, _primitivesCount );
+			createPrimitives( _primType, _primitivesCount, ALLOC_MODE_LAZY );
 	}
 	catch( const std::exception &e )
 	{
@@ -192,37 +649,53 @@ MeshLoader::create( const unsigned int _primitivesCount,
 	try
 	{
 		if ( _vertexFormatAttr0 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 0, _vertexFormatAttr0, _vertexCount );
+			createVertexAttribute( 0, _vertexFormatAttr0, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr1 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 1, _vertexFormatAttr1, _vertexCount );
+			createVertexAttribute( 1, _vertexFormatAttr1, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr2 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 2, _vertexFormatAttr2, _vertexCount );
+			createVertexAttribute( 2, _vertexFormatAttr2, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr3 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 3, _vertexFormatAttr3, _vertexCount );
+			createVertexAttribute( 3, _vertexFormatAttr3, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr4 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 4, _vertexFormatAttr4, _vertexCount );
+			createVertexAttribute( 4, _vertexFormatAttr4, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr5 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 5, _vertexFormatAttr5, _vertexCount );
+			createVertexAttribute( 5, _vertexFormatAttr5, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr6 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 6, _vertexFormatAttr6, _vertexCount );
+			createVertexAttribute( 6, _vertexFormatAttr6, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr7 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 7, _vertexFormatAttr7, _vertexCount );
+			createVertexAttribute( 7, _vertexFormatAttr7, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr8 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 8, _vertexFormatAttr8, _vertexCount );
+			createVertexAttribute( 8, _vertexFormatAttr8, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr9 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 9, _vertexFormatAttr9, _vertexCount );
+			createVertexAttribute( 9, _vertexFormatAttr9, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr10 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 10, _vertexFormatAttr10, _vertexCount );
+			createVertexAttribute( 10, _vertexFormatAttr10, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr11 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 11, _vertexFormatAttr11, _vertexCount );
+			createVertexAttribute( 11, _vertexFormatAttr11, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr12 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 12, _vertexFormatAttr12, _vertexCount );
+			createVertexAttribute( 12, _vertexFormatAttr12, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr13 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 13, _vertexFormatAttr13, _vertexCount );
+			createVertexAttribute( 13, _vertexFormatAttr13, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr14 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 14, _vertexFormatAttr14, _vertexCount );
+			createVertexAttribute( 14, _vertexFormatAttr14, _vertexCount,
+								   ALLOC_MODE_LAZY );
 		if ( _vertexFormatAttr15 != VERTEX_FORMAT_NONE )
-			createVertexAttribute( 15, _vertexFormatAttr15, _vertexCount );
+			createVertexAttribute( 15, _vertexFormatAttr15, _vertexCount,
+								   ALLOC_MODE_LAZY );
 	}
 	catch( const std::exception &e )
 	{
@@ -273,19 +746,42 @@ MeshLoader::save( const std::string& _path, const FILE_FORMAT _fileFormat )
 		{
 			fileType = FILE_FORMAT_OBX;
 		}
+		else if ( ext == "gmb" )
+		{
+			fileType = FILE_FORMAT_GMB;
+		}
 	}
 
 
 	// activate the right file loader depending on file type
 	try
 	{
+		// text files are written from 32 bit stores and level 0, so narrow
+		// stores are widened and levels dropped on a copy-on-write share
+		MeshLoader wide;
+		if ( fileType == FILE_FORMAT_OBJ || fileType == FILE_FORMAT_OBX )
+		{
+			wide.share( *this );
+			wide.dropLODs();
+			wide.widenPrimitives();
+			for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+			{
+				Allocator& store = wide.vertexAttributes_[i];
+				if ( store.isAlloc() && getWideFormat( store ) !=
+										store.getFormat() )
+					wide.convertStore( store, getWideFormat( store ) );
+			}
+		}
 		switch ( fileType )
 		{
 		case FILE_FORMAT_OBJ:
-			saveOBJ( path );
+			wide.saveOBJ( path );
 			break;
 		case FILE_FORMAT_OBX:
-			saveOBX( path );
+			wide.saveOBX( path );
+			break;
+		case FILE_FORMAT_GMB:
+			saveGMB( path, NULL );
 			break;
 		default:
 			GEM_THROW( "Unsupported file type ." + ext );
@@ -293,129 +789,3496 @@ MeshLoader::save( const std::string& _path, const FILE_FORMAT _fileFormat )
 	}
 	catch( const std::exception& e )
 	{
-		clear();
+		// a failed save leaves the mesh as it was
 		GEM_ERROR( e.what() );
 	}
 }
 
 
-//-- private load and create ---------------------------------------------------
+//-- optimize ------------------------------------------------------------------
 
 void
-MeshLoader::createPrimitives( const PRIM_TYPE _primType,
-							  const unsigned int _primitivesCount )
+MeshLoader::optimize( const bool _isOverdrawEnabled,
+					  const float _overdrawThreshold )
 {
-	// pre allocation checks
-	if ( !_primitivesCount )
-		GEM_THROW( "Invalid number of primitives" + _primitivesCount );
-	if ( _primType == PRIM_TYPE_NONE )
-		GEM_THROW( "Invalid primType" + _primType );
+	// nothing to optimize
+	if ( !isLoaded_ || !primitives_.isAlloc() )
+		return;
 
 
-	// allocate storage for index array
-	primitives_.alloc( static_cast<ALLOC_FORMAT>(_primType), _primitivesCount );
+	// reorder
+	try
+	{
+		optimizeMesh( _isOverdrawEnabled, _overdrawThreshold );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
 
+MeshLoader::CACHESTATS
+MeshLoader::getCacheStats( const unsigned int _cacheSize,
+							 const unsigned int _level )
+{
+	CACHESTATS stats;
+	std::memset( &stats, 0, sizeof( stats ) );
+	stats.cacheSize = _cacheSize;
+	if ( !primitives_.isAlloc() || !_cacheSize )
+		return stats;
+
+
+	// run the indices of the level through the cache, the vertices used are
+	// the ones stamped on the way
+	LODLEVEL lod = getLOD( _level );
+	unsigned int dim = primitives_.getDim();
+	unsigned int first = lod.primitivesFirst * dim;
+	unsigned int count = lod.primitivesCount * dim;
+	std::vector<unsigned int> wide;
+	const unsigned int* indices = NULL;
+	if ( primitives_.getType() == ALLOC_TYPE_16UI )
+	{
+		const unsigned short* narrow =
+			primitives_.getReadPtr<unsigned short>() + first;
+		wide.assign( narrow, narrow + count );
+		indices = count ? &wide[0] : NULL;
+	}
+	else
+	{
+		indices = primitives_.getReadPtr<unsigned int>() + first;
+	}
+	std::vector<unsigned int> stamps( vertexCount_, 0 );
+	unsigned int time = _cacheSize + 1;
+	stats.missCount = simulateCache( indices, count, _cacheSize, stamps,
+									 &time );
+	stats.primitivesCount = lod.primitivesCount;
+	for ( unsigned int v = 0; v < vertexCount_; ++v )
+	{
+		if ( stamps[v] )
+			++stats.vertexCount;
+	}
+	if ( stats.primitivesCount )
+		stats.acmr = static_cast<float>( stats.missCount ) /
+					 stats.primitivesCount;
+	if ( stats.vertexCount )
+		stats.atvr = static_cast<float>( stats.missCount ) /
+					 stats.vertexCount;
+	return stats;
+}
 
-	// set member variables
-	primitivesCount_ = _primitivesCount;
+
+//-- levels of detail ----------------------------------------------------------
+
+MeshLoader::LODLEVEL
+MeshLoader::getLOD( const unsigned int _level ) const
+{
+	// without a chain the whole mesh is level 0
+	if ( _level < lods_.size() )
+		return lods_[_level];
+	LODLEVEL lod;
+	lod.primitivesFirst = 0;
+	lod.primitivesCount = _level ? 0 : primitives_.getElementCount();
+	lod.error = 0.0f;
+	return lod;
 }
 
 void
-MeshLoader::createVertexAttribute( const unsigned int _attr,
-								   const VERTEX_FORMAT _vertexFormat,
-								   const unsigned int _vertexCount)
+MeshLoader::generateLODs( const unsigned int _levelCount,
+						  const float _reduction )
 {
-	// pre allocation checks
-	if ( !_vertexCount )
-		GEM_THROW( "Invalid number of vertices" + _vertexCount );
-	if ( _vertexFormat == VERTEX_FORMAT_NONE )
-		GEM_THROW( "Invalid vertexType" + _vertexFormat );
-	if ( _attr >= MAX_VERTEX_ATTRIBUTES )
-		GEM_THROW( "Attribute index out of range" + _attr );
+	// argument checks
+	if ( !_levelCount || _levelCount > MESH_MAX_LODS )
+		GEM_ERROR( "Invalid number of levels of detail." );
+	if ( !( _reduction > 0.0f && _reduction < 1.0f ) )
+		GEM_ERROR( "Reduction has to be between zero and one." );
 
 
-	// allocate storage for vertex array
-	vertexAttributes_[_attr].alloc( static_cast<ALLOC_FORMAT>(_vertexFormat),
-									vertexCount_ );
+	// nothing to simplify
+	if ( !isLoaded_ || !primitives_.isAlloc() )
+		return;
 
 
-	// set member variables
-	vertexCount_ = _vertexCount;
+	// simplify
+	try
+	{
+		simplifyMesh( _levelCount, _reduction );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
 }
 
+unsigned int
+MeshLoader::selectLOD( CameraNode& _camera, const Vec3f& _positionWorld,
+					   const float _pixelError ) const
+{
+	// errors grow with the level, so the first one from the coarse end that
+	// is small enough on screen, measured where the mesh is closest
+	for ( unsigned int i = getLODCount() - 1; i > 0; --i )
+	{
+		if ( _camera.getProjectedSize( _positionWorld, lods_[i].error,
+									   lodRadius_ ) <= _pixelError )
+			return i;
+	}
+	return 0;
+}
 
-//-- private file-io -----------------------------------------------------------
+//-- meshlets ------------------------------------------------------------------
 
 void
-MeshLoader::loadOBX( const std::string& _path )
+MeshLoader::buildMeshlets( const unsigned int _maxVertices,
+						   const unsigned int _maxTriangles )
 {
-	// local variables
-	std::string line;
-	std::istringstream iss;
-	std::string cmd;
-	unsigned int n = 0;
-	unsigned int primCount = 0;
-	unsigned int vertexCount = 0;
-	PRIM_TYPE primType = PRIM_TYPE_NONE;
-	VERTEX_FORMAT vertexFormat = VERTEX_FORMAT_NONE;
+	// argument checks, local indices are 8 bit
+	if ( _maxVertices < 3 || _maxVertices > 256 )
+		GEM_ERROR( "Meshlets need between 3 and 256 vertices." );
+	if ( !_maxTriangles )
+		GEM_ERROR( "Meshlets need at least one triangle." );
 
 
-	// open file for reading
-	std::ifstream ifs( _path.c_str( ) );
-	if ( ifs.fail() )
+	// nothing to partition
+	if ( !isLoaded_ || !primitives_.isAlloc() )
+		return;
+
+
+	// partition
+	try
 	{
-		GEM_THROW( "Could not open ifs " + _path );
+		partitionMeshlets( _maxVertices, _maxTriangles );
+	}
+	catch( const std::exception& e )
+	{
+		meshlets_.clear();
+		meshletVertices_.clear();
+		meshletTriangles_.clear();
+		GEM_ERROR( e.what() );
+	}
+}
+
+MeshLoader::CULLSTATS
+MeshLoader::cullMeshlets( CameraNode& _camera, const Mat4f& _modelMatrix,
+						  Allocator* _primitives,
+						  const bool _isBackfaceCullEnabled )
+{
+	CULLSTATS stats;
+	std::memset( &stats, 0, sizeof( stats ) );
+	stats.meshletCount = static_cast<unsigned int>( meshlets_.size() );
+	if ( !_primitives || meshlets_.empty() )
+		return stats;
+
+
+	// the store has the format of the primitives and room for level 0
+	unsigned int capacity = getLOD( 0 ).primitivesCount;
+	if ( _primitives->getFormat() != primitives_.getFormat() ||
+		 _primitives->getElementCount() != capacity )
+	{
+		_primitives->setTag( ALLOC_TAG_MESH );
+		_primitives->alloc( primitives_.getFormat(), capacity, 1 );
 	}
 
 
-	// run through file once to count vertices and faces
-	while ( std::getline( ifs, line ) )
+	// frustum planes in world space, and the camera in model space, where
+	// the cones are
+	float planes[6][4];
+	_camera.getFrustumPlanes( planes );
+	Vec4f eye = _modelMatrix.inverse() *
+				Vec4f( _camera.getDerivedPosition(), 1.0f );
+	float scale = 0.0f;
+	for ( unsigned int j = 0; j < 3; ++j )
 	{
-		// clear io-state and set new string
-		cmd.clear( );
-		iss.clear( );
-		iss.str( line );
-		iss >> cmd;
+		scale = std::max( scale, _modelMatrix( 0, j ) * _modelMatrix( 0, j ) +
+								 _modelMatrix( 1, j ) * _modelMatrix( 1, j ) +
+								 _modelMatrix( 2, j ) * _modelMatrix( 2, j ) );
+	}
+	scale = std::sqrt( scale );
 
 
-		// increase vertex and face counters
-		if ( cmd == "f" )
+	// test each meshlet and gather the triangles of the ones kept
+	std::vector<unsigned int> visible;
+	visible.reserve( 3 * capacity );
+	for ( unsigned int m = 0; m < meshlets_.size(); ++m )
+	{
+		const MESHLET& meshlet = meshlets_[m];
+		const float* c = meshlet.center;
+		float world[3];
+		for ( unsigned int i = 0; i < 3; ++i )
+			world[i] = _modelMatrix( i, 0 ) * c[0] +
+					   _modelMatrix( i, 1 ) * c[1] +
+					   _modelMatrix( i, 2 ) * c[2] + _modelMatrix( i, 3 );
+		bool isOutside = false;
+		for ( unsigned int p = 0; p < 6 && !isOutside; ++p )
 		{
-			if ( !primCount )
-			{
-				for ( n = 0; iss >> cmd; ++n );
-				switch ( n )
-				{
-				case 1: primType = PRIM_TYPE_POINT; break;
-				case 2: primType = PRIM_TYPE_LINE; break;
-				case 3: primType = PRIM_TYPE_TRIANGLE; break;
-				case 4: primType = PRIM_TYPE_QUAD; break;
-				}
-			}
-			++primCount;
+			isOutside = planes[p][0] * world[0] + planes[p][1] * world[1] +
+						planes[p][2] * world[2] + planes[p][3] <
+						-meshlet.radius * scale;
 		}
-		else if ( cmd == "v" || cmd == "v0f" )
+		if ( isOutside )
 		{
-			if ( !vertexCount )
-			{
-				for ( n = 0; iss >> cmd; ++n );
-				switch ( n )
-				{
-				case 1: vertexFormat = VERTEX_FORMAT_X_32F; break;
-				case 2: vertexFormat = VERTEX_FORMAT_XY_32F; break;
-				case 3: vertexFormat = VERTEX_FORMAT_XYZ_32F; break;
-				case 4: vertexFormat = VERTEX_FORMAT_XYZW_32F; break;
-				}
-			}
-			++vertexCount;
+			++stats.frustumCullCount;
+			continue;
 		}
-		else if ( cmd == "v0i" )
+
+
+		// every normal in the cone faces away when the view direction is
+		// within 90 degrees minus the cone angle of the axis, for all of
+		// the sphere
+		if ( _isBackfaceCullEnabled && meshlet.coneCutoff < 1.0f )
 		{
-			if ( !vertexCount )
+			float view[3] = { c[0] - eye[0], c[1] - eye[1], c[2] - eye[2] };
+			float distance = std::sqrt( view[0] * view[0] + view[1] * view[1] +
+										view[2] * view[2] );
+			if ( view[0] * meshlet.coneAxis[0] +
+				 view[1] * meshlet.coneAxis[1] +
+				 view[2] * meshlet.coneAxis[2] >=
+				 meshlet.coneCutoff * distance + meshlet.radius )
 			{
-				for ( n = 0; iss >> cmd; ++n );
-				switch ( n )
-				{
+				++stats.backfaceCullCount;
+				continue;
+			}
+		}
+		const unsigned int* vertices = &meshletVertices_[meshlet.vertexFirst];
+		const unsigned char* triangles =
+			&meshletTriangles_[3 * meshlet.triangleFirst];
+		for ( unsigned int i = 0; i < 3 * meshlet.triangleCount; ++i )
+			visible.push_back( vertices[triangles[i]] );
+	}
+
+
+	// only the front of the store is written, and so uploaded
+	unsigned int count = static_cast<unsigned int>( visible.size() );
+	stats.primitivesCount = count / 3;
+	if ( !count )
+		return stats;
+	if ( _primitives->getType() == ALLOC_TYPE_16UI )
+	{
+		std::vector<unsigned short> narrow( count );
+		narrowIndices( &visible[0], &narrow[0], count );
+		_primitives->scatter( 0, 1, &narrow[0], count );
+	}
+	else
+	{
+		_primitives->scatter( 0, 1, &visible[0], count );
+	}
+	return stats;
+}
+
+
+//-- normals and tangents ------------------------------------------------------
+
+void
+MeshLoader::generateNormals( const NORMAL_WEIGHT _weight )
+{
+	// nothing to weigh
+	if ( !isLoaded_ || !primitives_.isAlloc() )
+		return;
+
+
+	// compute
+	try
+	{
+		computeNormals( _weight );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+void
+MeshLoader::generateTangents( const unsigned int _attr )
+{
+	// argument checks, the inputs cant be overwritten
+	if ( _attr >= MAX_VERTEX_ATTRIBUTES )
+		GEM_ERROR( "Attribute index out of range." );
+	if ( _attr == 0 || _attr == 2 || _attr == 8 )
+		GEM_ERROR( "Tangents cant replace positions, normals or texcoords." );
+
+
+	// nothing to weigh
+	if ( !isLoaded_ || !primitives_.isAlloc() )
+		return;
+
+
+	// compute
+	try
+	{
+		computeTangents( _attr );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+
+//-- ray queries ---------------------------------------------------------------
+
+void
+MeshLoader::buildBVH( const unsigned int _maxLeafSize )
+{
+	// argument checks
+	if ( !_maxLeafSize )
+		GEM_ERROR( "BVH leaves need at least one triangle." );
+
+
+	// nothing to build
+	if ( !isLoaded_ || !primitives_.isAlloc() )
+		return;
+
+
+	// build
+	try
+	{
+		computeBVH( _maxLeafSize );
+	}
+	catch( const std::exception& e )
+	{
+		bvhNodes_.clear();
+		bvhPrimitives_.clear();
+		bvhTriangles_.clear();
+		GEM_ERROR( e.what() );
+	}
+}
+
+bool
+MeshLoader::intersectRay( const Vec3f& _origin, const Vec3f& _direction,
+						  RAYHIT* _hit, const float _maxDistance ) const
+{
+	// nothing to hit
+	if ( !_hit )
+		return false;
+	_hit->primitive = NO_HIT;
+	_hit->distance = _maxDistance;
+	_hit->u = 0.0f;
+	_hit->v = 0.0f;
+	if ( bvhNodes_.empty() )
+		return false;
+	float origin[3] = { _origin[0], _origin[1], _origin[2] };
+	float direction[3] = { _direction[0], _direction[1], _direction[2] };
+	float invDirection[3];
+	for ( unsigned int k = 0; k < 3; ++k )
+		invDirection[k] = invertDirection( direction[k] );
+	float best = _maxDistance;
+	if ( enterBox( bvhNodes_[0].lower, bvhNodes_[0].upper, origin,
+				   invDirection, best ) > best )
+		return false;
+
+
+	// depth first, the nearer child first and the other on the stack with
+	// the distance the ray enters it at, dropped if a hit comes before that
+	unsigned int stack[BVH_STACK_SIZE];
+	float stackDistance[BVH_STACK_SIZE];
+	unsigned int size = 0;
+	unsigned int node = 0;
+	unsigned int leafTriangle = NO_HIT;
+	for ( ;; )
+	{
+		const BVHNODE& current = bvhNodes_[node];
+		if ( current.count )
+		{
+			for ( unsigned int i = current.first;
+				  i < current.first + current.count; ++i )
+			{
+				if ( hitTriangle( &bvhTriangles_[9 * i], origin, direction,
+								  &best, &_hit->u, &_hit->v ) )
+					leafTriangle = i;
+			}
+		}
+		else
+		{
+			unsigned int left = node + 1;
+			unsigned int right = current.first;
+			float leftDistance = enterBox( bvhNodes_[left].lower,
+										   bvhNodes_[left].upper, origin,
+										   invDirection, best );
+			float rightDistance = enterBox( bvhNodes_[right].lower,
+											bvhNodes_[right].upper, origin,
+											invDirection, best );
+			if ( leftDistance <= best && rightDistance <= best )
+			{
+				if ( rightDistance < leftDistance )
+				{
+					std::swap( left, right );
+					std::swap( leftDistance, rightDistance );
+				}
+				stack[size] = right;
+				stackDistance[size++] = rightDistance;
+				node = left;
+				continue;
+			}
+			if ( leftDistance <= best )
+			{
+				node = left;
+				continue;
+			}
+			if ( rightDistance <= best )
+			{
+				node = right;
+				continue;
+			}
+		}
+		while ( size && stackDistance[size - 1] > best )
+			--size;
+		if ( !size )
+			break;
+		node = stack[--size];
+	}
+
+
+	// triangle of the mesh
+	if ( leafTriangle == NO_HIT )
+		return false;
+	_hit->primitive = bvhPrimitives_[leafTriangle];
+	_hit->distance = best;
+	return true;
+}
+
+bool
+MeshLoader::intersectRayAny( const Vec3f& _origin, const Vec3f& _direction,
+							 const float _maxDistance ) const
+{
+	// nothing to hit
+	if ( bvhNodes_.empty() )
+		return false;
+	float origin[3] = { _origin[0], _origin[1], _origin[2] };
+	float direction[3] = { _direction[0], _direction[1], _direction[2] };
+	float invDirection[3];
+	for ( unsigned int k = 0; k < 3; ++k )
+		invDirection[k] = invertDirection( direction[k] );
+
+
+	// depth first in tree order, done at the first hit
+	unsigned int stack[BVH_STACK_SIZE];
+	unsigned int size = 0;
+	stack[size++] = 0;
+	while ( size )
+	{
+		unsigned int node = stack[--size];
+		const BVHNODE& current = bvhNodes_[node];
+		if ( enterBox( current.lower, current.upper, origin, invDirection,
+					   _maxDistance ) > _maxDistance )
+			continue;
+		if ( !current.count )
+		{
+			stack[size++] = current.first;
+			stack[size++] = node + 1;
+			continue;
+		}
+		for ( unsigned int i = current.first;
+			  i < current.first + current.count; ++i )
+		{
+			float t = _maxDistance;
+			float u, v;
+			if ( hitTriangle( &bvhTriangles_[9 * i], origin, direction, &t,
+							  &u, &v ) )
+				return true;
+		}
+	}
+	return false;
+}
+
+unsigned int
+MeshLoader::intersectRays( const Vec3f* _origins, const Vec3f* _directions,
+						   const unsigned int _count, RAYHIT* _hits,
+						   const float _maxDistance ) const
+{
+	// nothing to hit
+	if ( !_hits )
+		return 0;
+	if ( bvhNodes_.empty() )
+	{
+		for ( unsigned int i = 0; i < _count; ++i )
+		{
+			_hits[i].primitive = NO_HIT;
+			_hits[i].distance = _maxDistance;
+			_hits[i].u = 0.0f;
+			_hits[i].v = 0.0f;
+		}
+		return 0;
+	}
+
+
+	// packets of four rays
+	unsigned int hitCount = 0;
+	for ( unsigned int i = 0; i < _count; i += 4 )
+	{
+		unsigned int count = std::min( 4u, _count - i );
+		traceRayPacket( _origins + i, _directions + i, count, _hits + i,
+						_maxDistance );
+		for ( unsigned int j = 0; j < count; ++j )
+			hitCount += _hits[i + j].primitive != NO_HIT;
+	}
+	return hitCount;
+}
+
+bool
+MeshLoader::pick( CameraNode& _camera, const Mat4f& _modelMatrix,
+				  const Vec2f& _positionWindow, RAYHIT* _hit ) const
+{
+	// the ray from the camera through the window position on the near
+	// plane, unit length in world space so distances are in world units
+	Vec3f eye = _camera.getDerivedPosition();
+	Vec4f target = _camera.unprojectWindow2World( _positionWindow );
+	if ( target[3] != 0.0f )
+		target *= 1.0f / target[3];
+	Vec3f direction( target[0] - eye[0], target[1] - eye[1],
+					 target[2] - eye[2] );
+	direction.normalize();
+
+
+	// in model space
+	Mat4f inverse = _modelMatrix.inverse();
+	Vec4f origin = inverse * Vec4f( eye, 1.0f );
+	Vec4f along = inverse * Vec4f( direction, 0.0f );
+	return intersectRay( Vec3f( origin[0], origin[1], origin[2] ),
+						 Vec3f( along[0], along[1], along[2] ), _hit );
+}
+
+
+//-- formats -------------------------------------------------------------------
+
+void
+MeshLoader::convertVertexAttribute( const unsigned int _attr,
+									const VERTEX_FORMAT _vertexFormat )
+{
+	// argument checks
+	if ( _attr >= MAX_VERTEX_ATTRIBUTES )
+		GEM_ERROR( "Attribute index out of range." );
+	if ( _vertexFormat == VERTEX_FORMAT_NONE )
+		GEM_ERROR( "Invalid vertex format." );
+
+
+	// convert
+	try
+	{
+		convertStore( vertexAttributes_[_attr],
+					  static_cast<ALLOC_FORMAT>( _vertexFormat ) );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+void
+MeshLoader::remapTexcoords( const Vec2f& _scale, const Vec2f& _offset,
+							const unsigned int _attr )
+{
+	// argument checks
+	if ( _attr >= MAX_VERTEX_ATTRIBUTES )
+		GEM_ERROR( "Attribute index out of range." );
+
+
+	// nothing to remap
+	Allocator& store = vertexAttributes_[_attr];
+	if ( !isLoaded_ || !store.isAlloc() )
+		return;
+
+
+	// u and v of each vertex in floats, narrow again if the store was
+	try
+	{
+		const ALLOC_FORMAT format = store.getFormat();
+		convertStore( store, getWideFormat( store ) );
+		if ( store.getType() != ALLOC_TYPE_32F ||
+			 store.getDim() < ALLOC_DIM_VEC2 || store.getDim() > ALLOC_DIM_VEC4 )
+			GEM_THROW( "Texcoords missing or not enough components" );
+		const unsigned int dim = store.getDim() - ALLOC_DIM_NONE;
+		const unsigned int count = store.getElementCount();
+		float* texcoords = store.getWritePtr<float>();
+		for ( unsigned int i = 0; i < count; ++i )
+		{
+			texcoords[i*dim] = texcoords[i*dim] * _scale[0] + _offset[0];
+			texcoords[i*dim+1] = texcoords[i*dim+1] * _scale[1] + _offset[1];
+		}
+		convertStore( store, format );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+
+//-- private load and create ---------------------------------------------------
+
+void
+MeshLoader::createPrimitives( const PRIM_TYPE _primType,
+							  const unsigned int _primitivesCount,
+							  const ALLOC_MODE _allocMode )
+{
+	// pre allocation checks
+	if ( !_primitivesCount )
+		GEM_THROW( "Invalid number of primitives" + _primitivesCount );
+	if ( _primType == PRIM_TYPE_NONE )
+		GEM_THROW( "Invalid primType" + _primType );
+
+
+	// allocate storage for index array
+	primitives_.alloc( static_cast<ALLOC_FORMAT>(_primType), _primitivesCount,
+					   1, _allocMode );
+
+
+	// set member variables
+	primitivesCount_ = _primitivesCount;
+}
+
+void
+MeshLoader::createVertexAttribute( const unsigned int _attr,
+								   const VERTEX_FORMAT _vertexFormat,
+								   const unsigned int _vertexCount,
+								   const ALLOC_MODE _allocMode )
+{
+	// pre allocation checks
+	if ( !_vertexCount )
+		GEM_THROW( "Invalid number of vertices" + _vertexCount );
+	if ( _vertexFormat == VERTEX_FORMAT_NONE )
+		GEM_THROW( "Invalid vertexType" + _vertexFormat );
+	if ( _attr >= MAX_VERTEX_ATTRIBUTES )
+		GEM_THROW( "Attribute index out of range" + _attr );
+
+
+	// allocate storage for vertex array
+	vertexAttributes_[_attr].alloc( static_cast<ALLOC_FORMAT>(_vertexFormat),
+									_vertexCount, 1, _allocMode );
+
+
+	// set member variables
+	vertexCount_ = _vertexCount;
+}
+
+
+//-- private optimize ----------------------------------------------------------
+
+void
+MeshLoader::optimizeMesh( const bool _isOverdrawEnabled,
+						  const float _overdrawThreshold )
+{
+	// 32 bit indices while working on them, meshlets and the bvh dont
+	// survive this
+	bool isNarrow = widenPrimitives();
+	meshlets_.clear();
+	meshletVertices_.clear();
+	meshletTriangles_.clear();
+	bvhNodes_.clear();
+	bvhPrimitives_.clear();
+	bvhTriangles_.clear();
+
+
+	// every index has to name a vertex of every store before anything moves
+	unsigned int count = primitives_.getElementCount() * primitives_.getDim();
+	const unsigned int* indices = primitives_.getReadPtr<unsigned int>();
+	for ( unsigned int i = 0; i < count; ++i )
+	{
+		if ( indices[i] >= vertexCount_ )
+			GEM_THROW( "Primitive index out of range" );
+	}
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( vertexAttributes_[i].isAlloc() &&
+			 vertexAttributes_[i].getElementCount() != vertexCount_ )
+			GEM_THROW( "Vertex attributes differ in size" );
+	}
+
+
+	// triangles first, as the vertex order follows from theirs, one level of
+	// detail at a time so they stay apart
+	CACHESTATS before = getCacheStats();
+	if ( getPrimitivesType() == PRIM_TYPE_TRIANGLE )
+	{
+		for ( unsigned int i = 0; i < getLODCount(); ++i )
+		{
+			LODLEVEL lod = getLOD( i );
+			optimizeVertexCache( lod.primitivesFirst, lod.primitivesCount );
+			if ( _isOverdrawEnabled )
+				optimizeOverdraw( lod.primitivesFirst, lod.primitivesCount,
+								  _overdrawThreshold );
+		}
+	}
+	optimizeVertexFetch();
+	if ( isNarrow )
+		narrowPrimitives();
+	CACHESTATS after = getCacheStats();
+
+
+	// report the gain
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 3 )
+	   << "Optimized mesh for a cache of " << after.cacheSize
+	   << ", ACMR " << before.acmr << " -> " << after.acmr
+	   << ", ATVR " << before.atvr << " -> " << after.atvr;
+	GEM_CONSOLE( ss.str() );
+}
+
+void
+MeshLoader::optimizeVertexCache( const unsigned int _first,
+								 const unsigned int _count )
+{
+	// Tom Forsyth, Linear-Speed Vertex Cache Optimisation, 2006. Triangles
+	// are emitted greedily by score, the score of a triangle being the sum
+	// of its vertices, which score by their position in a modelled LRU cache
+	// and by how few triangles they have left
+	unsigned int triangleCount = _count;
+	unsigned int vertexCount = vertexCount_;
+	const unsigned int* indices = primitives_.getReadPtr<unsigned int>() +
+								  3 * _first;
+	if ( !triangleCount )
+		return;
+
+
+	// triangles of each vertex in compressed rows, the live ones first
+	std::vector<unsigned int> offsets( vertexCount + 1, 0 );
+	for ( unsigned int i = 0; i < 3 * triangleCount; ++i )
+		++offsets[indices[i] + 1];
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> triangles( 3 * triangleCount );
+	std::vector<unsigned int> liveCount( vertexCount, 0 );
+	for ( unsigned int t = 0; t < triangleCount; ++t )
+	{
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			unsigned int v = indices[3 * t + k];
+			triangles[offsets[v] + liveCount[v]++] = t;
+		}
+	}
+
+
+	// score tables for cache positions and live triangle counts
+	const unsigned int cacheSize = MESH_CACHE_SIZE;
+	const unsigned int valenceMax = 32;
+	float cacheScores[MESH_CACHE_SIZE];
+	float valenceScores[valenceMax];
+	for ( unsigned int i = 0; i < cacheSize; ++i )
+	{
+		cacheScores[i] = i < 3 ? 0.75f : std::pow( 1.0f -
+			static_cast<float>( i - 3 ) / ( cacheSize - 3 ), 1.5f );
+	}
+	valenceScores[0] = -1.0f;
+	for ( unsigned int i = 1; i < valenceMax; ++i )
+		valenceScores[i] = 2.0f / std::sqrt( static_cast<float>( i ) );
+	std::vector<int> cachePos( vertexCount, -1 );
+	std::vector<float> vertexScores( vertexCount );
+	auto getScore = [&]( const unsigned int v ) -> float
+	{
+		unsigned int live = liveCount[v];
+		if ( !live )
+			return -1.0f;
+		float score = live < valenceMax ? valenceScores[live] :
+						  2.0f / std::sqrt( static_cast<float>( live ) );
+		return cachePos[v] < 0 ? score : score + cacheScores[cachePos[v]];
+	};
+
+
+	// initial scores, and the best triangle to start with
+	std::vector<float> triangleScores( triangleCount, 0.0f );
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+		vertexScores[v] = getScore( v );
+	unsigned int best = 0;
+	for ( unsigned int t = 0; t < triangleCount; ++t )
+	{
+		for ( unsigned int k = 0; k < 3; ++k )
+			triangleScores[t] += vertexScores[indices[3 * t + k]];
+		if ( triangleScores[t] > triangleScores[best] )
+			best = t;
+	}
+
+
+	// emit one triangle at a time
+	std::vector<unsigned int> optimized;
+	optimized.reserve( 3 * triangleCount );
+	std::vector<char> isEmitted( triangleCount, 0 );
+	unsigned int cache[MESH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int cursor = 0;
+	for ( unsigned int n = 0; n < triangleCount; ++n )
+	{
+		// at a dead end, take the next triangle in file order
+		if ( best == ~0u )
+		{
+			while ( isEmitted[cursor] )
+				++cursor;
+			best = cursor;
+		}
+		const unsigned int* triangle = &indices[3 * best];
+		isEmitted[best] = 1;
+		optimized.insert( optimized.end(), triangle, triangle + 3 );
+
+
+		// take the triangle out of the live rows of its vertices
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			unsigned int v = triangle[k];
+			unsigned int* row = &triangles[offsets[v]];
+			unsigned int last = --liveCount[v];
+			*std::find( row, row + last, best ) = row[last];
+			row[last] = best;
+		}
+
+
+		// vertices of the triangle go to the front of the cache, the ones
+		// falling out the back lose their cache score
+		unsigned int next[MESH_CACHE_SIZE + 3];
+		unsigned int nextCount = 0;
+		for ( unsigned int k = 0; k < 3; ++k )
+			next[nextCount++] = triangle[k];
+		for ( unsigned int i = 0; i < cacheCount; ++i )
+		{
+			unsigned int v = cache[i];
+			if ( v != triangle[0] && v != triangle[1] && v != triangle[2] )
+				next[nextCount++] = v;
+		}
+		for ( unsigned int i = 0; i < nextCount; ++i )
+			cachePos[next[i]] = i < cacheSize ? static_cast<int>( i ) : -1;
+
+
+		// rescore the touched vertices and their live triangles
+		for ( unsigned int i = 0; i < nextCount; ++i )
+		{
+			unsigned int v = next[i];
+			float score = getScore( v );
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			const unsigned int* row = &triangles[offsets[v]];
+			for ( unsigned int j = 0; j < liveCount[v]; ++j )
+				triangleScores[row[j]] += delta;
+		}
+		cacheCount = std::min( nextCount, cacheSize );
+		std::copy( next, next + cacheCount, cache );
+
+
+		// the next triangle is the best one with a vertex in the cache
+		best = ~0u;
+		float bestScore = -1.0f;
+		for ( unsigned int i = 0; i < cacheCount; ++i )
+		{
+			unsigned int v = cache[i];
+			const unsigned int* row = &triangles[offsets[v]];
+			for ( unsigned int j = 0; j < liveCount[v]; ++j )
+			{
+				if ( triangleScores[row[j]] > bestScore )
+				{
+					bestScore = triangleScores[row[j]];
+					best = row[j];
+				}
+			}
+		}
+	}
+	std::copy( optimized.begin(), optimized.end(),
+			   primitives_.getWritePtr<unsigned int>() + 3 * _first );
+}
+
+void
+MeshLoader::optimizeOverdraw( const unsigned int _first,
+							  const unsigned int _count,
+							  const float _threshold )
+{
+	// Sander, Nehab and Barczak, Fast Triangle Reordering for Vertex
+	// Locality and Reduced Overdraw, 2007. The cache ordered triangles are
+	// cut into clusters, which are then drawn in order of how far out of the
+	// mesh they face, so triangles on the outside tend to occlude the ones
+	// behind them from any view
+	Allocator& positions = vertexAttributes_[0];
+	if ( !positions.isAlloc() || positions.getType() != ALLOC_TYPE_32F ||
+		 positions.getDim() < 3 )
+		return;
+	unsigned int triangleCount = _count;
+	const unsigned int* indices = primitives_.getReadPtr<unsigned int>() +
+								  3 * _first;
+	if ( !triangleCount )
+		return;
+
+
+	// hard boundaries, where the cache order starts over and all three
+	// vertices of a triangle miss
+	const unsigned int cacheSize = MESH_CACHE_SIZE;
+	std::vector<unsigned int> stamps( vertexCount_, 0 );
+	unsigned int time = cacheSize + 1;
+	std::vector<unsigned int> hard;
+	for ( unsigned int t = 0; t < triangleCount; ++t )
+	{
+		if ( simulateCache( &indices[3 * t], 3, cacheSize, stamps,
+							&time ) == 3 || !t )
+			hard.push_back( t );
+	}
+	hard.push_back( triangleCount );
+
+
+	// soft boundaries, inside a hard cluster wherever the misses so far are
+	// within the threshold of the whole cluster, and the cache restarts
+	std::vector<unsigned int> clusters;
+	for ( unsigned int c = 0; c + 1 < hard.size(); ++c )
+	{
+		unsigned int first = hard[c];
+		unsigned int last = hard[c + 1];
+		time += cacheSize + 1;
+		float threshold = _threshold * simulateCache( &indices[3 * first],
+			3 * ( last - first ), cacheSize, stamps, &time ) /
+			( last - first );
+		time += cacheSize + 1;
+		clusters.push_back( first );
+		unsigned int missCount = 0;
+		for ( unsigned int t = first; t + 1 < last; ++t )
+		{
+			missCount += simulateCache( &indices[3 * t], 3, cacheSize, stamps,
+										&time );
+			if ( missCount <= threshold * ( t + 1 - clusters.back() ) )
+			{
+				clusters.push_back( t + 1 );
+				missCount = 0;
+				time += cacheSize + 1;
+			}
+		}
+	}
+	clusters.push_back( triangleCount );
+
+
+	// mesh centroid
+	const float* position = positions.getReadPtr<float>();
+	unsigned int dim = positions.getDim();
+	double center[3] = { 0.0, 0.0, 0.0 };
+	for ( unsigned int v = 0; v < vertexCount_; ++v )
+	{
+		for ( unsigned int k = 0; k < 3; ++k )
+			center[k] += position[v * dim + k];
+	}
+	for ( unsigned int k = 0; k < 3; ++k )
+		center[k] /= vertexCount_;
+
+
+	// area weighted centroid and normal of each cluster, sorted by how far
+	// the cluster is out of the mesh along its normal
+	unsigned int clusterCount = static_cast<unsigned int>( clusters.size() ) - 1;
+	std::vector< std::pair<float, unsigned int> > keys( clusterCount );
+	for ( unsigned int c = 0; c < clusterCount; ++c )
+	{
+		double centroid[3] = { 0.0, 0.0, 0.0 };
+		double normal[3] = { 0.0, 0.0, 0.0 };
+		double area = 0.0;
+		for ( unsigned int t = clusters[c]; t < clusters[c + 1]; ++t )
+		{
+			const float* p0 = &position[indices[3 * t] * dim];
+			const float* p1 = &position[indices[3 * t + 1] * dim];
+			const float* p2 = &position[indices[3 * t + 2] * dim];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+						   e1[2] * e2[0] - e1[0] * e2[2],
+						   e1[0] * e2[1] - e1[1] * e2[0] };
+			double w = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				centroid[k] += ( p0[k] + p1[k] + p2[k] ) * w / 3.0;
+				normal[k] += n[k];
+			}
+			area += w;
+		}
+		double length = std::sqrt( normal[0] * normal[0] +
+								   normal[1] * normal[1] +
+								   normal[2] * normal[2] );
+		float key = 0.0f;
+		for ( unsigned int k = 0; k < 3 && area > 0.0 && length > 0.0; ++k )
+			key += static_cast<float>( ( centroid[k] / area - center[k] ) *
+									   normal[k] / length );
+		keys[c] = std::make_pair( -key, c );
+	}
+	std::stable_sort( keys.begin(), keys.end() );
+
+
+	// emit clusters in sorted order
+	std::vector<unsigned int> optimized;
+	optimized.reserve( 3 * triangleCount );
+	for ( unsigned int i = 0; i < clusterCount; ++i )
+	{
+		unsigned int c = keys[i].second;
+		optimized.insert( optimized.end(), &indices[3 * clusters[c]],
+						  &indices[0] + 3 * clusters[c + 1] );
+	}
+	std::copy( optimized.begin(), optimized.end(),
+			   primitives_.getWritePtr<unsigned int>() + 3 * _first );
+}
+
+void
+MeshLoader::optimizeVertexFetch()
+{
+	// vertices in the order the primitives first use them, unused ones last
+	unsigned int count = primitives_.getElementCount() * primitives_.getDim();
+	const unsigned int* indices = primitives_.getReadPtr<unsigned int>();
+	std::vector<unsigned int> remap( vertexCount_, ~0u );
+	std::vector<unsigned int> sources;
+	sources.reserve( vertexCount_ );
+	for ( unsigned int i = 0; i < count; ++i )
+	{
+		unsigned int v = indices[i];
+		if ( remap[v] == ~0u )
+		{
+			remap[v] = static_cast<unsigned int>( sources.size() );
+			sources.push_back( v );
+		}
+	}
+	for ( unsigned int v = 0; v < vertexCount_; ++v )
+	{
+		if ( remap[v] == ~0u )
+		{
+			remap[v] = static_cast<unsigned int>( sources.size() );
+			sources.push_back( v );
+		}
+	}
+	bool isIdentity = true;
+	for ( unsigned int v = 0; v < vertexCount_ && isIdentity; ++v )
+		isIdentity = remap[v] == v;
+	if ( isIdentity )
+		return;
+
+
+	// gather the stores and remap primitives (throws)
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( vertexAttributes_[i].isAlloc() )
+			gatherVertexAttribute( i, &sources[0], 1, vertexCount_ );
+	}
+	unsigned int* primitives = primitives_.getWritePtr<unsigned int>();
+	for ( unsigned int i = 0; i < count; ++i )
+		primitives[i] = remap[primitives[i]];
+}
+
+unsigned int
+MeshLoader::simulateCache( const unsigned int* _indices,
+						   const unsigned int _count,
+						   const unsigned int _cacheSize,
+						   std::vector<unsigned int>& _stamps,
+						   unsigned int* _time )
+{
+	// FIFO cache, a vertex is in it if fewer than _cacheSize vertices have
+	// been transformed since it was, indices without a stamp always miss.
+	// Moving the time on by more than _cacheSize empties the cache
+	unsigned int stampCount = static_cast<unsigned int>( _stamps.size() );
+	unsigned int missCount = 0;
+	for ( unsigned int i = 0; i < _count; ++i )
+	{
+		unsigned int v = _indices[i];
+		if ( v < stampCount && *_time - _stamps[v] <= _cacheSize )
+			continue;
+		if ( v < stampCount )
+			_stamps[v] = *_time;
+		++*_time;
+		++missCount;
+	}
+	return missCount;
+}
+
+
+//-- private levels of detail --------------------------------------------------
+
+void
+MeshLoader::simplifyMesh( const unsigned int _levelCount,
+						  const float _reduction )
+{
+	// Garland and Heckbert, Surface Simplification Using Quadric Error
+	// Metrics, 1997. Edges are collapsed cheapest first, the cost of moving
+	// a vertex being the sum of squared distances to the planes of the
+	// triangles merged into it so far. Collapses are half edge, the vertex
+	// moves onto its neighbour rather than to a new position, so every level
+	// indexes the vertices of level 0 as they are
+	dropLODs();
+	meshlets_.clear();
+	meshletVertices_.clear();
+	meshletTriangles_.clear();
+	bvhNodes_.clear();
+	bvhPrimitives_.clear();
+	bvhTriangles_.clear();
+	bool isNarrow = widenPrimitives();
+	if ( getPrimitivesType() != PRIM_TYPE_TRIANGLE )
+		GEM_THROW( "Only triangle meshes can be simplified" );
+	unsigned int vertexCount = vertexCount_;
+	unsigned int count = primitives_.getElementCount() * primitives_.getDim();
+	const unsigned int* src = primitives_.getReadPtr<unsigned int>();
+	for ( unsigned int i = 0; i < count; ++i )
+	{
+		if ( src[i] >= vertexCount )
+			GEM_THROW( "Primitive index out of range" );
+	}
+	std::vector<unsigned int> indices( src, src + count );
+
+
+	// positions, normals and texcoords as floats, narrow stores decoded on a
+	// copy-on-write share
+	const unsigned int slots[3] = { 0, 2, 8 };
+	Allocator stores[3];
+	const float* data[3] = { NULL, NULL, NULL };
+	unsigned int dims[3] = { 0, 0, 0 };
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		Allocator& store = vertexAttributes_[slots[k]];
+		if ( !store.isAlloc() )
+			continue;
+		if ( store.getElementCount() != vertexCount )
+			GEM_THROW( "Vertex attributes differ in size" );
+		stores[k].share( store );
+		convertStore( stores[k], getWideFormat( stores[k] ) );
+		if ( stores[k].getType() != ALLOC_TYPE_32F )
+			continue;
+		data[k] = stores[k].getReadPtr<float>();
+		dims[k] = stores[k].getDim();
+	}
+	if ( !data[0] || dims[0] < 3 )
+		GEM_THROW( "Simplification needs xyz float positions" );
+	const float* positions = data[0];
+	const unsigned int dim = dims[0];
+
+
+	// plane quadric of each triangle summed on its vertices, as the upper
+	// triangle of the symmetric 4x4 matrix
+	std::vector<double> quadrics( 10 * vertexCount, 0.0 );
+	for ( unsigned int t = 0; t < count / 3; ++t )
+	{
+		const float* p0 = &positions[indices[3 * t] * dim];
+		const float* p1 = &positions[indices[3 * t + 1] * dim];
+		const float* p2 = &positions[indices[3 * t + 2] * dim];
+		double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		double n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+						e1[2] * e2[0] - e1[0] * e2[2],
+						e1[0] * e2[1] - e1[1] * e2[0] };
+		double length = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+		if ( length == 0.0 )
+			continue;
+		double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+		double d = -( a * p0[0] + b * p0[1] + c * p0[2] );
+		double plane[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d,
+							 c * c, c * d, d * d };
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			double* q = &quadrics[10 * indices[3 * t + k]];
+			for ( unsigned int j = 0; j < 10; ++j )
+				q[j] += plane[j];
+		}
+	}
+	auto getError = [&]( const unsigned int _from, const unsigned int _to )
+		-> double
+	{
+		const double* q = &quadrics[10 * _from];
+		const float* p = &positions[_to * dim];
+		double x = p[0], y = p[1], z = p[2];
+		return std::max( q[0] * x * x + 2.0 * q[1] * x * y +
+						 2.0 * q[2] * x * z + 2.0 * q[3] * x +
+						 q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y +
+						 q[7] * z * z + 2.0 * q[8] * z + q[9], 0.0 );
+	};
+
+
+	// the vertex also takes the normal and texcoord of its neighbour, which
+	// costs the squared change times the squared length of the edge
+	auto getCost = [&]( const unsigned int _from, const unsigned int _to )
+		-> double
+	{
+		double length = 0.0;
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			double e = positions[_to * dim + k] - positions[_from * dim + k];
+			length += e * e;
+		}
+		double change = 0.0;
+		for ( unsigned int k = 1; k < 3; ++k )
+		{
+			for ( unsigned int j = 0; data[k] && j < dims[k]; ++j )
+			{
+				double e = data[k][_to * dims[k] + j] -
+						   data[k][_from * dims[k] + j];
+				change += e * e;
+			}
+		}
+		return getError( _from, _to ) + length * change;
+	};
+
+
+	// vertices on open or non-manifold edges are locked, which are borders
+	// and seams where a position has a vertex per normal or texcoord
+	std::unordered_map<unsigned long long, unsigned int> edges;
+	edges.reserve( count );
+	for ( unsigned int i = 0; i < count; ++i )
+	{
+		unsigned long long a = indices[i];
+		unsigned long long b = indices[i % 3 == 2 ? i - 2 : i + 1];
+		++edges[a < b ? ( a << 32 ) | b : ( b << 32 ) | a];
+	}
+	std::vector<char> isLocked( vertexCount, 0 );
+	for ( auto it = edges.begin(); it != edges.end(); ++it )
+	{
+		if ( it->second != 2 )
+		{
+			isLocked[static_cast<unsigned int>( it->first >> 32 )] = 1;
+			isLocked[static_cast<unsigned int>( it->first )] = 1;
+		}
+	}
+
+
+	// a collapse has to keep the surface manifold, its edge bordering two
+	// triangles and the ends sharing no other neighbour, and must not turn
+	// a triangle over
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> triangles;
+	std::vector<unsigned int> cursors;
+	std::vector<unsigned int> ringFrom, ringTo;
+	auto getRing = [&]( const unsigned int _v,
+						std::vector<unsigned int>& _ring )
+	{
+		_ring.clear();
+		for ( unsigned int j = offsets[_v]; j < offsets[_v + 1]; ++j )
+		{
+			const unsigned int* triangle = &indices[3 * triangles[j]];
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				if ( triangle[k] != _v )
+					_ring.push_back( triangle[k] );
+			}
+		}
+		std::sort( _ring.begin(), _ring.end() );
+		_ring.erase( std::unique( _ring.begin(), _ring.end() ), _ring.end() );
+	};
+	auto isCollapseValid = [&]( const unsigned int _from,
+								const unsigned int _to ) -> bool
+	{
+		getRing( _from, ringFrom );
+		getRing( _to, ringTo );
+		unsigned int sharedCount = 0;
+		for ( unsigned int i = 0, j = 0; i < ringFrom.size() &&
+										 j < ringTo.size(); )
+		{
+			if ( ringFrom[i] < ringTo[j] )
+				++i;
+			else if ( ringTo[j] < ringFrom[i] )
+				++j;
+			else
+				++sharedCount, ++i, ++j;
+		}
+		if ( sharedCount != 2 )
+			return false;
+		const float* target = &positions[_to * dim];
+		unsigned int edgeCount = 0;
+		for ( unsigned int j = offsets[_from]; j < offsets[_from + 1]; ++j )
+		{
+			const unsigned int* triangle = &indices[3 * triangles[j]];
+			if ( triangle[0] == _to || triangle[1] == _to ||
+				 triangle[2] == _to )
+			{
+				++edgeCount;
+				continue;
+			}
+			const float* p[3];
+			const float* q[3];
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				p[k] = &positions[triangle[k] * dim];
+				q[k] = triangle[k] == _from ? target : p[k];
+			}
+			float n0[3], n1[3];
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				unsigned int k1 = ( k + 1 ) % 3, k2 = ( k + 2 ) % 3;
+				n0[k] = ( p[1][k1] - p[0][k1] ) * ( p[2][k2] - p[0][k2] ) -
+						( p[1][k2] - p[0][k2] ) * ( p[2][k1] - p[0][k1] );
+				n1[k] = ( q[1][k1] - q[0][k1] ) * ( q[2][k2] - q[0][k2] ) -
+						( q[1][k2] - q[0][k2] ) * ( q[2][k1] - q[0][k1] );
+			}
+			float dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+			float length0 = n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2];
+			float length1 = n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2];
+			if ( dot <= 0.25f * std::sqrt( length0 * length1 ) )
+				return false;
+		}
+		return edgeCount == 2;
+	};
+
+
+	// each level collapses the one before in passes, a pass collapsing the
+	// cheapest edges that dont touch each other
+	std::vector<unsigned int> levels( indices );
+	lods_.resize( 1 );
+	lods_[0].primitivesFirst = 0;
+	lods_[0].primitivesCount = count / 3;
+	lods_[0].error = 0.0f;
+	std::vector<unsigned int> targets( vertexCount );
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+		targets[v] = v;
+	float error = 0.0f;
+	std::vector< std::pair<double, unsigned long long> > collapses;
+	const double locked = std::numeric_limits<double>::max();
+	std::vector<char> isTouched;
+	for ( unsigned int level = 1; level < _levelCount; ++level )
+	{
+		unsigned int triangleCount = lods_.back().primitivesCount;
+		unsigned int target = static_cast<unsigned int>( triangleCount *
+														 _reduction );
+		while ( triangleCount > target )
+		{
+			// triangles of each vertex in compressed rows
+			unsigned int indexCount = 3 * triangleCount;
+			offsets.assign( vertexCount + 1, 0 );
+			for ( unsigned int i = 0; i < indexCount; ++i )
+				++offsets[indices[i] + 1];
+			for ( unsigned int v = 0; v < vertexCount; ++v )
+				offsets[v + 1] += offsets[v];
+			triangles.resize( indexCount );
+			cursors.assign( offsets.begin(), offsets.end() - 1 );
+			for ( unsigned int i = 0; i < indexCount; ++i )
+				triangles[cursors[indices[i]]++] = i / 3;
+
+
+			// the cheaper direction of every edge, interior edges are met
+			// once in each direction so only take the upward one
+			collapses.clear();
+			for ( unsigned int i = 0; i < indexCount; ++i )
+			{
+				unsigned int a = indices[i];
+				unsigned int b = indices[i % 3 == 2 ? i - 2 : i + 1];
+				if ( a > b || ( isLocked[a] && isLocked[b] ) )
+					continue;
+				double costA = isLocked[a] ? locked : getCost( a, b );
+				double costB = isLocked[b] ? locked : getCost( b, a );
+				unsigned long long from = costA <= costB ? a : b;
+				unsigned long long to = costA <= costB ? b : a;
+				collapses.push_back( std::make_pair( std::min( costA, costB ),
+													 ( from << 32 ) | to ) );
+			}
+			std::sort( collapses.begin(), collapses.end() );
+
+
+			// collapse, triangles on the edge are left with three equal
+			// indices to be removed below
+			isTouched.assign( vertexCount, 0 );
+			unsigned int collapseCount = 0;
+			for ( unsigned int c = 0; c < collapses.size() &&
+									  triangleCount > target; ++c )
+			{
+				unsigned int from = static_cast<unsigned int>(
+					collapses[c].second >> 32 );
+				unsigned int to = static_cast<unsigned int>(
+					collapses[c].second );
+				if ( isTouched[from] || isTouched[to] ||
+					 !isCollapseValid( from, to ) )
+					continue;
+				targets[from] = to;
+				for ( unsigned int j = offsets[from]; j < offsets[from + 1];
+					  ++j )
+				{
+					unsigned int* triangle = &indices[3 * triangles[j]];
+					bool isEdge = triangle[0] == to || triangle[1] == to ||
+								  triangle[2] == to;
+					for ( unsigned int k = 0; k < 3; ++k )
+					{
+						isTouched[triangle[k]] = 1;
+						if ( isEdge || triangle[k] == from )
+							triangle[k] = to;
+					}
+					triangleCount -= isEdge ? 1 : 0;
+				}
+				for ( unsigned int j = 0; j < 10; ++j )
+					quadrics[10 * to + j] += quadrics[10 * from + j];
+				++collapseCount;
+			}
+			unsigned int kept = 0;
+			for ( unsigned int t = 0; t < indexCount / 3; ++t )
+			{
+				const unsigned int* triangle = &indices[3 * t];
+				if ( triangle[0] == triangle[1] && triangle[1] == triangle[2] )
+					continue;
+				std::copy( triangle, triangle + 3, &indices[3 * kept++] );
+			}
+			indices.resize( 3 * kept );
+			if ( !collapseCount )
+				break;
+		}
+
+
+		// stop when too much is locked for the chain to get any coarser
+		if ( triangleCount > lods_.back().primitivesCount * 0.95f )
+			break;
+
+
+		// measured error, the largest distance from a collapsed vertex to the
+		// triangles around the vertex it ended up on, never less than the
+		// level before so selection can go by it
+		unsigned int indexCount = 3 * triangleCount;
+		offsets.assign( vertexCount + 1, 0 );
+		for ( unsigned int i = 0; i < indexCount; ++i )
+			++offsets[indices[i] + 1];
+		for ( unsigned int v = 0; v < vertexCount; ++v )
+			offsets[v + 1] += offsets[v];
+		triangles.resize( indexCount );
+		cursors.assign( offsets.begin(), offsets.end() - 1 );
+		for ( unsigned int i = 0; i < indexCount; ++i )
+			triangles[cursors[indices[i]]++] = i / 3;
+		for ( unsigned int v = 0; v < vertexCount; ++v )
+		{
+			unsigned int to = targets[v];
+			if ( to == v )
+				continue;
+			while ( targets[to] != to )
+				to = targets[to];
+			targets[v] = to;
+			float distance = std::numeric_limits<float>::max();
+			for ( unsigned int j = offsets[to]; j < offsets[to + 1]; ++j )
+			{
+				const unsigned int* triangle = &indices[3 * triangles[j]];
+				distance = std::min( distance, getTriangleDistance(
+					&positions[v * dim], &positions[triangle[0] * dim],
+					&positions[triangle[1] * dim],
+					&positions[triangle[2] * dim] ) );
+			}
+			if ( offsets[to] < offsets[to + 1] )
+				error = std::max( error, distance );
+		}
+		LODLEVEL lod;
+		lod.primitivesFirst = static_cast<unsigned int>( levels.size() / 3 );
+		lod.primitivesCount = triangleCount;
+		lod.error = error;
+		lods_.push_back( lod );
+		levels.insert( levels.end(), indices.begin(), indices.end() );
+	}
+
+
+	// all levels in one store, the new ones ordered for the vertex cache
+	primitives_.alloc( ALLOC_FORMAT_VEC3_32UI,
+					   static_cast<unsigned int>( levels.size() / 3 ), 1,
+					   ALLOC_MODE_NOINIT );
+	std::copy( levels.begin(), levels.end(),
+			   primitives_.getWritePtr<unsigned int>() );
+	primitivesCount_ = lods_[0].primitivesCount;
+	for ( unsigned int i = 1; i < lods_.size(); ++i )
+		optimizeVertexCache( lods_[i].primitivesFirst,
+							 lods_[i].primitivesCount );
+	if ( isNarrow )
+		narrowPrimitives();
+
+
+	// distance from the origin the error is projected at
+	lodRadius_ = 0.0f;
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+	{
+		const float* p = &positions[v * dim];
+		lodRadius_ = std::max( lodRadius_, p[0] * p[0] + p[1] * p[1] +
+										   p[2] * p[2] );
+	}
+	lodRadius_ = std::sqrt( lodRadius_ );
+
+
+	// report the chain
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 4 )
+	   << "Generated " << lods_.size() << " levels of detail,";
+	for ( unsigned int i = 0; i < lods_.size(); ++i )
+		ss << " " << lods_[i].primitivesCount << " (" << lods_[i].error
+		   << ")";
+	GEM_CONSOLE( ss.str() );
+}
+
+void
+MeshLoader::dropLODs()
+{
+	// level 0 comes first, so it is what is left of the store
+	if ( lods_.empty() )
+		return;
+	unsigned int count = lods_[0].primitivesCount;
+	lods_.clear();
+	if ( count == primitives_.getElementCount() )
+		return;
+	Allocator level;
+	level.setTag( ALLOC_TAG_MESH );
+	level.alloc( primitives_.getFormat(), count, 1, ALLOC_MODE_NOINIT );
+	const char* src = primitives_.getReadPtr<char>();
+	std::copy( src, src + level.getByteCount(), level.getWritePtr<char>() );
+#ifdef GEM_HAS_RVALUE_REFS
+	primitives_ = std::move( level );
+#else
+	primitives_ = level;
+#endif
+	primitivesCount_ = count;
+}
+
+float
+MeshLoader::getTriangleDistance( const float* _p, const float* _a,
+								 const float* _b, const float* _c )
+{
+	// closest point by the Voronoi region of _p, after Christer Ericson,
+	// Real-Time Collision Detection, 2005
+	double ab[3], ac[3], ap[3], bp[3], cp[3];
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		ab[k] = _b[k] - _a[k];
+		ac[k] = _c[k] - _a[k];
+		ap[k] = _p[k] - _a[k];
+		bp[k] = _p[k] - _b[k];
+		cp[k] = _p[k] - _c[k];
+	}
+	auto dot = []( const double* _u, const double* _v ) -> double
+	{ return _u[0] * _v[0] + _u[1] * _v[1] + _u[2] * _v[2]; };
+	double d1 = dot( ab, ap ), d2 = dot( ac, ap );
+	double d3 = dot( ab, bp ), d4 = dot( ac, bp );
+	double d5 = dot( ab, cp ), d6 = dot( ac, cp );
+	double va = d3 * d6 - d5 * d4;
+	double vb = d5 * d2 - d1 * d6;
+	double vc = d1 * d4 - d3 * d2;
+	double v = 0.0, w = 0.0;
+	if ( d1 <= 0.0 && d2 <= 0.0 )
+	{
+	}
+	else if ( d3 >= 0.0 && d4 <= d3 )
+	{
+		v = 1.0;
+	}
+	else if ( d6 >= 0.0 && d5 <= d6 )
+	{
+		w = 1.0;
+	}
+	else if ( vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 )
+	{
+		v = d1 / ( d1 - d3 );
+	}
+	else if ( vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 )
+	{
+		w = d2 / ( d2 - d6 );
+	}
+	else if ( va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0 )
+	{
+		w = ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) );
+		v = 1.0 - w;
+	}
+	else
+	{
+		v = vb / ( va + vb + vc );
+		w = vc / ( va + vb + vc );
+	}
+	double distance = 0.0;
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		double e = ap[k] - v * ab[k] - w * ac[k];
+		distance += e * e;
+	}
+	return static_cast<float>( std::sqrt( distance ) );
+}
+
+
+//-- private meshlets ----------------------------------------------------------
+
+void
+MeshLoader::partitionMeshlets( const unsigned int _maxVertices,
+							   const unsigned int _maxTriangles )
+{
+	// level 0 triangles as 32 bit indices
+	meshlets_.clear();
+	meshletVertices_.clear();
+	meshletTriangles_.clear();
+	if ( primitives_.getDim() != 3 )
+		GEM_THROW( "Only triangle meshes have meshlets" );
+	unsigned int triangleCount = getLOD( 0 ).primitivesCount;
+	unsigned int vertexCount = vertexCount_;
+	std::vector<unsigned int> indices( 3 * triangleCount );
+	if ( primitives_.getType() == ALLOC_TYPE_16UI )
+	{
+		const unsigned short* src = primitives_.getReadPtr<unsigned short>();
+		std::copy( src, src + indices.size(), indices.begin() );
+	}
+	else
+	{
+		const unsigned int* src = primitives_.getReadPtr<unsigned int>();
+		std::copy( src, src + indices.size(), indices.begin() );
+	}
+	for ( unsigned int i = 0; i < indices.size(); ++i )
+	{
+		if ( indices[i] >= vertexCount )
+			GEM_THROW( "Primitive index out of range" );
+	}
+	if ( !triangleCount )
+		return;
+
+
+	// positions as floats, narrow stores decoded on a copy-on-write share
+	Allocator store;
+	store.share( vertexAttributes_[0] );
+	convertStore( store, getWideFormat( store ) );
+	if ( !store.isAlloc() || store.getType() != ALLOC_TYPE_32F ||
+		 store.getDim() < 3 || store.getElementCount() != vertexCount )
+		GEM_THROW( "Meshlets need xyz float positions" );
+	const float* positions = store.getReadPtr<float>();
+	const unsigned int dim = store.getDim();
+
+
+	// unit normal and centroid of each triangle, and the bounds of the
+	// centroids for their Morton codes
+	std::vector<float> normals( 3 * triangleCount );
+	std::vector<float> centroids( 3 * triangleCount );
+	const float huge = std::numeric_limits<float>::max();
+	float lower[3] = { huge, huge, huge };
+	float upper[3] = { -huge, -huge, -huge };
+	for ( unsigned int t = 0; t < triangleCount; ++t )
+	{
+		const float* p0 = &positions[indices[3 * t] * dim];
+		const float* p1 = &positions[indices[3 * t + 1] * dim];
+		const float* p2 = &positions[indices[3 * t + 2] * dim];
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float* n = &normals[3 * t];
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		float length = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			n[k] = length > 0.0f ? n[k] / length : 0.0f;
+			centroids[3 * t + k] = ( p0[k] + p1[k] + p2[k] ) / 3.0f;
+			lower[k] = std::min( lower[k], centroids[3 * t + k] );
+			upper[k] = std::max( upper[k], centroids[3 * t + k] );
+		}
+	}
+
+
+	// triangles in Morton order, 10 bits per axis interleaved
+	std::vector< std::pair<unsigned int, unsigned int> > order( triangleCount );
+	for ( unsigned int t = 0; t < triangleCount; ++t )
+	{
+		unsigned int code = 0;
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			float extent = upper[k] - lower[k];
+			unsigned int q = extent > 0.0f ? static_cast<unsigned int>(
+				( centroids[3 * t + k] - lower[k] ) / extent * 1023.0f ) : 0;
+			for ( unsigned int b = 0; b < 10; ++b )
+				code |= ( ( q >> b ) & 1 ) << ( 3 * b + k );
+		}
+		order[t] = std::make_pair( code, t );
+	}
+	std::sort( order.begin(), order.end() );
+
+
+	// triangles of each vertex in compressed rows
+	std::vector<unsigned int> offsets( vertexCount + 1, 0 );
+	for ( unsigned int i = 0; i < indices.size(); ++i )
+		++offsets[indices[i] + 1];
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> triangles( indices.size() );
+	std::vector<unsigned int> cursors( offsets.begin(), offsets.end() - 1 );
+	for ( unsigned int i = 0; i < indices.size(); ++i )
+		triangles[cursors[indices[i]]++] = i / 3;
+
+
+	// grow meshlets one triangle at a time
+	std::vector<char> isEmitted( triangleCount, 0 );
+	std::vector<int> local( vertexCount, -1 );
+	unsigned int cursor = 0;
+	unsigned int emittedCount = 0;
+	while ( emittedCount < triangleCount )
+	{
+		MESHLET meshlet;
+		std::memset( &meshlet, 0, sizeof( meshlet ) );
+		meshlet.vertexFirst =
+			static_cast<unsigned int>( meshletVertices_.size() );
+		meshlet.triangleFirst =
+			static_cast<unsigned int>( meshletTriangles_.size() / 3 );
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		while ( meshlet.triangleCount < _maxTriangles )
+		{
+			// the neighbour with the fewest new vertices, then the one
+			// closest to the normals so far
+			unsigned int best = ~0u;
+			float bestScore = huge;
+			float length = std::sqrt( axis[0] * axis[0] + axis[1] * axis[1] +
+									  axis[2] * axis[2] );
+			for ( unsigned int i = 0; i < meshlet.vertexCount; ++i )
+			{
+				unsigned int v = meshletVertices_[meshlet.vertexFirst + i];
+				for ( unsigned int j = offsets[v]; j < offsets[v + 1]; ++j )
+				{
+					unsigned int t = triangles[j];
+					if ( isEmitted[t] )
+						continue;
+					unsigned int extra = 0;
+					for ( unsigned int k = 0; k < 3; ++k )
+						extra += local[indices[3 * t + k]] < 0 ? 1 : 0;
+					if ( meshlet.vertexCount + extra > _maxVertices )
+						continue;
+					const float* n = &normals[3 * t];
+					float score = extra + ( length > 0.0f ? 1.0f -
+						( n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2] ) /
+						length : 0.0f );
+					if ( score < bestScore )
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+
+
+			// no neighbour left, the next triangle in Morton order if its
+			// vertices fit
+			if ( best == ~0u )
+			{
+				while ( cursor < triangleCount &&
+						isEmitted[order[cursor].second] )
+					++cursor;
+				if ( cursor == triangleCount )
+					break;
+				unsigned int t = order[cursor].second;
+				unsigned int extra = 0;
+				for ( unsigned int k = 0; k < 3; ++k )
+					extra += local[indices[3 * t + k]] < 0 ? 1 : 0;
+				if ( meshlet.vertexCount + extra > _maxVertices )
+					break;
+				best = t;
+			}
+
+
+			// add it
+			isEmitted[best] = 1;
+			++emittedCount;
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				unsigned int v = indices[3 * best + k];
+				if ( local[v] < 0 )
+				{
+					local[v] = static_cast<int>( meshlet.vertexCount++ );
+					meshletVertices_.push_back( v );
+				}
+				meshletTriangles_.push_back(
+					static_cast<unsigned char>( local[v] ) );
+				axis[k] += normals[3 * best + k];
+			}
+			++meshlet.triangleCount;
+		}
+		for ( unsigned int i = 0; i < meshlet.vertexCount; ++i )
+			local[meshletVertices_[meshlet.vertexFirst + i]] = -1;
+		boundMeshlet( &meshlet, positions, dim );
+		meshlets_.push_back( meshlet );
+	}
+
+
+	// report the partition
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 1 )
+	   << "Built " << meshlets_.size() << " meshlets, "
+	   << static_cast<float>( triangleCount ) / meshlets_.size()
+	   << " triangles and "
+	   << static_cast<float>( meshletVertices_.size() ) / meshlets_.size()
+	   << " vertices each";
+	GEM_CONSOLE( ss.str() );
+}
+
+void
+MeshLoader::boundMeshlet( MESHLET* _meshlet, const float* _positions,
+						  const unsigned int _dim ) const
+{
+	// sphere around the center of the box of the vertices
+	const unsigned int* vertices = &meshletVertices_[_meshlet->vertexFirst];
+	const float huge = std::numeric_limits<float>::max();
+	float lower[3] = { huge, huge, huge };
+	float upper[3] = { -huge, -huge, -huge };
+	for ( unsigned int i = 0; i < _meshlet->vertexCount; ++i )
+	{
+		const float* p = &_positions[vertices[i] * _dim];
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			lower[k] = std::min( lower[k], p[k] );
+			upper[k] = std::max( upper[k], p[k] );
+		}
+	}
+	float radius = 0.0f;
+	for ( unsigned int k = 0; k < 3; ++k )
+		_meshlet->center[k] = 0.5f * ( lower[k] + upper[k] );
+	for ( unsigned int i = 0; i < _meshlet->vertexCount; ++i )
+	{
+		const float* p = &_positions[vertices[i] * _dim];
+		float e[3] = { p[0] - _meshlet->center[0], p[1] - _meshlet->center[1],
+					   p[2] - _meshlet->center[2] };
+		radius = std::max( radius, e[0] * e[0] + e[1] * e[1] + e[2] * e[2] );
+	}
+	_meshlet->radius = std::sqrt( radius );
+
+
+	// cone around the mean normal, the cutoff is the sine of the widest
+	// angle to a normal, and no cone when that is 90 degrees or more
+	const unsigned char* triangles =
+		&meshletTriangles_[3 * _meshlet->triangleFirst];
+	std::vector<float> normals( 3 * _meshlet->triangleCount );
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	for ( unsigned int t = 0; t < _meshlet->triangleCount; ++t )
+	{
+		const float* p0 = &_positions[vertices[triangles[3 * t]] * _dim];
+		const float* p1 = &_positions[vertices[triangles[3 * t + 1]] * _dim];
+		const float* p2 = &_positions[vertices[triangles[3 * t + 2]] * _dim];
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float* n = &normals[3 * t];
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		float length = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			n[k] = length > 0.0f ? n[k] / length : 0.0f;
+			axis[k] += n[k];
+		}
+	}
+	float length = std::sqrt( axis[0] * axis[0] + axis[1] * axis[1] +
+							  axis[2] * axis[2] );
+	float minDot = length > 0.0f ? 1.0f : -1.0f;
+	for ( unsigned int t = 0; t < _meshlet->triangleCount && length > 0.0f;
+		  ++t )
+	{
+		const float* n = &normals[3 * t];
+		minDot = std::min( minDot, ( n[0] * axis[0] + n[1] * axis[1] +
+									 n[2] * axis[2] ) / length );
+	}
+	for ( unsigned int k = 0; k < 3; ++k )
+		_meshlet->coneAxis[k] = length > 0.0f ? axis[k] / length : 0.0f;
+	_meshlet->coneCutoff = minDot > 0.0f ?
+		std::sqrt( 1.0f - minDot * minDot ) : 1.0f;
+}
+
+
+//-- private normals and tangents ----------------------------------------------
+
+void
+MeshLoader::computeNormals( const NORMAL_WEIGHT _weight )
+{
+	// level 0 triangles, positions as floats and the corners around each
+	// vertex
+	std::vector<unsigned int> indices;
+	getTriangleIndices( indices );
+	if ( indices.empty() )
+		return;
+	Allocator positions;
+	getFloatAttribute( 0, 3, positions );
+	std::vector<unsigned int> cornerFirst;
+	std::vector<unsigned int> corners;
+	listVertexCorners( indices, vertexCount_, cornerFirst, corners );
+
+
+	// weigh the corners of each triangle
+	const unsigned int cornerCount =
+		static_cast<unsigned int>( indices.size() );
+	std::vector<float> cornerData( 3 * cornerCount );
+	FRAMERANGE range;
+	std::memset( &range, 0, sizeof( range ) );
+	range.indices = &indices[0];
+	range.positions = positions.getReadPtr<float>();
+	range.positionDim = positions.getDim();
+	range.weight = _weight;
+	range.cornerX = &cornerData[0];
+	range.cornerY = &cornerData[cornerCount];
+	range.cornerZ = &cornerData[2 * cornerCount];
+	runFrameKernel( &MeshLoader::weighNormalCorners, range, cornerCount / 3 );
+
+
+	// sum them around each vertex straight into a new store, narrow again
+	// if the old one was
+	Allocator& store = vertexAttributes_[2];
+	const ALLOC_FORMAT format = store.getFormat();
+	const bool isNarrow = store.isAlloc() &&
+		( format == ALLOC_FORMAT_VEC3_16F ||
+		  format == ALLOC_FORMAT_VEC2_16I ||
+		  format == ALLOC_FORMAT_VEC4_2_10_10_10 );
+	createVertexAttribute( 2, VERTEX_FORMAT_XYZ_32F, vertexCount_,
+						   ALLOC_MODE_NOINIT );
+	range.cornerFirst = &cornerFirst[0];
+	range.corners = &corners[0];
+	range.frames = store.getWritePtr<float>();
+	range.frameDim = 3;
+	runFrameKernel( &MeshLoader::sumFrameCorners, range, vertexCount_ );
+	if ( isNarrow )
+		convertStore( store, format );
+}
+
+void
+MeshLoader::computeTangents( const unsigned int _attr )
+{
+	// level 0 triangles, the inputs as floats and the corners around each
+	// vertex
+	std::vector<unsigned int> indices;
+	getTriangleIndices( indices );
+	if ( indices.empty() )
+		return;
+	Allocator positions;
+	Allocator normals;
+	Allocator texcoords;
+	getFloatAttribute( 0, 3, positions );
+	getFloatAttribute( 2, 3, normals );
+	getFloatAttribute( 8, 2, texcoords );
+	std::vector<unsigned int> cornerFirst;
+	std::vector<unsigned int> corners;
+	listVertexCorners( indices, vertexCount_, cornerFirst, corners );
+
+
+	// weigh the corners of each triangle
+	const unsigned int cornerCount =
+		static_cast<unsigned int>( indices.size() );
+	std::vector<float> cornerData( 4 * cornerCount );
+	FRAMERANGE range;
+	std::memset( &range, 0, sizeof( range ) );
+	range.indices = &indices[0];
+	range.positions = positions.getReadPtr<float>();
+	range.positionDim = positions.getDim();
+	range.normals = normals.getReadPtr<float>();
+	range.normalDim = normals.getDim();
+	range.texcoords = texcoords.getReadPtr<float>();
+	range.texcoordDim = texcoords.getDim();
+	range.cornerX = &cornerData[0];
+	range.cornerY = &cornerData[cornerCount];
+	range.cornerZ = &cornerData[2 * cornerCount];
+	range.cornerW = &cornerData[3 * cornerCount];
+	runFrameKernel( &MeshLoader::weighTangentCorners, range,
+					cornerCount / 3 );
+
+
+	// sum them around each vertex straight into a new store, narrow again
+	// if the old one was
+	Allocator& store = vertexAttributes_[_attr];
+	const ALLOC_FORMAT format = store.getFormat();
+	const bool isNarrow = store.isAlloc() &&
+		( format == ALLOC_FORMAT_VEC4_16F ||
+		  format == ALLOC_FORMAT_VEC4_2_10_10_10 );
+	createVertexAttribute( _attr, VERTEX_FORMAT_XYZW_32F, vertexCount_,
+						   ALLOC_MODE_NOINIT );
+	range.cornerFirst = &cornerFirst[0];
+	range.corners = &corners[0];
+	range.frames = store.getWritePtr<float>();
+	range.frameDim = 4;
+	runFrameKernel( &MeshLoader::sumFrameCorners, range, vertexCount_ );
+	if ( isNarrow )
+		convertStore( store, format );
+}
+
+void
+MeshLoader::getTriangleIndices( std::vector<unsigned int>& _indices )
+{
+	// level 0 as 32 bit indices, checked against the vertex count
+	if ( primitives_.getDim() != 3 )
+		GEM_THROW( "Only triangle meshes have normals and tangents" );
+	_indices.resize( 3 * getLOD( 0 ).primitivesCount );
+	if ( _indices.empty() )
+		return;
+	if ( primitives_.getType() == ALLOC_TYPE_16UI )
+	{
+		const unsigned short* src = primitives_.getReadPtr<unsigned short>();
+		std::copy( src, src + _indices.size(), _indices.begin() );
+	}
+	else
+	{
+		const unsigned int* src = primitives_.getReadPtr<unsigned int>();
+		std::copy( src, src + _indices.size(), _indices.begin() );
+	}
+	for ( unsigned int i = 0; i < _indices.size(); ++i )
+	{
+		if ( _indices[i] >= vertexCount_ )
+			GEM_THROW( "Primitive index out of range" );
+	}
+}
+
+void
+MeshLoader::getFloatAttribute( const unsigned int _attr,
+							   const unsigned int _dim, Allocator& _store )
+{
+	// at least _dim floats per vertex, narrow stores decoded on a
+	// copy-on-write share
+	_store.share( vertexAttributes_[_attr] );
+	convertStore( _store, getWideFormat( _store ) );
+	if ( !_store.isAlloc() || _store.getType() != ALLOC_TYPE_32F ||
+		 _store.getDim() < _dim || _store.getElementCount() != vertexCount_ )
+		GEM_THROW( "Vertex attribute missing or not enough components" );
+}
+
+void
+MeshLoader::listVertexCorners( const std::vector<unsigned int>& _indices,
+							   const unsigned int _vertexCount,
+							   std::vector<unsigned int>& _cornerFirst,
+							   std::vector<unsigned int>& _corners )
+{
+	// counting sort of the corners by vertex, the corners of a vertex stay
+	// in mesh order
+	const unsigned int cornerCount =
+		static_cast<unsigned int>( _indices.size() );
+	_cornerFirst.assign( _vertexCount + 1, 0 );
+	for ( unsigned int i = 0; i < cornerCount; ++i )
+		++_cornerFirst[_indices[i] + 1];
+	for ( unsigned int v = 0; v < _vertexCount; ++v )
+		_cornerFirst[v + 1] += _cornerFirst[v];
+	std::vector<unsigned int> next( _cornerFirst.begin(),
+									_cornerFirst.end() - 1 );
+	_corners.resize( cornerCount );
+	for ( unsigned int i = 0; i < cornerCount; ++i )
+		_corners[next[_indices[i]]++] = i;
+}
+
+void
+MeshLoader::runFrameKernel( void (*_kernel)( FRAMERANGE* ),
+							const FRAMERANGE& _range,
+							const unsigned int _count ) const
+{
+	// split _count triangles or vertices into a range per thread, at least
+	// 16k each, the calling thread takes the first
+	unsigned int threadCount = parseMode_ == PARSE_MODE_PARALLEL ?
+		std::max( 1u, std::thread::hardware_concurrency() ) : 1;
+	threadCount = std::max( 1u, std::min( threadCount, _count >> 14 ) );
+	std::vector<FRAMERANGE> ranges( threadCount, _range );
+	for ( unsigned int i = 0; i < threadCount; ++i )
+	{
+		ranges[i].first = static_cast<unsigned int>(
+			static_cast<unsigned long long>( _count ) * i / threadCount );
+		ranges[i].last = static_cast<unsigned int>(
+			static_cast<unsigned long long>( _count ) * ( i + 1 ) /
+			threadCount );
+	}
+	std::vector<std::thread> workers;
+	for ( unsigned int i = 1; i < threadCount; ++i )
+		workers.push_back( std::thread( _kernel, &ranges[i] ) );
+	_kernel( &ranges[0] );
+	for ( unsigned int i = 0; i < workers.size(); ++i )
+		workers[i].join();
+}
+
+void
+MeshLoader::weighNormalCorners( FRAMERANGE* _range )
+{
+	// The normal of each triangle times the angle of each corner, or not
+	// normalized for area weights, its length being twice the area. Four
+	// triangles at a time with SSE2, the lanes past the end of the range
+	// repeat its last triangle and are not stored
+	const unsigned int* indices = _range->indices;
+	const float* positions = _range->positions;
+	const unsigned int dim = _range->positionDim;
+	const bool isAngleWeighted = _range->weight == NORMAL_WEIGHT_ANGLE;
+#ifdef GEM_HAS_SSE2
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128 vSignMask = _mm_set1_ps( -0.0f );
+	for ( unsigned int t = _range->first; t < _range->last; t += 4 )
+	{
+		const unsigned int laneCount = std::min( 4u, _range->last - t );
+		unsigned int vertices[3][4];
+		for ( unsigned int l = 0; l < 4; ++l )
+		{
+			const unsigned int* triangle =
+				&indices[3 * ( t + std::min( l, laneCount - 1 ) )];
+			for ( unsigned int c = 0; c < 3; ++c )
+				vertices[c][l] = triangle[c];
+		}
+		__m128 px[3];
+		__m128 py[3];
+		__m128 pz[3];
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			px[c] = gather4( positions, vertices[c], dim, 0 );
+			py[c] = gather4( positions, vertices[c], dim, 1 );
+			pz[c] = gather4( positions, vertices[c], dim, 2 );
+		}
+		__m128 e1x = _mm_sub_ps( px[1], px[0] );
+		__m128 e1y = _mm_sub_ps( py[1], py[0] );
+		__m128 e1z = _mm_sub_ps( pz[1], pz[0] );
+		__m128 e2x = _mm_sub_ps( px[2], px[0] );
+		__m128 e2y = _mm_sub_ps( py[2], py[0] );
+		__m128 e2z = _mm_sub_ps( pz[2], pz[0] );
+		__m128 nx = _mm_sub_ps( _mm_mul_ps( e1y, e2z ),
+								_mm_mul_ps( e1z, e2y ) );
+		__m128 ny = _mm_sub_ps( _mm_mul_ps( e1z, e2x ),
+								_mm_mul_ps( e1x, e2z ) );
+		__m128 nz = _mm_sub_ps( _mm_mul_ps( e1x, e2y ),
+								_mm_mul_ps( e1y, e2x ) );
+		__m128 weights[3] = { vOne, vOne, vOne };
+		if ( isAngleWeighted )
+		{
+			__m128 scale = invSqrt4( dot4( nx, ny, nz, nx, ny, nz ) );
+			nx = _mm_mul_ps( nx, scale );
+			ny = _mm_mul_ps( ny, scale );
+			nz = _mm_mul_ps( nz, scale );
+			__m128 e3x = _mm_sub_ps( px[2], px[1] );
+			__m128 e3y = _mm_sub_ps( py[2], py[1] );
+			__m128 e3z = _mm_sub_ps( pz[2], pz[1] );
+			__m128 s1 = invSqrt4( dot4( e1x, e1y, e1z, e1x, e1y, e1z ) );
+			__m128 s2 = invSqrt4( dot4( e2x, e2y, e2z, e2x, e2y, e2z ) );
+			__m128 s3 = invSqrt4( dot4( e3x, e3y, e3z, e3x, e3y, e3z ) );
+			weights[0] = acos4( _mm_mul_ps( dot4( e1x, e1y, e1z,
+				e2x, e2y, e2z ), _mm_mul_ps( s1, s2 ) ) );
+			weights[1] = acos4( _mm_xor_ps( vSignMask, _mm_mul_ps( dot4(
+				e1x, e1y, e1z, e3x, e3y, e3z ), _mm_mul_ps( s1, s3 ) ) ) );
+			weights[2] = acos4( _mm_mul_ps( dot4( e2x, e2y, e2z,
+				e3x, e3y, e3z ), _mm_mul_ps( s2, s3 ) ) );
+		}
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			float x[4];
+			float y[4];
+			float z[4];
+			_mm_storeu_ps( x, _mm_mul_ps( nx, weights[c] ) );
+			_mm_storeu_ps( y, _mm_mul_ps( ny, weights[c] ) );
+			_mm_storeu_ps( z, _mm_mul_ps( nz, weights[c] ) );
+			for ( unsigned int l = 0; l < laneCount; ++l )
+			{
+				const unsigned int corner = 3 * ( t + l ) + c;
+				_range->cornerX[corner] = x[l];
+				_range->cornerY[corner] = y[l];
+				_range->cornerZ[corner] = z[l];
+			}
+		}
+	}
+#else
+	for ( unsigned int t = _range->first; t < _range->last; ++t )
+	{
+		const float* p[3];
+		for ( unsigned int c = 0; c < 3; ++c )
+			p[c] = &positions[indices[3 * t + c] * dim];
+		float e1[3];
+		float e2[3];
+		float e3[3];
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			e1[k] = p[1][k] - p[0][k];
+			e2[k] = p[2][k] - p[0][k];
+			e3[k] = p[2][k] - p[1][k];
+		}
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+					   e1[2] * e2[0] - e1[0] * e2[2],
+					   e1[0] * e2[1] - e1[1] * e2[0] };
+		float weights[3] = { 1.0f, 1.0f, 1.0f };
+		if ( isAngleWeighted )
+		{
+			float scale = invSqrt1( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+			for ( unsigned int k = 0; k < 3; ++k )
+				n[k] *= scale;
+			float s1 = invSqrt1( e1[0] * e1[0] + e1[1] * e1[1] +
+								 e1[2] * e1[2] );
+			float s2 = invSqrt1( e2[0] * e2[0] + e2[1] * e2[1] +
+								 e2[2] * e2[2] );
+			float s3 = invSqrt1( e3[0] * e3[0] + e3[1] * e3[1] +
+								 e3[2] * e3[2] );
+			weights[0] = acos1( ( e1[0] * e2[0] + e1[1] * e2[1] +
+								  e1[2] * e2[2] ) * ( s1 * s2 ) );
+			weights[1] = acos1( -( e1[0] * e3[0] + e1[1] * e3[1] +
+								   e1[2] * e3[2] ) * ( s1 * s3 ) );
+			weights[2] = acos1( ( e2[0] * e3[0] + e2[1] * e3[1] +
+								  e2[2] * e3[2] ) * ( s2 * s3 ) );
+		}
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			_range->cornerX[3 * t + c] = n[0] * weights[c];
+			_range->cornerY[3 * t + c] = n[1] * weights[c];
+			_range->cornerZ[3 * t + c] = n[2] * weights[c];
+		}
+	}
+#endif
+}
+
+void
+MeshLoader::weighTangentCorners( FRAMERANGE* _range )
+{
+	// MikkTSpace, the direction of increasing u of each triangle projected
+	// onto the plane of the vertex normal at each corner, times the angle
+	// of the corner in that plane. The weight is the angle signed by the
+	// orientation of the triangle in texture space, and zero for triangles
+	// without texture area. Four triangles at a time with SSE2 as in
+	// weighNormalCorners()
+	const unsigned int* indices = _range->indices;
+	const float* positions = _range->positions;
+	const float* normals = _range->normals;
+	const float* texcoords = _range->texcoords;
+	const unsigned int positionDim = _range->positionDim;
+	const unsigned int normalDim = _range->normalDim;
+	const unsigned int texcoordDim = _range->texcoordDim;
+	const float tiny = std::numeric_limits<float>::min();
+#ifdef GEM_HAS_SSE2
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128 vSignMask = _mm_set1_ps( -0.0f );
+	const __m128 vTiny = _mm_set1_ps( tiny );
+	for ( unsigned int t = _range->first; t < _range->last; t += 4 )
+	{
+		const unsigned int laneCount = std::min( 4u, _range->last - t );
+		unsigned int vertices[3][4];
+		for ( unsigned int l = 0; l < 4; ++l )
+		{
+			const unsigned int* triangle =
+				&indices[3 * ( t + std::min( l, laneCount - 1 ) )];
+			for ( unsigned int c = 0; c < 3; ++c )
+				vertices[c][l] = triangle[c];
+		}
+		__m128 px[3];
+		__m128 py[3];
+		__m128 pz[3];
+		__m128 nx[3];
+		__m128 ny[3];
+		__m128 nz[3];
+		__m128 u[3];
+		__m128 v[3];
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			px[c] = gather4( positions, vertices[c], positionDim, 0 );
+			py[c] = gather4( positions, vertices[c], positionDim, 1 );
+			pz[c] = gather4( positions, vertices[c], positionDim, 2 );
+			nx[c] = gather4( normals, vertices[c], normalDim, 0 );
+			ny[c] = gather4( normals, vertices[c], normalDim, 1 );
+			nz[c] = gather4( normals, vertices[c], normalDim, 2 );
+			u[c] = gather4( texcoords, vertices[c], texcoordDim, 0 );
+			v[c] = gather4( texcoords, vertices[c], texcoordDim, 1 );
+			__m128 scale = invSqrt4( dot4( nx[c], ny[c], nz[c],
+										   nx[c], ny[c], nz[c] ) );
+			nx[c] = _mm_mul_ps( nx[c], scale );
+			ny[c] = _mm_mul_ps( ny[c], scale );
+			nz[c] = _mm_mul_ps( nz[c], scale );
+		}
+
+		// orientation in texture space and the unit direction of
+		// increasing u, vOs in MikkTSpace
+		__m128 u1 = _mm_sub_ps( u[1], u[0] );
+		__m128 v1 = _mm_sub_ps( v[1], v[0] );
+		__m128 u2 = _mm_sub_ps( u[2], u[0] );
+		__m128 v2 = _mm_sub_ps( v[2], v[0] );
+		__m128 area = _mm_sub_ps( _mm_mul_ps( u1, v2 ), _mm_mul_ps( v1, u2 ) );
+		__m128 sx = _mm_sub_ps( _mm_mul_ps( v2, _mm_sub_ps( px[1], px[0] ) ),
+								_mm_mul_ps( v1, _mm_sub_ps( px[2], px[0] ) ) );
+		__m128 sy = _mm_sub_ps( _mm_mul_ps( v2, _mm_sub_ps( py[1], py[0] ) ),
+								_mm_mul_ps( v1, _mm_sub_ps( py[2], py[0] ) ) );
+		__m128 sz = _mm_sub_ps( _mm_mul_ps( v2, _mm_sub_ps( pz[1], pz[0] ) ),
+								_mm_mul_ps( v1, _mm_sub_ps( pz[2], pz[0] ) ) );
+		__m128 lengthSquared = dot4( sx, sy, sz, sx, sy, sz );
+		__m128 sign = _mm_or_ps( vOne, _mm_and_ps( vSignMask,
+			_mm_cmple_ps( area, vZero ) ) );
+		__m128 isValid = _mm_and_ps(
+			_mm_cmpgt_ps( _mm_andnot_ps( vSignMask, area ), vTiny ),
+			_mm_cmpgt_ps( lengthSquared, vZero ) );
+		__m128 scale = _mm_mul_ps( sign, invSqrt4( lengthSquared ) );
+		sx = _mm_mul_ps( sx, scale );
+		sy = _mm_mul_ps( sy, scale );
+		sz = _mm_mul_ps( sz, scale );
+
+		// per corner, the tangent and the two edges in the plane of the
+		// normal
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			const unsigned int prev = ( c + 2 ) % 3;
+			const unsigned int next = ( c + 1 ) % 3;
+			__m128 d = dot4( nx[c], ny[c], nz[c], sx, sy, sz );
+			__m128 tx = _mm_sub_ps( sx, _mm_mul_ps( d, nx[c] ) );
+			__m128 ty = _mm_sub_ps( sy, _mm_mul_ps( d, ny[c] ) );
+			__m128 tz = _mm_sub_ps( sz, _mm_mul_ps( d, nz[c] ) );
+			scale = invSqrt4( dot4( tx, ty, tz, tx, ty, tz ) );
+			__m128 ax = _mm_sub_ps( px[prev], px[c] );
+			__m128 ay = _mm_sub_ps( py[prev], py[c] );
+			__m128 az = _mm_sub_ps( pz[prev], pz[c] );
+			d = dot4( nx[c], ny[c], nz[c], ax, ay, az );
+			ax = _mm_sub_ps( ax, _mm_mul_ps( d, nx[c] ) );
+			ay = _mm_sub_ps( ay, _mm_mul_ps( d, ny[c] ) );
+			az = _mm_sub_ps( az, _mm_mul_ps( d, nz[c] ) );
+			__m128 bx = _mm_sub_ps( px[next], px[c] );
+			__m128 by = _mm_sub_ps( py[next], py[c] );
+			__m128 bz = _mm_sub_ps( pz[next], pz[c] );
+			d = dot4( nx[c], ny[c], nz[c], bx, by, bz );
+			bx = _mm_sub_ps( bx, _mm_mul_ps( d, nx[c] ) );
+			by = _mm_sub_ps( by, _mm_mul_ps( d, ny[c] ) );
+			bz = _mm_sub_ps( bz, _mm_mul_ps( d, nz[c] ) );
+			__m128 cosine = _mm_mul_ps( dot4( ax, ay, az, bx, by, bz ),
+				_mm_mul_ps( invSqrt4( dot4( ax, ay, az, ax, ay, az ) ),
+							invSqrt4( dot4( bx, by, bz, bx, by, bz ) ) ) );
+			__m128 weight = _mm_and_ps( isValid, acos4( cosine ) );
+			scale = _mm_mul_ps( scale, weight );
+			float x[4];
+			float y[4];
+			float z[4];
+			float w[4];
+			_mm_storeu_ps( x, _mm_mul_ps( tx, scale ) );
+			_mm_storeu_ps( y, _mm_mul_ps( ty, scale ) );
+			_mm_storeu_ps( z, _mm_mul_ps( tz, scale ) );
+			_mm_storeu_ps( w, _mm_mul_ps( sign, weight ) );
+			for ( unsigned int l = 0; l < laneCount; ++l )
+			{
+				const unsigned int corner = 3 * ( t + l ) + c;
+				_range->cornerX[corner] = x[l];
+				_range->cornerY[corner] = y[l];
+				_range->cornerZ[corner] = z[l];
+				_range->cornerW[corner] = w[l];
+			}
+		}
+	}
+#else
+	for ( unsigned int t = _range->first; t < _range->last; ++t )
+	{
+		const float* p[3];
+		const float* uv[3];
+		float n[3][3];
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			const unsigned int vertex = indices[3 * t + c];
+			p[c] = &positions[vertex * positionDim];
+			uv[c] = &texcoords[vertex * texcoordDim];
+			const float* normal = &normals[vertex * normalDim];
+			float scale = invSqrt1( normal[0] * normal[0] +
+									normal[1] * normal[1] +
+									normal[2] * normal[2] );
+			for ( unsigned int k = 0; k < 3; ++k )
+				n[c][k] = normal[k] * scale;
+		}
+
+		// orientation in texture space and the unit direction of
+		// increasing u, vOs in MikkTSpace
+		float u1 = uv[1][0] - uv[0][0];
+		float v1 = uv[1][1] - uv[0][1];
+		float u2 = uv[2][0] - uv[0][0];
+		float v2 = uv[2][1] - uv[0][1];
+		float area = u1 * v2 - v1 * u2;
+		float s[3];
+		for ( unsigned int k = 0; k < 3; ++k )
+			s[k] = v2 * ( p[1][k] - p[0][k] ) - v1 * ( p[2][k] - p[0][k] );
+		float lengthSquared = s[0] * s[0] + s[1] * s[1] + s[2] * s[2];
+		float sign = area > 0.0f ? 1.0f : -1.0f;
+		bool isValid = std::fabs( area ) > tiny && lengthSquared > 0.0f;
+		float scale = sign * invSqrt1( lengthSquared );
+		for ( unsigned int k = 0; k < 3; ++k )
+			s[k] *= scale;
+
+		// per corner, the tangent and the two edges in the plane of the
+		// normal
+		for ( unsigned int c = 0; c < 3; ++c )
+		{
+			const float* nc = n[c];
+			const float* pc = p[c];
+			const float* pa = p[( c + 2 ) % 3];
+			const float* pb = p[( c + 1 ) % 3];
+			float tangent[3];
+			float a[3];
+			float b[3];
+			float ds = nc[0] * s[0] + nc[1] * s[1] + nc[2] * s[2];
+			float da = 0.0f;
+			float db = 0.0f;
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				tangent[k] = s[k] - ds * nc[k];
+				a[k] = pa[k] - pc[k];
+				b[k] = pb[k] - pc[k];
+				da += nc[k] * a[k];
+				db += nc[k] * b[k];
+			}
+			for ( unsigned int k = 0; k < 3; ++k )
+			{
+				a[k] -= da * nc[k];
+				b[k] -= db * nc[k];
+			}
+			float weight = isValid ? acos1(
+				( a[0] * b[0] + a[1] * b[1] + a[2] * b[2] ) *
+				( invSqrt1( a[0] * a[0] + a[1] * a[1] + a[2] * a[2] ) *
+				  invSqrt1( b[0] * b[0] + b[1] * b[1] + b[2] * b[2] ) ) ) :
+				0.0f;
+			scale = invSqrt1( tangent[0] * tangent[0] +
+							  tangent[1] * tangent[1] +
+							  tangent[2] * tangent[2] ) * weight;
+			_range->cornerX[3 * t + c] = tangent[0] * scale;
+			_range->cornerY[3 * t + c] = tangent[1] * scale;
+			_range->cornerZ[3 * t + c] = tangent[2] * scale;
+			_range->cornerW[3 * t + c] = sign * weight;
+		}
+	}
+#endif
+}
+
+void
+MeshLoader::sumFrameCorners( FRAMERANGE* _range )
+{
+	// Sum the corners of each vertex in mesh order, the same for any split
+	// into ranges, and normalize. Tangents sum the corners on the side with
+	// the larger weight only and get its sign as w.
+	const unsigned int dim = _range->frameDim;
+	for ( unsigned int v = _range->first; v < _range->last; ++v )
+	{
+		const unsigned int* first = _range->corners + _range->cornerFirst[v];
+		const unsigned int* last = _range->corners + _range->cornerFirst[v+1];
+		float sign = 1.0f;
+		if ( dim == 4 )
+		{
+			float positive = 0.0f;
+			float negative = 0.0f;
+			for ( const unsigned int* corner = first; corner != last;
+				  ++corner )
+			{
+				float weight = _range->cornerW[*corner];
+				if ( weight > 0.0f )
+					positive += weight;
+				else
+					negative -= weight;
+			}
+			sign = positive >= negative ? 1.0f : -1.0f;
+		}
+		float sum[3] = { 0.0f, 0.0f, 0.0f };
+		for ( const unsigned int* corner = first; corner != last; ++corner )
+		{
+			if ( dim == 4 && _range->cornerW[*corner] * sign <= 0.0f )
+				continue;
+			sum[0] += _range->cornerX[*corner];
+			sum[1] += _range->cornerY[*corner];
+			sum[2] += _range->cornerZ[*corner];
+		}
+		float length = std::sqrt( sum[0] * sum[0] + sum[1] * sum[1] +
+								  sum[2] * sum[2] );
+		float* frame = _range->frames + v * dim;
+		if ( length > 0.0f )
+		{
+			for ( unsigned int k = 0; k < 3; ++k )
+				frame[k] = sum[k] / length;
+		}
+		else if ( dim == 3 )
+		{
+			for ( unsigned int k = 0; k < 3; ++k )
+				frame[k] = 0.0f;
+		}
+		else
+		{
+			// any unit vector across the normal
+			const float* normal = _range->normals + v * _range->normalDim;
+			float n[3] = { normal[0], normal[1], normal[2] };
+			length = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+			for ( unsigned int k = 0; k < 3 && length > 0.0f; ++k )
+				n[k] /= length;
+			float axis[3] = { 1.0f, 0.0f, 0.0f };
+			if ( std::fabs( n[0] ) > 0.9f )
+			{
+				axis[0] = 0.0f;
+				axis[1] = 1.0f;
+			}
+			float d = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+			for ( unsigned int k = 0; k < 3; ++k )
+				axis[k] -= d * n[k];
+			length = std::sqrt( axis[0] * axis[0] + axis[1] * axis[1] +
+								axis[2] * axis[2] );
+			for ( unsigned int k = 0; k < 3; ++k )
+				frame[k] = axis[k] / length;
+		}
+		if ( dim == 4 )
+			frame[3] = sign;
+	}
+}
+
+
+//-- private ray queries -------------------------------------------------------
+
+void
+MeshLoader::computeBVH( const unsigned int _maxLeafSize )
+{
+	// level 0 triangles and float positions
+	bvhNodes_.clear();
+	bvhPrimitives_.clear();
+	bvhTriangles_.clear();
+	if ( primitives_.getDim() != 3 )
+		GEM_THROW( "Only triangle meshes have a bvh" );
+	std::vector<unsigned int> indices;
+	getTriangleIndices( indices );
+	Allocator store;
+	getFloatAttribute( 0, 3, store );
+	const float* positions = store.getReadPtr<float>();
+	const unsigned int dim = store.getDim();
+	const unsigned int triangleCount =
+		static_cast<unsigned int>( indices.size() / 3 );
+	if ( !triangleCount )
+		return;
+
+
+	// bounds of each triangle, moved along with it when partitioned so
+	// that a range reads them forward through memory
+	std::vector<BVHPRIMITIVE> primitives( triangleCount );
+	for ( unsigned int t = 0; t < triangleCount; ++t )
+	{
+		const float* a = &positions[indices[3 * t + 0] * dim];
+		const float* b = &positions[indices[3 * t + 1] * dim];
+		const float* c = &positions[indices[3 * t + 2] * dim];
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			primitives[t].lower[k] = std::min( a[k], std::min( b[k], c[k] ) );
+			primitives[t].upper[k] = std::max( a[k], std::max( b[k], c[k] ) );
+		}
+		primitives[t].primitive = t;
+	}
+
+
+	// the tree, with threads for the first splits so that there is one per
+	// core at the bottom of them
+	unsigned int threadCount = parseMode_ == PARSE_MODE_PARALLEL ?
+		std::max( 1u, std::thread::hardware_concurrency() ) : 1;
+	BVHRANGE range;
+	range.first = 0;
+	range.last = triangleCount;
+	range.primitives = &primitives[0];
+	range.maxLeafSize = _maxLeafSize;
+	range.depth = 0;
+	range.threadDepth = 0;
+	while ( ( 1u << range.threadDepth ) < threadCount )
+		++range.threadDepth;
+	range.nodes = &bvhNodes_;
+	buildBVHRange( &range );
+
+
+	// triangles in leaf order as a corner and two edges
+	bvhPrimitives_.resize( triangleCount );
+	bvhTriangles_.resize( 9 * triangleCount );
+	for ( unsigned int i = 0; i < triangleCount; ++i )
+	{
+		bvhPrimitives_[i] = primitives[i].primitive;
+		const unsigned int* t = &indices[3 * primitives[i].primitive];
+		float* triangle = &bvhTriangles_[9 * i];
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			float a = positions[t[0] * dim + k];
+			triangle[k] = a;
+			triangle[3 + k] = positions[t[1] * dim + k] - a;
+			triangle[6 + k] = positions[t[2] * dim + k] - a;
+		}
+	}
+
+
+	// report the tree
+	unsigned int leafCount = 0;
+	for ( unsigned int i = 0; i < bvhNodes_.size(); ++i )
+		leafCount += bvhNodes_[i].count ? 1 : 0;
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 1 )
+	   << "Built a bvh of " << bvhNodes_.size() << " nodes, "
+	   << static_cast<float>( triangleCount ) / leafCount
+	   << " triangles per leaf";
+	GEM_CONSOLE( ss.str() );
+}
+
+void
+MeshLoader::buildBVHRange( BVHRANGE* _range )
+{
+	// bounds of the triangles and of their centroids, which are kept at
+	// twice their value
+	const float huge = std::numeric_limits<float>::max();
+	BVHNODE node;
+	float centroidLower[3] = { huge, huge, huge };
+	float centroidUpper[3] = { -huge, -huge, -huge };
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		node.lower[k] = huge;
+		node.upper[k] = -huge;
+	}
+	for ( unsigned int i = _range->first; i < _range->last; ++i )
+	{
+		const BVHPRIMITIVE& b = _range->primitives[i];
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			node.lower[k] = std::min( node.lower[k], b.lower[k] );
+			node.upper[k] = std::max( node.upper[k], b.upper[k] );
+			float c = b.lower[k] + b.upper[k];
+			centroidLower[k] = std::min( centroidLower[k], c );
+			centroidUpper[k] = std::max( centroidUpper[k], c );
+		}
+	}
+	node.first = _range->first;
+	node.count = _range->last - _range->first;
+	std::vector<BVHNODE>& nodes = *_range->nodes;
+	const unsigned int index = static_cast<unsigned int>( nodes.size() );
+	nodes.push_back( node );
+
+
+	// a leaf unless a split pays
+	unsigned int middle = splitBVHRange( _range, centroidLower,
+										 centroidUpper );
+	if ( middle == _range->last )
+		return;
+	nodes[index].count = 0;
+
+
+	// the left half right after the node and the right half after that. The
+	// right half of a big enough range is built on a thread into a vector of
+	// its own, and its child indices moved along when appended.
+	BVHRANGE left = *_range;
+	left.last = middle;
+	++left.depth;
+	BVHRANGE right = *_range;
+	right.first = middle;
+	++right.depth;
+	if ( _range->threadDepth && node.count >= ( 1u << 14 ) )
+	{
+		--left.threadDepth;
+		--right.threadDepth;
+		std::vector<BVHNODE> rightNodes;
+		right.nodes = &rightNodes;
+		std::thread worker( &MeshLoader::buildBVHRange, &right );
+		buildBVHRange( &left );
+		worker.join();
+		const unsigned int offset = static_cast<unsigned int>( nodes.size() );
+		for ( unsigned int i = 0; i < rightNodes.size(); ++i )
+		{
+			if ( !rightNodes[i].count )
+				rightNodes[i].first += offset;
+		}
+		nodes[index].first = offset;
+		nodes.insert( nodes.end(), rightNodes.begin(), rightNodes.end() );
+	}
+	else
+	{
+		buildBVHRange( &left );
+		nodes[index].first = static_cast<unsigned int>( nodes.size() );
+		buildBVHRange( &right );
+	}
+}
+
+unsigned int
+MeshLoader::splitBVHRange( BVHRANGE* _range, const float* _centroidLower,
+						   const float* _centroidUpper )
+{
+	// The cost of a split relative to a leaf that tests every triangle of
+	// the range is one for the step down, plus the triangles of each half
+	// times the chance that a ray through the node enters it, the ratio of
+	// their surface areas. Leaves have at most maxLeafSize triangles.
+	const unsigned int first = _range->first;
+	const unsigned int last = _range->last;
+	const unsigned int count = last - first;
+	BVHPRIMITIVE* primitives = _range->primitives;
+	const BVHNODE& node = _range->nodes->back();
+	if ( count == 1 )
+		return last;
+	const float huge = std::numeric_limits<float>::max();
+	float bestCost = count <= _range->maxLeafSize ?
+		static_cast<float>( count ) : huge;
+	int bestAxis = -1;
+	int bestBin = 0;
+	float area = getHalfArea( node.lower, node.upper );
+
+
+	// Bin the centroids along all axes in one pass and sweep the bins of
+	// each from both ends, a split between bins b and b+1 has the bounds
+	// and counts of both sweeps there. Small ranges get a bin for each
+	// triangle. Axes without extent have everything in their first bin
+	// and no split. Past BVH_MEDIAN_DEPTH levels only median splits are
+	// made, which bounds the depth of the tree.
+	const int bins = std::min( MESH_BVH_BINS, static_cast<int>( count ) );
+	float offset[3];
+	float scale[3];
+	for ( unsigned int axis = 0; axis < 3; ++axis )
+	{
+		float extent = _centroidUpper[axis] - _centroidLower[axis];
+		offset[axis] = _centroidLower[axis];
+		scale[axis] = extent > 0.0f ? bins / extent : 0.0f;
+	}
+	if ( area > 0.0f && _range->depth < BVH_MEDIAN_DEPTH )
+	{
+		unsigned int binSize[3][MESH_BVH_BINS];
+		float binLower[3][MESH_BVH_BINS][4];
+		float binUpper[3][MESH_BVH_BINS][4];
+		for ( unsigned int axis = 0; axis < 3; ++axis )
+		{
+			for ( int bin = 0; bin < bins; ++bin )
+			{
+				binSize[axis][bin] = 0;
+				for ( unsigned int k = 0; k < 4; ++k )
+				{
+					binLower[axis][bin][k] = huge;
+					binUpper[axis][bin][k] = -huge;
+				}
+			}
+		}
+#ifdef GEM_HAS_SSE2
+		// the bounds of a triangle in two registers, w cleared, the
+		// primitive index is not a float
+		const __m128 vMask = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1,
+															   0 ) );
+		const __m128 vOffset = _mm_setr_ps( offset[0], offset[1], offset[2],
+											0.0f );
+		const __m128 vScale = _mm_setr_ps( scale[0], scale[1], scale[2],
+										   0.0f );
+		const __m128i vLastBin = _mm_set1_epi32( bins - 1 );
+		for ( unsigned int i = first; i < last; ++i )
+		{
+			const BVHPRIMITIVE& b = primitives[i];
+			__m128 lower = _mm_and_ps( vMask, _mm_loadu_ps( b.lower ) );
+			__m128 upper = _mm_loadu_ps(
+				reinterpret_cast<const float*>( &b.primitive ) );
+			upper = _mm_and_ps( vMask, _mm_shuffle_ps( upper, upper,
+				_MM_SHUFFLE( 0, 3, 2, 1 ) ) );
+			__m128i bin = _mm_cvttps_epi32( _mm_mul_ps( _mm_sub_ps(
+				_mm_add_ps( lower, upper ), vOffset ), vScale ) );
+			__m128i isPast = _mm_cmpgt_epi32( bin, vLastBin );
+			bin = _mm_or_si128( _mm_and_si128( isPast, vLastBin ),
+								_mm_andnot_si128( isPast, bin ) );
+			int bin4[4];
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( bin4 ), bin );
+			for ( unsigned int axis = 0; axis < 3; ++axis )
+			{
+				++binSize[axis][bin4[axis]];
+				float* binL = binLower[axis][bin4[axis]];
+				float* binU = binUpper[axis][bin4[axis]];
+				_mm_storeu_ps( binL, _mm_min_ps( _mm_loadu_ps( binL ),
+												 lower ) );
+				_mm_storeu_ps( binU, _mm_max_ps( _mm_loadu_ps( binU ),
+												 upper ) );
+			}
+		}
+#else
+		for ( unsigned int i = first; i < last; ++i )
+		{
+			const BVHPRIMITIVE& b = primitives[i];
+			for ( unsigned int axis = 0; axis < 3; ++axis )
+			{
+				int bin = std::min( bins - 1, static_cast<int>(
+					( b.lower[axis] + b.upper[axis] - offset[axis] ) *
+					scale[axis] ) );
+				++binSize[axis][bin];
+				float* binL = binLower[axis][bin];
+				float* binU = binUpper[axis][bin];
+				for ( unsigned int k = 0; k < 3; ++k )
+				{
+					binL[k] = std::min( binL[k], b.lower[k] );
+					binU[k] = std::max( binU[k], b.upper[k] );
+				}
+			}
+		}
+#endif
+		for ( unsigned int axis = 0; axis < 3; ++axis )
+		{
+			float lower[4] = { huge, huge, huge, huge };
+			float upper[4] = { -huge, -huge, -huge, -huge };
+			float rightArea[MESH_BVH_BINS];
+			unsigned int rightCount[MESH_BVH_BINS];
+			unsigned int sweepCount = 0;
+			for ( int bin = bins - 1; bin > 0; --bin )
+			{
+				sweepCount += binSize[axis][bin];
+				growBox( lower, upper, binLower[axis][bin],
+						 binUpper[axis][bin] );
+				rightCount[bin] = sweepCount;
+				rightArea[bin] = sweepCount ?
+					getHalfArea( lower, upper ) : 0.0f;
+			}
+			for ( unsigned int k = 0; k < 4; ++k )
+			{
+				lower[k] = huge;
+				upper[k] = -huge;
+			}
+			sweepCount = 0;
+			for ( int bin = 0; bin + 1 < bins; ++bin )
+			{
+				sweepCount += binSize[axis][bin];
+				growBox( lower, upper, binLower[axis][bin],
+						 binUpper[axis][bin] );
+				if ( !sweepCount || !rightCount[bin + 1] )
+					continue;
+				float cost = 1.0f + ( getHalfArea( lower, upper ) *
+									  sweepCount + rightArea[bin + 1] *
+									  rightCount[bin + 1] ) / area;
+				if ( cost < bestCost )
+				{
+					bestCost = cost;
+					bestAxis = static_cast<int>( axis );
+					bestBin = bin;
+				}
+			}
+		}
+	}
+
+
+	// partition at the best split, with the same binning as above
+	if ( bestAxis >= 0 )
+	{
+		const unsigned int axis = static_cast<unsigned int>( bestAxis );
+		const float axisOffset = offset[axis];
+		const float axisScale = scale[axis];
+		BVHPRIMITIVE* middle = std::partition( primitives + first,
+			primitives + last, [=]( const BVHPRIMITIVE& _b ) -> bool
+		{
+			return std::min( bins - 1, static_cast<int>(
+				( _b.lower[axis] + _b.upper[axis] - axisOffset ) *
+				axisScale ) ) <= bestBin;
+		} );
+		if ( middle != primitives + first && middle != primitives + last )
+			return static_cast<unsigned int>( middle - primitives );
+	}
+
+
+	// a leaf if small enough, else split at the median of the centroids
+	// along their longest axis, for ranges too deep or whose centroids are
+	// all the same
+	if ( count <= _range->maxLeafSize )
+		return last;
+	unsigned int axis = 0;
+	for ( unsigned int k = 1; k < 3; ++k )
+	{
+		if ( _centroidUpper[k] - _centroidLower[k] >
+			 _centroidUpper[axis] - _centroidLower[axis] )
+			axis = k;
+	}
+	std::nth_element( primitives + first, primitives + first + count / 2,
+					  primitives + last,
+		[=]( const BVHPRIMITIVE& _a, const BVHPRIMITIVE& _b ) -> bool
+	{
+		return _a.lower[axis] + _a.upper[axis] <
+			   _b.lower[axis] + _b.upper[axis];
+	} );
+	return first + count / 2;
+}
+
+void
+MeshLoader::traceRayPacket( const Vec3f* _origins, const Vec3f* _directions,
+							const unsigned int _count, RAYHIT* _hits,
+							const float _maxDistance ) const
+{
+#ifdef GEM_HAS_SSE2
+	// up to four rays in SoA registers, missing lanes repeat the last ray
+	__m128 origin[3];
+	__m128 direction[3];
+	__m128 invDirection[3];
+	for ( unsigned int k = 0; k < 3; ++k )
+	{
+		float o[4], d[4], id[4];
+		for ( unsigned int j = 0; j < 4; ++j )
+		{
+			unsigned int r = std::min( j, _count - 1 );
+			o[j] = _origins[r][k];
+			d[j] = _directions[r][k];
+			id[j] = invertDirection( d[j] );
+		}
+		origin[k] = _mm_loadu_ps( o );
+		direction[k] = _mm_loadu_ps( d );
+		invDirection[k] = _mm_loadu_ps( id );
+	}
+	__m128 best = _mm_set1_ps( _maxDistance );
+	__m128 u = _mm_setzero_ps();
+	__m128 v = _mm_setzero_ps();
+	__m128 leafTriangle = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+
+
+	// As intersectRay(), through the nodes any of the rays enter. Children
+	// entered by several rays are taken in the order most of them see, and
+	// the stack keeps the distance of each ray to the other.
+	static const unsigned int bitCount[16] =
+		{ 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+	unsigned int stack[BVH_STACK_SIZE];
+	__m128 stackDistance[BVH_STACK_SIZE];
+	unsigned int size = 0;
+	unsigned int node = 0;
+	__m128 distance;
+	bool isDone = !enterBox4( bvhNodes_[0].lower, bvhNodes_[0].upper,
+							  origin, invDirection, best, &distance );
+	while ( !isDone )
+	{
+		const BVHNODE& current = bvhNodes_[node];
+		if ( current.count )
+		{
+			for ( unsigned int i = current.first;
+				  i < current.first + current.count; ++i )
+			{
+				__m128 isHit = hitTriangle4( &bvhTriangles_[9 * i], origin,
+											 direction, &best, &u, &v );
+				leafTriangle = select4( isHit, _mm_castsi128_ps(
+					_mm_set1_epi32( static_cast<int>( i ) ) ), leafTriangle );
+			}
+		}
+		else
+		{
+			unsigned int left = node + 1;
+			unsigned int right = current.first;
+			__m128 leftDistance, rightDistance;
+			int leftMask = enterBox4( bvhNodes_[left].lower,
+									  bvhNodes_[left].upper, origin,
+									  invDirection, best, &leftDistance );
+			int rightMask = enterBox4( bvhNodes_[right].lower,
+									   bvhNodes_[right].upper, origin,
+									   invDirection, best, &rightDistance );
+			if ( leftMask && rightMask )
+			{
+				int both = leftMask & rightMask;
+				int rightFirst = _mm_movemask_ps( _mm_cmplt_ps(
+					rightDistance, leftDistance ) ) & both;
+				if ( 2 * bitCount[rightFirst] > bitCount[both] )
+				{
+					std::swap( left, right );
+					std::swap( leftDistance, rightDistance );
+				}
+				stack[size] = right;
+				stackDistance[size++] = rightDistance;
+				node = left;
+				continue;
+			}
+			if ( leftMask )
+			{
+				node = left;
+				continue;
+			}
+			if ( rightMask )
+			{
+				node = right;
+				continue;
+			}
+		}
+		while ( size && !_mm_movemask_ps( _mm_cmple_ps(
+			stackDistance[size - 1], best ) ) )
+			--size;
+		if ( !size )
+			break;
+		node = stack[--size];
+	}
+
+
+	// triangles of the mesh
+	float t4[4], u4[4], v4[4];
+	unsigned int triangle4[4];
+	_mm_storeu_ps( t4, best );
+	_mm_storeu_ps( u4, u );
+	_mm_storeu_ps( v4, v );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( triangle4 ),
+					  _mm_castps_si128( leafTriangle ) );
+	for ( unsigned int j = 0; j < _count; ++j )
+	{
+		_hits[j].primitive = triangle4[j] == NO_HIT ?
+			NO_HIT : bvhPrimitives_[triangle4[j]];
+		_hits[j].distance = t4[j];
+		_hits[j].u = u4[j];
+		_hits[j].v = v4[j];
+	}
+#else
+	// a ray at a time
+	for ( unsigned int i = 0; i < _count; ++i )
+		intersectRay( _origins[i], _directions[i], &_hits[i], _maxDistance );
+#endif
+}
+
+
+//-- private formats -----------------------------------------------------------
+
+ALLOC_FORMAT
+MeshLoader::getWideFormat( const Allocator& _store )
+{
+	// 32 bit format a narrow format decodes to, others are their own
+	switch ( _store.getFormat() )
+	{
+	case ALLOC_FORMAT_SCALAR_16UI:		return ALLOC_FORMAT_SCALAR_32UI;
+	case ALLOC_FORMAT_VEC2_16UI:		return ALLOC_FORMAT_VEC2_32UI;
+	case ALLOC_FORMAT_VEC3_16UI:		return ALLOC_FORMAT_VEC3_32UI;
+	case ALLOC_FORMAT_VEC4_16UI:		return ALLOC_FORMAT_VEC4_32UI;
+	case ALLOC_FORMAT_VEC2_16I:			return ALLOC_FORMAT_VEC3_32F;
+	case ALLOC_FORMAT_VEC2_16F:			return ALLOC_FORMAT_VEC2_32F;
+	case ALLOC_FORMAT_VEC3_16F:			return ALLOC_FORMAT_VEC3_32F;
+	case ALLOC_FORMAT_VEC4_16F:			return ALLOC_FORMAT_VEC4_32F;
+	case ALLOC_FORMAT_VEC4_2_10_10_10:	return ALLOC_FORMAT_VEC4_32F;
+	default:							return _store.getFormat();
+	}
+}
+
+void
+MeshLoader::convertStore( Allocator& _store, const ALLOC_FORMAT _format )
+{
+	// nothing to convert
+	if ( !_store.isAlloc() || _store.getFormat() == _format )
+		return;
+
+
+	// new store, the two formats decide the kernel
+	unsigned int count = _store.getElementCount();
+	Allocator converted;
+	converted.setTag( _store.getTag() );
+	converted.alloc( _format, count, 1, ALLOC_MODE_NOINIT );
+	ALLOC_TYPE srcType = _store.getType();
+	ALLOC_TYPE dstType = converted.getType();
+	ALLOC_DIM srcDim = _store.getDim();
+	ALLOC_DIM dstDim = converted.getDim();
+	bool isSrcVector = srcDim == ALLOC_DIM_VEC3 || srcDim == ALLOC_DIM_VEC4;
+	bool isDstVector = dstDim == ALLOC_DIM_VEC3 || dstDim == ALLOC_DIM_VEC4;
+
+
+	// between two narrow formats through 32 bit floats
+	if ( srcType != ALLOC_TYPE_32F && dstType != ALLOC_TYPE_32F &&
+		 getWideFormat( _store ) != _store.getFormat() )
+	{
+		converted.clear();
+		convertStore( _store, getWideFormat( _store ) );
+		convertStore( _store, _format );
+		return;
+	}
+
+
+	// convert (throws)
+	const unsigned char* src = _store.getReadPtr<unsigned char>();
+	unsigned char* dst = converted.getWritePtr<unsigned char>();
+	if ( srcType == ALLOC_TYPE_32F && dstType == ALLOC_TYPE_16F &&
+		 srcDim == dstDim )
+	{
+		encodeHalf( reinterpret_cast<const float*>( src ),
+					reinterpret_cast<unsigned short*>( dst ),
+					count * dstDim );
+	}
+	else if ( srcType == ALLOC_TYPE_32F &&
+			  _format == ALLOC_FORMAT_VEC2_16I && isSrcVector )
+	{
+		encodeOctahedral( reinterpret_cast<const float*>( src ), srcDim,
+						  reinterpret_cast<short*>( dst ), count );
+	}
+	else if ( srcType == ALLOC_TYPE_32F &&
+			  dstType == ALLOC_TYPE_2_10_10_10 && isSrcVector )
+	{
+		encodePacked( reinterpret_cast<const float*>( src ), srcDim,
+					  reinterpret_cast<unsigned int*>( dst ), count );
+	}
+	else if ( srcType == ALLOC_TYPE_16F && dstType == ALLOC_TYPE_32F &&
+			  srcDim == dstDim )
+	{
+		decodeHalf( reinterpret_cast<const unsigned short*>( src ),
+					reinterpret_cast<float*>( dst ), count * dstDim );
+	}
+	else if ( _store.getFormat() == ALLOC_FORMAT_VEC2_16I &&
+			  dstType == ALLOC_TYPE_32F && isDstVector )
+	{
+		decodeOctahedral( reinterpret_cast<const short*>( src ),
+						  reinterpret_cast<float*>( dst ), dstDim, count );
+	}
+	else if ( srcType == ALLOC_TYPE_2_10_10_10 &&
+			  dstType == ALLOC_TYPE_32F && isDstVector )
+	{
+		decodePacked( reinterpret_cast<const unsigned int*>( src ),
+					  reinterpret_cast<float*>( dst ), dstDim, count );
+	}
+	else
+	{
+		GEM_THROW( "Unsupported vertex format conversion" );
+	}
+#ifdef GEM_HAS_RVALUE_REFS
+	_store = std::move( converted );
+#else
+	_store = converted;
+#endif
+}
+
+void
+MeshLoader::narrowPrimitives()
+{
+	// 16 bit indices when every vertex fits
+	if ( !primitives_.isAlloc() || primitives_.getType() != ALLOC_TYPE_32UI ||
+		 vertexCount_ >= 65536 )
+		return;
+	unsigned int count = primitives_.getElementCount() * primitives_.getDim();
+	const unsigned int* src = primitives_.getReadPtr<unsigned int>();
+	unsigned int maxIndex = 0;
+	for ( unsigned int i = 0; i < count; ++i )
+		maxIndex = std::max( maxIndex, src[i] );
+	if ( maxIndex >= 65536 )
+		return;
+
+
+	// same dimension, narrow type
+	ALLOC_FORMAT format = ALLOC_FORMAT_NONE;
+	switch ( primitives_.getFormat() )
+	{
+	case ALLOC_FORMAT_SCALAR_32UI:	format = ALLOC_FORMAT_SCALAR_16UI; break;
+	case ALLOC_FORMAT_VEC2_32UI:	format = ALLOC_FORMAT_VEC2_16UI; break;
+	case ALLOC_FORMAT_VEC3_32UI:	format = ALLOC_FORMAT_VEC3_16UI; break;
+	case ALLOC_FORMAT_VEC4_32UI:	format = ALLOC_FORMAT_VEC4_16UI; break;
+	default:						return;
+	}
+	Allocator narrow;
+	narrow.setTag( ALLOC_TAG_MESH );
+	narrow.alloc( format, primitives_.getElementCount(), 1,
+				  ALLOC_MODE_NOINIT );
+	narrowIndices( src, narrow.getWritePtr<unsigned short>(), count );
+#ifdef GEM_HAS_RVALUE_REFS
+	primitives_ = std::move( narrow );
+#else
+	primitives_ = narrow;
+#endif
+}
+
+bool
+MeshLoader::widenPrimitives()
+{
+	// 32 bit indices back, true if they were narrow
+	if ( !primitives_.isAlloc() || primitives_.getType() != ALLOC_TYPE_16UI )
+		return false;
+	unsigned int count = primitives_.getElementCount() * primitives_.getDim();
+	const unsigned short* src = primitives_.getReadPtr<unsigned short>();
+	Allocator wide;
+	wide.setTag( ALLOC_TAG_MESH );
+	wide.alloc( getWideFormat( primitives_ ), primitives_.getElementCount(),
+				1, ALLOC_MODE_NOINIT );
+	std::copy( src, src + count, wide.getWritePtr<unsigned int>() );
+#ifdef GEM_HAS_RVALUE_REFS
+	primitives_ = std::move( wide );
+#else
+	primitives_ = wide;
+#endif
+	return true;
+}
+
+void
+MeshLoader::encodeHalf( const float* _src, unsigned short* _dst,
+						const unsigned int _count )
+{
+	// Round to nearest even after Fabian Giesen, with SSE2 eight at a time.
+	// Too large values become infinity, NaNs stay NaN and values too small
+	// for a normal half are rounded to subnormals by a float add
+	const unsigned int halfMax = ( 127 + 16 ) << 23;
+	const unsigned int floatMax = 255 << 23;
+	const unsigned int normalMin = 113 << 23;
+	const unsigned int denormMagic = ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23;
+	const unsigned int bias =
+		( static_cast<unsigned int>( 15 - 127 ) << 23 ) + 0xfff;
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	const __m128i vSignMask = _mm_set1_epi32( 0x80000000 );
+	const __m128i vHalfMax = _mm_set1_epi32( halfMax - 1 );
+	const __m128i vFloatMax = _mm_set1_epi32( floatMax );
+	const __m128i vNormalMin = _mm_set1_epi32( normalMin );
+	const __m128i vDenormMagic = _mm_set1_epi32( denormMagic );
+	const __m128i vBias = _mm_set1_epi32( bias );
+	const __m128i vOne = _mm_set1_epi32( 1 );
+	const __m128i vInfinity = _mm_set1_epi32( 0x7c00 );
+	const __m128i vNan = _mm_set1_epi32( 0x7e00 );
+	for ( ; i + 8 <= _count; i += 8 )
+	{
+		__m128i h[2];
+		for ( unsigned int k = 0; k < 2; ++k )
+		{
+			__m128i f = _mm_castps_si128( _mm_loadu_ps( _src + i + 4 * k ) );
+			__m128i sign = _mm_and_si128( f, vSignMask );
+			__m128i a = _mm_xor_si128( f, sign );
+			__m128i subnormal = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps(
+				_mm_castsi128_ps( a ), _mm_castsi128_ps( vDenormMagic ) ) ),
+				vDenormMagic );
+			__m128i odd = _mm_and_si128( _mm_srli_epi32( a, 13 ), vOne );
+			__m128i normal = _mm_srli_epi32( _mm_add_epi32(
+				_mm_add_epi32( a, vBias ), odd ), 13 );
+			__m128i isNan = _mm_cmpgt_epi32( a, vFloatMax );
+			__m128i special = _mm_or_si128( _mm_and_si128( isNan, vNan ),
+				_mm_andnot_si128( isNan, vInfinity ) );
+			__m128i isSubnormal = _mm_cmpgt_epi32( vNormalMin, a );
+			__m128i isSpecial = _mm_cmpgt_epi32( a, vHalfMax );
+			__m128i r = _mm_or_si128( _mm_and_si128( isSubnormal, subnormal ),
+				_mm_andnot_si128( isSubnormal, normal ) );
+			r = _mm_or_si128( _mm_and_si128( isSpecial, special ),
+				_mm_andnot_si128( isSpecial, r ) );
+			r = _mm_or_si128( r, _mm_srli_epi32( sign, 16 ) );
+			h[k] = _mm_srai_epi32( _mm_slli_epi32( r, 16 ), 16 );
+		}
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _dst + i ),
+						  _mm_packs_epi32( h[0], h[1] ) );
+	}
+#endif
+	for ( ; i < _count; ++i )
+	{
+		unsigned int f;
+		std::memcpy( &f, &_src[i], sizeof( f ) );
+		unsigned int sign = f & 0x80000000u;
+		unsigned int a = f ^ sign;
+		unsigned int h;
+		if ( a >= halfMax )
+		{
+			h = a > floatMax ? 0x7e00 : 0x7c00;
+		}
+		else if ( a < normalMin )
+		{
+			float fa, magic;
+			std::memcpy( &fa, &a, sizeof( fa ) );
+			std::memcpy( &magic, &denormMagic, sizeof( magic ) );
+			fa += magic;
+			std::memcpy( &h, &fa, sizeof( h ) );
+			h -= denormMagic;
+		}
+		else
+		{
+			h = ( a + bias + ( ( a >> 13 ) & 1 ) ) >> 13;
+		}
+		_dst[i] = static_cast<unsigned short>( h | ( sign >> 16 ) );
+	}
+}
+
+void
+MeshLoader::decodeHalf( const unsigned short* _src, float* _dst,
+						const unsigned int _count )
+{
+	// exact, subnormals are renormalized by a float subtract
+	const unsigned int exponentMask = 0x7c00 << 13;
+	const unsigned int magic = 113 << 23;
+	float fmagic;
+	std::memcpy( &fmagic, &magic, sizeof( fmagic ) );
+	for ( unsigned int i = 0; i < _count; ++i )
+	{
+		unsigned int f = ( _src[i] & 0x7fff ) << 13;
+		unsigned int exponent = f & exponentMask;
+		f += ( 127 - 15 ) << 23;
+		if ( exponent == exponentMask )
+		{
+			f += ( 128 - 16 ) << 23;
+		}
+		else if ( exponent == 0 )
+		{
+			f += 1 << 23;
+			float ff;
+			std::memcpy( &ff, &f, sizeof( ff ) );
+			ff -= fmagic;
+			std::memcpy( &f, &ff, sizeof( f ) );
+		}
+		f |= static_cast<unsigned int>( _src[i] & 0x8000 ) << 16;
+		std::memcpy( &_dst[i], &f, sizeof( f ) );
+	}
+}
+
+void
+MeshLoader::encodeOctahedral( const float* _src, const unsigned int _srcDim,
+							  short* _dst, const unsigned int _count )
+{
+	// Project onto the octahedron |x|+|y|+|z| = 1 and fold the lower half
+	// over the upper one, Cigolle et al. 2014. Four vectors at a time with
+	// SSE2, the vectors need not be unit length
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	const __m128 vSignMask = _mm_set1_ps( -0.0f );
+	const __m128 vOne = _mm_set1_ps( 1.0f );
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vTiny = _mm_set1_ps( 1e-20f );
+	const __m128 vScale = _mm_set1_ps( 32767.0f );
+	for ( ; i + 4 <= _count; i += 4 )
+	{
+		const float* p = _src + i * _srcDim;
+		const unsigned int d = _srcDim;
+		__m128 x = _mm_setr_ps( p[0], p[d], p[2*d], p[3*d] );
+		__m128 y = _mm_setr_ps( p[1], p[d+1], p[2*d+1], p[3*d+1] );
+		__m128 z = _mm_setr_ps( p[2], p[d+2], p[2*d+2], p[3*d+2] );
+		__m128 l1 = _mm_add_ps( _mm_add_ps( _mm_andnot_ps( vSignMask, x ),
+			_mm_andnot_ps( vSignMask, y ) ), _mm_andnot_ps( vSignMask, z ) );
+		l1 = _mm_max_ps( l1, vTiny );
+		x = _mm_div_ps( x, l1 );
+		y = _mm_div_ps( y, l1 );
+		__m128 foldX = _mm_or_ps( _mm_sub_ps( vOne, _mm_andnot_ps(
+			vSignMask, y ) ), _mm_and_ps( vSignMask, x ) );
+		__m128 foldY = _mm_or_ps( _mm_sub_ps( vOne, _mm_andnot_ps(
+			vSignMask, x ) ), _mm_and_ps( vSignMask, y ) );
+		__m128 isLower = _mm_cmplt_ps( z, vZero );
+		x = _mm_or_ps( _mm_and_ps( isLower, foldX ),
+					   _mm_andnot_ps( isLower, x ) );
+		y = _mm_or_ps( _mm_and_ps( isLower, foldY ),
+					   _mm_andnot_ps( isLower, y ) );
+		__m128i ix = _mm_cvtps_epi32( _mm_mul_ps( x, vScale ) );
+		__m128i iy = _mm_cvtps_epi32( _mm_mul_ps( y, vScale ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _dst + 2 * i ),
+						  _mm_unpacklo_epi16( _mm_packs_epi32( ix, ix ),
+											  _mm_packs_epi32( iy, iy ) ) );
+	}
+#endif
+	for ( ; i < _count; ++i )
+	{
+		const float* p = _src + i * _srcDim;
+		float l1 = std::max( std::fabs( p[0] ) + std::fabs( p[1] ) +
+							 std::fabs( p[2] ), 1e-20f );
+		float x = p[0] / l1;
+		float y = p[1] / l1;
+		if ( p[2] < 0.0f )
+		{
+			float foldX = 1.0f - std::fabs( y );
+			float foldY = 1.0f - std::fabs( x );
+			x = x < 0.0f ? -foldX : foldX;
+			y = y < 0.0f ? -foldY : foldY;
+		}
+		_dst[2*i] = static_cast<short>( std::floor( x * 32767.0f + 0.5f ) );
+		_dst[2*i+1] = static_cast<short>( std::floor( y * 32767.0f + 0.5f ) );
+	}
+}
+
+void
+MeshLoader::decodeOctahedral( const short* _src, float* _dst,
+							  const unsigned int _dstDim,
+							  const unsigned int _count )
+{
+	// unfold and normalize, w is zero
+	for ( unsigned int i = 0; i < _count; ++i )
+	{
+		float x = std::max( _src[2*i] / 32767.0f, -1.0f );
+		float y = std::max( _src[2*i+1] / 32767.0f, -1.0f );
+		float z = 1.0f - std::fabs( x ) - std::fabs( y );
+		float t = std::max( -z, 0.0f );
+		x += x >= 0.0f ? -t : t;
+		y += y >= 0.0f ? -t : t;
+		float scale = 1.0f / std::sqrt( x * x + y * y + z * z );
+		float* q = _dst + i * _dstDim;
+		q[0] = x * scale;
+		q[1] = y * scale;
+		q[2] = z * scale;
+		if ( _dstDim == 4 )
+			q[3] = 0.0f;
+	}
+}
+
+void
+MeshLoader::encodePacked( const float* _src, const unsigned int _srcDim,
+						  unsigned int* _dst, const unsigned int _count )
+{
+	// xyz as 10 bit and w as 2 bit snorm, GL_INT_2_10_10_10_REV order with
+	// x in the lowest bits. w is zero for three component sources. Four
+	// vectors at a time with SSE2
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	const __m128 vMin = _mm_set1_ps( -1.0f );
+	const __m128 vMax = _mm_set1_ps( 1.0f );
+	const __m128 vScale = _mm_set1_ps( 511.0f );
+	const __m128i vMask = _mm_set1_epi32( 0x3ff );
+	for ( ; i + 4 <= _count; i += 4 )
+	{
+		const float* p = _src + i * _srcDim;
+		const unsigned int d = _srcDim;
+		__m128 x = _mm_setr_ps( p[0], p[d], p[2*d], p[3*d] );
+		__m128 y = _mm_setr_ps( p[1], p[d+1], p[2*d+1], p[3*d+1] );
+		__m128 z = _mm_setr_ps( p[2], p[d+2], p[2*d+2], p[3*d+2] );
+		__m128 w = d == 4 ? _mm_setr_ps( p[3], p[7], p[11], p[15] ) :
+							_mm_setzero_ps();
+		x = _mm_min_ps( _mm_max_ps( x, vMin ), vMax );
+		y = _mm_min_ps( _mm_max_ps( y, vMin ), vMax );
+		z = _mm_min_ps( _mm_max_ps( z, vMin ), vMax );
+		w = _mm_min_ps( _mm_max_ps( w, vMin ), vMax );
+		__m128i ix = _mm_and_si128( _mm_cvtps_epi32(
+			_mm_mul_ps( x, vScale ) ), vMask );
+		__m128i iy = _mm_and_si128( _mm_cvtps_epi32(
+			_mm_mul_ps( y, vScale ) ), vMask );
+		__m128i iz = _mm_and_si128( _mm_cvtps_epi32(
+			_mm_mul_ps( z, vScale ) ), vMask );
+		__m128i iw = _mm_cvtps_epi32( w );
+		__m128i r = _mm_or_si128(
+			_mm_or_si128( ix, _mm_slli_epi32( iy, 10 ) ),
+			_mm_or_si128( _mm_slli_epi32( iz, 20 ), _mm_slli_epi32( iw, 30 ) ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _dst + i ), r );
+	}
+#endif
+	for ( ; i < _count; ++i )
+	{
+		const float* p = _src + i * _srcDim;
+		unsigned int r = 0;
+		for ( unsigned int k = 0; k < 4; ++k )
+		{
+			float c = k < 3 || _srcDim == 4 ? p[k] : 0.0f;
+			c = std::min( std::max( c, -1.0f ), 1.0f );
+			c *= k < 3 ? 511.0f : 1.0f;
+			int q = static_cast<int>( std::floor( c + 0.5f ) );
+			r |= ( static_cast<unsigned int>( q ) & ( k < 3 ? 0x3ffu : 0x3u ) )
+				 << ( 10 * k );
+		}
+		_dst[i] = r;
+	}
+}
+
+void
+MeshLoader::decodePacked( const unsigned int* _src, float* _dst,
+						  const unsigned int _dstDim,
+						  const unsigned int _count )
+{
+	// sign extend each field and map to [-1,1] like the GL does
+	for ( unsigned int i = 0; i < _count; ++i )
+	{
+		unsigned int v = _src[i];
+		float* q = _dst + i * _dstDim;
+		q[0] = std::max( ( static_cast<int>( v << 22 ) >> 22 ) / 511.0f,
+						 -1.0f );
+		q[1] = std::max( ( static_cast<int>( v << 12 ) >> 22 ) / 511.0f,
+						 -1.0f );
+		q[2] = std::max( ( static_cast<int>( v << 2 ) >> 22 ) / 511.0f,
+						 -1.0f );
+		if ( _dstDim == 4 )
+			q[3] = std::max( static_cast<float>(
+				static_cast<int>( v ) >> 30 ), -1.0f );
+	}
+}
+
+void
+MeshLoader::narrowIndices( const unsigned int* _src, unsigned short* _dst,
+						   const unsigned int _count )
+{
+	// all indices are below 65536, SSE2 packs with signed saturation so
+	// they are sign extended from 16 bits first
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	for ( ; i + 8 <= _count; i += 8 )
+	{
+		__m128i a = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>( _src + i ) );
+		__m128i b = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>( _src + i + 4 ) );
+		a = _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 );
+		b = _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _dst + i ),
+						  _mm_packs_epi32( a, b ) );
+	}
+#endif
+	for ( ; i < _count; ++i )
+		_dst[i] = static_cast<unsigned short>( _src[i] );
+}
+
+
+//-- private file-io -----------------------------------------------------------
+
+void
+MeshLoader::loadOBX( const std::string& _path )
+{
+	// local variables
+	std::string line;
+	std::istringstream iss;
+	std::string cmd;
+	unsigned int n = 0;
+	unsigned int primCount = 0;
+	unsigned int vertexCount = 0;
+	unsigned int texcoordCount = 0;
+	unsigned int normalCount = 0;
+	bool hasCorners = false;
+	PRIM_TYPE primType = PRIM_TYPE_NONE;
+	VERTEX_FORMAT vertexFormat = VERTEX_FORMAT_NONE;
+
+
+	// open file for reading
+	std::ifstream ifs( _path.c_str( ) );
+	if ( ifs.fail() )
+	{
+		GEM_THROW( "Could not open ifs " + _path );
+	}
+
+
+	// run through file once to count vertices and faces
+	while ( std::getline( ifs, line ) )
+	{
+		// clear io-state and set new string
+		cmd.clear( );
+		iss.clear( );
+		iss.str( line );
+		iss >> cmd;
+
+
+		// increase vertex and face counters, any slash on a face line means
+		// v/vt/vn triplets
+		if ( cmd == "f" )
+		{
+			hasCorners = hasCorners || line.find( '/' ) != std::string::npos;
+			if ( !primCount )
+			{
+				for ( n = 0; iss >> cmd; ++n );
+				switch ( n )
+				{
+				case 1: primType = PRIM_TYPE_POINT; break;
+				case 2: primType = PRIM_TYPE_LINE; break;
+				case 3: primType = PRIM_TYPE_TRIANGLE; break;
+				case 4: primType = PRIM_TYPE_QUAD; break;
+				}
+			}
+			++primCount;
+		}
+		else if ( cmd == "v" || cmd == "v0f" )
+		{
+			if ( !vertexCount )
+			{
+				for ( n = 0; iss >> cmd; ++n );
+				switch ( n )
+				{
+				case 1: vertexFormat = VERTEX_FORMAT_X_32F; break;
+				case 2: vertexFormat = VERTEX_FORMAT_XY_32F; break;
+				case 3: vertexFormat = VERTEX_FORMAT_XYZ_32F; break;
+				case 4: vertexFormat = VERTEX_FORMAT_XYZW_32F; break;
+				}
+			}
+			++vertexCount;
+		}
+		else if ( cmd == "v0i" )
+		{
+			if ( !vertexCount )
+			{
+				for ( n = 0; iss >> cmd; ++n );
+				switch ( n )
+				{
 				case 1: vertexFormat = VERTEX_FORMAT_X_32UI; break;
 				case 2: vertexFormat = VERTEX_FORMAT_XY_32UI; break;
 				case 3: vertexFormat = VERTEX_FORMAT_XYZ_32UI; break;
@@ -424,6 +4287,14 @@ MeshLoader::loadOBX( const std::string& _path )
 			}
 			++vertexCount;
 		}
+		else if ( cmd == "vt" )
+		{
+			++texcoordCount;
+		}
+		else if ( cmd == "vn" )
+		{
+			++normalCount;
+		}
 	}
 
 
@@ -441,6 +4312,13 @@ MeshLoader::loadOBX( const std::string& _path )
 	ifs.seekg( 0 );
 
 
+	// elements read so far for negative indices, and the corners of faces
+	// with v/vt/vn triplets, see resolveOBXCorners()
+	unsigned int primDim = primitives_.getDim();
+	unsigned int seen[MAX_VERTEX_ATTRIBUTES] = { 0 };
+	std::vector<unsigned int> corners;
+
+
 	// run through file again adding attributes
 	while ( std::getline( ifs, line ) )
 	{
@@ -454,14 +4332,40 @@ MeshLoader::loadOBX( const std::string& _path )
 		// load primitives
 		if ( cmd == "f" )
 		{
-			// get indices from file
-			unsigned int c[4] = { 0, 0, 0, 0 };
-			for ( n = 0; iss >> c[n] && n<4; ++n )
-				iss.ignore( 100, ' ' );
+			// get 1-based corners from file, past the command
+			const char* p = line.c_str();
+			const char* end = p + line.size();
+			skipBlanks( p, end );
+			skipToken( p, end );
+			unsigned int c[12] = { 0 };
+			int corner[3];
+			for ( n = 0; skipBlanks( p, end ), !isLineEnd( p, end );
+				  skipToken( p, end ) )
+			{
+				if ( n < primDim && scanOBXCorner( p, end, corner ) )
+				{
+					c[3*n] = getOBXIndex( corner[0], seen[0] );
+					c[3*n+1] = getOBXIndex( corner[1], seen[8] );
+					c[3*n+2] = getOBXIndex( corner[2], seen[2] );
+					++n;
+				}
+			}
+
+			// short faces are padded with their last corner
+			for ( ; n && n < primDim; ++n )
+			{
+				c[3*n] = c[3*n-3];
+				c[3*n+1] = c[3*n-2];
+				c[3*n+2] = c[3*n-1];
+			}
 
 			// add indices to buffer
 			for ( unsigned int i = 0; i<n; ++i )
-				primitives_.write<unsigned int>( c[i] - 1 );
+			{
+				primitives_.write<unsigned int>( c[3*i] - 1 );
+				if ( hasCorners )
+					corners.insert( corners.end(), c + 3*i, c + 3*i + 3 );
+			}
 		}
 
 
@@ -529,228 +4433,1196 @@ MeshLoader::loadOBX( const std::string& _path )
 			else { continue; }
 
 
-			// create attribute buffer if it doesnt exist (throws)
-			if ( !vertexAttributes_[attr].isAlloc( ) )
-				createVertexAttribute( attr, vertexFormat, vertexCount );
+			// create attribute buffer if it doesnt exist (throws), with
+			// triplets texcoords and normals have counts of their own
+			if ( !vertexAttributes_[attr].isAlloc( ) )
+			{
+				unsigned int count = vertexCount;
+				if ( hasCorners && cmd == "vt" )
+					count = texcoordCount;
+				else if ( hasCorners && cmd == "vn" )
+					count = normalCount;
+				createVertexAttribute( attr, vertexFormat, count );
+			}
+			++seen[attr];
+
+
+			// add floating point coordinate to buffer
+			if ( vertexFormat == VERTEX_FORMAT_X_32F ||
+				 vertexFormat == VERTEX_FORMAT_XY_32F ||
+				 vertexFormat == VERTEX_FORMAT_XYZ_32F ||
+				 vertexFormat == VERTEX_FORMAT_XYZW_32F )
+			{
+				for ( unsigned int i = 0; i<n; ++i )
+					vertexAttributes_[attr].write<float>( c[i] );
+			}
+			
+
+			// add unsigned int coordinate to buffer
+			if ( vertexFormat == VERTEX_FORMAT_X_32UI ||
+				 vertexFormat == VERTEX_FORMAT_XY_32UI ||
+				 vertexFormat == VERTEX_FORMAT_XYZ_32UI ||
+				 vertexFormat == VERTEX_FORMAT_XYZW_32UI )
+			{
+				for ( unsigned int i = 0; i<n; ++i )
+					vertexAttributes_[attr].write<unsigned int>( c[i] );
+			}
+		}
+	}
+
+
+	// one vertex per unique triplet (throws)
+	vertexCount_ = vertexCount;
+	if ( hasCorners )
+		resolveOBXCorners( corners );
+}
+
+void
+MeshLoader::loadOBXBuffered( const std::string& _path,
+							 const unsigned int _threadCount )
+{
+	// read the whole file with one read (throws)
+	std::vector<char> buffer;
+	readFile( _path, &buffer );
+	const char* begin = buffer.empty() ? NULL : &buffer[0];
+	const char* end = begin + buffer.size();
+
+
+	// split into one range per thread at line boundaries, but keep ranges
+	// large enough to be worth a thread
+	const size_t minRangeSize = 256 * 1024;
+	unsigned int rangeCount = static_cast<unsigned int>( std::min<size_t>(
+		std::max( _threadCount, 1u ), buffer.size() / minRangeSize + 1 ) );
+	std::vector<OBXRANGE> ranges( rangeCount );
+	for ( unsigned int i = 0; i < rangeCount; ++i )
+	{
+		ranges[i].begin = i ? ranges[i-1].end : begin;
+		ranges[i].end = end;
+		if ( i + 1 < rangeCount )
+		{
+			const char* split = begin + static_cast<size_t>(
+				static_cast<unsigned long long>( buffer.size() ) * ( i + 1 ) /
+				rangeCount );
+			split = std::max( split, ranges[i].begin );
+			skipLine( split, end );
+			ranges[i].end = split;
+		}
+	}
+
+
+	// count lines and find formats in each range
+	std::vector<std::thread> workers;
+	for ( unsigned int i = 1; i < rangeCount; ++i )
+		workers.push_back( std::thread( &MeshLoader::scanOBXRange,
+										&ranges[i] ) );
+	scanOBXRange( &ranges[0] );
+	for ( unsigned int i = 0; i < workers.size(); ++i )
+		workers[i].join();
+	workers.clear();
+
+
+	// sum up counts, formats come from the first range that has the kind
+	OBXRANGE total = ranges[0];
+	for ( unsigned int i = 1; i < rangeCount; ++i )
+	{
+		if ( !total.primitivesCount )
+			total.primitivesDim = ranges[i].primitivesDim;
+		total.primitivesCount += ranges[i].primitivesCount;
+		total.hasCorners = total.hasCorners || ranges[i].hasCorners;
+		for ( unsigned int j = 0; j < MAX_VERTEX_ATTRIBUTES; ++j )
+		{
+			if ( !total.attributeCount[j] )
+			{
+				total.attributeDim[j] = ranges[i].attributeDim[j];
+				total.attributeType[j] = ranges[i].attributeType[j];
+			}
+			total.attributeCount[j] += ranges[i].attributeCount[j];
+		}
+	}
+
+
+	// allocate stores (throws)
+	createOBXStores( total );
+
+
+	// prefix sum over the range counts gives each range its slice of the
+	// stores, raw pointers are fetched once so each store gets one write count
+	unsigned int* primitives = primitives_.getWritePtr<unsigned int>();
+	unsigned int primitivesDim = primitives_.getDim();
+	std::vector<unsigned int> corners;
+	if ( total.hasCorners )
+		corners.resize( static_cast<size_t>( total.primitivesCount ) *
+						primitivesDim * 3 );
+	unsigned int* cornersPtr = corners.empty() ? NULL : &corners[0];
+	unsigned char* attributes[MAX_VERTEX_ATTRIBUTES];
+	unsigned int attributeSpace[MAX_VERTEX_ATTRIBUTES];
+	unsigned int attributeBytes[MAX_VERTEX_ATTRIBUTES];
+	unsigned int attributeFirst[MAX_VERTEX_ATTRIBUTES];
+	for ( unsigned int j = 0; j < MAX_VERTEX_ATTRIBUTES; ++j )
+	{
+		attributes[j] = NULL;
+		attributeSpace[j] = 0;
+		attributeFirst[j] = 0;
+		attributeBytes[j] = vertexAttributes_[j].getBitsPerElement() / 8;
+		if ( vertexAttributes_[j].isAlloc() )
+		{
+			attributes[j] =
+				vertexAttributes_[j].getWritePtr<unsigned char>();
+			attributeSpace[j] = vertexAttributes_[j].getElementCount();
+		}
+	}
+	for ( unsigned int i = 0; i < rangeCount; ++i )
+	{
+		ranges[i].primitives = primitives;
+		primitives += ranges[i].primitivesCount * primitivesDim;
+		ranges[i].corners = cornersPtr;
+		if ( cornersPtr )
+			cornersPtr += ranges[i].primitivesCount * primitivesDim * 3;
+		for ( unsigned int j = 0; j < MAX_VERTEX_ATTRIBUTES; ++j )
+		{
+			ranges[i].attributeFirst[j] = attributeFirst[j];
+			attributeFirst[j] += ranges[i].attributeCount[j];
+			unsigned int count = std::min( ranges[i].attributeCount[j],
+										   attributeSpace[j] );
+			ranges[i].attributes[j] = attributes[j];
+			ranges[i].attributeSpace[j] = attributeSpace[j];
+			if ( attributes[j] )
+				attributes[j] += count * attributeBytes[j];
+			attributeSpace[j] -= count;
+		}
+	}
+
+
+	// fill the stores
+	for ( unsigned int i = 1; i < rangeCount; ++i )
+		workers.push_back( std::thread( &MeshLoader::parseOBXRange, this,
+										std::cref( ranges[i] ) ) );
+	parseOBXRange( ranges[0] );
+	for ( unsigned int i = 0; i < workers.size(); ++i )
+		workers[i].join();
+
+
+	// one vertex per unique triplet (throws)
+	if ( total.hasCorners )
+		resolveOBXCorners( corners );
+}
+
+unsigned int
+MeshLoader::scanOBXCommand( const char*& _ptr, const char* _end,
+							ALLOC_TYPE* _type )
+{
+	// local variables
+	const char* p = _ptr;
+	unsigned int command = OBX_COMMAND_UNKNOWN;
+	unsigned int attr = 0;
+	*_type = ALLOC_TYPE_32F;
+
+
+	// f, v, vn, vt, v<attr>f, v<attr>ui and v<attr>i
+	if ( p < _end && *p == 'f' )
+	{
+		++p;
+		command = OBX_COMMAND_FACE;
+	}
+	else if ( p < _end && *p == 'v' )
+	{
+		++p;
+		if ( p < _end && *p == 'n' )
+		{
+			++p;
+			command = 2;
+		}
+		else if ( p < _end && *p == 't' )
+		{
+			++p;
+			command = 8;
+		}
+		else if ( scanUInt( p, _end, &attr ) )
+		{
+			if ( p < _end && *p == 'f' )
+			{
+				++p;
+			}
+			else if ( p + 1 < _end && p[0] == 'u' && p[1] == 'i' )
+			{
+				p += 2;
+				*_type = ALLOC_TYPE_32UI;
+			}
+			else if ( p < _end && *p == 'i' )
+			{
+				++p;
+				*_type = ALLOC_TYPE_32UI;
+			}
+			command = attr < MAX_VERTEX_ATTRIBUTES ? attr :
+				static_cast<unsigned int>( OBX_COMMAND_UNKNOWN );
+		}
+		else
+		{
+			command = 0;
+		}
+	}
 
 
-			// add floating point coordinate to buffer
-			if ( vertexFormat == VERTEX_FORMAT_X_32F ||
-				 vertexFormat == VERTEX_FORMAT_XY_32F ||
-				 vertexFormat == VERTEX_FORMAT_XYZ_32F ||
-				 vertexFormat == VERTEX_FORMAT_XYZW_32F )
+	// commands are whole words, so vp, fo etc are unknown
+	if ( !isLineEnd( p, _end ) && *p != ' ' && *p != '\t' && *p != '\r' )
+		command = OBX_COMMAND_UNKNOWN;
+
+	_ptr = p;
+	return command;
+}
+
+void
+MeshLoader::scanOBXRange( OBXRANGE* _range )
+{
+	// reset counters
+	_range->primitivesCount = 0;
+	_range->primitivesDim = 0;
+	_range->hasCorners = false;
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		_range->attributeCount[i] = 0;
+		_range->attributeDim[i] = 0;
+		_range->attributeType[i] = ALLOC_TYPE_NONE;
+	}
+
+
+	// only the command bytes of each line are looked at, except for the
+	// first line of each kind where the elements are counted
+	const char* p = _range->begin;
+	const char* end = _range->end;
+	while ( p < end )
+	{
+		skipBlanks( p, end );
+		ALLOC_TYPE type;
+		unsigned int command = scanOBXCommand( p, end, &type );
+		unsigned int* count = NULL;
+		unsigned int* dim = NULL;
+		if ( command == OBX_COMMAND_FACE )
+		{
+			count = &_range->primitivesCount;
+			dim = &_range->primitivesDim;
+
+			// any slash on a face line means v/vt/vn triplets
+			if ( !_range->hasCorners )
 			{
-				for ( unsigned int i = 0; i<n; ++i )
-					vertexAttributes_[attr].write<float>( c[i] );
+				const char* line = p;
+				skipLine( line, end );
+				_range->hasCorners =
+					std::memchr( p, '/', line - p ) != NULL;
 			}
-			
+		}
+		else if ( command < MAX_VERTEX_ATTRIBUTES )
+		{
+			count = &_range->attributeCount[command];
+			dim = &_range->attributeDim[command];
+			if ( !*count )
+				_range->attributeType[command] = type;
+		}
 
-			// add unsigned int coordinate to buffer
-			if ( vertexFormat == VERTEX_FORMAT_X_32UI ||
-				 vertexFormat == VERTEX_FORMAT_XY_32UI ||
-				 vertexFormat == VERTEX_FORMAT_XYZ_32UI ||
-				 vertexFormat == VERTEX_FORMAT_XYZW_32UI )
+		if ( count )
+		{
+			if ( !(*count)++ )
 			{
-				for ( unsigned int i = 0; i<n; ++i )
-					vertexAttributes_[attr].write<unsigned int>( c[i] );
+				for ( *dim = 0; skipBlanks( p, end ), !isLineEnd( p, end );
+					  ++(*dim) )
+					skipToken( p, end );
 			}
 		}
+		skipLine( p, end );
 	}
 }
 
 void
-MeshLoader::saveOBJ( const std::string& _path )
+MeshLoader::createOBXStores( const OBXRANGE& _range )
 {
-	// local vars
-	std::ofstream ofs;
-	unsigned int order[3] = {0,2,8};
+	// vertex count is given by the positions if there are any
+	unsigned int vertexCount = _range.attributeCount[0];
+	for ( unsigned int i = 1; i < MAX_VERTEX_ATTRIBUTES && !vertexCount; ++i )
+		vertexCount = std::max( vertexCount, _range.attributeCount[i] );
 
 
-	// open file for writing
-	ofs.open( _path.c_str(), std::ofstream::out | std::ofstream::binary );
-	if ( ofs.fail() )
-		std::cout << "TODO ERROR: MeshData::saveOBJ() file not found\n";
+	// formats ordered by number of elements on a line
+	static const PRIM_TYPE primTypes[5] =
+	{
+		PRIM_TYPE_NONE, PRIM_TYPE_POINT, PRIM_TYPE_LINE,
+		PRIM_TYPE_TRIANGLE, PRIM_TYPE_QUAD
+	};
+	static const VERTEX_FORMAT floatFormats[5] =
+	{
+		VERTEX_FORMAT_NONE, VERTEX_FORMAT_X_32F, VERTEX_FORMAT_XY_32F,
+		VERTEX_FORMAT_XYZ_32F, VERTEX_FORMAT_XYZW_32F
+	};
+	static const VERTEX_FORMAT intFormats[5] =
+	{
+		VERTEX_FORMAT_NONE, VERTEX_FORMAT_X_32UI, VERTEX_FORMAT_XY_32UI,
+		VERTEX_FORMAT_XYZ_32UI, VERTEX_FORMAT_XYZW_32UI
+	};
 
 
-	// save vertex attributes
-	for ( unsigned int i=0; i<3; ++i )
-	{
-		// useful vars
-		unsigned int attr	= order[i];
+	// allocate memory for primitives (throws)
+	if ( _range.primitivesDim > 4 )
+		GEM_THROW( "Faces with more than 4 vertices are not supported" );
+	createPrimitives( primTypes[_range.primitivesDim],
+					  _range.primitivesCount );
 
 
-		// dont continue if attribute is not allocated
-		if ( !vertexAttributes_[attr].isAlloc() )
+	// allocate memory for the attributes present (throws), with triplets
+	// every attribute has a count of its own until resolveOBXCorners()
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( !_range.attributeCount[i] )
 			continue;
+		if ( _range.attributeDim[i] > 4 )
+			GEM_THROW( "Vertex attributes have at most 4 elements" );
+		createVertexAttribute( i, _range.attributeType[i] == ALLOC_TYPE_32UI ?
+								  intFormats[_range.attributeDim[i]] :
+								  floatFormats[_range.attributeDim[i]],
+							   _range.hasCorners ? _range.attributeCount[i] :
+												   vertexCount );
+	}
+	vertexCount_ = vertexCount;
+}
 
+void
+MeshLoader::parseOBXRange( const OBXRANGE& _range ) const
+{
+	// store layouts, unused slots are left at zero
+	unsigned int primitivesDim = primitives_.getDim();
+	void* attributes[MAX_VERTEX_ATTRIBUTES];
+	unsigned int attributeDim[MAX_VERTEX_ATTRIBUTES];
+	bool attributeIsFloat[MAX_VERTEX_ATTRIBUTES];
+	unsigned int attributeSpace[MAX_VERTEX_ATTRIBUTES];
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		attributes[i] = _range.attributes[i];
+		attributeDim[i] = vertexAttributes_[i].getDim();
+		attributeIsFloat[i] = vertexAttributes_[i].getType() == ALLOC_TYPE_32F;
+		attributeSpace[i] = attributes[i] ? _range.attributeSpace[i] : 0;
+	}
+	unsigned int* primitives = _range.primitives;
+	unsigned int* corners = _range.corners;
+	unsigned int primitivesSpace = _range.primitivesCount;
 
-		// get vertex data type and dimension
-		ALLOC_TYPE type = vertexAttributes_[attr].getType();
-		ALLOC_DIM dim = vertexAttributes_[attr].getDim();
 
+	// elements read so far, for negative face indices
+	unsigned int seen[MAX_VERTEX_ATTRIBUTES];
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+		seen[i] = _range.attributeFirst[i];
 
-		// only supports floating point vertices
-		if ( type == ALLOC_TYPE_32F )
-		{
-			// set command string
-			std::stringstream	cmd;
-			if ( attr==0 ) cmd << "v";
-			else if ( attr==2 ) cmd << "vn";
-			else if ( attr==8 ) cmd << "vt";
 
+	// one pass over the range, writing straight into the stores
+	const char* p = _range.begin;
+	const char* end = _range.end;
+	while ( p < end )
+	{
+		skipBlanks( p, end );
+		ALLOC_TYPE type;
+		unsigned int command = scanOBXCommand( p, end, &type );
 
-			// set 
-			float e;
-			vertexAttributes_[attr].seek<float>( 0 );
-			ofs  << std::setprecision(6) << std::fixed;
 
-			for ( int j=0; vertexAttributes_[attr].read<float>( &e ); ++j )
+		// faces, position index of each corner, 1-based in file. Whole
+		// triplets go to the corners if there are any
+		if ( command == OBX_COMMAND_FACE && primitivesSpace )
+		{
+			unsigned int n = 0;
+			int corner[3];
+			while ( skipBlanks( p, end ), !isLineEnd( p, end ) )
 			{
-				if ( j%dim==0 ) ofs << cmd.str();
-				ofs << ' ' << e;
-				if ( j%dim==dim-1 ) ofs << '\n';
+				if ( n < primitivesDim && scanOBXCorner( p, end, corner ) )
+				{
+					primitives[n] = getOBXIndex( corner[0], seen[0] ) - 1;
+					if ( corners )
+					{
+						corners[3*n] = primitives[n] + 1;
+						corners[3*n+1] = getOBXIndex( corner[1], seen[8] );
+						corners[3*n+2] = getOBXIndex( corner[2], seen[2] );
+					}
+					++n;
+				}
+				skipToken( p, end );
 			}
-		}
-	}
 
+			// short faces are padded with their last corner
+			for ( ; n && n < primitivesDim; ++n )
+			{
+				primitives[n] = primitives[n-1];
+				if ( corners )
+				{
+					corners[3*n] = corners[3*n-3];
+					corners[3*n+1] = corners[3*n-2];
+					corners[3*n+2] = corners[3*n-1];
+				}
+			}
 
-	// save primitives
-	if ( true )
-	{
-		// get primitive data type and dimension
-		ALLOC_TYPE type = primitives_.getType();
-		ALLOC_DIM dim = primitives_.getDim();
+			primitives += primitivesDim;
+			if ( corners )
+				corners += 3 * primitivesDim;
+			--primitivesSpace;
+		}
 
 
-		// only supports unsigned int indices
-		if ( type == ALLOC_TYPE_32UI )
+		// vertex attributes, missing elements are set to zero
+		else if ( command < MAX_VERTEX_ATTRIBUTES &&
+				  attributeSpace[command] )
 		{
-			// set command string
-			std::string cmd( "f" );
-
-			unsigned int e;
-			primitives_.seek<unsigned int>( 0 );
-			//ofs << std::resetiosflags;
-
-			for ( int j=0; primitives_.read<unsigned int>( &e ); ++j )
+			unsigned int dim = attributeDim[command];
+			if ( attributeIsFloat[command] )
+			{
+				float* e = static_cast<float*>( attributes[command] );
+				unsigned int n = 0;
+				for ( ; n < dim; ++n )
+				{
+					skipBlanks( p, end );
+					if ( !scanFloat( p, end, &e[n] ) )
+						break;
+				}
+				for ( ; n < dim; ++n )
+					e[n] = 0.0f;
+				attributes[command] = e + dim;
+			}
+			else
 			{
-				if ( j%dim==0 ) ofs << cmd;
-				ofs << ' ' << e+1 << '/' << e+1 << '/' << e+1;
-				if ( j%dim==dim-1 ) ofs << '\n';
+				unsigned int* e =
+					static_cast<unsigned int*>( attributes[command] );
+				unsigned int n = 0;
+				for ( ; n < dim; ++n )
+				{
+					skipBlanks( p, end );
+					if ( !scanUInt( p, end, &e[n] ) )
+						break;
+				}
+				for ( ; n < dim; ++n )
+					e[n] = 0;
+				attributes[command] = e + dim;
 			}
+			--attributeSpace[command];
 		}
+
+		if ( command < MAX_VERTEX_ATTRIBUTES )
+			++seen[command];
+		skipLine( p, end );
 	}
+}
 
+bool
+MeshLoader::scanOBXCorner( const char*& _ptr, const char* _end,
+						   int* _corner )
+{
+	// v, v/vt, v//vn or v/vt/vn, missing indices are zero
+	const char* p = _ptr;
+	_corner[0] = _corner[1] = _corner[2] = 0;
+	if ( !scanInt( p, _end, &_corner[0] ) )
+		return false;
+	for ( unsigned int i = 1; i < 3 && p < _end && *p == '/'; ++i )
+	{
+		++p;
+		scanInt( p, _end, &_corner[i] );
+	}
+	_ptr = p;
+	return true;
+}
 
-	// close file and report sucess
-	ofs.close();
+unsigned int
+MeshLoader::getOBXIndex( const int _index, const unsigned int _count )
+{
+	// 1-based, negative indices count back from the _count elements read so
+	// far, zero if there is no such element
+	if ( _index >= 0 )
+		return static_cast<unsigned int>( _index );
+	unsigned int back = static_cast<unsigned int>( -_index );
+	return back <= _count ? _count - back + 1 : 0;
 }
 
 void
-MeshLoader::saveOBX( const std::string& _path )
+MeshLoader::resolveOBXCorners( std::vector<unsigned int>& _corners )
 {
-	// local vars
-	std::ofstream ofs;
-	unsigned int order[16] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+	// 0-based triplets in place. Corners without a texcoord or normal get a
+	// zero element appended to that store, files without the store keep the
+	// position index, which no store is gathered by.
+	unsigned int cornerCount = static_cast<unsigned int>( _corners.size() / 3 );
+	bool hasTexcoords = vertexAttributes_[8].isAlloc();
+	bool hasNormals = vertexAttributes_[2].isAlloc();
+	unsigned int texcoordDefault = vertexAttributes_[8].getElementCount();
+	unsigned int normalDefault = vertexAttributes_[2].getElementCount();
+	bool isTexcoordDefaultUsed = false;
+	bool isNormalDefaultUsed = false;
+	bool isIdentity = true;
+	for ( unsigned int i = 0; i < cornerCount; ++i )
+	{
+		unsigned int* c = &_corners[3*i];
+		if ( !c[0] )
+			GEM_THROW( "Face index out of range" );
+		if ( hasTexcoords && !c[1] )
+			isTexcoordDefaultUsed = true;
+		if ( hasNormals && !c[2] )
+			isNormalDefaultUsed = true;
+		c[1] = !hasTexcoords ? c[0] - 1 : c[1] ? c[1] - 1 : texcoordDefault;
+		c[2] = !hasNormals ? c[0] - 1 : c[2] ? c[2] - 1 : normalDefault;
+		c[0] = c[0] - 1;
+		isIdentity = isIdentity && c[1] == c[0] && c[2] == c[0];
+	}
+	if ( isTexcoordDefaultUsed )
+		appendVertexAttribute( 8 );
+	if ( isNormalDefaultUsed )
+		appendVertexAttribute( 2 );
 
 
-	// open file for writing
-	ofs.open( _path.c_str(), std::ofstream::out | std::ofstream::binary );
-	if ( ofs.fail() )
-		std::cout << "TODO ERROR: MeshData::saveOBJ() file not found\n";
+	// triplets that agree on stores of the same size are already one index
+	// per vertex, which is what the primitives hold
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( vertexAttributes_[i].isAlloc() )
+			isIdentity = isIdentity &&
+				vertexAttributes_[i].getElementCount() == vertexCount_;
+	}
+	if ( isIdentity )
+		return;
 
 
-	// save vertex attributes
-	for ( unsigned int i=0; i<MAX_VERTEX_ATTRIBUTES; ++i )
+	// open addressing hash map from triplet to vertex, at most half full
+	unsigned int tableSize = 1;
+	while ( tableSize < 2 * cornerCount )
+		tableSize <<= 1;
+	std::vector<unsigned int> table( tableSize, 0 );
+	std::vector<unsigned int> uniques;
+	uniques.reserve( _corners.size() );
+	unsigned int primitivesSize = std::min( cornerCount,
+		primitives_.getElementCount() * primitives_.getDim() );
+	unsigned int* primitives = primitives_.getWritePtr<unsigned int>();
+	for ( unsigned int i = 0; i < primitivesSize; ++i )
 	{
-		// useful vars
-		unsigned int attr	= order[i];
+		const unsigned int* key = &_corners[3*i];
+		unsigned int hash = key[0] * 0x9E3779B1u ^ key[1] * 0x85EBCA77u ^
+							key[2] * 0xC2B2AE3Du;
+		hash ^= hash >> 15;
+		unsigned int slot = hash & ( tableSize - 1 );
+		while ( table[slot] &&
+				!std::equal( key, key + 3, &uniques[3*(table[slot]-1)] ) )
+			slot = ( slot + 1 ) & ( tableSize - 1 );
+		if ( !table[slot] )
+		{
+			uniques.insert( uniques.end(), key, key + 3 );
+			table[slot] = static_cast<unsigned int>( uniques.size() / 3 );
+		}
+		primitives[i] = table[slot] - 1;
+	}
 
 
-		// dont continue if attibrute is not allocated
-		if ( !vertexAttributes_[attr].isAlloc() )
+	// gather the stores, each by its element of the triplet (throws)
+	unsigned int vertexCount = static_cast<unsigned int>( uniques.size() / 3 );
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( !vertexAttributes_[i].isAlloc() )
 			continue;
+		unsigned int element = i == 8 ? 1 : i == 2 ? 2 : 0;
+		gatherVertexAttribute( i, vertexCount ? &uniques[element] : NULL, 3,
+							   vertexCount );
+	}
+	vertexCount_ = vertexCount;
+}
 
-
-		// get vertex data type and dimension
-		ALLOC_TYPE type = vertexAttributes_[attr].getType();
-		ALLOC_DIM dim = vertexAttributes_[attr].getDim();
+void
+MeshLoader::weldVertices( const float _epsilon )
+{
+	// positions decide which cell of an epsilon sized grid a vertex is in
+	Allocator& positions = vertexAttributes_[0];
+	if ( !positions.isAlloc() || positions.getType() != ALLOC_TYPE_32F )
+		return;
+	unsigned int vertexCount = positions.getElementCount();
+	unsigned int positionDim = positions.getDim();
+	unsigned int cellDim = std::min( positionDim, 3u );
+	float scale = 1.0f / _epsilon;
 
 
-		// only supports floating point vertices
-		if ( type == ALLOC_TYPE_32F )
+	// raw pointers and layouts of all stores, vertices are compared in full
+	const unsigned char* data[MAX_VERTEX_ATTRIBUTES];
+	unsigned int byteCount[MAX_VERTEX_ATTRIBUTES];
+	bool isFloat[MAX_VERTEX_ATTRIBUTES];
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		data[i] = NULL;
+		if ( !vertexAttributes_[i].isAlloc() )
+			continue;
+		if ( vertexAttributes_[i].getElementCount() != vertexCount )
+			GEM_THROW( "Vertex attributes differ in size" );
+		data[i] = vertexAttributes_[i].getReadPtr<unsigned char>();
+		byteCount[i] = vertexAttributes_[i].getBitsPerElement() / 8;
+		isFloat[i] = vertexAttributes_[i].getType() == ALLOC_TYPE_32F;
+	}
+	const float* position = reinterpret_cast<const float*>( data[0] );
+
+
+	// open addressing hash map from cell to the last vertex kept in it, the
+	// others kept in the cell are chained through next
+	unsigned int tableSize = 1;
+	while ( tableSize < 2 * vertexCount )
+		tableSize <<= 1;
+	std::vector<int> cells( 3 * tableSize );
+	std::vector<unsigned int> heads( tableSize, ~0u );
+	std::vector<unsigned int> next( vertexCount, ~0u );
+	std::vector<unsigned int> remap( vertexCount );
+	std::vector<unsigned int> sources;
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+	{
+		int cell[3] = { 0, 0, 0 };
+		for ( unsigned int d = 0; d < cellDim; ++d )
 		{
-			// set command string
-			std::stringstream cmd;
-			cmd << "v" << attr << "f";
+			float c = position[v * positionDim + d] * scale;
+			cell[d] = static_cast<int>( std::floor(
+				std::max( -1e9f, std::min( c, 1e9f ) ) ) );
+		}
 
-			// set 
-			float e;
-			vertexAttributes_[attr].seek<unsigned int>( 0 );
-			ofs  << std::setprecision(6) << std::fixed;
 
-			for ( int j=0; vertexAttributes_[attr].read<float>( &e ); ++j )
+		// look for a vertex kept in this or a neighbouring cell that all
+		// attributes are within epsilon of
+		unsigned int match = ~0u;
+		int reach[3] = { 0, 0, 0 };
+		for ( unsigned int d = 0; d < cellDim; ++d )
+			reach[d] = 1;
+		for ( int dx = -reach[0]; dx <= reach[0] && match == ~0u; ++dx )
+		for ( int dy = -reach[1]; dy <= reach[1] && match == ~0u; ++dy )
+		for ( int dz = -reach[2]; dz <= reach[2] && match == ~0u; ++dz )
+		{
+			int neighbour[3] = { cell[0] + dx, cell[1] + dy, cell[2] + dz };
+			unsigned int slot = getWeldCell( cells, heads, neighbour );
+			for ( unsigned int r = heads[slot]; r != ~0u && match == ~0u;
+				  r = next[r] )
 			{
-				if ( j%dim==0 ) ofs << cmd.str();
-				ofs << ' ' << e;
-				if ( j%dim==dim-1 ) ofs << '\n';
+				bool isNear = true;
+				for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES && isNear;
+					  ++i )
+				{
+					if ( !data[i] )
+						continue;
+					const unsigned char* a = data[i] + v * byteCount[i];
+					const unsigned char* b = data[i] + r * byteCount[i];
+					if ( !isFloat[i] )
+					{
+						isNear = std::memcmp( a, b, byteCount[i] ) == 0;
+						continue;
+					}
+					const float* fa = reinterpret_cast<const float*>( a );
+					const float* fb = reinterpret_cast<const float*>( b );
+					for ( unsigned int k = 0; k < byteCount[i] / 4; ++k )
+						isNear = isNear &&
+								 std::fabs( fa[k] - fb[k] ) <= _epsilon;
+				}
+				if ( isNear )
+					match = r;
 			}
 		}
 
 
-		else if ( type == ALLOC_TYPE_32UI )
+		// merge or keep
+		if ( match != ~0u )
 		{
-			// set command string
-			std::stringstream cmd;
-			cmd << "v" << attr << "i";
+			remap[v] = remap[match];
+			continue;
+		}
+		remap[v] = static_cast<unsigned int>( sources.size() );
+		sources.push_back( v );
+		unsigned int slot = getWeldCell( cells, heads, cell );
+		if ( heads[slot] == ~0u )
+			std::copy( cell, cell + 3, &cells[3*slot] );
+		next[v] = heads[slot];
+		heads[slot] = v;
+	}
+	if ( sources.size() == vertexCount )
+		return;
 
-			// set
-			unsigned int e;
-			vertexAttributes_[attr].seek<unsigned int>( 0 );
 
-			for ( int j=0;
-				  vertexAttributes_[attr].read<unsigned int>( &e ); ++j )
-			{
-				if ( j%dim==0 ) ofs << cmd.str();
-				ofs << ' ' << e;
-				if ( j%dim==dim-1 ) ofs << '\n';
-			}
+	// gather kept vertices and remap primitives (throws)
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( data[i] )
+			gatherVertexAttribute( i, &sources[0], 1,
+				static_cast<unsigned int>( sources.size() ) );
+	}
+	if ( primitives_.isAlloc() )
+	{
+		unsigned int count = primitives_.getElementCount() *
+							 primitives_.getDim();
+		unsigned int* primitives = primitives_.getWritePtr<unsigned int>();
+		for ( unsigned int i = 0; i < count; ++i )
+		{
+			if ( primitives[i] < vertexCount )
+				primitives[i] = remap[primitives[i]];
 		}
 	}
+	vertexCount_ = static_cast<unsigned int>( sources.size() );
+}
 
+unsigned int
+MeshLoader::getWeldCell( const std::vector<int>& _cells,
+						 const std::vector<unsigned int>& _heads,
+						 const int* _cell )
+{
+	// slot of cell, or the empty slot where it goes
+	unsigned int mask = static_cast<unsigned int>( _heads.size() ) - 1;
+	unsigned int hash = static_cast<unsigned int>( _cell[0] ) * 73856093u ^
+						static_cast<unsigned int>( _cell[1] ) * 19349663u ^
+						static_cast<unsigned int>( _cell[2] ) * 83492791u;
+	unsigned int slot = ( hash ^ ( hash >> 15 ) ) & mask;
+	while ( _heads[slot] != ~0u &&
+			!std::equal( _cell, _cell + 3, &_cells[3*slot] ) )
+		slot = ( slot + 1 ) & mask;
+	return slot;
+}
 
-	// save primitives
-	if ( true )
+void
+MeshLoader::gatherVertexAttribute( const unsigned int _attr,
+								   const unsigned int* _sources,
+								   const unsigned int _stride,
+								   const unsigned int _count )
+{
+	// new store with element i taken from element _sources[i*_stride]
+	Allocator& store = vertexAttributes_[_attr];
+	unsigned int elementCount = store.getElementCount();
+	unsigned int byteCount = store.getBitsPerElement() / 8;
+	Allocator gathered;
+	gathered.setTag( ALLOC_TAG_MESH );
+	gathered.alloc( store.getFormat(), _count, 1, ALLOC_MODE_NOINIT );
+	const unsigned char* src = store.getReadPtr<unsigned char>();
+	unsigned char* dst = gathered.getWritePtr<unsigned char>();
+	for ( unsigned int i = 0; i < _count; ++i )
 	{
-		// get primitive data type and dimension
-		ALLOC_TYPE type = primitives_.getType();
-		ALLOC_DIM dim = primitives_.getDim();
+		unsigned int source = _sources[i * _stride];
+		if ( source >= elementCount )
+			GEM_THROW( "Face index out of range" );
+		std::memcpy( dst + i * byteCount, src + source * byteCount,
+					 byteCount );
+	}
+#ifdef GEM_HAS_RVALUE_REFS
+	store = std::move( gathered );
+#else
+	store = gathered;
+#endif
+}
 
+void
+MeshLoader::appendVertexAttribute( const unsigned int _attr )
+{
+	// same store with one more element, set to zero
+	Allocator& store = vertexAttributes_[_attr];
+	unsigned int elementCount = store.getElementCount();
+	unsigned int byteCount = store.getBitsPerElement() / 8;
+	Allocator grown;
+	grown.setTag( ALLOC_TAG_MESH );
+	grown.alloc( store.getFormat(), elementCount + 1, 1, ALLOC_MODE_ZERO );
+	if ( elementCount )
+		std::memcpy( grown.getWritePtr<unsigned char>(),
+					 store.getReadPtr<unsigned char>(),
+					 elementCount * byteCount );
+#ifdef GEM_HAS_RVALUE_REFS
+	store = std::move( grown );
+#else
+	store = grown;
+#endif
+}
 
-		// only supports unsigned int indices
-		if ( type == ALLOC_TYPE_32UI )
+bool
+MeshLoader::loadGMB( const std::string& _path, const GMBHEADER* _source )
+{
+	// open file for reading
+	std::ifstream ifs( _path.c_str(), std::ifstream::in |
+									  std::ifstream::binary );
+	if ( ifs.fail() )
+		GEM_THROW( "Could not open file " + _path );
+
+
+	// check header
+	GMBHEADER header;
+	if ( !ifs.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) ||
+		 header.magic != GMB_MAGIC ||
+		 header.headerSize != sizeof( GMBHEADER ) )
+		GEM_THROW( "Not a gmb file " + _path );
+	if ( header.version != GMB_VERSION )
+		return false;
+
+
+	// caches must come from the same source file
+	if ( _source && ( header.sourcePathHash != _source->sourcePathHash ||
+					  header.sourceOptions != _source->sourceOptions ||
+					  header.sourceSize != _source->sourceSize ||
+					  header.sourceTime != _source->sourceTime ) )
+		return false;
+
+
+	// allocate stores and read payloads straight into them (throws)
+	// every byte is overwritten, so skip zeroing. When mapping, the stores
+	// are only reserved and then replaced by the mapping
+	ALLOC_MODE allocMode = isMapEnabled_ ? ALLOC_MODE_LAZY : ALLOC_MODE_NOINIT;
+	vertexCount_ = header.vertexCount;
+	createPrimitives( static_cast<PRIM_TYPE>( header.primitivesFormat ),
+					  header.primitivesCount, allocMode );
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		if ( header.attributeFormat[i] != VERTEX_FORMAT_NONE )
+			createVertexAttribute( i,
+				static_cast<VERTEX_FORMAT>( header.attributeFormat[i] ),
+				header.vertexCount, allocMode );
+	}
+	for ( unsigned int i = 0; i <= MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		Allocator& store = i < MAX_VERTEX_ATTRIBUTES ? vertexAttributes_[i] :
+													   primitives_;
+		unsigned int offset = i < MAX_VERTEX_ATTRIBUTES ?
+			header.attributeOffset[i] : header.primitivesOffset;
+		unsigned int byteCount = i < MAX_VERTEX_ATTRIBUTES ?
+			header.attributeByteCount[i] : header.primitivesByteCount;
+		if ( !store.isAlloc() )
+			continue;
+		if ( byteCount != store.getByteCount() )
+			GEM_THROW( "Corrupt gmb file " + _path );
+		if ( isMapEnabled_ )
 		{
-			// set command string
-			std::string cmd( "f" );
+			store.map( _path, offset, store.getFormat(), store.getWidth() );
+			continue;
+		}
+		ifs.seekg( offset );
+		if ( !ifs.read( store.getWritePtr<char>(), byteCount ) )
+			GEM_THROW( "Truncated gmb file " + _path );
+	}
 
-			unsigned int e;
-			primitives_.seek<unsigned int>( 0 );
-			//ofs << std::resetiosflags;
 
-			for ( int j=0; primitives_.read<unsigned int>( &e ); ++j )
-			{
-				if ( j%dim==0 ) ofs << cmd;
-				ofs << ' ' << e+1 << '/' << e+1 << '/' << e+1;
-				if ( j%dim==dim-1 ) ofs << '\n';
-			}
-		}
+	// levels of detail have to be ranges of the primitives
+	if ( header.lodCount > MESH_MAX_LODS )
+		GEM_THROW( "Corrupt gmb file " + _path );
+	lods_.resize( header.lodCount );
+	for ( unsigned int i = 0; i < header.lodCount; ++i )
+	{
+		lods_[i].primitivesFirst = header.lodPrimitivesFirst[i];
+		lods_[i].primitivesCount = header.lodPrimitivesCount[i];
+		lods_[i].error = header.lodError[i];
+		if ( lods_[i].primitivesFirst > header.primitivesCount ||
+			 lods_[i].primitivesCount > header.primitivesCount -
+										lods_[i].primitivesFirst )
+			GEM_THROW( "Corrupt gmb file " + _path );
 	}
+	lodRadius_ = header.lodRadius;
+	if ( !lods_.empty() )
+		primitivesCount_ = lods_[0].primitivesCount;
+	return true;
+}
+
+bool
+MeshLoader::loadCache( const std::string& _path )
+{
+	// a cache is only any good if it matches the current source file
+	GMBHEADER source;
+	if ( !getSource( _path, &source ) )
+		return false;
+
+
+	// bad or stale caches are silently replaced
+	try
+	{
+		if ( loadGMB( _path + ".gmb", &source ) )
+			return true;
+	}
+	catch( const std::exception& )
+	{
+	}
+	clear();
+	return false;
+}
+
+void
+MeshLoader::saveGMB( const std::string& _path, const GMBHEADER* _source )
+{
+	// header with payloads laid out in attribute order, primitives last
+	GMBHEADER header;
+	std::memset( &header, 0, sizeof( header ) );
+	if ( _source )
+		header = *_source;
+	header.magic = GMB_MAGIC;
+	header.version = GMB_VERSION;
+	header.headerSize = sizeof( GMBHEADER );
+	header.primitivesFormat = primitives_.getFormat();
+	header.primitivesCount = primitives_.getElementCount();
+	header.vertexCount = vertexCount_;
+
+	unsigned int offset = sizeof( GMBHEADER );
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		offset = ( offset + GMB_ALIGNMENT - 1 ) & ~( GMB_ALIGNMENT - 1 );
+		header.attributeFormat[i] = vertexAttributes_[i].getFormat();
+		header.attributeOffset[i] = offset;
+		header.attributeByteCount[i] = vertexAttributes_[i].getByteCount();
+		offset += header.attributeByteCount[i];
+	}
+	offset = ( offset + GMB_ALIGNMENT - 1 ) & ~( GMB_ALIGNMENT - 1 );
+	header.primitivesOffset = offset;
+	header.primitivesByteCount = primitives_.getByteCount();
+	header.lodCount = static_cast<unsigned int>( lods_.size() );
+	for ( unsigned int i = 0; i < lods_.size(); ++i )
+	{
+		header.lodPrimitivesFirst[i] = lods_[i].primitivesFirst;
+		header.lodPrimitivesCount[i] = lods_[i].primitivesCount;
+		header.lodError[i] = lods_[i].error;
+	}
+	header.lodRadius = lodRadius_;
+
+
+	// Write to a file of this thread and rename it into place, so loads of
+	// the same file on other threads never see half a cache. Where rename
+	// does not replace, the old cache is removed first and a load in between
+	// only misses the cache
+	std::ostringstream tempPath;
+	tempPath << _path << '.' << std::this_thread::get_id() << ".tmp";
+	std::ofstream ofs( tempPath.str().c_str(), std::ofstream::out |
+											   std::ofstream::binary );
+	if ( ofs.fail() )
+		GEM_THROW( "Could not open file " + tempPath.str() );
 
 
-	// close file and report sucess
+	// write header and payloads with zero padding in between
+	const char padding[GMB_ALIGNMENT] = { 0 };
+	ofs.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	for ( unsigned int i = 0; i <= MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		Allocator& store = i < MAX_VERTEX_ATTRIBUTES ? vertexAttributes_[i] :
+													   primitives_;
+		unsigned int offset = i < MAX_VERTEX_ATTRIBUTES ?
+			header.attributeOffset[i] : header.primitivesOffset;
+		if ( !store.isAlloc() )
+			continue;
+		ofs.write( padding, offset - static_cast<unsigned int>( ofs.tellp() ) );
+		ofs.write( store.getReadPtr<char>(), store.getByteCount() );
+	}
 	ofs.close();
+	if ( ofs.fail() )
+	{
+		std::remove( tempPath.str().c_str() );
+		GEM_THROW( "Could not write file " + tempPath.str() );
+	}
+	if ( std::rename( tempPath.str().c_str(), _path.c_str() ) != 0 &&
+		 ( std::remove( _path.c_str() ) != 0 ||
+		   std::rename( tempPath.str().c_str(), _path.c_str() ) != 0 ) )
+	{
+		std::remove( tempPath.str().c_str() );
+		GEM_THROW( "Could not replace file " + _path );
+	}
+}
+
+void
+MeshLoader::saveCache( const std::string& _path )
+{
+	// failing to write the cache is not an error for the load
+	GMBHEADER source;
+	try
+	{
+		if ( getSource( _path, &source ) )
+			saveGMB( _path + ".gmb", &source );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_WARNING( e.what() );
+	}
+}
+
+bool
+MeshLoader::getSource( const std::string& _path, GMBHEADER* _source ) const
+{
+	// size and modification time of file
+	struct stat status;
+	if ( stat( _path.c_str(), &status ) != 0 )
+		return false;
+
+
+	// FNV-1a hash of path
+	unsigned int hash = 2166136261u;
+	for ( unsigned int i = 0; i < _path.size(); ++i )
+		hash = ( hash ^ static_cast<unsigned char>( _path[i] ) ) * 16777619u;
+
+
+	// FNV-1a hash of parser revision and options that change the result
+	unsigned int weldBits;
+	std::memcpy( &weldBits, &weldEpsilon_, sizeof( weldBits ) );
+	unsigned int options = 2166136261u;
+	options = ( options ^ GMB_PARSER_REVISION ) * 16777619u;
+	options = ( options ^ weldBits ) * 16777619u;
+	options = ( options ^ ( isOptimizeEnabled_ ? 1u : 0u ) ) * 16777619u;
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+		options = ( options ^ loadFormats_[i] ) * 16777619u;
+	options = ( options ^ ( isIndexNarrowingEnabled_ ? 1u : 0u ) ) * 16777619u;
+	options = ( options ^ loadLODCount_ ) * 16777619u;
+
+
+	std::memset( _source, 0, sizeof( GMBHEADER ) );
+	_source->sourcePathHash = hash;
+	_source->sourceOptions = options;
+	_source->sourceSize = static_cast<unsigned long long>( status.st_size );
+	_source->sourceTime = static_cast<unsigned long long>( status.st_mtime );
+	return true;
+}
+
+void
+MeshLoader::saveOBJ( const std::string& _path )
+{
+	// open file for writing
+	std::ofstream ofs( _path.c_str(), std::ofstream::out |
+									  std::ofstream::binary );
+	if ( ofs.fail() )
+		GEM_THROW( "Could not open file " + _path );
+
+
+	// formatting buffers, one per thread and reused for every command
+	std::vector< std::vector<char> > buffers(
+		parseMode_ == PARSE_MODE_PARALLEL ?
+		std::max( 1u, std::thread::hardware_concurrency() ) : 1 );
+
+
+	// positions, texture coordinates and normals, only floats
+	static const unsigned int attrs[3] = { 0, 8, 2 };
+	static const char* const commands[3] = { "v", "vt", "vn" };
+	bool hasAttr[3];
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		Allocator& store = vertexAttributes_[attrs[i]];
+		hasAttr[i] = store.isAlloc() && store.getType() == ALLOC_TYPE_32F;
+		if ( hasAttr[i] )
+			writeOBXLines( ofs, commands[i], store, NULL, &buffers );
+	}
+
+
+	// faces refer to every attribute written, with the same index as there
+	// is one index space
+	const char* corner = hasAttr[1] && hasAttr[2] ? "#/#/#" :
+						 hasAttr[1] ? "#/#" : hasAttr[2] ? "#//#" : "#";
+	if ( primitives_.isAlloc() && primitives_.getType() == ALLOC_TYPE_32UI )
+		writeOBXLines( ofs, "f", primitives_, corner, &buffers );
+}
+
+void
+MeshLoader::saveOBX( const std::string& _path )
+{
+	// open file for writing
+	std::ofstream ofs( _path.c_str(), std::ofstream::out |
+									  std::ofstream::binary );
+	if ( ofs.fail() )
+		GEM_THROW( "Could not open file " + _path );
+
+
+	// formatting buffers, one per thread and reused for every command
+	std::vector< std::vector<char> > buffers(
+		parseMode_ == PARSE_MODE_PARALLEL ?
+		std::max( 1u, std::thread::hardware_concurrency() ) : 1 );
+
+
+	// every attribute as v<attr>f or v<attr>i
+	for ( unsigned int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i )
+	{
+		Allocator& store = vertexAttributes_[i];
+		if ( !store.isAlloc() || ( store.getType() != ALLOC_TYPE_32F &&
+								   store.getType() != ALLOC_TYPE_32UI ) )
+			continue;
+		std::stringstream command;
+		command << "v" << i << ( store.getType() == ALLOC_TYPE_32F ? "f"
+																	: "i" );
+		writeOBXLines( ofs, command.str().c_str(), store, NULL, &buffers );
+	}
+
+
+	// faces with a single index for all attributes
+	if ( primitives_.isAlloc() && primitives_.getType() == ALLOC_TYPE_32UI )
+		writeOBXLines( ofs, "f", primitives_, "#", &buffers );
+}
+
+void
+MeshLoader::writeOBXLines( std::ofstream& _ofs, const char* _command,
+						   Allocator& _store, const char* _corner,
+						   std::vector< std::vector<char> >* _buffers )
+{
+	// one line per element of the store, chunks of lines are formatted in
+	// parallel, one per buffer, and written in order
+	const unsigned int chunkCount = 1 << 16;
+	const unsigned int lineCount = _store.getElementCount();
+	const unsigned int bufferCount =
+		static_cast<unsigned int>( _buffers->size() );
+	std::vector<OBXLINES> lines( bufferCount );
+	for ( unsigned int first = 0; first < lineCount;
+		  first += chunkCount * bufferCount )
+	{
+		unsigned int usedCount = 0;
+		for ( ; usedCount < bufferCount &&
+				first + usedCount * chunkCount < lineCount; ++usedCount )
+		{
+			OBXLINES& chunk = lines[usedCount];
+			chunk.command = _command;
+			chunk.data = _store.getReadPtr<void>();
+			chunk.type = _store.getType();
+			chunk.dim = _store.getDim();
+			chunk.corner = _corner;
+			chunk.first = first + usedCount * chunkCount;
+			chunk.last = std::min( chunk.first + chunkCount, lineCount );
+			chunk.text = &(*_buffers)[usedCount];
+			chunk.length = 0;
+		}
+		std::vector<std::thread> workers;
+		for ( unsigned int i = 1; i < usedCount; ++i )
+			workers.push_back( std::thread( &MeshLoader::formatOBXLines,
+											&lines[i] ) );
+		formatOBXLines( &lines[0] );
+		for ( unsigned int i = 0; i < workers.size(); ++i )
+			workers[i].join();
+		for ( unsigned int i = 0; i < usedCount; ++i )
+			_ofs.write( &(*lines[i].text)[0], lines[i].length );
+	}
+	if ( _ofs.fail() )
+		GEM_THROW( "Could not write file." );
 }
 
+void
+MeshLoader::formatOBXLines( OBXLINES* _lines )
+{
+	// worst case size of a line, numbers take at most 24 characters and
+	// corner indices 11 each
+	size_t commandLength = std::strlen( _lines->command );
+	size_t elementLength = _lines->corner ?
+		std::strlen( _lines->corner ) * 11 + 1 : 25;
+	size_t lineLength = commandLength + _lines->dim * elementLength + 1;
+	size_t byteCount = ( _lines->last - _lines->first ) * lineLength;
+	if ( _lines->text->size() < byteCount )
+		_lines->text->resize( byteCount );
+
+
+	// command, then the elements separated by spaces
+	char* begin = &(*_lines->text)[0];
+	char* p = begin;
+	const float* floats = static_cast<const float*>( _lines->data );
+	const unsigned int* uints =
+		static_cast<const unsigned int*>( _lines->data );
+	for ( unsigned int i = _lines->first; i < _lines->last; ++i )
+	{
+		p = std::copy( _lines->command, _lines->command + commandLength, p );
+		for ( unsigned int j = i * _lines->dim; j < ( i + 1 ) * _lines->dim;
+			  ++j )
+		{
+			*p++ = ' ';
+			if ( _lines->corner )
+			{
+				for ( const char* c = _lines->corner; *c; ++c )
+				{
+					if ( *c == '#' )
+						p = formatUInt( p, uints[j] + 1 );
+					else
+						*p++ = *c;
+				}
+			}
+			else if ( _lines->type == ALLOC_TYPE_32F )
+			{
+				p = formatFloat( p, floats[j] );
+			}
+			else
+			{
+				p = formatUInt( p, uints[j] );
+			}
+		}
+		*p++ = '\n';
+	}
+	_lines->length = p - begin;
+}
 
 //==============================================================================
 GEM_END_NAMESPACE
@@ -3,6 +3,7 @@
 #include "GemRenderState.h"
 #include "GemMeshLoader.h"
 #include "GemTextureLoader.h"
+#include "GemBlockCompression.h"
 #include "GemShaderLoader.h"
 #include "GemTracker.h"
 
@@ -18,6 +19,9 @@ GEM_BEGIN_NAMESPACE
 //-- define static members -----------------------------------------------------
 
 std::map<const Allocator*,BufferState> RenderState::bufferStates_;
+unsigned int RenderState::uploadByteCount_ = 0;
+unsigned int RenderState::lastFrameUploadByteCount_ = 0;
+float RenderState::fullUploadFraction_ = 0.5f;
 
 
 //-- constructors/destructor ---------------------------------------------------
@@ -74,6 +78,9 @@ RenderState::clear()
 	viewportHeight_ = 0;
 	viewportWidthPtr_ = &viewportWidth_;
 	viewportHeightPtr_ = &viewportHeight_;
+	// draw range
+	drawFirst_ = 0;
+	drawCount_ = ~0u;
 }
 
 //-- the star function of the entire library -----------------------------------
@@ -200,23 +207,29 @@ RenderState::draw()
 	// ----
 	// What: glDrawElements() flushes all the data through the pipeline
 	// When: Every frame
+	GLuint drawFirst = std::min( drawFirst_, vertexState_.getIndexCount() );
+	GLuint drawCount = std::min( drawCount_,
+								 vertexState_.getIndexCount() - drawFirst );
+	GLuint indexSize =
+		vertexState_.getIndexType() == GL_UNSIGNED_SHORT ? 2 : 4;
+	const GLvoid* drawOffset = reinterpret_cast<const GLvoid*>(
+		static_cast<size_t>( drawFirst ) * vertexState_.getIndexDim() *
+		indexSize );
 	if ( programState_.hasTesselator() )
 	{
 		glPatchParameteri( GL_PATCH_VERTICES,
 						   vertexState_.getIndexDim() );
 		glDrawElements( GL_PATCHES,
-						vertexState_.getIndexDim()*
-						vertexState_.getIndexCount(),
+						vertexState_.getIndexDim()*drawCount,
 						vertexState_.getIndexType(),
-						0 );
+						drawOffset );
 	}
 	else
 	{
 		glDrawElements( vertexState_.getDrawMode(),
-						vertexState_.getIndexDim()*
-						vertexState_.getIndexCount(),
+						vertexState_.getIndexDim()*drawCount,
 						vertexState_.getIndexType(),
-						0 );
+						drawOffset );
 	}
 
 
@@ -252,6 +265,15 @@ RenderState::draw()
 
 }
 
+//== UPLOAD STATISTICS =========================================================
+
+void
+RenderState::newFrame()
+{
+	lastFrameUploadByteCount_ = uploadByteCount_;
+	uploadByteCount_ = 0;
+}
+
 //== OPENGL FLAGS & VARS =======================================================
 
 //-- sets and gets -------------------------------------------------------------
@@ -314,6 +336,14 @@ RenderState::setViewportPtr( const unsigned int* _viewportWidthPtr,
 	viewportHeightPtr_ = _viewportHeightPtr;
 }
 
+void
+RenderState::setDrawRange( const unsigned int _primitivesFirst,
+						   const unsigned int _primitivesCount )
+{
+	drawFirst_ = _primitivesFirst;
+	drawCount_ = _primitivesCount;
+}
+
 
 //-- modify opengl state -------------------------------------------------------
 
@@ -362,7 +392,9 @@ BufferState::clear()
 	uploadCount_ = 0;
 	packCount_ = 0;
 	feedbackCount_ = 0;
+	uploadByteCount_ = 0;
 	isDeclared_ = 0;
+	isFullUpload_ = false;
 }
 
 
@@ -438,6 +470,11 @@ BufferState::declare()
 	// this buffer is now declared, let everyone know
 	declareCount_++;
 	isDeclared_ = true;
+
+
+	// New storage has no content, dirty ranges are meaningless until the
+	// whole buffer has been uploaded once
+	isFullUpload_ = true;
 }
 
 void
@@ -496,17 +533,44 @@ BufferState::upload()
 	}
 
 
-	// The buffer is uploaded here
+	// The buffer is uploaded here. Only the dirty ranges are sent unless the
+	// buffer is new or most of it has changed, then glBufferData() sends it
+	// all and orphans the old storage so we dont stall on pending draws
+	unsigned int byteCount = allocatorPtr_->getByteCount();
+	unsigned int dirtyCount = allocatorPtr_->getDirtyByteCount();
 	glBindBuffer( initialTarget_, bufferID_ );
-	glBufferData( initialTarget_,
-					allocatorPtr_->getByteCount(),
-					allocatorPtr_->getReadPtr<GLvoid>(),
-					initialUsage_ );
+	if ( isFullUpload_ ||
+		 dirtyCount > RenderState::fullUploadFraction_ * byteCount )
+	{
+		glBufferData( initialTarget_,
+						byteCount,
+						allocatorPtr_->getReadPtr<GLvoid>(),
+						initialUsage_ );
+		dirtyCount = byteCount;
+		isFullUpload_ = false;
+	}
+	else
+	{
+		const std::vector<Allocator::Range>& ranges =
+			allocatorPtr_->getDirtyRanges();
+		for ( unsigned int i=0; i<ranges.size(); ++i )
+		{
+			unsigned int count = ranges[i].second - ranges[i].first;
+			glBufferSubData( initialTarget_,
+							 ranges[i].first,
+							 count,
+							 allocatorPtr_->getReadPtr<unsigned char>(
+								ranges[i].first, count ) );
+		}
+	}
 	glBindBuffer( initialTarget_, 0 );
+	allocatorPtr_->clearDirtyRanges();
 
 
 	// this buffer has been uploaded, let everyone know
 	uploadCount_++;
+	uploadByteCount_ += dirtyCount;
+	RenderState::uploadByteCount_ += dirtyCount;
 }
 
 void
@@ -533,6 +597,11 @@ BufferState::download()
 							allocatorPtr_->getByteCount(),
 							allocatorPtr_->getWritePtr<GLvoid>() );
 		glBindBuffer( initialTarget_, 0 );
+
+
+		// RAM now matches the buffer, dont send it back on next upload
+		trackerWriteCount_.greaterPtrCpy();
+		allocatorPtr_->clearDirtyRanges();
 	}
 }
 
@@ -634,6 +703,7 @@ VertexState::clear()
 	{
 		attributeDim_[i] = GL_NONE;
 		attributeType_[i] = GL_NONE;
+		attributeNormalized_[i] = GL_FALSE;
 	}
 
 	// BufferStates and trackers
@@ -705,6 +775,18 @@ RenderState::setMesh( MeshLoader* const _meshLoaderPtr )
 	}
 
 
+	// meshes with levels of detail draw level 0 until told otherwise
+	if ( _meshLoaderPtr->getLODCount() > 1 )
+	{
+		MeshLoader::LODLEVEL lod = _meshLoaderPtr->getLOD( 0 );
+		setDrawRange( lod.primitivesFirst, lod.primitivesCount );
+	}
+	else
+	{
+		setDrawRange();
+	}
+
+
 	// for each vertex attribute slot we loop through the storage to see if
 	// it has data
 	for ( unsigned int i=0; i<MAX_VERTEX_ATTRIBUTES; ++i )
@@ -827,12 +909,12 @@ VertexState::declare()
 	switch ( indexBufferPtr_->getAllocatorPtr()->getFormat() )
 	{
 	case ALLOC_FORMAT_SCALAR_32UI:
-		drawMode_ = GL_POINT;
+		drawMode_ = GL_POINTS;
 		indexDim_ = 1;
 		indexType_ = GL_UNSIGNED_INT;
 		break;
 	case ALLOC_FORMAT_VEC2_32UI:
-		drawMode_ = GL_LINE;
+		drawMode_ = GL_LINES;
 		indexDim_ = 2;
 		indexType_ = GL_UNSIGNED_INT;
 		break;
@@ -846,6 +928,26 @@ VertexState::declare()
 		indexDim_ = 4;
 		indexType_ = GL_UNSIGNED_INT;
 		break;
+	case ALLOC_FORMAT_SCALAR_16UI:
+		drawMode_ = GL_POINTS;
+		indexDim_ = 1;
+		indexType_ = GL_UNSIGNED_SHORT;
+		break;
+	case ALLOC_FORMAT_VEC2_16UI:
+		drawMode_ = GL_LINES;
+		indexDim_ = 2;
+		indexType_ = GL_UNSIGNED_SHORT;
+		break;
+	case ALLOC_FORMAT_VEC3_16UI:
+		drawMode_ = GL_TRIANGLES;
+		indexDim_ = 3;
+		indexType_ = GL_UNSIGNED_SHORT;
+		break;
+	case ALLOC_FORMAT_VEC4_16UI:
+		drawMode_ = GL_QUADS;
+		indexDim_ = 4;
+		indexType_ = GL_UNSIGNED_SHORT;
+		break;
 	default:
 		drawMode_ = GL_NONE;
 		indexDim_ = 0;
@@ -855,8 +957,13 @@ VertexState::declare()
 	indexCount_ = indexBufferPtr_->getAllocatorPtr()->getElementCount();
 
 
+	// Narrow formats are converted to floats by the GL as they are fetched.
+	// Half floats as they are, octahedral unit vectors and 2_10_10_10 as
+	// signed normalized, i.e. mapped to [-1,1]. Octahedral vectors still
+	// have to be unfolded to three components in the shader.
 	for ( unsigned int i=0; i<MAX_VERTEX_ATTRIBUTES; ++i )
 	{
+		attributeNormalized_[i] = GL_FALSE;
 		if ( attributeBufferPtr_[i] && 
 			 attributeBufferPtr_[i]->getAllocatorPtr() )
 		{
@@ -894,6 +1001,28 @@ VertexState::declare()
 				attributeDim_[i] = 4;
 				attributeType_[i] = GL_FLOAT;
 				break;
+			case ALLOC_FORMAT_VEC2_16F:
+				attributeDim_[i] = 2;
+				attributeType_[i] = GL_HALF_FLOAT;
+				break;
+			case ALLOC_FORMAT_VEC3_16F:
+				attributeDim_[i] = 3;
+				attributeType_[i] = GL_HALF_FLOAT;
+				break;
+			case ALLOC_FORMAT_VEC4_16F:
+				attributeDim_[i] = 4;
+				attributeType_[i] = GL_HALF_FLOAT;
+				break;
+			case ALLOC_FORMAT_VEC2_16I:
+				attributeDim_[i] = 2;
+				attributeType_[i] = GL_SHORT;
+				attributeNormalized_[i] = GL_TRUE;
+				break;
+			case ALLOC_FORMAT_VEC4_2_10_10_10:
+				attributeDim_[i] = 4;
+				attributeType_[i] = GL_INT_2_10_10_10_REV;
+				attributeNormalized_[i] = GL_TRUE;
+				break;
 			default:
 				attributeDim_[i] = 0;
 				attributeType_[i] = GL_NONE;
@@ -956,7 +1085,8 @@ VertexState::declare()
 			glBindBuffer( GL_ARRAY_BUFFER, 
 						  attributeBufferPtr_[i]->getBufferID() );
 			glVertexAttribPointer( i, attributeDim_[i],
-								   attributeType_[i], GL_FALSE, 0, 0);
+								   attributeType_[i], attributeNormalized_[i],
+								   0, 0);
 			glEnableVertexAttribArray( i );
 		}
 	}
@@ -2150,6 +2280,8 @@ TextureState::clear()
 	}
 	textureUnit_ = TEXTURE_UNIT_0;
 	mipLevelCount_ = 0;
+	textureTarget_ = TEXTURE_TARGET_2D;
+	layerCount_ = 1;
 
 	// Counters and flags
 	isDeclared_ = false;
@@ -2187,6 +2319,33 @@ TextureState::setMipMap( BufferState* const _bufferStatePtr,
 		_bufferStatePtr->getPackCountPtr(), 0 );
 }
 
+void
+TextureState::setTarget( const TEXTURE_TARGET _textureTarget,
+						 const unsigned int _layerCount )
+{
+	// initial error handling
+	const bool isCube = _textureTarget == TEXTURE_TARGET_CUBE_MAP ||
+						_textureTarget == TEXTURE_TARGET_CUBE_MAP_ARRAY;
+	if ( _layerCount == 0 || ( isCube && _layerCount % 6 != 0 ) ||
+		 ( _textureTarget == TEXTURE_TARGET_2D && _layerCount != 1 ) )
+	{
+		GEM_ERROR( "Layer count does not fit the texture target." );
+	}
+
+
+	// declare and unpack again on change, as for new mip levels
+	if ( _textureTarget != textureTarget_ || _layerCount != layerCount_ )
+	{
+		for ( unsigned int i = 0; i < mipLevelCount_; ++i )
+		{
+			if ( bufferStatePtr_[i] )
+				setMipMap( bufferStatePtr_[i], i );
+		}
+	}
+	textureTarget_ = _textureTarget;
+	layerCount_ = _layerCount;
+}
+
 void
 RenderState::setTexture( TextureLoader* const _textureLoaderPtr,
 						 TEXTURE_UNIT _textureUnit )
@@ -2207,6 +2366,12 @@ RenderState::setTexture( TextureLoader* const _textureLoaderPtr,
 	{
 		setTexture( _textureLoaderPtr->getMipLevePtr( i ), _textureUnit, i );
 	}
+
+
+	// cube maps and arrays upload as one texture
+	textureStates_[_textureUnit].setTarget(
+		_textureLoaderPtr->getTextureTarget(),
+		_textureLoaderPtr->getLayerCount() );
 }
 
 void
@@ -2356,6 +2521,84 @@ TextureState::declare()
 		format_ = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
 		type_ = GL_UNSIGNED_BYTE;
 		break;
+	case ALLOC_FORMAT_VEC4_DXT5:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		format_ = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_SCALAR_BC4:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_COMPRESSED_RED_RGTC1;
+		format_ = GL_COMPRESSED_RED_RGTC1;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_VEC2_BC5:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_COMPRESSED_RG_RGTC2;
+		format_ = GL_COMPRESSED_RG_RGTC2;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_VEC2_8UI:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_RG8;
+		format_ = GL_RG;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_VEC4_8UI:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_RGBA8;
+		format_ = GL_RGBA;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_SCALAR_16F:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_R16F;
+		format_ = GL_RED;
+		type_ = GL_HALF_FLOAT;
+		break;
+	case ALLOC_FORMAT_VEC2_16F:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_RG16F;
+		format_ = GL_RG;
+		type_ = GL_HALF_FLOAT;
+		break;
+	case ALLOC_FORMAT_VEC4_16F:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_RGBA16F;
+		format_ = GL_RGBA;
+		type_ = GL_HALF_FLOAT;
+		break;
+	case ALLOC_FORMAT_VEC2_32F:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_RG32F;
+		format_ = GL_RG;
+		type_ = GL_FLOAT;
+		break;
+	case ALLOC_FORMAT_VEC4_32F:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_RGBA32F;
+		format_ = GL_RGBA;
+		type_ = GL_FLOAT;
+		break;
+	case ALLOC_FORMAT_VEC4_DXT3:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		format_ = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_VEC3_BC6H:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+		format_ = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
+	case ALLOC_FORMAT_VEC4_BC7:
+		target_ = GL_TEXTURE_2D;
+		internalFormat_ = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		format_ = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		type_ = GL_UNSIGNED_BYTE;
+		break;
 	default:
 		target_ = GL_NONE;
 		internalFormat_ = GL_NONE;
@@ -2365,6 +2608,23 @@ TextureState::declare()
 	}
 
 
+	// cube maps and arrays, every layer of a level in one allocator
+	switch ( textureTarget_ )
+	{
+	case TEXTURE_TARGET_2D_ARRAY:
+		target_ = GL_TEXTURE_2D_ARRAY;
+		break;
+	case TEXTURE_TARGET_CUBE_MAP:
+		target_ = GL_TEXTURE_CUBE_MAP;
+		break;
+	case TEXTURE_TARGET_CUBE_MAP_ARRAY:
+		target_ = GL_TEXTURE_CUBE_MAP_ARRAY;
+		break;
+	default:
+		break;
+	}
+
+
 	// Create the texture names and specify format.
 	//
 	// http://www.openorg/sdk/docs/man4/xhtml/glGenTextures.xml
@@ -2392,6 +2652,9 @@ TextureState::declare()
 	//
 	//		w_i = floor( w_0 / 2^i )
 	//
+	// Cube maps declare each face, arrays all layers of a level at once with
+	// the layers as depth.
+	//
 	glGenTextures( 1, &textureID_ );
 	glBindTexture( target_, textureID_ );
 
@@ -2402,7 +2665,8 @@ TextureState::declare()
 		{
 
 			double w = bufferStatePtr_[0]->getAllocatorPtr()->getWidth();
-			double h = bufferStatePtr_[0]->getAllocatorPtr()->getHeight();
+			double h = bufferStatePtr_[0]->getAllocatorPtr()->getHeight() /
+					   layerCount_;
 			w = std::max( std::floor( w / (1 << i) ), 1.0 );
 			h = std::max( std::floor( h / (1 << i) ), 1.0 );
 
@@ -2413,37 +2677,82 @@ TextureState::declare()
 				bufferStatePtr_[i]->getAllocatorPtr()->getByteCount();
 
 
-			if ( allocType == ALLOC_TYPE_DXT1 )
+			if ( target_ == GL_TEXTURE_2D_ARRAY ||
+				 target_ == GL_TEXTURE_CUBE_MAP_ARRAY )
 			{
-				glCompressedTexImage2D(
-					target_,							// target
-					i,									// mipmap level
-					internalFormat_,					// internal format
-					w,									// mipmap width
-					h,									// mipmap height
-					0,									// border
-					byteCount,							// image size
-					NULL );								// data ptr
+				if ( isBlockCompressed( allocType ) )
+				{
+					glCompressedTexImage3D(
+						target_,						// target
+						i,								// mipmap level
+						internalFormat_,				// internal format
+						w,								// mipmap width
+						h,								// mipmap height
+						layerCount_,					// layers
+						0,								// border
+						byteCount,						// image size
+						NULL );							// data ptr
+				}
+				else
+				{
+					glTexImage3D(
+						target_,						// target
+						i,								// mipmap level
+						internalFormat_,				// internal format
+						w,								// mipmap width
+						h,								// mipmap height
+						layerCount_,					// layers
+						0,								// border
+						format_,						// format
+						type_,							// type
+						NULL );							// data ptr
+				}
+				continue;
 			}
 
 
-			else
+			for ( unsigned int face = 0; face < layerCount_; ++face )
 			{
-				glTexImage2D( 
-					target_,							// target
-					i,									// mipmap level
-					internalFormat_,					// internal format
-					w,									// mipmap width
-					h,									// mipmap height
-					0,									// border
-					format_,							// format
-					type_,								// type
-					NULL );								// data ptr
+				GLenum faceTarget = target_ == GL_TEXTURE_CUBE_MAP ?
+					GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target_;
+				if ( isBlockCompressed( allocType ) )
+				{
+					glCompressedTexImage2D(
+						faceTarget,						// target
+						i,								// mipmap level
+						internalFormat_,				// internal format
+						w,								// mipmap width
+						h,								// mipmap height
+						0,								// border
+						byteCount / layerCount_,		// image size
+						NULL );							// data ptr
+				}
+				else
+				{
+					glTexImage2D( 
+						faceTarget,						// target
+						i,								// mipmap level
+						internalFormat_,				// internal format
+						w,								// mipmap width
+						h,								// mipmap height
+						0,								// border
+						format_,						// format
+						type_,							// type
+						NULL );							// data ptr
+				}
 			}
 		}
 	}
 
 
+	// a chain that stops before 1x1, such as an atlas page, is complete up
+	// to its last level
+	if ( mipLevelCount_ > 0 )
+	{
+		glTexParameteri( target_, GL_TEXTURE_MAX_LEVEL, mipLevelCount_ - 1 );
+	}
+
+
 	//glGenerateMipmap( textureTarget_ );
 	//glTexParameteri( textureTarget_, GL_GENERATE_MIPMAP, GL_TRUE );
 	glBindTexture( target_, 0 );
@@ -2483,6 +2792,13 @@ TextureState::declare()
 		glSamplerParameteri( samplerID_, GL_TEXTURE_WRAP_S, GL_REPEAT );
 		glSamplerParameteri( samplerID_, GL_TEXTURE_WRAP_T, GL_REPEAT );
 	}
+	if ( target_ == GL_TEXTURE_CUBE_MAP ||
+		 target_ == GL_TEXTURE_CUBE_MAP_ARRAY )
+	{
+		glSamplerParameteri( samplerID_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glSamplerParameteri( samplerID_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glSamplerParameteri( samplerID_, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+	}
 	
 
 	// texture data is now declared
@@ -2555,6 +2871,9 @@ TextureState::unpack()
 	// http://www.openorg/sdk/docs/man4/xhtml/glCompressedTexSubImage2D.xml
 	// https://www.openorg/sdk/docs/man4/xhtml/glTexSubImage2D.xml
 	//
+	// Arrays unpack all layers of a level at once, cube maps a face at a
+	// time from its offset in the buffer.
+	//
 	glBindTexture( target_, textureID_ );
 
 	for ( unsigned int i = 0; i<mipLevelCount_; ++i )
@@ -2563,11 +2882,13 @@ TextureState::unpack()
 		{
 
 			double w = bufferStatePtr_[0]->getAllocatorPtr()->getWidth();
-			double h = bufferStatePtr_[0]->getAllocatorPtr()->getHeight();
+			double h = bufferStatePtr_[0]->getAllocatorPtr()->getHeight() /
+					   layerCount_;
 			w = std::max( std::floor( w / (1 << i) ), 1.0 );
 			h = std::max( std::floor( h / (1 << i) ), 1.0 );
 			if ( w > bufferStatePtr_[i]->getAllocatorPtr()->getWidth() ||
-				 h > bufferStatePtr_[i]->getAllocatorPtr()->getHeight() )
+				 h * layerCount_ >
+				 bufferStatePtr_[i]->getAllocatorPtr()->getHeight() )
 			{
 				GEM_ERROR( "The allocator is smaller than what is"
 							"required for this mip level " + i );
@@ -2584,33 +2905,78 @@ TextureState::unpack()
 						  bufferStatePtr_[i]->getBufferID() );
 
 
-			if ( allocType == ALLOC_TYPE_DXT1 )
+			if ( target_ == GL_TEXTURE_2D_ARRAY ||
+				 target_ == GL_TEXTURE_CUBE_MAP_ARRAY )
 			{
-				glCompressedTexSubImage2D(
-					target_,							// target
-					i,									// mipmap level
-					0,									// xoffset
-					0,									// yoffset
-					w,									// mipmap width
-					h,									// mipmap height
-					format_,							// format
-					byteCount,							// image size
-					NULL );								// *data
+				if ( isBlockCompressed( allocType ) )
+				{
+					glCompressedTexSubImage3D(
+						target_,						// target
+						i,								// mipmap level
+						0,								// xoffset
+						0,								// yoffset
+						0,								// zoffset
+						w,								// mipmap width
+						h,								// mipmap height
+						layerCount_,					// layers
+						format_,						// format
+						byteCount,						// image size
+						NULL );							// *data
+				}
+				else
+				{
+					glTexSubImage3D(
+						target_,						// target
+						i,								// mipmap level
+						0,								// xoffset
+						0,								// yoffset
+						0,								// zoffset
+						w,								// texture width
+						h,								// texture height
+						layerCount_,					// layers
+						format_,						// format
+						type_,							// type
+						NULL );							// *data
+				}
 			}
 
 
 			else
 			{
-				glTexSubImage2D(
-					target_,							// target
-					i,									// mipmap level
-					0,									// xoffset
-					0,									// yoffset
-					w,									// texture width
-					h,									// texture height
-					format_,							// format
-					type_,							// type
-					NULL );								// *data
+				for ( unsigned int face = 0; face < layerCount_; ++face )
+				{
+					GLenum faceTarget = target_ == GL_TEXTURE_CUBE_MAP ?
+						GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target_;
+					const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+						static_cast<size_t>( face ) *
+						( byteCount / layerCount_ ) );
+					if ( isBlockCompressed( allocType ) )
+					{
+						glCompressedTexSubImage2D(
+							faceTarget,					// target
+							i,							// mipmap level
+							0,							// xoffset
+							0,							// yoffset
+							w,							// mipmap width
+							h,							// mipmap height
+							format_,					// format
+							byteCount / layerCount_,	// image size
+							offset );					// *data
+					}
+					else
+					{
+						glTexSubImage2D(
+							faceTarget,					// target
+							i,							// mipmap level
+							0,							// xoffset
+							0,							// yoffset
+							w,							// texture width
+							h,							// texture height
+							format_,					// format
+							type_,						// type
+							offset );					// *data
+					}
+				}
 			}
 
 
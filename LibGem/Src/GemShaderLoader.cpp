@@ -143,6 +143,41 @@ ShaderLoader::reload()
 	}
 }
 
+LoadHandle
+ShaderLoader::loadAsync( const std::string& _path,
+						 const SHADER_TYPE _shaderType )
+{
+	// the staged loader is swapped with this one when read, see Loader. The
+	// source is moved so the RenderStates see its counters go up
+	std::shared_ptr<ShaderLoader> staged( new ShaderLoader() );
+	return submitLoad( _path, staged,
+		[_path, _shaderType]( Loader* _staged ) -> bool
+		{
+			ShaderLoader* shader = static_cast<ShaderLoader*>( _staged );
+			shader->load( _path, _shaderType );
+			return shader->isLoaded();
+		},
+		[]( Loader* _target, Loader* _staged )
+		{
+			ShaderLoader* target = static_cast<ShaderLoader*>( _target );
+			ShaderLoader* staged = static_cast<ShaderLoader*>( _staged );
+			std::swap( target->path_, staged->path_ );
+			std::swap( target->shaderType_, staged->shaderType_ );
+			Allocator source( std::move( target->source_ ) );
+			target->source_ = std::move( staged->source_ );
+			staged->source_ = std::move( source );
+			target->isLoaded_ = true;
+		} );
+}
+
+LoadHandle
+ShaderLoader::reloadAsync()
+{
+	if ( !isLoaded_ )
+		return LoadHandle();
+	return loadAsync( path_, shaderType_ );
+}
+
 
 //-- private file-io -------------------------------------------------------
 
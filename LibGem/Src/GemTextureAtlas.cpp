@@ -0,0 +1,412 @@
+//== INCLUDES ==================================================================
+
+#include "GemTextureAtlas.h"
+#include "GemBlockCompression.h"
+
+
+//== NAMESPACES ================================================================
+
+GEM_BEGIN_NAMESPACE
+
+
+//== CLASS DEFINITION ==========================================================
+
+//-- constructors/destructor ---------------------------------------------------
+
+TextureAtlas::TextureAtlas()
+: maxPageSize_( ATLAS_PAGE_SIZE )
+, mipLevelCount_( ATLAS_MIP_LEVELS )
+, padding_( ATLAS_PADDING )
+, pages_()
+, entries_()
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	clear();
+}
+
+
+//-- copy and clear ------------------------------------------------------------
+
+void
+TextureAtlas::clear()
+{
+	pages_.clear();
+	entries_.clear();
+}
+
+
+//-- build ---------------------------------------------------------------------
+
+void
+TextureAtlas::build( TextureLoader* const* _textures,
+					 const unsigned int _textureCount )
+{
+	// argument checks
+	if ( !_textures && _textureCount )
+		GEM_ERROR( "Texture argument is NULL." );
+	if ( mipLevelCount_ < 1 || mipLevelCount_ > MAX_MIP_LEVELS )
+		GEM_ERROR( "Invalid mip level count." );
+	if ( maxPageSize_ < getAlignment() ||
+		 ( maxPageSize_ & ( maxPageSize_ - 1 ) ) )
+		GEM_ERROR( "Page size is not a power of two as large as a cell." );
+
+
+	// always build new
+	clear();
+
+
+	// pack, then fill each page and filter its levels
+	try
+	{
+		std::vector<ATLASBIN> bins;
+		packTextures( _textures, _textureCount, bins );
+		const unsigned int alignment = getAlignment();
+		pages_.resize( bins.size() );
+		for ( unsigned int i = 0; i < bins.size(); ++i )
+		{
+			unsigned int width = alignment;
+			unsigned int height = alignment;
+			while ( width < bins[i].usedWidth * alignment )
+				width *= 2;
+			while ( height < bins[i].usedHeight * alignment )
+				height *= 2;
+			pages_[i].create( width, height, bins[i].textureFormat );
+			fillPage( _textures, _textureCount, i );
+			pages_[i].generateMipLevels( MIP_FILTER_BOX, mipLevelCount_ );
+		}
+
+
+		// texcoords of each texture on its page
+		for ( unsigned int i = 0; i < entries_.size(); ++i )
+		{
+			ATLASENTRY& entry = entries_[i];
+			const float width = static_cast<float>(
+				pages_[entry.page].getMipLevePtr( 0 )->getWidth() );
+			const float height = static_cast<float>(
+				pages_[entry.page].getMipLevePtr( 0 )->getHeight() );
+			entry.uvScale = Vec2f( entry.width / width,
+								   entry.height / height );
+			entry.uvOffset = Vec2f( entry.x / width, entry.y / height );
+		}
+	}
+	catch( const std::exception& e )
+	{
+		clear();
+		GEM_ERROR( e.what() );
+	}
+}
+
+
+//-- private build -------------------------------------------------------------
+
+void
+TextureAtlas::packTextures( TextureLoader* const* _textures,
+							const unsigned int _textureCount,
+							std::vector<ATLASBIN>& _bins )
+{
+	// the cell of each texture, in units of the alignment
+	const unsigned int alignment = getAlignment();
+	const unsigned int border = getBorderSize();
+	const unsigned int maxBinSize = maxPageSize_ / alignment;
+	std::vector<ATLASRECT> cells( _textureCount );
+	std::vector<TEXTURE_FORMAT> formats;
+	std::vector<unsigned int> order( _textureCount );
+	unsigned int largestSide = 1;
+	unsigned long long area = 0;
+	entries_.resize( _textureCount );
+	for ( unsigned int i = 0; i < _textureCount; ++i )
+	{
+		if ( !_textures[i] || !_textures[i]->isLoaded() )
+			GEM_THROW( "Texture is not loaded." );
+		Allocator* level = _textures[i]->getMipLevePtr( 0 );
+		const ALLOC_TYPE type = level->getType();
+		if ( _textures[i]->getLayerCount() != 1 || isBlockCompressed( type ) ||
+			 ( type != ALLOC_TYPE_8UI && type != ALLOC_TYPE_32F ) )
+			GEM_THROW( "Atlas textures must be 8UI or 32F, of one layer and "
+					   "not block compressed." );
+		entries_[i].width = level->getWidth();
+		entries_[i].height = level->getHeight();
+		cells[i].width = ( entries_[i].width + 2 * border + alignment - 1 ) /
+						 alignment;
+		cells[i].height = ( entries_[i].height + 2 * border + alignment - 1 ) /
+						  alignment;
+		if ( cells[i].width > maxBinSize || cells[i].height > maxBinSize )
+			GEM_THROW( "Texture does not fit the atlas page size." );
+		const TEXTURE_FORMAT textureFormat = static_cast<TEXTURE_FORMAT>(
+			level->getFormat() );
+		if ( std::find( formats.begin(), formats.end(), textureFormat ) ==
+			 formats.end() )
+			formats.push_back( textureFormat );
+		largestSide = std::max( largestSide,
+								std::max( cells[i].width, cells[i].height ) );
+		area += cells[i].width * cells[i].height;
+		order[i] = i;
+	}
+
+
+	// largest side first, then largest area, ties in texture order
+	std::sort( order.begin(), order.end(),
+			   [&cells]( const unsigned int a, const unsigned int b ) -> bool
+	{
+		const unsigned int sideA = std::max( cells[a].width, cells[a].height );
+		const unsigned int sideB = std::max( cells[b].width, cells[b].height );
+		if ( sideA != sideB )
+			return sideA > sideB;
+		const unsigned int areaA = cells[a].width * cells[a].height;
+		const unsigned int areaB = cells[b].width * cells[b].height;
+		if ( areaA != areaB )
+			return areaA > areaB;
+		return a < b;
+	} );
+
+
+	// Pages of the smallest powers of two that take all textures of a
+	// format, twice as wide as high or square, starting from one with room
+	// for all of them, else as many pages of the largest size as it takes.
+	// A page bigger than it needs to be spreads the textures over all of
+	// it, since every free rectangle looks as good.
+	unsigned int binWidth = 1;
+	unsigned int binHeight = 1;
+	while ( binHeight < largestSide ||
+			static_cast<unsigned long long>( binWidth ) * binHeight < area )
+		( binWidth == binHeight ? binWidth : binHeight ) *= 2;
+	for ( ;; ( binWidth == binHeight ? binWidth : binHeight ) *= 2 )
+	{
+		binWidth = std::min( binWidth, maxBinSize );
+		binHeight = std::min( binHeight, maxBinSize );
+		// each into the free rectangle of an open page of its format that
+		// leaves the least on its shorter side, or into a new page
+		_bins.clear();
+		for ( unsigned int k = 0; k < _textureCount; ++k )
+		{
+			const unsigned int i = order[k];
+			const TEXTURE_FORMAT textureFormat = static_cast<TEXTURE_FORMAT>(
+				_textures[i]->getMipLevePtr( 0 )->getFormat() );
+			unsigned int bestBin = static_cast<unsigned int>( _bins.size() );
+			unsigned int bestShortSide = 0xffffffff;
+			unsigned int bestLongSide = 0xffffffff;
+			ATLASRECT bestRect;
+			for ( unsigned int b = 0; b < _bins.size(); ++b )
+			{
+				unsigned int shortSide, longSide;
+				ATLASRECT rect;
+				if ( _bins[b].textureFormat == textureFormat &&
+					 findFreeRect( _bins[b], cells[i].width, cells[i].height,
+								   &shortSide, &longSide, &rect ) &&
+					 ( shortSide < bestShortSide ||
+					   ( shortSide == bestShortSide &&
+						 longSide < bestLongSide ) ) )
+				{
+					bestBin = b;
+					bestShortSide = shortSide;
+					bestLongSide = longSide;
+					bestRect = rect;
+				}
+			}
+			if ( bestBin == _bins.size() )
+			{
+				ATLASBIN bin;
+				ATLASRECT whole = { 0, 0, binWidth, binHeight };
+				bin.textureFormat = textureFormat;
+				bin.freeRects.push_back( whole );
+				bin.usedWidth = 0;
+				bin.usedHeight = 0;
+				_bins.push_back( bin );
+				findFreeRect( _bins.back(), cells[i].width, cells[i].height,
+							  &bestShortSide, &bestLongSide, &bestRect );
+			}
+
+
+			// take it, the texture sits inside the border of its cell
+			ATLASBIN& bin = _bins[bestBin];
+			placeRect( bin, bestRect );
+			bin.usedWidth = std::max( bin.usedWidth,
+									  bestRect.x + bestRect.width );
+			bin.usedHeight = std::max( bin.usedHeight,
+									   bestRect.y + bestRect.height );
+			entries_[i].page = bestBin;
+			entries_[i].x = bestRect.x * alignment + border;
+			entries_[i].y = bestRect.y * alignment + border;
+		}
+		if ( _bins.size() <= formats.size() || binHeight >= maxBinSize )
+			break;
+	}
+}
+
+void
+TextureAtlas::fillPage( TextureLoader* const* _textures,
+						const unsigned int _textureCount,
+						const unsigned int _page )
+{
+	// level 0 of the page
+	Allocator* page = pages_[_page].getMipLevePtr( 0 );
+	unsigned char* dst = page->getWritePtr<unsigned char>();
+	const unsigned int pageWidth = page->getWidth();
+	const unsigned int pixelSize = page->getBitsPerElement() / 8;
+	const unsigned int alignment = getAlignment();
+	const unsigned int border = getBorderSize();
+
+
+	// each texture on the page with its edge pixels repeated out to the
+	// sides of its cell
+	for ( unsigned int i = 0; i < _textureCount; ++i )
+	{
+		const ATLASENTRY& entry = entries_[i];
+		if ( entry.page != _page )
+			continue;
+		const unsigned char* src =
+			_textures[i]->getMipLevePtr( 0 )->getReadPtr<unsigned char>();
+		const unsigned int cellX = entry.x - border;
+		const unsigned int cellY = entry.y - border;
+		const unsigned int cellWidth = ( entry.width + 2 * border +
+										 alignment - 1 ) / alignment *
+									   alignment;
+		const unsigned int cellHeight = ( entry.height + 2 * border +
+										  alignment - 1 ) / alignment *
+										alignment;
+		const unsigned int rowSize = entry.width * pixelSize;
+		for ( unsigned int y = 0; y < cellHeight; ++y )
+		{
+			const unsigned int srcY = std::min( entry.height - 1,
+				y < border ? 0 : y - border );
+			const unsigned char* srcRow = src + srcY * rowSize;
+			unsigned char* dstRow = dst + ( ( cellY + y ) * pageWidth +
+											cellX ) * pixelSize;
+			for ( unsigned int x = 0; x < border; ++x )
+			{
+				std::memcpy( dstRow + x * pixelSize, srcRow, pixelSize );
+			}
+			std::memcpy( dstRow + border * pixelSize, srcRow, rowSize );
+			for ( unsigned int x = border + entry.width; x < cellWidth; ++x )
+			{
+				std::memcpy( dstRow + x * pixelSize,
+							 srcRow + rowSize - pixelSize, pixelSize );
+			}
+		}
+	}
+}
+
+bool
+TextureAtlas::findFreeRect( const ATLASBIN& _bin, const unsigned int _width,
+							const unsigned int _height,
+							unsigned int* _shortSide, unsigned int* _longSide,
+							ATLASRECT* _rect )
+{
+	// best short side fit, ties to the smaller long side leftover, then to
+	// the lowest and leftmost
+	bool isFound = false;
+	for ( unsigned int i = 0; i < _bin.freeRects.size(); ++i )
+	{
+		const ATLASRECT& freeRect = _bin.freeRects[i];
+		if ( freeRect.width < _width || freeRect.height < _height )
+			continue;
+		const unsigned int leftoverX = freeRect.width - _width;
+		const unsigned int leftoverY = freeRect.height - _height;
+		const unsigned int shortSide = std::min( leftoverX, leftoverY );
+		const unsigned int longSide = std::max( leftoverX, leftoverY );
+		if ( !isFound || shortSide < *_shortSide ||
+			 ( shortSide == *_shortSide && ( longSide < *_longSide ||
+			   ( longSide == *_longSide && ( freeRect.y < _rect->y ||
+				 ( freeRect.y == _rect->y && freeRect.x < _rect->x ) ) ) ) ) )
+		{
+			isFound = true;
+			*_shortSide = shortSide;
+			*_longSide = longSide;
+			_rect->x = freeRect.x;
+			_rect->y = freeRect.y;
+			_rect->width = _width;
+			_rect->height = _height;
+		}
+	}
+	return isFound;
+}
+
+void
+TextureAtlas::placeRect( ATLASBIN& _bin, const ATLASRECT& _rect )
+{
+	// split every free rectangle the new one overlaps into the parts of it
+	// left, right, below and above the new one, which overlap each other
+	std::vector<ATLASRECT> freeRects;
+	freeRects.reserve( _bin.freeRects.size() + 4 );
+	for ( unsigned int i = 0; i < _bin.freeRects.size(); ++i )
+	{
+		const ATLASRECT& freeRect = _bin.freeRects[i];
+		if ( _rect.x >= freeRect.x + freeRect.width ||
+			 _rect.x + _rect.width <= freeRect.x ||
+			 _rect.y >= freeRect.y + freeRect.height ||
+			 _rect.y + _rect.height <= freeRect.y )
+		{
+			freeRects.push_back( freeRect );
+			continue;
+		}
+		if ( _rect.x > freeRect.x )
+		{
+			ATLASRECT left = { freeRect.x, freeRect.y,
+							   _rect.x - freeRect.x, freeRect.height };
+			freeRects.push_back( left );
+		}
+		if ( _rect.x + _rect.width < freeRect.x + freeRect.width )
+		{
+			ATLASRECT right = { _rect.x + _rect.width, freeRect.y,
+								freeRect.x + freeRect.width - _rect.x -
+								_rect.width, freeRect.height };
+			freeRects.push_back( right );
+		}
+		if ( _rect.y > freeRect.y )
+		{
+			ATLASRECT below = { freeRect.x, freeRect.y, freeRect.width,
+								_rect.y - freeRect.y };
+			freeRects.push_back( below );
+		}
+		if ( _rect.y + _rect.height < freeRect.y + freeRect.height )
+		{
+			ATLASRECT above = { freeRect.x, _rect.y + _rect.height,
+								freeRect.width, freeRect.y + freeRect.height -
+								_rect.y - _rect.height };
+			freeRects.push_back( above );
+		}
+	}
+
+
+	// drop the ones inside another, of two equal ones the later
+	_bin.freeRects.clear();
+	for ( unsigned int i = 0; i < freeRects.size(); ++i )
+	{
+		const ATLASRECT& a = freeRects[i];
+		bool isContained = false;
+		for ( unsigned int j = 0; j < freeRects.size() && !isContained; ++j )
+		{
+			const ATLASRECT& b = freeRects[j];
+			const bool isInside = j != i && a.x >= b.x && a.y >= b.y &&
+				a.x + a.width <= b.x + b.width &&
+				a.y + a.height <= b.y + b.height;
+			const bool isEqual = a.x == b.x && a.y == b.y &&
+				a.width == b.width && a.height == b.height;
+			isContained = isInside && ( !isEqual || j < i );
+		}
+		if ( !isContained )
+			_bin.freeRects.push_back( a );
+	}
+}
+
+unsigned int
+TextureAtlas::getAlignment() const
+{
+	// a pixel of the last level, and a compression block
+	return std::max( 4u, 1u << ( mipLevelCount_ - 1 ) );
+}
+
+unsigned int
+TextureAtlas::getBorderSize() const
+{
+	// the padding on the last level, doubling on each level above it
+	return padding_ << ( mipLevelCount_ - 1 );
+}
+
+
+//==============================================================================
+GEM_END_NAMESPACE
+//==============================================================================
@@ -1,6 +1,10 @@
 //== INCLUDES ==================================================================
 
 #include "GemTextureLoader.h"
+#include "GemBlockCompression.h"
+#ifdef GEM_HAS_SSE2
+#include <emmintrin.h>
+#endif
 
 
 //== NAMESPACES ================================================================
@@ -8,21 +12,286 @@
 GEM_BEGIN_NAMESPACE
 
 
+//== FILTER HELPERS ============================================================
+
+// half width of the windowed sinc filters in pixels of the smaller level, and
+// the Kaiser window shape, as in the NVIDIA texture tools
+static const float MIP_SINC_RADIUS = 3.0f;
+static const float MIP_KAISER_ALPHA = 4.0f;
+
+static inline float sinc( const float _x )
+{
+	if ( std::fabs( _x ) < 1e-4f )
+		return 1.0f;
+	const float x = 3.14159265f * _x;
+	return std::sin( x ) / x;
+}
+
+// modified Bessel function of the first kind, order zero, from its series
+static inline float besselI0( const float _x )
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	const float x2 = 0.25f * _x * _x;
+	for ( unsigned int k = 1; term > sum * 1e-7f; ++k )
+	{
+		term *= x2 / static_cast<float>( k * k );
+		sum += term;
+	}
+	return sum;
+}
+
+// windowed sinc at _x pixels of the smaller level, zero past the radius
+static inline float evalMipFilter( const MIP_FILTER _filter, const float _x )
+{
+	const float t = _x / MIP_SINC_RADIUS;
+	if ( t <= -1.0f || t >= 1.0f )
+		return 0.0f;
+	if ( _filter == MIP_FILTER_KAISER )
+		return sinc( _x ) * besselI0( MIP_KAISER_ALPHA *
+			std::sqrt( 1.0f - t * t ) ) / besselI0( MIP_KAISER_ALPHA );
+	return sinc( _x ) * sinc( t );
+}
+
+
+//== DDS HELPERS ===============================================================
+
+// DXGI_FORMAT values of the DX10 header, from dxgiformat.h. sRGB formats are
+// read as their linear twins, saving writes the first entry of a format.
+struct DXGIFORMAT {
+	unsigned int dxgiFormat;
+	TEXTURE_FORMAT textureFormat;
+};
+
+static const DXGIFORMAT DXGI_FORMATS[] = {
+	{ 2, TEXTURE_FORMAT_RGBA_32F },		// R32G32B32A32_FLOAT
+	{ 6, TEXTURE_FORMAT_RGB_32F },		// R32G32B32_FLOAT
+	{ 10, TEXTURE_FORMAT_RGBA_16F },	// R16G16B16A16_FLOAT
+	{ 16, TEXTURE_FORMAT_RG_32F },		// R32G32_FLOAT
+	{ 28, TEXTURE_FORMAT_RGBA_8UI },	// R8G8B8A8_UNORM
+	{ 29, TEXTURE_FORMAT_RGBA_8UI },	// R8G8B8A8_UNORM_SRGB
+	{ 34, TEXTURE_FORMAT_RG_16F },		// R16G16_FLOAT
+	{ 41, TEXTURE_FORMAT_R_32F },		// R32_FLOAT
+	{ 49, TEXTURE_FORMAT_RG_8UI },		// R8G8_UNORM
+	{ 54, TEXTURE_FORMAT_R_16F },		// R16_FLOAT
+	{ 61, TEXTURE_FORMAT_R_8UI },		// R8_UNORM
+	{ 71, TEXTURE_FORMAT_RGB_DXT1 },	// BC1_UNORM
+	{ 72, TEXTURE_FORMAT_RGB_DXT1 },	// BC1_UNORM_SRGB
+	{ 74, TEXTURE_FORMAT_RGBA_DXT3 },	// BC2_UNORM
+	{ 75, TEXTURE_FORMAT_RGBA_DXT3 },	// BC2_UNORM_SRGB
+	{ 77, TEXTURE_FORMAT_RGBA_DXT5 },	// BC3_UNORM
+	{ 78, TEXTURE_FORMAT_RGBA_DXT5 },	// BC3_UNORM_SRGB
+	{ 80, TEXTURE_FORMAT_R_BC4 },		// BC4_UNORM
+	{ 83, TEXTURE_FORMAT_RG_BC5 },		// BC5_UNORM
+	{ 95, TEXTURE_FORMAT_RGB_BC6H },	// BC6H_UF16
+	{ 98, TEXTURE_FORMAT_RGBA_BC7 },	// BC7_UNORM
+	{ 99, TEXTURE_FORMAT_RGBA_BC7 },	// BC7_UNORM_SRGB
+};
+
+// B8G8R8A8 and B8G8R8X8, read through their bit masks
+static const unsigned int DXGI_FORMAT_B8G8R8A8_UNORM = 87;
+static const unsigned int DXGI_FORMAT_B8G8R8X8_UNORM = 88;
+static const unsigned int DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91;
+static const unsigned int DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93;
+
+// Pixels of _pixelSize bytes to _dim 8 bit channels, channel k from the
+// bits of _masks[k]. Narrower channels are scaled up, wider ones keep their
+// top 8 bits.
+static void unpackMaskedPixels( const unsigned char* _src,
+								const unsigned int _pixelCount,
+								const unsigned int _pixelSize,
+								const unsigned int* _masks,
+								const unsigned int _dim, unsigned char* _dst )
+{
+	unsigned int shifts[4], maxValues[4];
+	for ( unsigned int k = 0; k < _dim; ++k )
+	{
+		shifts[k] = 0;
+		while ( _masks[k] && !( ( _masks[k] >> shifts[k] ) & 1 ) )
+			++shifts[k];
+		maxValues[k] = _masks[k] >> shifts[k];
+		while ( maxValues[k] > 255 )
+		{
+			maxValues[k] >>= 1;
+			++shifts[k];
+		}
+	}
+	for ( unsigned int i = 0; i < _pixelCount; ++i )
+	{
+		unsigned int pixel = 0;
+		const unsigned char* src = _src + i * _pixelSize;
+		for ( unsigned int b = 0; b < _pixelSize; ++b )
+			pixel |= static_cast<unsigned int>( src[b] ) << ( 8 * b );
+		for ( unsigned int k = 0; k < _dim; ++k )
+		{
+			const unsigned int v = ( pixel & _masks[k] ) >> shifts[k];
+			_dst[i*_dim+k] = !maxValues[k] ? 0 : static_cast<unsigned char>(
+				( std::min( v, maxValues[k] ) * 255 + maxValues[k] / 2 ) /
+				maxValues[k] );
+		}
+	}
+}
+
+
+//== FILE HELPERS ==============================================================
+
+// bytes of file rows streamed through memory at a time by the bmp codecs
+static const unsigned int FILE_CHUNK_SIZE = 256 * 1024;
+
+#ifdef GEM_HAS_SSE2
+// bytes of _up where _upMask is set, of _down where _downMask is and of _x
+// where _keepMask is
+static inline __m128i selectBytes( const __m128i _x, const __m128i _up,
+								   const __m128i _down, const __m128i _upMask,
+								   const __m128i _downMask,
+								   const __m128i _keepMask )
+{
+	return _mm_or_si128( _mm_or_si128( _mm_and_si128( _up, _upMask ),
+									   _mm_and_si128( _down, _downMask ) ),
+						 _mm_and_si128( _x, _keepMask ) );
+}
+#endif
+
+// _pixelCount pixels of three bytes with the first and third swapped, bgr to
+// rgb and back. _src may be _dst.
+static void swapRedBlue24( const unsigned char* _src, unsigned char* _dst,
+						   const unsigned int _pixelCount )
+{
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	// 16 pixels at a time in three registers. Each byte takes the one two
+	// after it, the one two before it or stays, by its place in the pixel,
+	// which repeats every 48 bytes, so the masks are fixed and the bytes
+	// shifted in from outside the 48 are never taken.
+	const __m128i mask0 = _mm_setr_epi8( -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0,
+										 0, -1, 0, 0, -1 );
+	const __m128i mask1 = _mm_setr_epi8( 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0,
+										 -1, 0, 0, -1, 0 );
+	const __m128i mask2 = _mm_setr_epi8( 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1,
+										 0, 0, -1, 0, 0 );
+	for ( ; i + 16 <= _pixelCount; i += 16 )
+	{
+		const __m128i* src = reinterpret_cast<const __m128i*>( _src + 3 * i );
+		__m128i* dst = reinterpret_cast<__m128i*>( _dst + 3 * i );
+		const __m128i a = _mm_loadu_si128( src );
+		const __m128i b = _mm_loadu_si128( src + 1 );
+		const __m128i c = _mm_loadu_si128( src + 2 );
+		const __m128i aUp = _mm_or_si128( _mm_srli_si128( a, 2 ),
+										  _mm_slli_si128( b, 14 ) );
+		const __m128i bUp = _mm_or_si128( _mm_srli_si128( b, 2 ),
+										  _mm_slli_si128( c, 14 ) );
+		const __m128i cUp = _mm_srli_si128( c, 2 );
+		const __m128i aDown = _mm_slli_si128( a, 2 );
+		const __m128i bDown = _mm_or_si128( _mm_slli_si128( b, 2 ),
+											_mm_srli_si128( a, 14 ) );
+		const __m128i cDown = _mm_or_si128( _mm_slli_si128( c, 2 ),
+											_mm_srli_si128( b, 14 ) );
+		_mm_storeu_si128( dst, selectBytes( a, aUp, aDown, mask0, mask1,
+											mask2 ) );
+		_mm_storeu_si128( dst + 1, selectBytes( b, bUp, bDown, mask1, mask2,
+												mask0 ) );
+		_mm_storeu_si128( dst + 2, selectBytes( c, cUp, cDown, mask2, mask0,
+												mask1 ) );
+	}
+#endif
+	for ( ; i < _pixelCount; ++i )
+	{
+		const unsigned char r = _src[3*i];
+		_dst[3*i] = _src[3*i+2];
+		_dst[3*i+1] = _src[3*i+1];
+		_dst[3*i+2] = r;
+	}
+}
+
+// _pixelCount pixels of four bytes with the first and third swapped, bgra
+// to rgba and back. _src may be _dst.
+static void swapRedBlue32( const unsigned char* _src, unsigned char* _dst,
+						   const unsigned int _pixelCount )
+{
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	// four pixels at a time, each a little endian 32 bit word
+	const __m128i greenAlpha = _mm_set1_epi32(
+		static_cast<int>( 0xff00ff00 ) );
+	const __m128i low = _mm_set1_epi32( 0x000000ff );
+	const __m128i high = _mm_set1_epi32( 0x00ff0000 );
+	for ( ; i + 4 <= _pixelCount; i += 4 )
+	{
+		const __m128i x = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>( _src + 4 * i ) );
+		const __m128i y = _mm_or_si128( _mm_and_si128( x, greenAlpha ),
+			_mm_or_si128( _mm_and_si128( _mm_srli_epi32( x, 16 ), low ),
+						  _mm_and_si128( _mm_slli_epi32( x, 16 ), high ) ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _dst + 4 * i ), y );
+	}
+#endif
+	for ( ; i < _pixelCount; ++i )
+	{
+		const unsigned char r = _src[4*i];
+		_dst[4*i] = _src[4*i+2];
+		_dst[4*i+1] = _src[4*i+1];
+		_dst[4*i+2] = r;
+		_dst[4*i+3] = _src[4*i+3];
+	}
+}
+
+// _wordCount 32 bit words with their bytes reversed, big to little endian
+// and back. _src may be _dst.
+static void swapBytes32( const unsigned char* _src, unsigned char* _dst,
+						 const unsigned int _wordCount )
+{
+	unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+	// four words at a time, swap the halves of each, then the bytes of each
+	// half
+	for ( ; i + 4 <= _wordCount; i += 4 )
+	{
+		__m128i x = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>( _src + 4 * i ) );
+		x = _mm_shufflelo_epi16( x, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		x = _mm_shufflehi_epi16( x, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		x = _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( _dst + 4 * i ), x );
+	}
+#endif
+	for ( ; i < _wordCount; ++i )
+	{
+		const unsigned char b0 = _src[4*i];
+		const unsigned char b1 = _src[4*i+1];
+		_dst[4*i] = _src[4*i+3];
+		_dst[4*i+1] = _src[4*i+2];
+		_dst[4*i+2] = b1;
+		_dst[4*i+3] = b0;
+	}
+}
+
+
 //== CLASS DEFINITION ==========================================================
 
 //-- constructors/destructor ---------------------------------------------------
 
 TextureLoader::TextureLoader()
-: path_()
-, fileFormat_( FILE_FORMAT_NONE )
-, width_( 0 )
-, height_( 0 )
-, textureFormat_( TEXTURE_FORMAT_NONE )
-, mipLevelCount_( 0 )
-, isLoaded_( false )
+: Loader()
+{
+	init();
+}
+
+TextureLoader::TextureLoader( const TextureLoader& other )
+: Loader( other )
 {
+	init();
+	copy( other );
 }
 
+#ifdef GEM_HAS_RVALUE_REFS
+TextureLoader::TextureLoader( TextureLoader&& other )
+: Loader()
+{
+	init();
+	(*this) = std::move( other );
+}
+#endif
+
 TextureLoader::~TextureLoader( )
 {
 	clear( );
@@ -43,21 +312,105 @@ TextureLoader::clear( )
 	height_ = 0;
 	textureFormat_ = TEXTURE_FORMAT_NONE;
 	mipLevelCount_ = 0;
+	textureTarget_ = TEXTURE_TARGET_2D;
+	layerCount_ = 1;
 	for ( unsigned int i = 0; i < MAX_MIP_LEVELS; ++i )
 	{
 		mipLevels_[i].clear();
 	}
 
 	// status flags
-	bool isLoaded_ = false;
+	isLoaded_ = false;
 }
 
 void
 TextureLoader::copy( const TextureLoader& other )
 {
-	// no deep copy needed
-	(*this) = other;
+	// allocators have deep copy implemented
+	for ( unsigned int i = 0; i < MAX_MIP_LEVELS; ++i )
+	{
+		mipLevels_[i] = other.mipLevels_[i];
+	}
+	copyMembers( other );
+}
+
+void
+TextureLoader::share( TextureLoader& other )
+{
+	if ( this == &other )
+		return;
+
+	for ( unsigned int i = 0; i < MAX_MIP_LEVELS; ++i )
+	{
+		mipLevels_[i].share( other.mipLevels_[i] );
+	}
+	copyMembers( other );
+}
+
+void
+TextureLoader::init()
+{
+	fileFormat_ = FILE_FORMAT_NONE;
+	width_ = 0;
+	height_ = 0;
+	textureFormat_ = TEXTURE_FORMAT_NONE;
+	mipLevelCount_ = 0;
+	textureTarget_ = TEXTURE_TARGET_2D;
+	layerCount_ = 1;
+	isMapEnabled_ = false;
+	mipFilter_ = MIP_FILTER_NONE;
+	isLoaded_ = false;
+	for ( unsigned int i = 0; i < MAX_MIP_LEVELS; ++i )
+	{
+		mipLevels_[i].setTag( ALLOC_TAG_TEXTURE );
+	}
+}
+
+void
+TextureLoader::copyMembers( const TextureLoader& other )
+{
+	path_ = other.path_;
+	fileFormat_ = other.fileFormat_;
+	width_ = other.width_;
+	height_ = other.height_;
+	textureFormat_ = other.textureFormat_;
+	mipLevelCount_ = other.mipLevelCount_;
+	textureTarget_ = other.textureTarget_;
+	layerCount_ = other.layerCount_;
+	isMapEnabled_ = other.isMapEnabled_;
+	mipFilter_ = other.mipFilter_;
+	isLoaded_ = other.isLoaded_;
+}
+
+
+//-- assignment operators ------------------------------------------------------
+
+TextureLoader&
+TextureLoader::operator=( const TextureLoader& rhs )
+{
+	if ( this != &rhs )
+	{
+		copy( rhs );
+	}
+	return *this;
+}
+
+#ifdef GEM_HAS_RVALUE_REFS
+TextureLoader&
+TextureLoader::operator=( TextureLoader&& rhs )
+{
+	if ( this != &rhs )
+	{
+		for ( unsigned int i = 0; i < MAX_MIP_LEVELS; ++i )
+		{
+			mipLevels_[i] = std::move( rhs.mipLevels_[i] );
+		}
+		copyMembers( rhs );
+		rhs.clear();
+	}
+	return *this;
 }
+#endif
 
 
 //-- load and create -----------------------------------------------------------
@@ -126,6 +479,11 @@ TextureLoader::load( const std::string& _path,
 			GEM_THROW( "Unsupported file type ." + ext );
 			break;
 		}
+
+
+		// dds files carry their own mip levels
+		if ( mipFilter_ != MIP_FILTER_NONE && fileFormat != FILE_FORMAT_DDS )
+			computeMipLevels( mipFilter_, MAX_MIP_LEVELS );
 	}
 	catch( const std::exception& e )
 	{
@@ -170,6 +528,37 @@ TextureLoader::reload()
 	}
 }
 
+LoadHandle
+TextureLoader::loadAsync( const std::string& _path,
+						  const FILE_FORMAT _fileFormat )
+{
+	// the staged loader is swapped with this one when parsed, see Loader
+	std::shared_ptr<TextureLoader> staged( new TextureLoader() );
+	staged->isMapEnabled_ = isMapEnabled_;
+	staged->mipFilter_ = mipFilter_;
+	return submitLoad( _path, staged,
+		[_path, _fileFormat]( Loader* _staged ) -> bool
+		{
+			TextureLoader* texture = static_cast<TextureLoader*>( _staged );
+			texture->load( _path, _fileFormat );
+			return texture->isLoaded();
+		},
+		[]( Loader* _target, Loader* _staged )
+		{
+			std::swap( *static_cast<TextureLoader*>( _target ),
+					   *static_cast<TextureLoader*>( _staged ) );
+		} );
+}
+
+LoadHandle
+TextureLoader::reloadAsync()
+{
+	// created textures have no file to read
+	if ( !isLoaded_ || path_.empty() )
+		return LoadHandle();
+	return loadAsync( path_, fileFormat_ );
+}
+
 void
 TextureLoader::create( const unsigned int _width, const unsigned int _height, 
 					   const TEXTURE_FORMAT _textureFormat,
@@ -189,16 +578,20 @@ TextureLoader::create( const unsigned int _width, const unsigned int _height,
 		clear( );
 
 
-	// allocate memory for first mip level
+	// allocate memory for first mip level. Created textures are typically
+	// render targets, so only specify the mip levels and let host memory be
+	// committed on demand
 	try
 	{
 		if ( _createMipLevels )
 		{
-			createMipLevels( _width, _height, _textureFormat, MAX_MIP_LEVELS );
+			createMipLevels( _width, _height, _textureFormat, MAX_MIP_LEVELS,
+							 ALLOC_MODE_LAZY );
 		}
 		else
 		{
-			createMipLevels( _width, _height, _textureFormat, 1 );
+			createMipLevels( _width, _height, _textureFormat, 1,
+							 ALLOC_MODE_LAZY );
 		}
 	}
 	catch( const std::exception &e )
@@ -251,6 +644,10 @@ TextureLoader::save( const std::string& _path,
 		{
 			fileFormat = FILE_FORMAT_PFM;
 		}
+		else if ( ext == "dds" )
+		{
+			fileFormat = FILE_FORMAT_DDS;
+		}
 	}
 
 
@@ -265,6 +662,9 @@ TextureLoader::save( const std::string& _path,
 		case FILE_FORMAT_PFM:
 			savePFM( path );
 			break;
+		case FILE_FORMAT_DDS:
+			saveDDS( path );
+			break;
 		default:
 			GEM_THROW( "Unsupported file type ." + ext );
 		}
@@ -275,13 +675,94 @@ TextureLoader::save( const std::string& _path,
 	}
 }
 
+
+//-- mip levels ----------------------------------------------------------------
+
+void
+TextureLoader::generateMipLevels( const MIP_FILTER _filter,
+								  const unsigned int _maxMipLevelCount )
+{
+	// argument checks
+	if ( _maxMipLevelCount < 1 )
+		GEM_ERROR( "Invalid mip level count." );
+
+
+	// nothing to filter
+	if ( !isLoaded_ || _filter == MIP_FILTER_NONE )
+		return;
+
+
+	// compute
+	try
+	{
+		computeMipLevels( _filter, _maxMipLevelCount );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+
+//-- block compression ---------------------------------------------------------
+
+void
+TextureLoader::compress( const TEXTURE_FORMAT _format,
+						 const COMPRESS_QUALITY _quality )
+{
+	// argument checks
+	if ( !isBlockCompressed( _format ) )
+		GEM_ERROR( "Format argument is not block compressed." );
+
+
+	// nothing to compress
+	if ( !isLoaded_ || _format == textureFormat_ )
+		return;
+
+
+	// compress
+	try
+	{
+		compressMipLevels( _format, _quality );
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+void
+TextureLoader::decompress()
+{
+	// nothing to decompress
+	if ( !isLoaded_ || !isBlockCompressed( textureFormat_ ) )
+		return;
+
+
+	// decompress
+	try
+	{
+		decompressMipLevels();
+	}
+	catch( const std::exception& e )
+	{
+		GEM_ERROR( e.what() );
+	}
+}
+
+
 //-- private load and create -------------------------------------------------------
 
 void
 TextureLoader::createMipLevels( const unsigned int _width,
 							    const unsigned int _height,
 							    const TEXTURE_FORMAT _textureFormat,
-								unsigned int _maxMipLevelCount )
+								unsigned int _maxMipLevelCount,
+								const ALLOC_MODE _allocMode,
+								const std::string& _mapPath,
+								const unsigned long long _mapOffset,
+								const TEXTURE_TARGET _textureTarget,
+								const unsigned int _layerCount )
 {
 	// Calculate maximum miplevel
 	//
@@ -311,21 +792,40 @@ TextureLoader::createMipLevels( const unsigned int _width,
 	// Because we use floor here we might get a size of 0 for the smallest 
 	// dimensions, so make sure to clamp it.
 	//
-	// Notice that DXT textures have to have a width and hight divisible by 4
-	// (the block size) for ALL mip map levels. The common strategy seems to be
-	// to round up to the closest number divisible by 4. If you get read errors
-	// in LoadDDS, make sure your file writer respects this.
+	// Notice that block compressed textures have to have a width and hight
+	// divisible by 4 (the block size) for ALL mip map levels. The common
+	// strategy seems to be to round up to the closest number divisible by 4.
+	// If you get read errors in LoadDDS, make sure your file writer respects
+	// this.
+	//
+	// Each level holds all layers one after the other, so it is layer count
+	// times as high, see the top of the header.
+	//
+	// With a map path the levels are mapped from consecutive ranges of the
+	// file starting at the map offset instead.
 	//
+	unsigned long long offset = _mapOffset;
 	for ( unsigned int w, h, i = 0; i < mipLevelCount; ++i )
 	{
 		w = std::max( std::floor( width / (1 << i) ), 1.0 );
 		h = std::max( std::floor( height / (1 << i) ), 1.0 );
-		if ( _textureFormat == TEXTURE_FORMAT_RGB_DXT1 )
+		if ( isBlockCompressed( _textureFormat ) )
 		{
 			w = std::ceil( w / 4.0 ) * 4u;
 			h = std::ceil( h / 4.0 ) * 4u;
 		}
-		mipLevels_[i].alloc( static_cast<ALLOC_FORMAT>(_textureFormat), w, h );
+		h *= _layerCount;
+		if ( _mapPath.empty() )
+		{
+			mipLevels_[i].alloc( static_cast<ALLOC_FORMAT>(_textureFormat),
+								 w, h, _allocMode );
+		}
+		else
+		{
+			mipLevels_[i].map( _mapPath, offset,
+							   static_cast<ALLOC_FORMAT>(_textureFormat), w, h );
+			offset += mipLevels_[i].getByteCount();
+		}
 	}
 
 
@@ -334,128 +834,623 @@ TextureLoader::createMipLevels( const unsigned int _width,
 	height_ = _height;
 	textureFormat_ = _textureFormat;
 	mipLevelCount_ = mipLevelCount;
+	textureTarget_ = _textureTarget;
+	layerCount_ = _layerCount;
 }
 
 
-//-- private file-io -----------------------------------------------------------
+//-- private mip levels --------------------------------------------------------
 
 void
-TextureLoader::loadBMP( const std::string& _path )
+TextureLoader::computeMipLevels( const MIP_FILTER _filter,
+								 const unsigned int _maxMipLevelCount )
 {
-	// local vars
-	std::ifstream ifs;
-	BITMAPFILEHEADER filehdr;
-	BITMAPINFOHEADER infohdr;
-
-
-	// open file for reading
-	ifs.open( _path.c_str(), std::ifstream::in | std::ifstream::binary );
-	if ( ifs.fail() )
+	// filtered in floats, 8UI or 32F with up to four components
+	const ALLOC_TYPE type = mipLevels_[0].getType();
+	const unsigned int dim = mipLevels_[0].getDim() - ALLOC_DIM_NONE;
+	if ( ( type != ALLOC_TYPE_8UI && type != ALLOC_TYPE_32F ) || dim > 4 )
+		GEM_THROW( "Mip levels can only be generated for 8UI and 32F "
+				   "textures." );
+
+
+	// the whole chain, see createMipLevels(), or its first levels
+	unsigned int mipLevelCount = 1;
+	while ( mipLevelCount < MAX_MIP_LEVELS &&
+			mipLevelCount < _maxMipLevelCount &&
+			std::max( width_, height_ ) > ( 1u << ( mipLevelCount - 1 ) ) )
 	{
-		GEM_THROW( "Could not open file " + _path );
+		++mipLevelCount;
 	}
-
-
-	// read file header.
-	// values are read one by one rather then the whole struct at once because
-	// compilers will not always do two-padding of structs. This way is
-	// preferred here over getting into compiler specific directives.
-	ifs.read( reinterpret_cast<char*>(&filehdr.type), 2 );
-	ifs.read( reinterpret_cast<char*>(&filehdr.size), 4 );
-	ifs.read( reinterpret_cast<char*>(&filehdr.reserved1), 2 );
-	ifs.read( reinterpret_cast<char*>(&filehdr.reserved2), 2 );
-	ifs.read( reinterpret_cast<char*>(&filehdr.offBits), 4 );
-	if ( ifs.fail( ) )
+	for ( unsigned int i = mipLevelCount; i < mipLevelCount_; ++i )
 	{
-		ifs.close();
-		GEM_THROW( "Failed to read image file header." );
+		mipLevels_[i].clear();
 	}
-
-	
-	// make sure its a bitmap
-	if ( filehdr.type == "BM" )
+	for ( unsigned int i = mipLevelCount_; i < mipLevelCount; ++i )
 	{
-		ifs.close();
-		GEM_THROW( "File is not a bitmap." );
+		mipLevels_[i].alloc( static_cast<ALLOC_FORMAT>(textureFormat_),
+							 std::max( width_ >> i, 1u ),
+							 std::max( height_ >> i, 1u ) * layerCount_,
+							 ALLOC_MODE_NOINIT );
 	}
+	mipLevelCount_ = mipLevelCount;
 
 
-	// read info header
-	ifs.read( reinterpret_cast<char*>(&infohdr), sizeof( BITMAPINFOHEADER ) );
-	if ( ifs.fail( ) )
+	// each level from the one before, a layer at a time, its rows split into
+	// a band per thread, at least 16k pixels each, the calling thread takes
+	// the first
+	for ( unsigned int i = 1; i < mipLevelCount_; ++i )
 	{
-		ifs.close();
-		GEM_THROW( "Failed to read image info header." );
+		MIPKERNEL columns, rows;
+		MIPRANGE range;
+		range.srcWidth = mipLevels_[i-1].getWidth();
+		range.srcHeight = mipLevels_[i-1].getHeight() / layerCount_;
+		range.dstWidth = mipLevels_[i].getWidth();
+		const unsigned int dstHeight = mipLevels_[i].getHeight() / layerCount_;
+		buildMipKernel( range.srcWidth, range.dstWidth, _filter, &columns );
+		buildMipKernel( range.srcHeight, dstHeight, _filter, &rows );
+		range.dim = dim;
+		range.isFloat = type == ALLOC_TYPE_32F;
+		range.columns = &columns;
+		range.rows = &rows;
+
+		unsigned int threadCount = std::max( 1u,
+			std::thread::hardware_concurrency() );
+		threadCount = std::max( 1u, std::min( threadCount,
+			( range.dstWidth * dstHeight ) >> 14 ) );
+		for ( unsigned int layer = 0; layer < layerCount_; ++layer )
+		{
+			range.src = mipLevels_[i-1].getReadPtr<unsigned char>() + layer *
+				( mipLevels_[i-1].getByteCount() / layerCount_ );
+			range.dst = mipLevels_[i].getWritePtr<unsigned char>() + layer *
+				( mipLevels_[i].getByteCount() / layerCount_ );
+			std::vector<MIPRANGE> ranges( threadCount, range );
+			for ( unsigned int j = 0; j < threadCount; ++j )
+			{
+				ranges[j].first = dstHeight * j / threadCount;
+				ranges[j].last = dstHeight * ( j + 1 ) / threadCount;
+			}
+			std::vector<std::thread> workers;
+			for ( unsigned int j = 1; j < threadCount; ++j )
+				workers.push_back( std::thread( filterMipRows, &ranges[j] ) );
+			filterMipRows( &ranges[0] );
+			for ( unsigned int j = 0; j < workers.size(); ++j )
+				workers[j].join();
+		}
 	}
+}
 
-
-	// read 24-bit (rgb)
-	if ( infohdr.bitCount==24 )
+void
+TextureLoader::buildMipKernel( const unsigned int _srcSize,
+							   const unsigned int _dstSize,
+							   const MIP_FILTER _filter,
+							   MIPKERNEL* _kernel )
+{
+	// Pixel x of the smaller level covers [x*s, (x+1)*s) of the larger,
+	// s = srcSize / dstSize. The box weighs the pixels in there by how much
+	// of each is covered, the sincs are stretched by s and sampled at the
+	// pixel centers, both normalized to sum to one. A level as large as the
+	// one before is copied.
+	const float scale = static_cast<float>( _srcSize ) / _dstSize;
+	const float radius = _srcSize == _dstSize ? 0.0f :
+		_filter == MIP_FILTER_BOX ? 0.5f * scale : MIP_SINC_RADIUS * scale;
+	_kernel->tapCount = static_cast<unsigned int>( std::ceil( 2.0f * radius ) )
+		+ 1;
+	_kernel->tapStride = ( _kernel->tapCount + 3 ) & ~3u;
+	_kernel->first.resize( _dstSize );
+	_kernel->weights.assign( _dstSize * _kernel->tapStride, 0.0f );
+	for ( unsigned int x = 0; x < _dstSize; ++x )
 	{
-		// allocate data
-		createMipLevels( infohdr.width, infohdr.height,
-						 TEXTURE_FORMAT_RGB_8UI, 1 );
-
-		
-		// get character ptr and total bytecount
-		char* ptr = mipLevels_[0].getWritePtr<char>();
-		int bytecount =  mipLevels_[0].getByteCount();
-
-
-		// jump to data section
-		ifs.seekg( filehdr.offBits, std::ios::beg );
-
-		
-		// read image data
-		ifs.read( ptr, bytecount );
-		if ( ifs.fail() )
+		const float center = ( x + 0.5f ) * scale;
+		const int first = static_cast<int>( std::floor( center - radius ) );
+		float* weights = &_kernel->weights[x * _kernel->tapStride];
+		float sum = 0.0f;
+		for ( unsigned int k = 0; k < _kernel->tapCount; ++k )
 		{
-			ifs.close();
-			GEM_THROW( "Failed to read image data." );
+			const float lower = static_cast<float>( first +
+												   static_cast<int>( k ) );
+			if ( _srcSize == _dstSize )
+			{
+				weights[k] = k ? 0.0f : 1.0f;
+			}
+			else if ( _filter == MIP_FILTER_BOX )
+			{
+				weights[k] = std::max( 0.0f,
+					std::min( lower + 1.0f, center + radius ) -
+					std::max( lower, center - radius ) );
+			}
+			else
+			{
+				weights[k] = evalMipFilter( _filter,
+					( lower + 0.5f - center ) / scale );
+			}
+			sum += weights[k];
 		}
-
-
-		// data is in BGR format, so swap R and B
-		for ( int i=0; i<bytecount; i+=3 )
+		for ( unsigned int k = 0; k < _kernel->tapCount; ++k )
 		{
-			ptr[i] ^= ptr[i+2];
-			ptr[i+2] ^= ptr[i];
-			ptr[i] ^= ptr[i+2];
+			weights[k] /= sum;
 		}
+		_kernel->first[x] = _srcSize == _dstSize ? static_cast<int>( x ) :
+			first;
 	}
+}
 
-
-	// read 8-bit (monochrome)
-	else if ( infohdr.bitCount==8 )
+void
+TextureLoader::filterMipRows( MIPRANGE* _range )
+{
+	// Each row of the smaller level is the larger filtered along its columns
+	// into a row of floats, four at a time with SSE2, then along that row.
+	// The row has the edge repeated past both ends as far as the taps reach,
+	// so the taps of each pixel are contiguous, and another four floats at
+	// the end for the vector loads and stores that overrun the last pixel.
+	const MIPKERNEL& columns = *_range->columns;
+	const MIPKERNEL& rows = *_range->rows;
+	const unsigned int dim = _range->dim;
+	const unsigned int srcWidth = _range->srcWidth;
+	const unsigned int dstWidth = _range->dstWidth;
+	const unsigned int rowCount = srcWidth * dim;
+	const unsigned int elementSize = _range->isFloat ? 4 : 1;
+	const int pad = static_cast<int>( columns.tapStride );
+	std::vector<float> filtered( ( srcWidth + 2 * pad ) * dim + 4 );
+	std::vector<float> out( dstWidth * dim + 4 );
+	std::vector<const unsigned char*> taps( rows.tapCount );
+	std::vector<float> tapWeights( rows.tapCount );
+	float* column = &filtered[pad * dim];
+	for ( unsigned int y = _range->first; y < _range->last; ++y )
 	{
-		// set variables and allocate data
-		createMipLevels( infohdr.width, infohdr.height,
-						 TEXTURE_FORMAT_R_8UI, 1 );
-		char* ptr = mipLevels_[0].getWritePtr<char>();
-		int bytecount =  mipLevels_[0].getByteCount();
-
-		
-		// jump to data section
-		ifs.seekg( filehdr.offBits, std::ios::beg );
-
-		
-		// read image data
-		ifs.read( ptr, bytecount );
-		if ( ifs.fail() )
+		// along the columns, rows past the edge repeat the edge
+		const float* weights = &rows.weights[y * rows.tapStride];
+		unsigned int tapCount = 0;
+		for ( unsigned int k = 0; k < rows.tapCount; ++k )
 		{
-			ifs.close();
-			GEM_THROW( "Failed to read image data." );
+			if ( weights[k] == 0.0f )
+				continue;
+			const int row = std::min( std::max( rows.first[y] +
+				static_cast<int>( k ), 0 ),
+				static_cast<int>( _range->srcHeight ) - 1 );
+			taps[tapCount] = _range->src + static_cast<size_t>( row ) *
+				rowCount * elementSize;
+			tapWeights[tapCount++] = weights[k];
 		}
-	}
-
-
-	// bitcount is not supported, close and report failiure
-	else
-	{
-		ifs.close();
-		GEM_THROW( "Bitmap format not supported." );
-	}
-
+		unsigned int i = 0;
+#ifdef GEM_HAS_SSE2
+		const __m128i vZero = _mm_setzero_si128();
+		for ( ; i + 4 <= rowCount; i += 4 )
+		{
+			__m128 vSum = _mm_setzero_ps();
+			for ( unsigned int k = 0; k < tapCount; ++k )
+			{
+				__m128 v;
+				if ( _range->isFloat )
+				{
+					v = _mm_loadu_ps(
+						reinterpret_cast<const float*>( taps[k] ) + i );
+				}
+				else
+				{
+					int bytes;
+					std::memcpy( &bytes, taps[k] + i, 4 );
+					v = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_unpacklo_epi8(
+						_mm_cvtsi32_si128( bytes ), vZero ), vZero ) );
+				}
+				vSum = _mm_add_ps( vSum,
+					_mm_mul_ps( v, _mm_set1_ps( tapWeights[k] ) ) );
+			}
+			_mm_storeu_ps( column + i, vSum );
+		}
+#endif
+		for ( ; i < rowCount; ++i )
+		{
+			float sum = 0.0f;
+			for ( unsigned int k = 0; k < tapCount; ++k )
+			{
+				const float v = _range->isFloat ?
+					reinterpret_cast<const float*>( taps[k] )[i] :
+					static_cast<float>( taps[k][i] );
+				sum += v * tapWeights[k];
+			}
+			column[i] = sum;
+		}
+		for ( int x = 0; x < pad; ++x )
+		{
+			for ( unsigned int c = 0; c < dim; ++c )
+			{
+				filtered[x * dim + c] = column[c];
+				column[( srcWidth + x ) * dim + c] =
+					column[( srcWidth - 1 ) * dim + c];
+			}
+		}
+
+
+		// along the row, with SSE2 the taps of a one component pixel are
+		// summed four at a time and the components of a larger one at once,
+		// its store spilling into the next pixel
+		for ( unsigned int x = 0; x < dstWidth; ++x )
+		{
+			const float* weights = &columns.weights[x * columns.tapStride];
+			const float* taps = column + columns.first[x] * static_cast<int>(
+				dim );
+#ifdef GEM_HAS_SSE2
+			if ( dim == 1 )
+			{
+				__m128 vSum = _mm_setzero_ps();
+				for ( unsigned int k = 0; k < columns.tapStride; k += 4 )
+				{
+					vSum = _mm_add_ps( vSum, _mm_mul_ps(
+						_mm_loadu_ps( taps + k ), _mm_loadu_ps( weights + k ) ) );
+				}
+				vSum = _mm_add_ps( vSum, _mm_movehl_ps( vSum, vSum ) );
+				vSum = _mm_add_ss( vSum, _mm_shuffle_ps( vSum, vSum, 1 ) );
+				_mm_store_ss( &out[x], vSum );
+			}
+			else
+			{
+				__m128 vSum = _mm_setzero_ps();
+				for ( unsigned int k = 0; k < columns.tapCount; ++k )
+				{
+					vSum = _mm_add_ps( vSum, _mm_mul_ps(
+						_mm_loadu_ps( taps + k * dim ),
+						_mm_set1_ps( weights[k] ) ) );
+				}
+				_mm_storeu_ps( &out[x * dim], vSum );
+			}
+#else
+			for ( unsigned int c = 0; c < dim; ++c )
+			{
+				float sum = 0.0f;
+				for ( unsigned int k = 0; k < columns.tapCount; ++k )
+				{
+					sum += taps[k * dim + c] * weights[k];
+				}
+				out[x * dim + c] = sum;
+			}
+#endif
+		}
+
+
+		// store, 8UI rounded to nearest and clamped
+		const unsigned int outCount = dstWidth * dim;
+		unsigned char* dst = _range->dst + static_cast<size_t>( y ) *
+			outCount * elementSize;
+		if ( _range->isFloat )
+		{
+			std::memcpy( dst, &out[0], outCount * sizeof( float ) );
+			continue;
+		}
+		i = 0;
+#ifdef GEM_HAS_SSE2
+		const __m128 vMax = _mm_set1_ps( 255.0f );
+		const __m128 vHalf = _mm_set1_ps( 0.5f );
+		for ( ; i + 4 <= outCount; i += 4 )
+		{
+			__m128 v = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( &out[i] ),
+				_mm_setzero_ps() ), vMax );
+			__m128i vInt = _mm_cvttps_epi32( _mm_add_ps( v, vHalf ) );
+			vInt = _mm_packs_epi32( vInt, vInt );
+			int bytes = _mm_cvtsi128_si32( _mm_packus_epi16( vInt, vInt ) );
+			std::memcpy( dst + i, &bytes, 4 );
+		}
+#endif
+		for ( ; i < outCount; ++i )
+		{
+			const float v = std::min( std::max( out[i], 0.0f ), 255.0f );
+			dst[i] = static_cast<unsigned char>( v + 0.5f );
+		}
+	}
+}
+
+
+//-- private block compression -------------------------------------------------
+
+void
+TextureLoader::compressMipLevels( const TEXTURE_FORMAT _format,
+								  const COMPRESS_QUALITY _quality )
+{
+	// 8UI or 32F with up to four components
+	const ALLOC_TYPE type = mipLevels_[0].getType();
+	const unsigned int dim = mipLevels_[0].getDim() - ALLOC_DIM_NONE;
+	if ( ( type != ALLOC_TYPE_8UI && type != ALLOC_TYPE_32F ) || dim > 4 )
+		GEM_THROW( "Only 8UI and 32F textures can be block compressed." );
+
+
+	// compress each layer of each level next to the old ones, so a failure
+	// leaves the texture as it was. Levels are allocated in multiples of
+	// four pixels, see createMipLevels().
+	Allocator levels[MAX_MIP_LEVELS];
+	std::vector<unsigned char> bytes;
+	for ( unsigned int i = 0; i < mipLevelCount_; ++i )
+	{
+		const unsigned int w = mipLevels_[i].getWidth();
+		const unsigned int h = mipLevels_[i].getHeight() / layerCount_;
+		levels[i].setTag( ALLOC_TAG_TEXTURE );
+		levels[i].alloc( static_cast<ALLOC_FORMAT>(_format), ( w + 3 ) & ~3u,
+						 ( ( h + 3 ) & ~3u ) * layerCount_,
+						 ALLOC_MODE_NOINIT );
+		const unsigned int blockByteCount = getBlockByteCount( w, h, _format );
+		for ( unsigned int layer = 0; layer < layerCount_; ++layer )
+		{
+			const unsigned int elementCount = w * h * dim;
+			const unsigned char* src;
+			if ( type == ALLOC_TYPE_8UI )
+			{
+				src = mipLevels_[i].getReadPtr<unsigned char>() + layer *
+					elementCount;
+			}
+			else
+			{
+				const float* f = mipLevels_[i].getReadPtr<float>() + layer *
+					elementCount;
+				bytes.resize( elementCount );
+				for ( unsigned int j = 0; j < elementCount; ++j )
+				{
+					const float v = std::min( std::max( f[j], 0.0f ), 1.0f );
+					bytes[j] = static_cast<unsigned char>( v * 255.0f + 0.5f );
+				}
+				src = &bytes[0];
+			}
+			compressImage( src, w, h, dim, _format, _quality,
+						   levels[i].getWritePtr<unsigned char>() + layer *
+						   blockByteCount );
+		}
+	}
+
+
+	// swap them in
+	for ( unsigned int i = 0; i < mipLevelCount_; ++i )
+	{
+#ifdef GEM_HAS_RVALUE_REFS
+		mipLevels_[i] = std::move( levels[i] );
+#else
+		mipLevels_[i] = levels[i];
+#endif
+	}
+	textureFormat_ = _format;
+}
+
+void
+TextureLoader::decompressMipLevels()
+{
+	// the 8UI format with the channels the blocks store
+	TEXTURE_FORMAT format;
+	unsigned int dim;
+	switch ( textureFormat_ )
+	{
+	case TEXTURE_FORMAT_RGB_DXT1:
+		format = TEXTURE_FORMAT_RGB_8UI;
+		dim = 3;
+		break;
+	case TEXTURE_FORMAT_RGBA_DXT3:
+	case TEXTURE_FORMAT_RGBA_DXT5:
+		format = TEXTURE_FORMAT_RGBA_8UI;
+		dim = 4;
+		break;
+	case TEXTURE_FORMAT_R_BC4:
+		format = TEXTURE_FORMAT_R_8UI;
+		dim = 1;
+		break;
+	case TEXTURE_FORMAT_RG_BC5:
+		format = TEXTURE_FORMAT_RG_8UI;
+		dim = 2;
+		break;
+	default:
+		GEM_THROW( "Texture is not BC1 to BC5 compressed." );
+	}
+
+
+	// decompress each layer of each level next to the old ones, at its real
+	// size
+	Allocator levels[MAX_MIP_LEVELS];
+	for ( unsigned int i = 0; i < mipLevelCount_; ++i )
+	{
+		const unsigned int w = std::max( width_ >> i, 1u );
+		const unsigned int h = std::max( height_ >> i, 1u );
+		levels[i].setTag( ALLOC_TAG_TEXTURE );
+		levels[i].alloc( static_cast<ALLOC_FORMAT>(format), w,
+						 h * layerCount_, ALLOC_MODE_NOINIT );
+		const unsigned int blockByteCount = mipLevels_[i].getByteCount() /
+											layerCount_;
+		for ( unsigned int layer = 0; layer < layerCount_; ++layer )
+		{
+			decompressImage( mipLevels_[i].getReadPtr<unsigned char>() +
+							 layer * blockByteCount, w, h, textureFormat_, dim,
+							 levels[i].getWritePtr<unsigned char>() + layer *
+							 w * h * dim );
+		}
+	}
+
+
+	// swap them in
+	for ( unsigned int i = 0; i < mipLevelCount_; ++i )
+	{
+#ifdef GEM_HAS_RVALUE_REFS
+		mipLevels_[i] = std::move( levels[i] );
+#else
+		mipLevels_[i] = levels[i];
+#endif
+	}
+	textureFormat_ = format;
+}
+
+
+//-- private file-io -----------------------------------------------------------
+
+void
+TextureLoader::loadBMP( const std::string& _path )
+{
+	// local vars
+	std::ifstream ifs;
+	BITMAPFILEHEADER filehdr;
+	BITMAPINFOHEADER infohdr;
+	unsigned int masks[4] = { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
+
+
+	// open file for reading
+	ifs.open( _path.c_str(), std::ifstream::in | std::ifstream::binary );
+	if ( ifs.fail() )
+	{
+		GEM_THROW( "Could not open file " + _path );
+	}
+
+
+	// read file header.
+	// values are read one by one rather then the whole struct at once because
+	// compilers will not always do two-padding of structs. This way is
+	// preferred here over getting into compiler specific directives.
+	ifs.read( reinterpret_cast<char*>(&filehdr.type), 2 );
+	ifs.read( reinterpret_cast<char*>(&filehdr.size), 4 );
+	ifs.read( reinterpret_cast<char*>(&filehdr.reserved1), 2 );
+	ifs.read( reinterpret_cast<char*>(&filehdr.reserved2), 2 );
+	ifs.read( reinterpret_cast<char*>(&filehdr.offBits), 4 );
+	if ( ifs.fail( ) )
+	{
+		ifs.close();
+		GEM_THROW( "Failed to read image file header." );
+	}
+
+	
+	// make sure its a bitmap
+	if ( filehdr.type[0] != 'B' || filehdr.type[1] != 'M' )
+	{
+		ifs.close();
+		GEM_THROW( "File is not a bitmap." );
+	}
+
+
+	// read info header, the first 40 bytes of any of its versions
+	ifs.read( reinterpret_cast<char*>(&infohdr), 40 );
+	if ( ifs.fail( ) )
+	{
+		ifs.close();
+		GEM_THROW( "Failed to read image info header." );
+	}
+
+
+	// bit masks follow the first 40 bytes, alpha too in the longer headers
+	if ( infohdr.compression == BMP_BITFIELDS ||
+		 infohdr.compression == BMP_ALPHABITFIELDS )
+	{
+		masks[3] = 0;
+		ifs.read( reinterpret_cast<char*>(masks), infohdr.size >= 56 ||
+				  infohdr.compression == BMP_ALPHABITFIELDS ? 16 : 12 );
+		if ( ifs.fail( ) )
+		{
+			ifs.close();
+			GEM_THROW( "Failed to read image bit masks." );
+		}
+	}
+
+
+	// 8-bit (monochrome), 24-bit (bgr) and 32-bit (bgra). 32-bit files with
+	// other masks are unpacked through them, to rgb if they have no alpha.
+	TEXTURE_FORMAT textureFormat;
+	bool isMasked = false;
+	if ( infohdr.bitCount == 8 && infohdr.compression == BMP_RGB )
+	{
+		textureFormat = TEXTURE_FORMAT_R_8UI;
+	}
+	else if ( infohdr.bitCount == 24 && infohdr.compression == BMP_RGB )
+	{
+		textureFormat = TEXTURE_FORMAT_RGB_8UI;
+	}
+	else if ( infohdr.bitCount == 32 && ( infohdr.compression == BMP_RGB ||
+			  infohdr.compression == BMP_BITFIELDS ||
+			  infohdr.compression == BMP_ALPHABITFIELDS ) )
+	{
+		textureFormat = masks[3] ? TEXTURE_FORMAT_RGBA_8UI :
+								   TEXTURE_FORMAT_RGB_8UI;
+		isMasked = masks[0] != 0x00ff0000 || masks[1] != 0x0000ff00 ||
+				   masks[2] != 0x000000ff || masks[3] != 0xff000000;
+	}
+	else
+	{
+		ifs.close();
+		GEM_THROW( "Bitmap format not supported." );
+	}
+	if ( infohdr.width <= 0 || infohdr.height == 0 )
+	{
+		ifs.close();
+		GEM_THROW( "Bitmap size not supported." );
+	}
+
+
+	// rows are padded to four bytes and run bottom to top, as in the level,
+	// unless the height is negative
+	const bool isTopDown = infohdr.height < 0;
+	const unsigned int width = infohdr.width;
+	const unsigned int height = isTopDown ? -infohdr.height : infohdr.height;
+	const unsigned int fileRowSize = ( width * infohdr.bitCount / 8 + 3 ) &
+									 ~3u;
+	const bool isDirect = !isTopDown && !isMasked &&
+						  fileRowSize == width * infohdr.bitCount / 8;
+
+
+	// map 8-bit pixel data straight from file
+	if ( isMapEnabled_ && isDirect && infohdr.bitCount == 8 )
+	{
+		ifs.close();
+		createMipLevels( width, height, textureFormat, 1, ALLOC_MODE_NOINIT,
+						 _path, filehdr.offBits );
+		return;
+	}
+
+
+	// allocate data and jump to data section
+	createMipLevels( width, height, textureFormat, 1, ALLOC_MODE_NOINIT );
+	unsigned char* ptr = mipLevels_[0].getWritePtr<unsigned char>();
+	const unsigned int rowSize = mipLevels_[0].getByteCount() / height;
+	ifs.seekg( filehdr.offBits, std::ios::beg );
+
+
+	// file rows are the level rows, read them in one go and swap R and B
+	// in place
+	if ( isDirect )
+	{
+		ifs.read( reinterpret_cast<char*>(ptr), mipLevels_[0].getByteCount() );
+		if ( ifs.fail() )
+		{
+			ifs.close();
+			GEM_THROW( "Failed to read image data." );
+		}
+		if ( infohdr.bitCount == 24 )
+			swapRedBlue24( ptr, ptr, width * height );
+		else if ( infohdr.bitCount == 32 )
+			swapRedBlue32( ptr, ptr, width * height );
+	}
+
+
+	// otherwise stream rows through a buffer into their place
+	else
+	{
+		const unsigned int chunkRowCount = std::max( 1u, FILE_CHUNK_SIZE /
+														 fileRowSize );
+		std::vector<unsigned char> chunk( chunkRowCount * fileRowSize );
+		for ( unsigned int y = 0; y < height; y += chunkRowCount )
+		{
+			const unsigned int rowCount = std::min( chunkRowCount, height - y );
+			ifs.read( reinterpret_cast<char*>(&chunk[0]),
+					  rowCount * fileRowSize );
+			if ( ifs.fail() )
+			{
+				ifs.close();
+				GEM_THROW( "Failed to read image data." );
+			}
+			for ( unsigned int i = 0; i < rowCount; ++i )
+			{
+				const unsigned char* src = &chunk[i * fileRowSize];
+				unsigned char* dst = ptr + rowSize * ( isTopDown ?
+					height - 1 - y - i : y + i );
+				if ( isMasked )
+					unpackMaskedPixels( src, width, 4, masks, rowSize / width,
+										dst );
+				else if ( infohdr.bitCount == 24 )
+					swapRedBlue24( src, dst, width );
+				else if ( infohdr.bitCount == 32 )
+					swapRedBlue32( src, dst, width );
+				else
+					std::memcpy( dst, src, rowSize );
+			}
+		}
+	}
+
 
 	// close file and return
 	ifs.close();
@@ -477,104 +1472,143 @@ TextureLoader::saveBMP( const std::string& _path )
 	}
 
 
+	// 8-bit/channel integer monochrome, RGB and RGBA
+	unsigned short bitCount;
+	if ( textureFormat_ == TEXTURE_FORMAT_R_8UI )
+	{
+		bitCount = 8;
+	}
+	else if ( textureFormat_ == TEXTURE_FORMAT_RGB_8UI )
+	{
+		bitCount = 24;
+	}
+	else if ( textureFormat_ == TEXTURE_FORMAT_RGBA_8UI )
+	{
+		bitCount = 32;
+	}
+	else
+	{
+		GEM_THROW( "Bitmap format not supported" );
+	}
+
+
 	// open file for writing
 	ofs.open( _path.c_str(), std::ofstream::out | std::ofstream::binary );
 	if ( ofs.fail() )
 	{
 		GEM_THROW( "Could not open file " + _path );
 	}
-		
-
-	// 8-bit/channel integer RGB
-	if ( textureFormat_ == TEXTURE_FORMAT_RGB_8UI )
-	{
-		// fill in file header
-		filehdr.type[0] = 'B';
-		filehdr.type[1] = 'M';
-		filehdr.size = mipLevels_[0].getByteCount();
-		filehdr.reserved1 = 0;
-		filehdr.reserved2 = 0;
-		filehdr.offBits = 54;
-
-
-		// write file header to file
-		// values are written one by one rather then the whole struct at once
-		// because compilers will not always do two-padding of structs. This
-		// way is preferred here over getting into compiler specific directives.
-		ofs.write( reinterpret_cast<char*>(&filehdr.type), 2 );
-		ofs.write( reinterpret_cast<char*>(&filehdr.size), 4 );
-		ofs.write( reinterpret_cast<char*>(&filehdr.reserved1), 2 );
-		ofs.write( reinterpret_cast<char*>(&filehdr.reserved2), 2 );
-		ofs.write( reinterpret_cast<char*>(&filehdr.offBits), 4 );
-		if ( ofs.fail() )
-		{
-			ofs.close();
-			GEM_THROW( "Could not write header to file" );
-		}
 
 
-		// fill in info header
-		infohdr.size = 40;
-		infohdr.width = mipLevels_[0].getWidth();
-		infohdr.height = mipLevels_[0].getHeight();
-		infohdr.planes = 1;
-		infohdr.bitCount = mipLevels_[0].getBitsPerElement();
-		infohdr.compression = 0;
-		infohdr.sizeImage = mipLevels_[0].getByteCount();
-		infohdr.xPelsPerMeter = 0;
-		infohdr.yPelsPerMeter = 0;
-		infohdr.clrUsed = 0;
-		infohdr.clrImportant = 0;
-
-
-		// write info header to file
-		ofs.write( reinterpret_cast<char*>(&infohdr), 40 );
-		if ( ofs.fail() )
-		{
-			ofs.close();
-			GEM_THROW( "Could not write info header to file" );
-		}
+	// rows padded to four bytes, 8-bit files with a gray palette first
+	const unsigned int width = mipLevels_[0].getWidth();
+	const unsigned int height = mipLevels_[0].getHeight();
+	const unsigned int rowSize = width * bitCount / 8;
+	const unsigned int fileRowSize = ( rowSize + 3 ) & ~3u;
+	const unsigned int paletteSize = bitCount == 8 ? 1024 : 0;
+
+
+	// fill in file header
+	filehdr.type[0] = 'B';
+	filehdr.type[1] = 'M';
+	filehdr.size = 54 + paletteSize + fileRowSize * height;
+	filehdr.reserved1 = 0;
+	filehdr.reserved2 = 0;
+	filehdr.offBits = 54 + paletteSize;
+
+
+	// write file header to file
+	// values are written one by one rather then the whole struct at once
+	// because compilers will not always do two-padding of structs. This
+	// way is preferred here over getting into compiler specific directives.
+	ofs.write( reinterpret_cast<char*>(&filehdr.type), 2 );
+	ofs.write( reinterpret_cast<char*>(&filehdr.size), 4 );
+	ofs.write( reinterpret_cast<char*>(&filehdr.reserved1), 2 );
+	ofs.write( reinterpret_cast<char*>(&filehdr.reserved2), 2 );
+	ofs.write( reinterpret_cast<char*>(&filehdr.offBits), 4 );
+	if ( ofs.fail() )
+	{
+		ofs.close();
+		GEM_THROW( "Could not write header to file" );
+	}
 
 
-		// get data pointer
-		char* ptr = mipLevels_[0].getWritePtr<char>();
-		int bytecount =  mipLevels_[0].getByteCount();
+	// fill in info header
+	infohdr.size = 40;
+	infohdr.width = width;
+	infohdr.height = height;
+	infohdr.planes = 1;
+	infohdr.bitCount = bitCount;
+	infohdr.compression = BMP_RGB;
+	infohdr.sizeImage = fileRowSize * height;
+	infohdr.xPelsPerMeter = 0;
+	infohdr.yPelsPerMeter = 0;
+	infohdr.clrUsed = paletteSize / 4;
+	infohdr.clrImportant = 0;
 
 
-		// file should be in BGR, so swap B and R
-		for ( int i=0; i<bytecount; i+=3 )
+	// write info header and palette to file
+	ofs.write( reinterpret_cast<char*>(&infohdr), 40 );
+	if ( paletteSize )
+	{
+		unsigned char palette[1024];
+		for ( unsigned int i = 0; i < 256; ++i )
 		{
-			ptr[i] ^= ptr[i+2];
-			ptr[i+2] ^= ptr[i];
-			ptr[i] ^= ptr[i+2];
+			palette[4*i] = palette[4*i+1] = palette[4*i+2] =
+				static_cast<unsigned char>( i );
+			palette[4*i+3] = 0;
 		}
+		ofs.write( reinterpret_cast<char*>(palette), paletteSize );
+	}
+	if ( ofs.fail() )
+	{
+		ofs.close();
+		GEM_THROW( "Could not write info header to file" );
+	}
 
 
-		// write data to file
-		ofs.write( ptr, bytecount );
+	// file rows are the level rows, write them in one go
+	const unsigned char* ptr = mipLevels_[0].getReadPtr<unsigned char>();
+	if ( bitCount == 8 && fileRowSize == rowSize )
+	{
+		ofs.write( reinterpret_cast<const char*>(ptr), rowSize * height );
 		if ( ofs.fail() )
 		{
 			ofs.close();
 			GEM_THROW( "Could not write data to file" );
 		}
+	}
 
 
-		// data is in RGB format, so swap R and B
-		for ( int i=0; i<bytecount; i+=3 )
-		{
-			ptr[i] ^= ptr[i+2];
-			ptr[i+2] ^= ptr[i];
-			ptr[i] ^= ptr[i+2];
-		}
-
-	}
-	
-	
-	// format not supported
+	// otherwise stream rows through a buffer, R and B swapped and padded
+	// with zeros
 	else
 	{
-		ofs.close();
-		GEM_THROW( "Bitmap format not supported" );
+		const unsigned int chunkRowCount = std::max( 1u, FILE_CHUNK_SIZE /
+														 fileRowSize );
+		std::vector<unsigned char> chunk( chunkRowCount * fileRowSize, 0 );
+		for ( unsigned int y = 0; y < height; y += chunkRowCount )
+		{
+			const unsigned int rowCount = std::min( chunkRowCount, height - y );
+			for ( unsigned int i = 0; i < rowCount; ++i )
+			{
+				const unsigned char* src = ptr + rowSize * ( y + i );
+				unsigned char* dst = &chunk[i * fileRowSize];
+				if ( bitCount == 24 )
+					swapRedBlue24( src, dst, width );
+				else if ( bitCount == 32 )
+					swapRedBlue32( src, dst, width );
+				else
+					std::memcpy( dst, src, rowSize );
+			}
+			ofs.write( reinterpret_cast<char*>(&chunk[0]),
+					   rowCount * fileRowSize );
+			if ( ofs.fail() )
+			{
+				ofs.close();
+				GEM_THROW( "Could not write data to file" );
+			}
+		}
 	}
 
 
@@ -603,52 +1637,52 @@ TextureLoader::loadPFM( const std::string& _path )
 	ifs >> hdr.p >> hdr.f				// identifier line
 		>> hdr.width >> hdr.height		// dimension line
 		>> hdr.scalefactor;				// scale/endianess line
-		ifs.getline( &ignore, 1 );		// chew last linefeed
-	if ( hdr.p!='P' || ( hdr.f!='F' && hdr .f!='f' ) )
+		ifs.get( ignore );				// chew last linefeed
+	if ( ifs.fail() || hdr.p!='P' || ( hdr.f!='F' && hdr .f!='f' ) )
 	{
 		ifs.close();
 		GEM_THROW( "Failed to read image header." );
 	}
 
 
-	// 32-bit/channel floating point RGB
-	if ( hdr.f=='F' )
-	{
-		// allocate data
-		createMipLevels( hdr.width, hdr.height, TEXTURE_FORMAT_RGB_32F, 1 );
+	// 32-bit/channel floating point RGB or monochrome, rows run bottom to
+	// top as in the level, little endian if the scale is negative
+	const TEXTURE_FORMAT textureFormat = hdr.f=='F' ?
+		TEXTURE_FORMAT_RGB_32F : TEXTURE_FORMAT_R_32F;
+	const bool isBigEndian = hdr.scalefactor > 0.0f;
 
 
-		// get character ptr and total bytecount
-		char* ptr = mipLevels_[0].getWritePtr<char>();
-		int bytecount =  mipLevels_[0].getByteCount();
+	// map little endian pixel data straight from file
+	if ( isMapEnabled_ && !isBigEndian )
+	{
+		unsigned long long offset = ifs.tellg();
+		ifs.close();
+		createMipLevels( hdr.width, hdr.height, textureFormat, 1,
+						 ALLOC_MODE_NOINIT, _path, offset );
+		return;
+	}
 
 
-		// read floating point data from file
-		ifs.read( ptr, bytecount );
-		if ( ifs.fail() )
-		{
-			ifs.close();
-			GEM_THROW( "Failed to read image data." );
-		}
-	}
+	// allocate data
+	createMipLevels( hdr.width, hdr.height, textureFormat, 1,
+					 ALLOC_MODE_NOINIT );
 
- 
-	// 32-bit/channel floating point monochrome
-	else
-	{
-		// set variables and allocate data
-		createMipLevels( hdr.width, hdr.height, TEXTURE_FORMAT_R_32F, 1 );
-		char* ptr = mipLevels_[0].getWritePtr<char>();
-		int bytecount =  mipLevels_[0].getByteCount();
 
+	// get character ptr and total bytecount
+	unsigned char* ptr = mipLevels_[0].getWritePtr<unsigned char>();
+	unsigned int bytecount =  mipLevels_[0].getByteCount();
 
-		// read floating point data from file
-		ifs.read( ptr, bytecount );
-		if ( ifs.fail() )
-		{
-			ifs.close();
-			GEM_THROW( "Failed to read image data." );
-		}
+
+	// read floating point data from file, swap the bytes of big endian
+	ifs.read( reinterpret_cast<char*>(ptr), bytecount );
+	if ( ifs.fail() )
+	{
+		ifs.close();
+		GEM_THROW( "Failed to read image data." );
+	}
+	if ( isBigEndian )
+	{
+		swapBytes32( ptr, ptr, bytecount / 4 );
 	}
 
 
@@ -674,19 +1708,17 @@ TextureLoader::savePFM( const std::string& _path )
 	// open file for writing
 	ofs.open( _path.c_str(), std::ofstream::out | std::ofstream::binary );
 	if ( ofs.fail() )
-	if ( ofs.fail() )
 	{
 		GEM_THROW( "Could not open file " + _path );
 	}
 
 
-	// 16-bit/channel floating point RGB
 	// 32-bit/channel floating point RGB
-	// 16-bit/channel floating point monochrome
 	// 32-bit/channel floating point monochrome
 	ALLOC_TYPE allocType = mipLevels_[0].getType();
 	ALLOC_DIM allocDim = mipLevels_[0].getDim();
-	if ( allocType == ALLOC_TYPE_32F )
+	if ( allocType == ALLOC_TYPE_32F && ( allocDim == ALLOC_DIM_SCALAR ||
+										  allocDim == ALLOC_DIM_VEC3 ) )
 	{
 		// set header info
 		hdr.p = 'P';
@@ -708,11 +1740,11 @@ TextureLoader::savePFM( const std::string& _path )
 
 
 		// get data pointer
-		char* ptr = mipLevels_[0].getWritePtr<char>();
+		const char* ptr = mipLevels_[0].getReadPtr<char>();
 		int bytecount =  mipLevels_[0].getByteCount();
 
 
-		// write data to file
+		// write little endian data to file in one go, rows bottom to top
 		ofs.write( ptr, bytecount );
 		if ( ofs.fail() )
 		{
@@ -740,6 +1772,7 @@ TextureLoader::loadDDS( const std::string& _path )
 	// local vars
 	std::ifstream ifs;
 	DDSHEADER ddshdr;
+	DDSHEADERDX10 dx10hdr;
 
 
 	// open file for reading
@@ -760,43 +1793,236 @@ TextureLoader::loadDDS( const std::string& _path )
 
 
 	// make sure its a .dds file
-	if ( ddshdr.type == "DDS " )
+	if ( std::memcmp( ddshdr.type, "DDS ", 4 ) != 0 )
 	{
 		ifs.close();
 		GEM_THROW( "File is not a DDS file." );
 	}
+	if ( ddshdr.caps.caps2 & DDSCAPS2_VOLUME )
+	{
+		ifs.close();
+		GEM_THROW( "DDS volume textures not supported." );
+	}
 
 
-	// DXT1 format
-	if ( ddshdr.pixelFormat.fourCC==FOURCC_DXT1 )
+	// extended header follows when fourCC says so
+	const bool isFourCC = ( ddshdr.pixelFormat.flags & DDPF_FOURCC ) != 0;
+	const bool isDX10 = isFourCC && ddshdr.pixelFormat.fourCC == FOURCC_DX10;
+	if ( isDX10 )
 	{
-		// allocate data
-		createMipLevels( ddshdr.width, ddshdr.height,
-						 TEXTURE_FORMAT_RGB_DXT1, ddshdr.mipMapCount );
+		ifs.read( reinterpret_cast<char*>(&dx10hdr), sizeof( DDSHEADERDX10 ) );
+		if ( ifs.fail() )
+		{
+			ifs.close();
+			GEM_THROW( "Failed to read DX10 header." );
+		}
+		if ( dx10hdr.resourceDimension != DDS_DIMENSION_TEXTURE2D )
+		{
+			ifs.close();
+			GEM_THROW( "Only 2D DDS textures are supported." );
+		}
+	}
 
 
-		// read image data for each mipmap
-		for ( unsigned int i=0; i<mipLevelCount_; ++i )
+	// Layers, see the top of the header. The DX10 header counts cubes and
+	// textures in arraySize, the old one has a cube map flag per face and no
+	// arrays.
+	TEXTURE_TARGET textureTarget = TEXTURE_TARGET_2D;
+	unsigned int layerCount = 1;
+	if ( isDX10 )
+	{
+		const unsigned int arraySize = std::max( dx10hdr.arraySize, 1u );
+		if ( dx10hdr.miscFlag & DDS_MISC_TEXTURECUBE )
+		{
+			textureTarget = arraySize > 1 ? TEXTURE_TARGET_CUBE_MAP_ARRAY :
+											TEXTURE_TARGET_CUBE_MAP;
+			layerCount = 6 * arraySize;
+		}
+		else if ( arraySize > 1 )
+		{
+			textureTarget = TEXTURE_TARGET_2D_ARRAY;
+			layerCount = arraySize;
+		}
+	}
+	else if ( ddshdr.caps.caps2 & DDSCAPS2_CUBEMAP )
+	{
+		if ( ( ddshdr.caps.caps2 & DDSCAPS2_ALLFACES ) != DDSCAPS2_ALLFACES )
 		{
-			// get character ptr and total bytecount
-			char* ptr = mipLevels_[i].getWritePtr<char>();
-			int bytecount =  mipLevels_[i].getByteCount();
+			ifs.close();
+			GEM_THROW( "DDS cube maps without all six faces not supported." );
+		}
+		textureTarget = TEXTURE_TARGET_CUBE_MAP;
+		layerCount = 6;
+	}
 
-			ifs.read( ptr, bytecount );
-			if ( ifs.fail() )
-			{
-				ifs.close();
-				GEM_THROW( "Failed to read image data." );
-			}
+
+	// Texture format. Block compressed and float formats by DXGI format or
+	// four character code, the rest by bit masks. Masks that match the
+	// layout of an 8UI format are read as is, others a surface at a time
+	// through unpackMaskedPixels().
+	TEXTURE_FORMAT textureFormat = TEXTURE_FORMAT_NONE;
+	unsigned int bitCount = ddshdr.pixelFormat.rgbBitCount;
+	unsigned int masks[4] = { ddshdr.pixelFormat.rBitMask,
+							  ddshdr.pixelFormat.gBitMask,
+							  ddshdr.pixelFormat.bBitMask,
+							  ddshdr.pixelFormat.rgbAlphaBitMask };
+	bool isMasked = false;
+	if ( isDX10 )
+	{
+		for ( unsigned int i = 0;
+			  i < sizeof( DXGI_FORMATS ) / sizeof( DXGIFORMAT ); ++i )
+		{
+			if ( DXGI_FORMATS[i].dxgiFormat == dx10hdr.dxgiFormat )
+				textureFormat = DXGI_FORMATS[i].textureFormat;
+		}
+		if ( dx10hdr.dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM ||
+			 dx10hdr.dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+			 dx10hdr.dxgiFormat == DXGI_FORMAT_B8G8R8X8_UNORM ||
+			 dx10hdr.dxgiFormat == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB )
+		{
+			const bool isAlpha =
+				dx10hdr.dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM ||
+				dx10hdr.dxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+			textureFormat = isAlpha ? TEXTURE_FORMAT_RGBA_8UI :
+									  TEXTURE_FORMAT_RGB_8UI;
+			bitCount = 32;
+			masks[0] = 0x00ff0000;
+			masks[1] = 0x0000ff00;
+			masks[2] = 0x000000ff;
+			masks[3] = isAlpha ? 0xff000000 : 0;
+			isMasked = true;
+		}
+	}
+	else if ( isFourCC )
+	{
+		switch ( ddshdr.pixelFormat.fourCC )
+		{
+		case FOURCC_DXT1:
+			textureFormat = TEXTURE_FORMAT_RGB_DXT1;
+			break;
+		case FOURCC_DXT3:
+			textureFormat = TEXTURE_FORMAT_RGBA_DXT3;
+			break;
+		case FOURCC_DXT5:
+			textureFormat = TEXTURE_FORMAT_RGBA_DXT5;
+			break;
+		case FOURCC_ATI1:
+		case FOURCC_BC4U:
+			textureFormat = TEXTURE_FORMAT_R_BC4;
+			break;
+		case FOURCC_ATI2:
+		case FOURCC_BC5U:
+			textureFormat = TEXTURE_FORMAT_RG_BC5;
+			break;
+		case D3DFMT_R16F:
+			textureFormat = TEXTURE_FORMAT_R_16F;
+			break;
+		case D3DFMT_G16R16F:
+			textureFormat = TEXTURE_FORMAT_RG_16F;
+			break;
+		case D3DFMT_A16B16G16R16F:
+			textureFormat = TEXTURE_FORMAT_RGBA_16F;
+			break;
+		case D3DFMT_R32F:
+			textureFormat = TEXTURE_FORMAT_R_32F;
+			break;
+		case D3DFMT_G32R32F:
+			textureFormat = TEXTURE_FORMAT_RG_32F;
+			break;
+		case D3DFMT_A32B32G32R32F:
+			textureFormat = TEXTURE_FORMAT_RGBA_32F;
+			break;
+		}
+	}
+	else if ( bitCount == 8 || bitCount == 16 || bitCount == 24 ||
+			  bitCount == 32 )
+	{
+		// luminance and alpha to r and g, alpha only to r
+		const unsigned int flags = ddshdr.pixelFormat.flags;
+		const bool isAlpha = ( flags & ( DDPF_ALPHAPIXELS | DDPF_ALPHA ) ) &&
+							 masks[3];
+		if ( flags & DDPF_LUMINANCE )
+		{
+			textureFormat = isAlpha ? TEXTURE_FORMAT_RG_8UI :
+									  TEXTURE_FORMAT_R_8UI;
+			masks[1] = isAlpha ? masks[3] : 0;
+		}
+		else if ( flags & DDPF_RGB )
+		{
+			textureFormat = isAlpha ? TEXTURE_FORMAT_RGBA_8UI :
+									  TEXTURE_FORMAT_RGB_8UI;
+		}
+		else if ( isAlpha )
+		{
+			textureFormat = TEXTURE_FORMAT_R_8UI;
+			masks[0] = masks[3];
 		}
+
+		// read as is when channel k is byte k
+		const unsigned int dim = textureFormat == TEXTURE_FORMAT_R_8UI ? 1 :
+								 textureFormat == TEXTURE_FORMAT_RG_8UI ? 2 :
+								 textureFormat == TEXTURE_FORMAT_RGB_8UI ? 3 :
+																		   4;
+		isMasked = bitCount != 8 * dim;
+		for ( unsigned int k = 0; k < dim; ++k )
+			isMasked |= masks[k] != 0xffu << ( 8 * k );
+	}
+	if ( textureFormat == TEXTURE_FORMAT_NONE )
+	{
+		ifs.close();
+		GEM_THROW( "DDS pixel format not supported." );
 	}
+	const unsigned int mipMapCount = std::max( ddshdr.mipMapCount, 1u );
 
 
-	// format not supported
-	else
+	// mapped straight from file, a single layer in the layout of its format
+	if ( isMapEnabled_ && layerCount == 1 && !isMasked )
 	{
+		unsigned long long offset = ifs.tellg();
 		ifs.close();
-		GEM_THROW( "This file is not a DXT1 file." );
+		createMipLevels( ddshdr.width, ddshdr.height, textureFormat,
+						 mipMapCount, ALLOC_MODE_NOINIT, _path, offset );
+		return;
+	}
+
+
+	// allocate data
+	createMipLevels( ddshdr.width, ddshdr.height, textureFormat, mipMapCount,
+					 ALLOC_MODE_NOINIT, "", 0, textureTarget, layerCount );
+
+
+	// Read each surface into its place in the level, a layer with all its
+	// levels at a time as the file has them, see the top of the header.
+	const unsigned int dim = mipLevels_[0].getDim() - ALLOC_DIM_NONE;
+	std::vector<unsigned char> bytes;
+	for ( unsigned int layer = 0; layer < layerCount_; ++layer )
+	{
+		for ( unsigned int i = 0; i < mipLevelCount_; ++i )
+		{
+			// get character ptr and bytecount of the surface
+			int bytecount = mipLevels_[i].getByteCount() / layerCount_;
+			char* ptr = mipLevels_[i].getWritePtr<char>() + layer * bytecount;
+
+			if ( !isMasked )
+			{
+				ifs.read( ptr, bytecount );
+			}
+			else
+			{
+				const unsigned int pixelCount = bytecount / dim;
+				bytes.resize( pixelCount * ( bitCount / 8 ) );
+				ifs.read( reinterpret_cast<char*>( &bytes[0] ),
+						  bytes.size() );
+				unpackMaskedPixels( &bytes[0], pixelCount, bitCount / 8, masks,
+									dim, reinterpret_cast<unsigned char*>(
+									ptr ) );
+			}
+			if ( ifs.fail() )
+			{
+				ifs.close();
+				GEM_THROW( "Failed to read image data." );
+			}
+		}
 	}
 
 
@@ -807,6 +2033,180 @@ TextureLoader::loadDDS( const std::string& _path )
 void
 TextureLoader::saveDDS( const std::string& _path )
 {
+	// local vars
+	std::ofstream ofs;
+	DDSHEADER ddshdr;
+	DDSHEADERDX10 dx10hdr;
+
+
+	// header common to all formats
+	std::memset( &ddshdr, 0, sizeof( DDSHEADER ) );
+	std::memset( &dx10hdr, 0, sizeof( DDSHEADERDX10 ) );
+	std::memcpy( ddshdr.type, "DDS ", 4 );
+	ddshdr.size = 124;
+	ddshdr.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+				   DDSD_MIPMAPCOUNT;
+	ddshdr.height = height_;
+	ddshdr.width = width_;
+	ddshdr.mipMapCount = mipLevelCount_;
+	ddshdr.pixelFormat.size = 32;
+	ddshdr.caps.caps1 = DDSCAPS_TEXTURE;
+	if ( mipLevelCount_ > 1 )
+		ddshdr.caps.caps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	if ( textureTarget_ == TEXTURE_TARGET_CUBE_MAP )
+	{
+		ddshdr.caps.caps1 |= DDSCAPS_COMPLEX;
+		ddshdr.caps.caps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_ALLFACES;
+	}
+
+
+	// block compressed and float formats by four character code, the size
+	// of the first level in bytes, 8UI by bit masks and the pitch of a row
+	switch ( textureFormat_ )
+	{
+	case TEXTURE_FORMAT_RGB_DXT1:
+		ddshdr.pixelFormat.fourCC = FOURCC_DXT1;
+		break;
+	case TEXTURE_FORMAT_RGBA_DXT3:
+		ddshdr.pixelFormat.fourCC = FOURCC_DXT3;
+		break;
+	case TEXTURE_FORMAT_RGBA_DXT5:
+		ddshdr.pixelFormat.fourCC = FOURCC_DXT5;
+		break;
+	case TEXTURE_FORMAT_R_BC4:
+		ddshdr.pixelFormat.fourCC = FOURCC_ATI1;
+		break;
+	case TEXTURE_FORMAT_RG_BC5:
+		ddshdr.pixelFormat.fourCC = FOURCC_ATI2;
+		break;
+	case TEXTURE_FORMAT_R_16F:
+		ddshdr.pixelFormat.fourCC = D3DFMT_R16F;
+		break;
+	case TEXTURE_FORMAT_RG_16F:
+		ddshdr.pixelFormat.fourCC = D3DFMT_G16R16F;
+		break;
+	case TEXTURE_FORMAT_RGBA_16F:
+		ddshdr.pixelFormat.fourCC = D3DFMT_A16B16G16R16F;
+		break;
+	case TEXTURE_FORMAT_R_32F:
+		ddshdr.pixelFormat.fourCC = D3DFMT_R32F;
+		break;
+	case TEXTURE_FORMAT_RG_32F:
+		ddshdr.pixelFormat.fourCC = D3DFMT_G32R32F;
+		break;
+	case TEXTURE_FORMAT_RGBA_32F:
+		ddshdr.pixelFormat.fourCC = D3DFMT_A32B32G32R32F;
+		break;
+	case TEXTURE_FORMAT_R_8UI:
+		ddshdr.pixelFormat.flags = DDPF_LUMINANCE;
+		ddshdr.pixelFormat.rgbBitCount = 8;
+		ddshdr.pixelFormat.rBitMask = 0x000000ff;
+		break;
+	case TEXTURE_FORMAT_RGB_8UI:
+		ddshdr.pixelFormat.flags = DDPF_RGB;
+		ddshdr.pixelFormat.rgbBitCount = 24;
+		ddshdr.pixelFormat.rBitMask = 0x000000ff;
+		ddshdr.pixelFormat.gBitMask = 0x0000ff00;
+		ddshdr.pixelFormat.bBitMask = 0x00ff0000;
+		break;
+	case TEXTURE_FORMAT_RGBA_8UI:
+		ddshdr.pixelFormat.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+		ddshdr.pixelFormat.rgbBitCount = 32;
+		ddshdr.pixelFormat.rBitMask = 0x000000ff;
+		ddshdr.pixelFormat.gBitMask = 0x0000ff00;
+		ddshdr.pixelFormat.bBitMask = 0x00ff0000;
+		ddshdr.pixelFormat.rgbAlphaBitMask = 0xff000000;
+		break;
+	default:
+		break;
+	}
+
+
+	// Arrays and formats the old header has no code for get the DX10
+	// header, with the same size fields
+	const bool isArray = textureTarget_ == TEXTURE_TARGET_2D_ARRAY ||
+						 textureTarget_ == TEXTURE_TARGET_CUBE_MAP_ARRAY;
+	const bool isDX10 = isArray || ( !ddshdr.pixelFormat.fourCC &&
+									 !ddshdr.pixelFormat.flags );
+	if ( isDX10 )
+	{
+		for ( unsigned int i = 0;
+			  i < sizeof( DXGI_FORMATS ) / sizeof( DXGIFORMAT ); ++i )
+		{
+			if ( DXGI_FORMATS[i].textureFormat == textureFormat_ )
+			{
+				dx10hdr.dxgiFormat = DXGI_FORMATS[i].dxgiFormat;
+				break;
+			}
+		}
+		if ( !dx10hdr.dxgiFormat )
+			GEM_THROW( "DDS format not supported" );
+		const bool isCube = textureTarget_ == TEXTURE_TARGET_CUBE_MAP ||
+							textureTarget_ == TEXTURE_TARGET_CUBE_MAP_ARRAY;
+		dx10hdr.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		dx10hdr.miscFlag = isCube ? DDS_MISC_TEXTURECUBE : 0;
+		dx10hdr.arraySize = isCube ? layerCount_ / 6 : layerCount_;
+		ddshdr.pixelFormat.flags = DDPF_FOURCC;
+		ddshdr.pixelFormat.fourCC = FOURCC_DX10;
+		ddshdr.pixelFormat.rgbBitCount = 0;
+		ddshdr.pixelFormat.rBitMask = 0;
+		ddshdr.pixelFormat.gBitMask = 0;
+		ddshdr.pixelFormat.bBitMask = 0;
+		ddshdr.pixelFormat.rgbAlphaBitMask = 0;
+	}
+	if ( ddshdr.pixelFormat.fourCC )
+	{
+		ddshdr.flags |= DDSD_LINEARSIZE;
+		ddshdr.pixelFormat.flags = DDPF_FOURCC;
+		ddshdr.linearSize = mipLevels_[0].getByteCount() / layerCount_;
+	}
+	else
+	{
+		ddshdr.flags |= DDSD_PITCH;
+		ddshdr.linearSize = width_ * ddshdr.pixelFormat.rgbBitCount / 8;
+	}
+
+
+	// open file for writing
+	ofs.open( _path.c_str(), std::ofstream::out | std::ofstream::binary );
+	if ( ofs.fail() )
+	{
+		GEM_THROW( "Could not open file " + _path );
+	}
+
+
+	// write headers
+	ofs.write( reinterpret_cast<char*>(&ddshdr), sizeof( DDSHEADER ) );
+	if ( isDX10 )
+		ofs.write( reinterpret_cast<char*>(&dx10hdr), sizeof( DDSHEADERDX10 ) );
+	if ( ofs.fail() )
+	{
+		ofs.close();
+		GEM_THROW( "Could not write header to file" );
+	}
+
+
+	// write each surface, a layer with all its levels at a time
+	for ( unsigned int layer = 0; layer < layerCount_; ++layer )
+	{
+		for ( unsigned int i=0; i<mipLevelCount_; ++i )
+		{
+			int bytecount = mipLevels_[i].getByteCount() / layerCount_;
+			const char* ptr = mipLevels_[i].getReadPtr<char>() + layer *
+							  bytecount;
+
+			ofs.write( ptr, bytecount );
+			if ( ofs.fail() )
+			{
+				ofs.close();
+				GEM_THROW( "Could not write data to file" );
+			}
+		}
+	}
+
+
+	// cleanup and return
+	ofs.close();
 }
 
 //==============================================================================
@@ -20,6 +20,7 @@
 
 //== INCLUDES ==================================================================
 
+#include "MemAdjacency.h"
 #include "MemGlobals.h"
 #include "MemMatrix.h"
 #include "MemPolynomial.h"
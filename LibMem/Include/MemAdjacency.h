@@ -0,0 +1,191 @@
+//==============================================================================
+//
+//	Vertex and face adjacency of a triangle mesh in compressed sparse row
+//	layout, built once in O(F) with a counting sort
+//
+//	The faces around vertex v are getVertexFaces() from faceFirst[v] to
+//	faceFirst[v+1], the vertices sharing a face with it getVertexNeighbours(),
+//	both in face order. Half-edge 3*f+k runs from corner k of face f to corner
+//	k+1, and with twins built getTwin() gives the half-edge running the other
+//	way, NO_TWIN on open edges. Edges with more than two faces pair their
+//	half-edges in face order as far as they go, and faces that disagree on
+//	orientation are not twins.
+//
+//	k-ring queries walk the neighbour lists breadth first and mark vertices
+//	in a bitmap kept in a RingQuery, clearing only the bits they set, so a
+//	RingQuery reused for many queries does not allocate after the first few.
+//	A RingQuery belongs to one thread, the Adjacency itself is only read and
+//	can be shared by any number of them. findRings() runs a batch of queries
+//	over threads into one CSR list, in the order of the batch.
+//
+//		Adjacency adjacency( triangles );
+//		Adjacency::RingQuery query;
+//		for ( ... )
+//		{
+//			adjacency.findRing( idx, 2, &query );
+//			smooth( query.ring );
+//		}
+//
+//==============================================================================
+
+
+#ifndef MEM_ADJACENCY_H
+#define MEM_ADJACENCY_H
+
+
+//== INCLUDES ==================================================================
+
+#include "MemPrerequisites.h"
+#include "MemVector.h"
+
+
+//== NAMESPACES ================================================================
+
+MEM_BEGIN_NAMESPACE
+
+
+//== CLASS DEFINITION ==========================================================
+
+class Adjacency
+{
+public:
+
+	//-- define, typedef, enum -------------------------------------------------
+
+	static const unsigned int NO_TWIN = 0xffffffff;
+
+	// scratch space and result of findRing(), one per thread
+	struct RingQuery
+	{
+		std::vector<unsigned int> visited;		// bitmap, 32 vertices a word
+		std::vector<unsigned int> ring;			// center first, by distance
+		std::vector<unsigned int> levelFirst;	// into ring, level+2 entries
+	};
+
+
+	//-- constructors ----------------------------------------------------------
+
+	// empty adjacency
+	Adjacency();
+
+	// build from triangles, see build()
+	explicit Adjacency( const std::vector<Vec3ui>& tri,
+						unsigned int vertexCount = 0,
+						bool isTwinsEnabled = false );
+
+	// compiler generated destructor is ok.
+
+	// compiler generated copy constructor is ok.
+
+	// compiler generated assignment operator is ok.
+
+
+	//-- build -----------------------------------------------------------------
+
+	// Build from triCount triangles of three indices each. With vertexCount
+	// zero the vertex count is one past the largest index.
+	void build( const unsigned int* tri, unsigned int triCount,
+				unsigned int vertexCount = 0,
+				bool isTwinsEnabled = false );
+
+	void build( const std::vector<Vec3ui>& tri,
+				unsigned int vertexCount = 0,
+				bool isTwinsEnabled = false );
+
+	void clear();
+
+
+	//-- gets ------------------------------------------------------------------
+
+	unsigned int getVertexCount() const
+	{ return vertexCount; }
+
+	unsigned int getFaceCount() const
+	{ return static_cast<unsigned int>( indices.size() / 3 ); }
+
+	// faces around v, count of them in *count
+	const unsigned int* getVertexFaces( unsigned int v,
+										unsigned int* count ) const
+	{
+		assert( v < vertexCount );
+		*count = faceFirst[v+1] - faceFirst[v];
+		return faces.empty() ? NULL : &faces[faceFirst[v]];
+	}
+
+	// vertices sharing a face with v, count of them in *count
+	const unsigned int* getVertexNeighbours( unsigned int v,
+											 unsigned int* count ) const
+	{
+		assert( v < vertexCount );
+		*count = neighbourFirst[v+1] - neighbourFirst[v];
+		return neighbours.empty() ? NULL : &neighbours[neighbourFirst[v]];
+	}
+
+	bool hasTwins() const
+	{ return !twins.empty() || indices.empty(); }
+
+	// half-edge running the other way, NO_TWIN on open edges
+	unsigned int getTwin( unsigned int halfEdge ) const
+	{
+		assert( halfEdge < twins.size() );
+		return twins[halfEdge];
+	}
+
+
+	//-- k-ring queries --------------------------------------------------------
+
+	// Vertices at most level edges from idx into query->ring, idx first and
+	// the rest by distance, ring k from levelFirst[k] to levelFirst[k+1].
+	// Returns the number of vertices.
+	unsigned int findRing( unsigned int idx, unsigned int level,
+						   RingQuery* query ) const;
+
+	// findRing() for count vertices, ring i from first[i] to first[i+1] in
+	// rings. Split over threadCount threads, all cores with zero.
+	void findRings( const unsigned int* idx, unsigned int count,
+					unsigned int level,
+					std::vector<unsigned int>* first,
+					std::vector<unsigned int>* rings,
+					unsigned int threadCount = 0 ) const;
+
+private:
+
+	//-- private build ---------------------------------------------------------
+
+	void buildNeighbours();
+
+	void buildTwins();
+
+
+	//-- private k-ring queries ------------------------------------------------
+
+	// rings of idx[begin] to idx[end] appended to rings, the end of each
+	// appended to ends
+	void findRingRange( const unsigned int* idx, unsigned int begin,
+						unsigned int end, unsigned int level,
+						std::vector<unsigned int>* ends,
+						std::vector<unsigned int>* rings ) const;
+
+private:
+
+	// triangles as given
+	std::vector<unsigned int> indices;
+	unsigned int vertexCount;
+
+	// faces around each vertex
+	std::vector<unsigned int> faceFirst;
+	std::vector<unsigned int> faces;
+
+	// vertices sharing a face with each vertex
+	std::vector<unsigned int> neighbourFirst;
+	std::vector<unsigned int> neighbours;
+
+	// half-edge running the other way, empty unless built
+	std::vector<unsigned int> twins;
+};
+
+
+//==============================================================================
+MEM_END_NAMESPACE
+#endif
+//==============================================================================
@@ -109,6 +109,8 @@ Vec3f calcBiNormal( const Vec3f& v0, const Vec3f& v1,
 					const Vec3f& v2, const Vec2f& c0,
 					const Vec2f& c1, const Vec2f& c2 );
 
+// vertices at most level edges from idx, sorted, see Adjacency for many
+// queries on the same mesh
 std::vector<unsigned int>
 findNeighbours( const std::vector<Vec3ui>& tri,
 				unsigned int idx,
@@ -0,0 +1,325 @@
+//==============================================================================
+//
+//	Vertex and face adjacency of a triangle mesh in compressed sparse row
+//	layout, built once in O(F) with a counting sort
+//
+//==============================================================================
+
+
+
+//== INCLUDES ==================================================================
+
+#include "MemAdjacency.h"
+#include <thread>
+
+
+//== NAMESPACES ================================================================
+
+MEM_BEGIN_NAMESPACE
+
+
+
+//-- static constants ----------------------------------------------------------
+
+const unsigned int Adjacency::NO_TWIN;
+
+
+//-- constructors --------------------------------------------------------------
+
+Adjacency::Adjacency()
+	: vertexCount(0)
+	, faceFirst(1,0)
+	, neighbourFirst(1,0)
+{}
+
+Adjacency::Adjacency( const std::vector<Vec3ui>& tri,
+					  unsigned int vertexCount,
+					  bool isTwinsEnabled )
+	: vertexCount(0)
+{
+	build( tri, vertexCount, isTwinsEnabled );
+}
+
+
+//-- build ---------------------------------------------------------------------
+
+void
+Adjacency::build( const unsigned int* tri, unsigned int triCount,
+				  unsigned int vertexCount, bool isTwinsEnabled )
+{
+	// triangles and vertex count
+	clear();
+	indices.assign( tri, tri + 3 * triCount );
+	for ( unsigned int i = 0; i < indices.size(); ++i )
+	{
+		vertexCount = std::max( vertexCount, indices[i] + 1 );
+	}
+	this->vertexCount = vertexCount;
+
+
+	// counting sort of faces by vertex, a face that has a vertex twice is
+	// listed once for it
+	faceFirst.assign( vertexCount + 1, 0 );
+	for ( unsigned int f = 0; f < triCount; ++f )
+	{
+		const unsigned int* t = &indices[3*f];
+		++faceFirst[t[0]+1];
+		if ( t[1] != t[0] )
+			++faceFirst[t[1]+1];
+		if ( t[2] != t[0] && t[2] != t[1] )
+			++faceFirst[t[2]+1];
+	}
+	for ( unsigned int v = 0; v < vertexCount; ++v )
+	{
+		faceFirst[v+1] += faceFirst[v];
+	}
+	faces.resize( faceFirst[vertexCount] );
+	std::vector<unsigned int> next( faceFirst.begin(), faceFirst.end() - 1 );
+	for ( unsigned int f = 0; f < triCount; ++f )
+	{
+		const unsigned int* t = &indices[3*f];
+		faces[next[t[0]]++] = f;
+		if ( t[1] != t[0] )
+			faces[next[t[1]]++] = f;
+		if ( t[2] != t[0] && t[2] != t[1] )
+			faces[next[t[2]]++] = f;
+	}
+
+
+	// the rest
+	buildNeighbours();
+	if ( isTwinsEnabled )
+		buildTwins();
+}
+
+void
+Adjacency::build( const std::vector<Vec3ui>& tri, unsigned int vertexCount,
+				  bool isTwinsEnabled )
+{
+	// Vec3ui is three packed unsigned ints
+	build( tri.empty() ? NULL : &tri[0][0],
+		   static_cast<unsigned int>( tri.size() ), vertexCount,
+		   isTwinsEnabled );
+}
+
+void
+Adjacency::clear()
+{
+	indices.clear();
+	vertexCount = 0;
+	faceFirst.assign( 1, 0 );
+	faces.clear();
+	neighbourFirst.assign( 1, 0 );
+	neighbours.clear();
+	twins.clear();
+}
+
+
+//-- k-ring queries ------------------------------------------------------------
+
+unsigned int
+Adjacency::findRing( unsigned int idx, unsigned int level,
+					 RingQuery* query ) const
+{
+	// bitmap for this mesh, all clear between queries
+	assert( idx < vertexCount );
+	std::vector<unsigned int>& visited = query->visited;
+	std::vector<unsigned int>& ring = query->ring;
+	std::vector<unsigned int>& levelFirst = query->levelFirst;
+	if ( visited.size() != ( vertexCount + 31 ) / 32 )
+		visited.assign( ( vertexCount + 31 ) / 32, 0 );
+
+
+	// breadth first over the neighbour lists, one ring per level
+	ring.clear();
+	levelFirst.clear();
+	ring.push_back( idx );
+	visited[idx >> 5] |= 1u << ( idx & 31 );
+	levelFirst.push_back( 0 );
+	unsigned int begin = 0;
+	for ( unsigned int k = 0; k < level; ++k )
+	{
+		unsigned int end = static_cast<unsigned int>( ring.size() );
+		levelFirst.push_back( end );
+		for ( unsigned int i = begin; i < end; ++i )
+		{
+			unsigned int v = ring[i];
+			for ( unsigned int j = neighbourFirst[v];
+				  j < neighbourFirst[v+1]; ++j )
+			{
+				unsigned int u = neighbours[j];
+				unsigned int bit = 1u << ( u & 31 );
+				if ( !( visited[u >> 5] & bit ) )
+				{
+					visited[u >> 5] |= bit;
+					ring.push_back( u );
+				}
+			}
+		}
+		begin = end;
+	}
+	levelFirst.push_back( static_cast<unsigned int>( ring.size() ) );
+
+
+	// clear the bits we set
+	for ( unsigned int i = 0; i < ring.size(); ++i )
+	{
+		visited[ring[i] >> 5] = 0;
+	}
+	return static_cast<unsigned int>( ring.size() );
+}
+
+void
+Adjacency::findRings( const unsigned int* idx, unsigned int count,
+					  unsigned int level,
+					  std::vector<unsigned int>* first,
+					  std::vector<unsigned int>* rings,
+					  unsigned int threadCount ) const
+{
+	// a contiguous range of the batch per thread, at least 256 queries
+	// each, the calling thread takes the first
+	if ( !threadCount )
+		threadCount = std::max( 1u, std::thread::hardware_concurrency() );
+	threadCount = std::max( 1u, std::min( threadCount, count / 256 ) );
+	std::vector<unsigned int> bounds( threadCount + 1 );
+	for ( unsigned int i = 0; i <= threadCount; ++i )
+	{
+		bounds[i] = static_cast<unsigned int>(
+			static_cast<unsigned long long>( count ) * i / threadCount );
+	}
+	std::vector< std::vector<unsigned int> > ends( threadCount );
+	std::vector< std::vector<unsigned int> > parts( threadCount );
+	std::vector<std::thread> workers;
+	for ( unsigned int i = 1; i < threadCount; ++i )
+	{
+		workers.push_back( std::thread( [=, &bounds, &ends, &parts]()
+		{
+			findRingRange( idx, bounds[i], bounds[i+1], level, &ends[i],
+						   &parts[i] );
+		} ) );
+	}
+	findRingRange( idx, bounds[0], bounds[1], level, &ends[0], &parts[0] );
+	for ( unsigned int i = 0; i < workers.size(); ++i )
+	{
+		workers[i].join();
+	}
+
+
+	// join the parts in batch order
+	first->assign( 1, 0 );
+	rings->clear();
+	for ( unsigned int i = 0; i < threadCount; ++i )
+	{
+		unsigned int offset = static_cast<unsigned int>( rings->size() );
+		for ( unsigned int j = 0; j < ends[i].size(); ++j )
+		{
+			first->push_back( offset + ends[i][j] );
+		}
+		rings->insert( rings->end(), parts[i].begin(), parts[i].end() );
+	}
+}
+
+
+//-- private build -------------------------------------------------------------
+
+void
+Adjacency::buildNeighbours()
+{
+	// the other corners of the faces around each vertex, each once, in face
+	// order. Counted in a first pass and filled in a second, a stamp per
+	// vertex tells if it was seen for the current one.
+	std::vector<unsigned int> stamps;
+	neighbourFirst.assign( vertexCount + 1, 0 );
+	for ( int pass = 0; pass < 2; ++pass )
+	{
+		stamps.assign( vertexCount, vertexCount );
+		for ( unsigned int v = 0; v < vertexCount; ++v )
+		{
+			unsigned int n = pass ? neighbourFirst[v] : 0;
+			stamps[v] = v;
+			for ( unsigned int i = faceFirst[v]; i < faceFirst[v+1]; ++i )
+			{
+				const unsigned int* t = &indices[3 * faces[i]];
+				for ( unsigned int k = 0; k < 3; ++k )
+				{
+					if ( stamps[t[k]] == v )
+						continue;
+					stamps[t[k]] = v;
+					if ( pass )
+						neighbours[n] = t[k];
+					++n;
+				}
+			}
+			if ( !pass )
+				neighbourFirst[v+1] = n;
+		}
+		if ( !pass )
+		{
+			for ( unsigned int v = 0; v < vertexCount; ++v )
+			{
+				neighbourFirst[v+1] += neighbourFirst[v];
+			}
+			neighbours.resize( neighbourFirst[vertexCount] );
+		}
+	}
+}
+
+void
+Adjacency::buildTwins()
+{
+	// the twin of a -> b is a half-edge b -> a of a face around b, the first
+	// one in face order that is not taken yet
+	const unsigned int triCount = static_cast<unsigned int>( indices.size() /
+															 3 );
+	twins.assign( indices.size(), NO_TWIN );
+	for ( unsigned int f = 0; f < triCount; ++f )
+	{
+		for ( unsigned int k = 0; k < 3; ++k )
+		{
+			unsigned int h = 3 * f + k;
+			if ( twins[h] != NO_TWIN )
+				continue;
+			unsigned int a = indices[h];
+			unsigned int b = indices[3 * f + ( k + 1 ) % 3];
+			if ( a == b )
+				continue;
+			for ( unsigned int i = faceFirst[b]; i < faceFirst[b+1]; ++i )
+			{
+				unsigned int g = faces[i];
+				unsigned int j = 0;
+				for ( ; j < 3 && indices[3 * g + j] != b; ++j ) {}
+				unsigned int o = 3 * g + j;
+				if ( g != f && indices[3 * g + ( j + 1 ) % 3] == a &&
+					 twins[o] == NO_TWIN )
+				{
+					twins[h] = o;
+					twins[o] = h;
+					break;
+				}
+			}
+		}
+	}
+}
+
+
+//-- private k-ring queries ----------------------------------------------------
+
+void
+Adjacency::findRingRange( const unsigned int* idx, unsigned int begin,
+						  unsigned int end, unsigned int level,
+						  std::vector<unsigned int>* ends,
+						  std::vector<unsigned int>* rings ) const
+{
+	RingQuery query;
+	for ( unsigned int i = begin; i < end; ++i )
+	{
+		findRing( idx[i], level, &query );
+		rings->insert( rings->end(), query.ring.begin(), query.ring.end() );
+		ends->push_back( static_cast<unsigned int>( rings->size() ) );
+	}
+}
+
+
+//==============================================================================
+MEM_END_NAMESPACE
+//==============================================================================
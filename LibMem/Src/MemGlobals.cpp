@@ -9,6 +9,7 @@
 //== INCLUDES ==================================================================
 
 #include "MemGlobals.h"
+#include "MemAdjacency.h"
 #include "MemVector.h"
 #include "MemMatrix.h"
 #include "MemQuaternion.h"
@@ -87,53 +88,18 @@ findNeighbours( const std::vector<Vec3ui>& tri,
 				unsigned int level )
 
 {
-	// local vars
-	std::vector<unsigned int> nb;
-	unsigned int i, ibegin, iend;
-		
-
-	// initialize nb and index
-	nb.push_back( idx );
-	i = 0;
-
+	// one off query through a new Adjacency, callers with many queries on
+	// the same mesh keep an Adjacency and a RingQuery around instead
+	Adjacency adjacency( tri );
+	if ( idx >= adjacency.getVertexCount() )
+		return std::vector<unsigned int>( 1, idx );
+	Adjacency::RingQuery query;
+	adjacency.findRing( idx, level, &query );
 
-	while ( level > 0 )
-	{
-		// set range of current ring
-		ibegin = i;
-		iend = static_cast<unsigned int>(nb.size());
-
-
-		// loop of current range and add neighbours to the end
-		for ( i=ibegin; i!=iend; ++i )
-		{
-			unsigned int e = nb.at(i);
-
-			for ( std::vector<Vec3ui>::const_iterator
-					jt=tri.begin(), jend=tri.end(); jt!=jend; ++jt )
-			{
-				if ( e==(*jt)[0] || e==(*jt)[1] || e==(*jt)[2] )
-				{
-					nb.push_back( (*jt)[0] );
-					nb.push_back( (*jt)[1] );
-					nb.push_back( (*jt)[2] );
-				}
-			}
-		}
-
-
-		// decrease level
-		level--;
-	}
 
-
-	// remove duplicates (easiest to sort first and use unique)
-	std::vector<unsigned int>::const_iterator it;
+	// sorted, as always
+	std::vector<unsigned int> nb( query.ring );
 	std::sort( nb.begin(), nb.end() );
-	nb.erase( std::unique( nb.begin(), nb.end() ), nb.end() );
-
-
-	// return
 	return nb;
 }
 